@@ -419,6 +419,16 @@ typedef enum MAX30009_LEAD_RBIAS_VALUE_ENUM
 
 //CALIBRATE_______________________________________________________________________________________
 #define MAX30009_CALIB_DELAY_PERIOD	5
+#define MAX30009_CALIB_ADC_FREQ 3000                // ADC sample rate for calibrate in 1/10 Hertz
+#define MAX30009_CALIB_MAX_BURST_COUNT 42           // max FIFO bursts (6 items) read in one calibrate step
+#define MAX30009_CALIB_MIN_BLOCK_SIZE 16            // samples per channel in one settling block
+#define MAX30009_CALIB_SETTLE_BLOCKS 3              // consecutive stable blocks for settled signal
+#define MAX30009_CALIB_SETTLE_MAX_BLOCKS 60         // settling timeout in blocks
+#define MAX30009_CALIB_SETTLE_ABS_TOLERANCE 2.0     // block mean tolerance in ADC LSB
+#define MAX30009_CALIB_MIN_SAMPLES 64               // min averaged samples per channel
+#define MAX30009_CALIB_MAX_SAMPLES 480              // max averaged samples per channel
+#define MAX30009_CALIB_STDERR_ABS 0.5               // target standard error of mean in ADC LSB
+#define MAX30009_CALIB_STDERR_REL 0.0001            // target standard error of mean relative to mean
 
 typedef enum MAX30009_CALIB_STATE_ENUM
 {
@@ -438,6 +448,7 @@ typedef enum MAX30009_CALIB_STATE_ENUM
 
 
     MAX30009_CALIB_STATE_CALCULATE_COEF,
+    MAX30009_CALIB_STATE_MEAS_VERIFY,
 
     MAX30009_CALIB_STATE_READY,
     MAX30009_CALIB_STATE_PRE_READY,
@@ -454,12 +465,37 @@ typedef enum MAX30009_CALIB_SOURCE_ENUM
 
 }MAX30009_CALIB_SOURCE_ENUM_TYPE;
 
+typedef struct MAX30009_CALIB_STAT
+{
+    uint32_t count;
+    double mean;
+    double M2; //sum of squares of differences from the mean
+}MAX30009_CALIB_STAT_TYPE;
+
+typedef struct MAX30009_CALIB_MEAS
+{
+    MAX30009_CALIB_STAT_TYPE block_I;
+    MAX30009_CALIB_STAT_TYPE block_Q;
+    MAX30009_CALIB_STAT_TYPE prev_block_I;
+    MAX30009_CALIB_STAT_TYPE prev_block_Q;
+    MAX30009_CALIB_STAT_TYPE I;
+    MAX30009_CALIB_STAT_TYPE Q;
+    uint32_t stable_blocks;
+    uint32_t settle_blocks;
+    bool settled;
+}MAX30009_CALIB_MEAS_TYPE;
+
 typedef struct MAX30009_CALIB_DATA
 {
     MAX30009_CALIB_STATE_ENUM_TYPE calib_state;
     MAX30009_CALIB_SOURCE_ENUM_TYPE calib_source;
     uint32_t delay_in_calib;
-    bool need_full_FIFO_buffer;
+    MAX30009_CALIB_MEAS_TYPE meas;
+
+    bool offset_is_valid;
+    uint32_t offset_frequency;
+    MAX30009_BIOZ_TOTAL_GAIN_ENUM_TYPE offset_gain;
+    uint32_t PLL_frequency;
 
     double ref_value; //in milliohms
     MAX30009_CURRENT_AMP_ENUM_TYPE calibrate_current;
@@ -484,6 +520,12 @@ typedef struct MAX30009_CALIB_DATA
     double Q_phase_cos;
     double Q_phase_sin;
 
+    //calibrate quality
+    double I_noise; //standard deviation of in phase measure in ADC codes
+    double Q_noise;
+    double residual; //calibrated reference measure minus ref_value, in ohms
+    int64_t calibrate_time; //unix time of calibrate, set by caller
+
     uint16_t FIFO_data_count;
 
 }MAX30009_CALIB_DATA_TYPE;
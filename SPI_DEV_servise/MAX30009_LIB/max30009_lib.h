@@ -48,6 +48,29 @@ public:
      */
     bool set_drive_frequency(uint32_t drive_freq, uint32_t desired_ADC_freq);
 
+    /**
+        \brief find PLL and ADC dividers for stimulation drive frequency without write registers
+        \param [in] drive_freq - stimulation drive frequency in 1/10 hertz (the specified frequency may have an error)
+        \param [in] desired_ADC_freq - frequency of operation  of the ADC to which the calculation will aim in 1/10 Hertz.
+        \param [in] REF_CLK - reference clock frequency in 1/10 Hertz
+        \param [out] clk_solution - pointer to struct var for found clock solution
+        \return - true if solution found
+     */
+    static bool find_clock_solution(uint32_t drive_freq, uint32_t desired_ADC_freq, uint32_t REF_CLK, MAX30009_FIND_CLOCKS_STRUCT_TYPE *clk_solution);
+
+    /**
+        \brief write clock solution (from find_clock_solution) to PLL and BIOZ registers
+        \param [in] clk_solution - clock solution
+        \return - true if set successful
+     */
+    bool set_clock_solution(const MAX30009_FIND_CLOCKS_STRUCT_TYPE &clk_solution);
+
+    /**
+        \brief return selected reference clock frequency
+        \return - reference clock frequency in 1/10 Hertz
+     */
+    uint32_t get_reference_clock_frequency(void);
+
     /**
         \brief set PLL state
         \param [in] PLL_enable - PLL enable
@@ -513,6 +536,11 @@ public:
     */
     void stop_calibrate();
 
+    /**
+    \brief forget offset and PLL state of previous calibrate points. Call before start new calibrate sweep
+    */
+    void reset_calibrate_sequence(void);
+
 
     /**
         \brief load all registers from MAX30009 to work register array
@@ -564,6 +592,24 @@ private:
      */
     void write_register_without_check(MAX30009_REGISTER_ADDRESS_ENUM_TYPE register_address_enum);
 
+    /**
+        \brief read all FIFO data and wait settled I and Q values (running mean/variance convergence)
+        \param [out] FIFO_I_data - pointer to averaged I data
+        \param [out] FIFO_Q_data - pointer to averaged Q data
+        \return - true if averaged data ready
+     */
+    bool calibrate_collect_FIFO_data(MAX30009_FIFO_DATA *FIFO_I_data,MAX30009_FIFO_DATA *FIFO_Q_data);
+
+    /**
+        \brief clear statistic for new calibrate measure
+     */
+    void reset_calibrate_measure(void);
+
+    void add_calib_stat_value(MAX30009_CALIB_STAT_TYPE *stat, double value);
+    void merge_calib_stat(MAX30009_CALIB_STAT_TYPE *stat, const MAX30009_CALIB_STAT_TYPE &add_stat);
+    double get_calib_stat_variance(const MAX30009_CALIB_STAT_TYPE &stat);
+    bool calib_blocks_is_stable(const MAX30009_CALIB_STAT_TYPE &prev_block, const MAX30009_CALIB_STAT_TYPE &block);
+
 
     bool _lib_is_init=false;
     MAX30009_REGISTERS_TYPE _write_reg;
@@ -714,6 +760,14 @@ inline MAX30009_LIB::MAX30009_LIB(VT_sync_data_stream_interface *data_stream)
     _calib_data.Q_coef=1;
     _calib_data.I_phase_coef=1;
     _calib_data.Q_phase_coef=1;
+    _calib_data.I_noise=0;
+    _calib_data.Q_noise=0;
+    _calib_data.residual=0;
+    _calib_data.calibrate_time=0;
+
+    _calib_data.delay_in_calib=0;
+    reset_calibrate_measure();
+    reset_calibrate_sequence();
 
     _lib_is_init=true;
 
@@ -796,16 +850,32 @@ inline bool MAX30009_LIB::set_drive_frequency(uint32_t drive_freq, uint32_t desi
 {
     MAX30009_FIND_CLOCKS_STRUCT_TYPE best_clk_solution;
 
-    //check reference clock
-    uint32_t REF_CLK=0;
-    if (_write_reg.PLL_CONFIGURATION_4.CLK_FREQ_SEL==0)
+    find_clock_solution(drive_freq,desired_ADC_freq,get_reference_clock_frequency(),&best_clk_solution);
+
+    _best_clk_solution=best_clk_solution;
+
+    if (best_clk_solution.solution_count==0)
     {
-        REF_CLK=320000; // in 1/10 Hertz
+        return  false;   //no clk solution found
     }
-    else
+
+    return set_clock_solution(best_clk_solution);
+}
+
+inline uint32_t MAX30009_LIB::get_reference_clock_frequency()
+{
+    if (_write_reg.PLL_CONFIGURATION_4.CLK_FREQ_SEL==0)
     {
-        REF_CLK=327680; // in 1/10 Hertz
+        return 320000; // in 1/10 Hertz
     }
+    return 327680; // in 1/10 Hertz
+}
+
+inline bool MAX30009_LIB::find_clock_solution(uint32_t drive_freq, uint32_t desired_ADC_freq, uint32_t REF_CLK, MAX30009_FIND_CLOCKS_STRUCT_TYPE *clk_solution)
+{
+    MAX30009_FIND_CLOCKS_STRUCT_TYPE best_clk_solution= {0};
+
+    *clk_solution=best_clk_solution;
 
     if (drive_freq<MAX30009_MIN_DRIVE_FREQ)
     {
@@ -816,7 +886,6 @@ inline bool MAX30009_LIB::set_drive_frequency(uint32_t drive_freq, uint32_t desi
         return false;
     }
 
-
     for (uint32_t tr=0; tr<MAX30009_FIND_CLK_SOLUTION_TRY_COUNT; tr++)
     {
         best_clk_solution.solution_count=0;
@@ -940,15 +1009,21 @@ inline bool MAX30009_LIB::set_drive_frequency(uint32_t drive_freq, uint32_t desi
         }
     }
 
-    _best_clk_solution=best_clk_solution;
+    *clk_solution=best_clk_solution;
 
-    if (best_clk_solution.solution_count==0)
+    return best_clk_solution.solution_count!=0;
+}
+
+inline bool MAX30009_LIB::set_clock_solution(const MAX30009_FIND_CLOCKS_STRUCT_TYPE &clk_solution)
+{
+    if (clk_solution.solution_count==0)
     {
-        return  false;   //no clk solution found
+        return  false;   //no clk solution
     }
+    _best_clk_solution=clk_solution;
 
     //If F_BIOZ = BIOZ_ADC_CLK / 2, set BIOZ_INA_CHOP_EN = 0, otherwise set to 1
-    if (best_clk_solution.drive_freq==best_clk_solution.BIOZ_ADC_CLK/2)
+    if (clk_solution.drive_freq==clk_solution.BIOZ_ADC_CLK/2)
     {
         _write_reg.BIOZ_CONFIGURATION_7.BIOZ_INA_CHOP_EN=0;
     }
@@ -958,7 +1033,7 @@ inline bool MAX30009_LIB::set_drive_frequency(uint32_t drive_freq, uint32_t desi
     }
 
     //If F_BIOZ = BIOZ_ADC_CLK / 8, set BIOZ_CH_FSEL = 1, otherwise set to 0
-    if (best_clk_solution.drive_freq==best_clk_solution.BIOZ_ADC_CLK/8)
+    if (clk_solution.drive_freq==clk_solution.BIOZ_ADC_CLK/8)
     {
         _write_reg.BIOZ_CONFIGURATION_7.BIOZ_CH_FSEL=1;
     }
@@ -967,14 +1042,14 @@ inline bool MAX30009_LIB::set_drive_frequency(uint32_t drive_freq, uint32_t desi
         _write_reg.BIOZ_CONFIGURATION_7.BIOZ_CH_FSEL=1;
     }
 
-    _write_reg.PLL_CONFIGURATION_1.MDIV_H=(best_clk_solution.MDIV>>8) & 0x03;
-    _write_reg.PLL_CONFIGURATION_1.NDIV=best_clk_solution.NDIV & 0x01;
-    _write_reg.PLL_CONFIGURATION_1.KDIV=best_clk_solution.KDIV & 0x0F;
+    _write_reg.PLL_CONFIGURATION_1.MDIV_H=(clk_solution.MDIV>>8) & 0x03;
+    _write_reg.PLL_CONFIGURATION_1.NDIV=clk_solution.NDIV & 0x01;
+    _write_reg.PLL_CONFIGURATION_1.KDIV=clk_solution.KDIV & 0x0F;
 
-    _write_reg.PLL_CONFIGURATION_2.MDIV_L=best_clk_solution.MDIV & 0xFF;
+    _write_reg.PLL_CONFIGURATION_2.MDIV_L=clk_solution.MDIV & 0xFF;
 
-    _write_reg.BIOZ_CONFIGURATION_1.BIOZ_DAC_OSR=best_clk_solution.BIOZ_DAC_OSR & 0x03;
-    _write_reg.BIOZ_CONFIGURATION_1.BIOZ_ADC_OSR=best_clk_solution.BIOZ_ADC_OSR & 0x07;
+    _write_reg.BIOZ_CONFIGURATION_1.BIOZ_DAC_OSR=clk_solution.BIOZ_DAC_OSR & 0x03;
+    _write_reg.BIOZ_CONFIGURATION_1.BIOZ_ADC_OSR=clk_solution.BIOZ_ADC_OSR & 0x07;
 
     bool write_reg_result=true;
     if (write_register(MAX30009_ADDRESS_PLL_CONFIGURATION_1)==false)
@@ -1950,21 +2025,6 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
         return MAX30009_CALIB_IN_DELAY;
     }
 
-    if (_calib_data.need_full_FIFO_buffer==true)
-    {
-
-        //get_FIFO_data_count(&_calib_data.FIFO_data_count);
-        read_status(&status);
-        if (status.a_full_flag==false) //buffer is not full
-        {
-            return MAX30009_CALIB_WAIT_DATA;
-        }
-        else
-        {
-            _calib_data.need_full_FIFO_buffer=false;
-        }
-    }
-
 
     if (_calib_data.calib_state==MAX30009_CALIB_STATE_NEED_CALIB)
     {
@@ -1983,7 +2043,13 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
 
     if (_calib_data.calib_state==MAX30009_CALIB_STATE_START_MEAS_OFFSET)
     {
-        set_reference_clock_source(MAX30009_REFCLK_SRC_INT_32768);
+        //PLL stay locked between calibrate points with same frequency
+        bool PLL_is_locked=(_write_reg.PLL_CONFIGURATION_1.PLL_EN==1 && _calib_data.PLL_frequency==_calib_data.calibrate_frequency);
+
+        if (PLL_is_locked==false)
+        {
+            set_reference_clock_source(MAX30009_REFCLK_SRC_INT_32768);
+        }
         set_MUX_state(false);
 
         set_MUX_BIST_enable(false);
@@ -2004,15 +2070,20 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
         set_input_HP_filter(MAX30009_BIOZ_IN_HPFILTER_BYPASS);
         set_out_DHP_filter(MAX30009_BIOZ_DHPF_BYPASS);
         set_out_DLP_filter(MAX30009_BIOZ_DLPF_BYPASS);
-        set_drive_frequency(_calib_data.calibrate_frequency*10,3000);
-
+        if (PLL_is_locked==false)
+        {
+            set_drive_frequency(_calib_data.calibrate_frequency*10,MAX30009_CALIB_ADC_FREQ);
+        }
 
         set_BIOZ_constant_current_mode(MAX30009_CURRENT_AMP_16nA); //set minimum current
         set_BIOZ_DRV_RESET(true);
 
 
-
-        set_PLL_state(true);
+        if (PLL_is_locked==false)
+        {
+            set_PLL_state(true);
+            _calib_data.PLL_frequency=_calib_data.calibrate_frequency;
+        }
         set_BIOZ_I_channel_state(true);
         set_BIOZ_Q_channel_state(true);
 
@@ -2021,10 +2092,17 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
 
         set_FIFO_A_FULL_size(250);
 
-
+        //offset is measured with minimum current, so it is same for all currents on this frequency
+        if (_calib_data.offset_is_valid==true &&
+                _calib_data.offset_frequency==_calib_data.calibrate_frequency &&
+                _calib_data.offset_gain==_calib_data.calibrate_gain)
+        {
+            _calib_data.calib_state=MAX30009_CALIB_STATE_START_MEAS_IN_PHASE;
+            return _calib_data.calib_state;
+        }
 
         _calib_data.delay_in_calib=MAX30009_CALIB_DELAY_PERIOD;
-        _calib_data.need_full_FIFO_buffer=true;
+        reset_calibrate_measure();
 
         _calib_data.calib_state=MAX30009_CALIB_STATE_MEAS_OFFSET;
         return _calib_data.calib_state;
@@ -2032,10 +2110,17 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
 
     if (_calib_data.calib_state==MAX30009_CALIB_STATE_MEAS_OFFSET)
     {
-        get_FIFO_average_all_value(&FIFO_I_data, &FIFO_Q_data);
+        if (calibrate_collect_FIFO_data(&FIFO_I_data, &FIFO_Q_data)==false)
+        {
+            return MAX30009_CALIB_WAIT_DATA;
+        }
         _calib_data.I_offset=(double)FIFO_I_data.channel_value;
         _calib_data.Q_offset=(double)FIFO_Q_data.channel_value;
 
+        _calib_data.offset_is_valid=true;
+        _calib_data.offset_frequency=_calib_data.calibrate_frequency;
+        _calib_data.offset_gain=_calib_data.calibrate_gain;
+
         _calib_data.calib_state=MAX30009_CALIB_STATE_START_MEAS_IN_PHASE;
         return _calib_data.calib_state;
     }
@@ -2068,8 +2153,8 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
         set_BIOZ_Q_CLK_PHASE(true);
 
 
-        _calib_data.delay_in_calib=MAX30009_CALIB_DELAY_PERIOD*3;
-        _calib_data.need_full_FIFO_buffer=true;
+        _calib_data.delay_in_calib=MAX30009_CALIB_DELAY_PERIOD;
+        reset_calibrate_measure();
 
         _calib_data.calib_state=MAX30009_CALIB_STATE_MEAS_IN_PHASE;
         return _calib_data.calib_state;
@@ -2077,10 +2162,15 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
 
     if (_calib_data.calib_state==MAX30009_CALIB_STATE_MEAS_IN_PHASE)
     {
-        get_FIFO_average_all_value(&FIFO_I_data, &FIFO_Q_data);
+        if (calibrate_collect_FIFO_data(&FIFO_I_data, &FIFO_Q_data)==false)
+        {
+            return MAX30009_CALIB_WAIT_DATA;
+        }
 
         _calib_data.I_cal_in_ADC=FIFO_I_data.channel_value;
         _calib_data.Q_cal_in_ADC=FIFO_Q_data.channel_value;
+        _calib_data.I_noise=sqrt(get_calib_stat_variance(_calib_data.meas.I));
+        _calib_data.Q_noise=sqrt(get_calib_stat_variance(_calib_data.meas.Q));
 
         calculate_impendance(&FIFO_I_data,_calib_data);
         calculate_impendance(&FIFO_Q_data,_calib_data);
@@ -2098,7 +2188,7 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
         set_BIOZ_Q_CLK_PHASE(false);
 
         _calib_data.delay_in_calib=MAX30009_CALIB_DELAY_PERIOD;
-        _calib_data.need_full_FIFO_buffer=true;
+        reset_calibrate_measure();
 
         _calib_data.calib_state=MAX30009_CALIB_STATE_MEAS_QUAD;
         return _calib_data.calib_state;
@@ -2106,7 +2196,10 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
 
     if (_calib_data.calib_state==MAX30009_CALIB_STATE_MEAS_QUAD)
     {
-        get_FIFO_average_all_value(&FIFO_I_data, &FIFO_Q_data);
+        if (calibrate_collect_FIFO_data(&FIFO_I_data, &FIFO_Q_data)==false)
+        {
+            return MAX30009_CALIB_WAIT_DATA;
+        }
         calculate_impendance(&FIFO_I_data,_calib_data);
         calculate_impendance(&FIFO_Q_data,_calib_data);
         _calib_data.I_cal_quad=(double)FIFO_I_data.impendance_value/100.0;
@@ -2119,15 +2212,9 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
     if (_calib_data.calib_state==MAX30009_CALIB_STATE_CALCULATE_COEF)
     {
 
+        //measure reference again with normal clock phases to check coefficients
         set_BIOZ_I_CLK_PHASE(false);
         set_BIOZ_Q_CLK_PHASE(false);
-        set_PLL_state(false);
-        set_MUX_state(false);
-        set_BIOZ_I_channel_state(false);
-        set_BIOZ_Q_channel_state(false);
-        set_MUX_CAL_state(false);
-        set_MUX_CAL_ONLY_state(false);
-        Flush_FIFO();
 
         //		1. I_coef = √(I_cal_in^2 + I_cal_quad^2) / RCAL
         //		2. Q_coef = √(Q_cal_in^2 + Q_cal_quad^2) / RCAL
@@ -2146,6 +2233,30 @@ inline MAX30009_CALIB_STATE_ENUM_TYPE MAX30009_LIB::calibrate_main_proccess()
         _calib_data.Q_phase_cos=cos(_calib_data.Q_phase_coef*M_PI/180.0);
         _calib_data.Q_phase_sin=sin(_calib_data.Q_phase_coef*M_PI/180.0);
 
+        _calib_data.delay_in_calib=MAX30009_CALIB_DELAY_PERIOD;
+        reset_calibrate_measure();
+
+        _calib_data.calib_state=MAX30009_CALIB_STATE_MEAS_VERIFY;
+        return _calib_data.calib_state;
+    }
+
+    if (_calib_data.calib_state==MAX30009_CALIB_STATE_MEAS_VERIFY)
+    {
+        if (calibrate_collect_FIFO_data(&FIFO_I_data, &FIFO_Q_data)==false)
+        {
+            return MAX30009_CALIB_WAIT_DATA;
+        }
+        calculate_impendance(&FIFO_I_data,_calib_data);
+        calculate_impendance(&FIFO_Q_data,_calib_data);
+        MAX30009_FIFO_DATA_CALIB_TYPE verify_data=calibrate_FIFO_data(FIFO_I_data,FIFO_Q_data,_calib_data);
+        _calib_data.residual=verify_data.Load_mag-_calib_data.ref_value;
+
+        //PLL and I/Q channels stay enabled for next calibrate point
+        set_MUX_state(false);
+        set_MUX_CAL_state(false);
+        set_MUX_CAL_ONLY_state(false);
+        Flush_FIFO();
+
         _calib_data.calib_state=MAX30009_CALIB_STATE_PRE_READY;
         return _calib_data.calib_state;
     }
@@ -2167,7 +2278,159 @@ inline void MAX30009_LIB::start_calibrate(MAX30009_CALIB_SOURCE_ENUM_TYPE calib_
     _calib_data.calibrate_current=calibrate_current;
     _calib_data.calibrate_frequency=calibrate_frequency;
     _calib_data.calibrate_gain=calibrate_gain;
-    _calib_data.need_full_FIFO_buffer=false;
+    _calib_data.delay_in_calib=0;
+    reset_calibrate_measure();
+}
+
+inline bool MAX30009_LIB::calibrate_collect_FIFO_data(MAX30009_FIFO_DATA *FIFO_I_data, MAX30009_FIFO_DATA *FIFO_Q_data)
+{
+    uint8_t request_array[20];
+    request_array[0]=(uint8_t)MAX30009_ADDRESS_FIFO_DATA_REGISTER;
+    request_array[1]=MAX30009_REGISTER_READ_DIRECT;
+    for (uint32_t i=2; i<20; i++)
+    {
+        request_array[i]=MAX30009_DUMMY_BYTE;
+    }
+    uint8_t answer_array[20];
+
+    MAX30009_CALIB_MEAS_TYPE *meas=&_calib_data.meas;
+
+    bool FIFO_is_empty=false;
+    for (uint32_t p=0; p<MAX30009_CALIB_MAX_BURST_COUNT && FIFO_is_empty==false; p++)
+    {
+        if (SPI_data_transfer(request_array,answer_array,20)==false)
+        {
+            break;
+        }
+
+        for (uint32_t i=0; i<6; i++)
+        {
+            MAX30009_FIFO_DATA FIFO_data=encode_FIFO_data(&answer_array[2+i*3]);
+
+            if (FIFO_data.data_source==MAX30009_I_CHANNEL)
+            {
+                add_calib_stat_value(&meas->block_I,FIFO_data.channel_value);
+            }
+            else if (FIFO_data.data_source==MAX30009_Q_CHANNEL)
+            {
+                add_calib_stat_value(&meas->block_Q,FIFO_data.channel_value);
+            }
+            else if (FIFO_data.data_source==MAX30009_ERROR_DATA_SOURCE)
+            {
+                FIFO_is_empty=true; //rest of burst is not valid data
+                break;
+            }
+        }
+    }
+
+    if (meas->block_I.count<MAX30009_CALIB_MIN_BLOCK_SIZE || meas->block_Q.count<MAX30009_CALIB_MIN_BLOCK_SIZE)
+    {
+        return false; //block is not complete
+    }
+
+    if (meas->settled==false)
+    {
+        //wait while mean of block is not changed more than noise
+        meas->settle_blocks++;
+        if (meas->prev_block_I.count>0 &&
+                calib_blocks_is_stable(meas->prev_block_I,meas->block_I) &&
+                calib_blocks_is_stable(meas->prev_block_Q,meas->block_Q))
+        {
+            meas->stable_blocks++;
+        }
+        else
+        {
+            meas->stable_blocks=0;
+        }
+
+        if (meas->stable_blocks>=MAX30009_CALIB_SETTLE_BLOCKS || meas->settle_blocks>=MAX30009_CALIB_SETTLE_MAX_BLOCKS)
+        {
+            meas->settled=true;
+            merge_calib_stat(&meas->I,meas->block_I);
+            merge_calib_stat(&meas->Q,meas->block_Q);
+        }
+        meas->prev_block_I=meas->block_I;
+        meas->prev_block_Q=meas->block_Q;
+    }
+    else
+    {
+        merge_calib_stat(&meas->I,meas->block_I);
+        merge_calib_stat(&meas->Q,meas->block_Q);
+    }
+    meas->block_I= {0,0,0};
+    meas->block_Q= {0,0,0};
+
+    if (meas->settled==false || meas->I.count<MAX30009_CALIB_MIN_SAMPLES || meas->Q.count<MAX30009_CALIB_MIN_SAMPLES)
+    {
+        return false;
+    }
+
+    //average until standard error of mean is small enough
+    double I_stderr=sqrt(get_calib_stat_variance(meas->I)/meas->I.count);
+    double Q_stderr=sqrt(get_calib_stat_variance(meas->Q)/meas->Q.count);
+    bool I_is_ready=(I_stderr<=MAX30009_CALIB_STDERR_ABS || I_stderr<=fabs(meas->I.mean)*MAX30009_CALIB_STDERR_REL);
+    bool Q_is_ready=(Q_stderr<=MAX30009_CALIB_STDERR_ABS || Q_stderr<=fabs(meas->Q.mean)*MAX30009_CALIB_STDERR_REL);
+
+    if ((I_is_ready==false || Q_is_ready==false) && meas->I.count<MAX30009_CALIB_MAX_SAMPLES)
+    {
+        return false;
+    }
+
+    FIFO_I_data->channel_value=(int32_t)lround(meas->I.mean);
+    FIFO_I_data->data_source=MAX30009_I_CHANNEL;
+
+    FIFO_Q_data->channel_value=(int32_t)lround(meas->Q.mean);
+    FIFO_Q_data->data_source=MAX30009_Q_CHANNEL;
+    return true;
+}
+
+inline void MAX30009_LIB::reset_calibrate_measure()
+{
+    MAX30009_CALIB_MEAS_TYPE empty_meas= {};
+    _calib_data.meas=empty_meas;
+}
+
+inline void MAX30009_LIB::add_calib_stat_value(MAX30009_CALIB_STAT_TYPE *stat, double value)
+{
+    //Welford running mean/variance
+    stat->count++;
+    double delta=value-stat->mean;
+    stat->mean=stat->mean+delta/stat->count;
+    stat->M2=stat->M2+delta*(value-stat->mean);
+}
+
+inline void MAX30009_LIB::merge_calib_stat(MAX30009_CALIB_STAT_TYPE *stat, const MAX30009_CALIB_STAT_TYPE &add_stat)
+{
+    if (add_stat.count==0)
+    {
+        return;
+    }
+    if (stat->count==0)
+    {
+        *stat=add_stat;
+        return;
+    }
+    double count=(double)stat->count+(double)add_stat.count;
+    double delta=add_stat.mean-stat->mean;
+    stat->mean=stat->mean+delta*add_stat.count/count;
+    stat->M2=stat->M2+add_stat.M2+delta*delta*(double)stat->count*(double)add_stat.count/count;
+    stat->count=stat->count+add_stat.count;
+}
+
+inline double MAX30009_LIB::get_calib_stat_variance(const MAX30009_CALIB_STAT_TYPE &stat)
+{
+    if (stat.count<2)
+    {
+        return 0;
+    }
+    return stat.M2/(stat.count-1);
+}
+
+inline bool MAX30009_LIB::calib_blocks_is_stable(const MAX30009_CALIB_STAT_TYPE &prev_block, const MAX30009_CALIB_STAT_TYPE &block)
+{
+    //difference of means must be in 3 sigma of its noise
+    double diff_sigma=sqrt(get_calib_stat_variance(prev_block)/prev_block.count+get_calib_stat_variance(block)/block.count);
+    return fabs(block.mean-prev_block.mean)<=(3.0*diff_sigma+MAX30009_CALIB_SETTLE_ABS_TOLERANCE);
 }
 
 inline MAX30009_FIFO_DATA_CALIB_TYPE MAX30009_LIB::calibrate_FIFO_data(MAX30009_FIFO_DATA I_data, MAX30009_FIFO_DATA Q_data, MAX30009_CALIB_DATA_TYPE calib_data)
@@ -2243,6 +2506,12 @@ inline void MAX30009_LIB::stop_calibrate()
     _calib_data.calib_state=MAX30009_CALIB_STATE_STOPED;
 }
 
+inline void MAX30009_LIB::reset_calibrate_sequence()
+{
+    _calib_data.offset_is_valid=false;
+    _calib_data.PLL_frequency=0;
+}
+
 inline bool MAX30009_LIB::start_load_all_registers()
 {
     if (_lib_is_init==false)
@@ -4,6 +4,18 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <chrono>
+
+#include "JSON_stream_writer.h"
+#include "JSON_command_parser.h"
+#include "Sync_mark_index.h"
+#include "Sample_ring.h"
+#include "Envelope_pyramid.h"
+#include "Stream_tap.h"
+#include "Biquad_filter_bank.h"
+#include "QRS_detector.h"
+#include "Sample_clock_model.h"
+#include "Timestamp_formatter.h"
 
 
 typedef struct ADS1293_USER_SETTINGS
@@ -23,6 +35,13 @@ typedef struct ADS1293_IFIFO_DATA
     int32_t ch3;
 } ADS1293_IFIFO_DATA_TDS;
 
+//samples of get_data
+typedef enum ADS1293_OUTPUT
+{
+    ADS1293_OUTPUT_RAW=0,    // as read from device
+    ADS1293_OUTPUT_FILTERED  // after filter bank, the same sequence numbers
+} ADS1293_OUTPUT_TDE;
+
 class ADS1293_process
 {
 public:
@@ -35,23 +54,94 @@ public:
 
     std::string get_all_settings_as_json(void);
     void process_all_settings_for_ADS1293(void);
-    std::string get_data_as_json(void);
+    std::string get_data_as_json(const DATA_REQUEST_TDS& request, ADS1293_OUTPUT_TDE output);
+    uint32_t get_available_samples(const DATA_REQUEST_TDS& request);
+    std::string process_pending_data_request(void);
+    bool is_data_request_pending(void);
+    void cancel_data_request(void);
+
+    /**
+        \brief min/max/mean envelope of last samples for screen
+        \param [in] width - count of pixels
+        \param [in] duration_ms - window length
+        \return - JSON response
+     */
+    std::string get_preview_as_json(uint32_t width, uint32_t duration_ms);
+
+    //notch, baseline wander and low-pass filters of all channels, they are applied once at acquisition
+    std::string get_filter_as_json(void);
+
+    /**
+        \brief R peaks of detector, event stream is read as data: with cursor (beat number) or by default reader
+        \param [in] request - from_seq/max_samples are beat numbers and count of beats
+        \return - JSON response
+     */
+    std::string get_beats_as_json(const DATA_REQUEST_TDS& request);
+    uint32_t get_available_beats(const DATA_REQUEST_TDS& request);
+
+    //named output streams with own decimation and filter
+    std::string get_tap_data_as_json(std::string_view tap_name, const DATA_REQUEST_TDS& request);
+
+    //samples access for aligned ECG/ICG data
+    Sample_clock_model& get_clock_model(void);
+    uint64_t get_oldest_seq(void);
+    uint64_t get_write_seq(void);
+    bool read_sample(uint64_t seq, ADS1293_IFIFO_DATA_TDS *item);
+    Sample_ring<QRS_BEAT_TDS>& get_beats(void);
+
+    //session recording
+    Sync_mark_index& get_sync_marks(void);
+    uint32_t get_settings_version(void);
 
         void set_power_state(bool state);
 
-            std::string get_timestamp_string();
 protected:
 
 private:
 
 ADS1293_USER_SETTINGS_TDE ADS1293_user_sett={0};
 
-static const int32_t SYNC_MARK_MAGIC_NUM=-99999;
-    static const uint32_t IFIFO_BUFF_SIZE=3000;
-    ADS1293_IFIFO_DATA_TDS _IFIFO_BUF[IFIFO_BUFF_SIZE]= {0};
-    uint32_t _IFIFO_write_pos=0;
-    uint32_t _IFIFO_read_pos=0;
-
+    //R1 decimation and modulator clock are not changed from default
+    static const uint32_t SDM_FREQUENCY=102400;
+    static const uint32_t R1_RATE=4;
+    static const uint32_t IFIFO_BUFFER_DURATION=10;
+    static const uint32_t IFIFO_BUFF_SIZE=4096;
+    Sample_ring<ADS1293_IFIFO_DATA_TDS> _IFIFO {IFIFO_BUFF_SIZE};
+
+    static const uint32_t CHANNELS_COUNT=3;
+    static const uint32_t PREVIEW_DURATION=120;     // seconds of envelope pyramid
+    static const uint32_t MAX_PREVIEW_WIDTH=4096;
+    static const uint32_t DEFAULT_PREVIEW_WIDTH=1000;
+    static const uint32_t DEFAULT_PREVIEW_DURATION_MS=30000;
+    Envelope_pyramid<CHANNELS_COUNT> _preview;
+    Stream_tap_bank<CHANNELS_COUNT> _taps;
+
+    //filtered samples are written with raw samples, ring of filtered samples has the same sequence numbers
+    static constexpr double DEFAULT_NOTCH_FREQUENCY=50.0;
+    static constexpr double DEFAULT_HIGHPASS_FREQUENCY=0.5;
+    static constexpr double DEFAULT_LOWPASS_FREQUENCY=0;    // off, band is limited by R3 decimation filter
+    BIQUAD_FILTER_SETTINGS_TDS _filter_settings= {DEFAULT_NOTCH_FREQUENCY,DEFAULT_HIGHPASS_FREQUENCY,DEFAULT_LOWPASS_FREQUENCY};
+    Biquad_filter_bank<CHANNELS_COUNT> _filter;
+    Sample_ring<ADS1293_IFIFO_DATA_TDS> _filtered_IFIFO {IFIFO_BUFF_SIZE};
+
+    //beats of all leads, sequence numbers of beats continue over settings
+    static const uint32_t BEATS_BUFF_SIZE=512;
+    QRS_detector<CHANNELS_COUNT> _QRS_detector;
+    Sample_ring<QRS_BEAT_TDS> _beats {BEATS_BUFF_SIZE};
+
+    Sync_mark_index _sync_marks;
+    Sample_clock_model _clock_model;
+    Timestamp_formatter _timestamp_formatter;
+    uint32_t _settings_version=0; // changed when settings are applied
+
+    DATA_REQUEST_TDS _pending_data_request= {false,0,0,0,0};
+    ADS1293_OUTPUT_TDE _pending_data_output=ADS1293_OUTPUT_RAW;
+    bool _is_pending_beats=false; // pending request is get_beats
+    std::chrono::steady_clock::time_point _pending_data_deadline;
+    bool _is_data_request_pending=false;
+
+    static const uint32_t JSON_BUFFER_RESERVE=IFIFO_BUFF_SIZE*40;
+    JSON_stream_writer _json_writer {JSON_BUFFER_RESERVE};
 
     bool _old_power_state=false;
 
@@ -0,0 +1,13 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+//count of heap allocations of calling thread. Global operator new is replaced in Alloc_counter.cpp only in
+//diagnostic build with ALLOC_COUNTER define (Debug target), difference of two counts shows allocations
+//of code between them (hot paths must keep it 0)
+#ifdef ALLOC_COUNTER
+uint64_t get_thread_alloc_count(void);
+#endif
+
+#endif // ALLOC_COUNTER_H
@@ -0,0 +1,187 @@
+#ifndef BIQUAD_FILTER_BANK_H
+#define BIQUAD_FILTER_BANK_H
+
+#include <cstdint>
+#include <cmath>
+
+typedef enum BIQUAD_STAGE
+{
+    BIQUAD_STAGE_NOTCH=0,    // mains interference
+    BIQUAD_STAGE_HIGHPASS,   // baseline wander
+    BIQUAD_STAGE_LOWPASS,
+    BIQUAD_STAGES_COUNT
+} BIQUAD_STAGE_TDE;
+
+//frequencies of stages in Hertz, 0 - stage is off
+typedef struct BIQUAD_FILTER_SETTINGS
+{
+    double notch_frequency;
+    double highpass_frequency;
+    double lowpass_frequency;
+} BIQUAD_FILTER_SETTINGS_TDS;
+
+//cascade of second order sections (notch, Butterworth high-pass, Butterworth low-pass) with the same coefficients
+//for CHANNELS channels. Channels are lanes of one loop, so compiler can vectorize it. Coefficients are computed
+//for sample rate (RBJ bilinear transform), stage is off when its frequency is not below Nyquist margin.
+//State is primed by first sample as steady state of constant input, filter starts without transient
+template <uint32_t CHANNELS>
+class Biquad_filter_bank
+{
+public:
+    static constexpr double NOTCH_Q=30.0;            // -3 dB width is frequency/Q
+    static constexpr double BUTTERWORTH_Q=0.7071067811865476;
+    static constexpr double MAX_FREQUENCY_RATIO=0.45; // of sample rate
+
+    Biquad_filter_bank()
+    {
+        reset({0,0,0},0);
+    }
+
+    /**
+        \brief compute coefficients and drop state
+        \param [in] settings - requested frequencies
+        \param [in] sample_rate - rate of samples, Hz
+     */
+    void reset(const BIQUAD_FILTER_SETTINGS_TDS& settings, double sample_rate)
+    {
+        _settings=settings;
+        _sample_rate=sample_rate;
+        _sections_count=0;
+        set_stage(BIQUAD_STAGE_NOTCH,&_settings.notch_frequency);
+        set_stage(BIQUAD_STAGE_HIGHPASS,&_settings.highpass_frequency);
+        set_stage(BIQUAD_STAGE_LOWPASS,&_settings.lowpass_frequency);
+        _is_primed=false;
+    }
+
+    //settings with frequencies of stages which are on
+    const BIQUAD_FILTER_SETTINGS_TDS& get_settings(void)
+    {
+        return _settings;
+    }
+
+    double get_sample_rate(void)
+    {
+        return _sample_rate;
+    }
+
+    uint32_t get_sections_count(void)
+    {
+        return _sections_count;
+    }
+
+    /**
+        \brief filter one sample of all channels
+        \param [in] values - input sample
+        \param [out] filtered - output sample, rounded
+     */
+    void process(const int32_t *values, int32_t *filtered)
+    {
+        double x[LANES]= {};
+        for (uint32_t j=0; j<CHANNELS; j++)
+        {
+            x[j]=values[j];
+        }
+        if (_is_primed==false)
+        {
+            prime(x);
+        }
+        //transposed direct form II
+        for (uint32_t k=0; k<_sections_count; k++)
+        {
+            SECTION_TDS& section=_sections[k];
+            for (uint32_t j=0; j<LANES; j++)
+            {
+                double y=section.b0*x[j]+section.s1[j];
+                section.s1[j]=section.b1*x[j]-section.a1*y+section.s2[j];
+                section.s2[j]=section.b2*x[j]-section.a2*y;
+                x[j]=y;
+            }
+        }
+        for (uint32_t j=0; j<CHANNELS; j++)
+        {
+            filtered[j]=(int32_t)std::lround(x[j]);
+        }
+    }
+
+protected:
+
+private:
+    //channels are padded to lanes of SIMD register
+    static const uint32_t LANES=(CHANNELS+3) & ~3u;
+
+    typedef struct SECTION
+    {
+        double b0,b1,b2;
+        double a1,a2;    // a0 is 1
+        alignas(32) double s1[LANES];
+        alignas(32) double s2[LANES];
+    } SECTION_TDS;
+
+    void set_stage(BIQUAD_STAGE_TDE stage, double *frequency)
+    {
+        if (*frequency<=0 || _sample_rate<=0 || *frequency>=_sample_rate*MAX_FREQUENCY_RATIO)
+        {
+            *frequency=0;
+            return;
+        }
+        double w0=2.0*M_PI*(*frequency)/_sample_rate;
+        double cos_w0=std::cos(w0);
+        double alpha=std::sin(w0)/(2.0*(stage==BIQUAD_STAGE_NOTCH ? NOTCH_Q : BUTTERWORTH_Q));
+        double a0=1.0+alpha;
+        SECTION_TDS& section=_sections[_sections_count++];
+        switch (stage)
+        {
+        case BIQUAD_STAGE_NOTCH:
+            section.b0=1.0;
+            section.b1=-2.0*cos_w0;
+            section.b2=1.0;
+            break;
+        case BIQUAD_STAGE_HIGHPASS:
+            section.b0=(1.0+cos_w0)/2.0;
+            section.b1=-(1.0+cos_w0);
+            section.b2=(1.0+cos_w0)/2.0;
+            break;
+        default:
+            section.b0=(1.0-cos_w0)/2.0;
+            section.b1=1.0-cos_w0;
+            section.b2=(1.0-cos_w0)/2.0;
+            break;
+        }
+        section.b0/=a0;
+        section.b1/=a0;
+        section.b2/=a0;
+        section.a1=-2.0*cos_w0/a0;
+        section.a2=(1.0-alpha)/a0;
+    }
+
+    //state of every section is set as for infinite constant input x
+    void prime(const double *x)
+    {
+        double input[LANES];
+        for (uint32_t j=0; j<LANES; j++)
+        {
+            input[j]=x[j];
+        }
+        for (uint32_t k=0; k<_sections_count; k++)
+        {
+            SECTION_TDS& section=_sections[k];
+            double gain=(section.b0+section.b1+section.b2)/(1.0+section.a1+section.a2);
+            for (uint32_t j=0; j<LANES; j++)
+            {
+                double y=gain*input[j];
+                section.s2[j]=section.b2*input[j]-section.a2*y;
+                section.s1[j]=section.b1*input[j]-section.a1*y+section.s2[j];
+                input[j]=y;
+            }
+        }
+        _is_primed=true;
+    }
+
+    SECTION_TDS _sections[BIQUAD_STAGES_COUNT];
+    uint32_t _sections_count=0;
+    BIQUAD_FILTER_SETTINGS_TDS _settings= {0,0,0};
+    double _sample_rate=0;
+    bool _is_primed=false;
+};
+
+#endif // BIQUAD_FILTER_BANK_H
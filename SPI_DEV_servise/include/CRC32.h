@@ -0,0 +1,43 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <cstdint>
+#include <cstddef>
+
+//CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320)
+typedef struct CRC32_TABLE
+{
+    uint32_t value[256];
+    constexpr CRC32_TABLE() : value()
+    {
+        for (uint32_t i=0; i<256; i++)
+        {
+            uint32_t c=i;
+            for (uint32_t k=0; k<8; k++)
+            {
+                c=(c & 1) ? (0xEDB88320u^(c>>1)) : (c>>1);
+            }
+            value[i]=c;
+        }
+    }
+} CRC32_TABLE_TDS;
+
+class CRC32
+{
+public:
+    static uint32_t calculate(const void *data, size_t size, uint32_t crc=0)
+    {
+        const uint8_t *bytes=(const uint8_t *)data;
+        crc=~crc;
+        for (size_t i=0; i<size; i++)
+        {
+            crc=_table.value[(crc^bytes[i]) & 0xFF]^(crc>>8);
+        }
+        return ~crc;
+    }
+
+private:
+    static constexpr CRC32_TABLE_TDS _table{};
+};
+
+#endif // CRC32_H
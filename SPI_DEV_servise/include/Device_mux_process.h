@@ -0,0 +1,91 @@
+#ifndef DEVICE_MUX_PROCESS_H
+#define DEVICE_MUX_PROCESS_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "ADS1293_process.h"
+#include "MAX30009_process.h"
+#include "WS2812_process.h"
+#include "ECG_ICG_align_process.h"
+#include "Session_recorder.h"
+#include "JSON_stream_writer.h"
+#include "JSON_command_parser.h"
+
+typedef enum MUX_DEVICE
+{
+    MUX_DEVICE_ADS1293=0,
+    MUX_DEVICE_MAX30009,
+    MUX_DEVICE_WS2812,
+    MUX_DEVICE_ALIGN,
+    MUX_DEVICE_RECORDER,
+    MUX_DEVICE_COUNT
+} MUX_DEVICE_TDE;
+
+//one connection for all devices: every command has "device" key and is passed to process of this device,
+//response is {"device":..., "response":{...}}. Batch command {"type":"batch","requests":[...]} gets
+//responses of all commands in one message. Waiting get_data requests (long poll) of batch are answered together,
+//batch has one command per device which can wait (ADS1293, MAX30009)
+class Device_mux_process
+{
+public:
+    Device_mux_process(ADS1293_process *ADS1293_process_ptr, MAX30009_process *MAX30009_process_ptr,
+                       WS2812_process *WS2812_process_ptr, ECG_ICG_align_process *align_process_ptr,
+                       Session_recorder *session_recorder_ptr);
+
+    std::string process_JSON_line(const char * JSON_line);
+    std::string process_pending_request(void);
+
+    /**
+        \brief check if waiting get_data request of device belongs to mux, its response must not be sent to device port
+        \param [in] device - device
+        \return - true if mux waits for response of device
+     */
+    bool is_device_pending(MUX_DEVICE_TDE device);
+
+    /**
+        \brief cancel waiting requests of devices which belong to mux, when client of mux port is gone
+     */
+    void cancel_pending_request(void);
+
+protected:
+
+private:
+    static const uint32_t MAX_BATCH_REQUESTS=16;
+    static const uint32_t PENDING_MARGIN_MS=1000; // devices answer their waiting requests before timeout of mux
+    static constexpr const char* DEVICE_NAMES[MUX_DEVICE_COUNT]= {"ADS1293","MAX30009","WS2812","ALIGN","RECORDER"};
+
+    typedef struct MUX_SLOT
+    {
+        MUX_DEVICE_TDE device;
+        bool is_pending;
+        std::string response;
+    } MUX_SLOT_TDS;
+
+    static bool is_long_poll_device(MUX_DEVICE_TDE device);
+    bool find_device(std::string_view name, MUX_DEVICE_TDE *device);
+    bool read_device(const char *command, MUX_DEVICE_TDE *device);
+    bool read_command_type(const char *command, std::string_view *command_type);
+    std::string send_to_device(MUX_DEVICE_TDE device, const char *command);
+    std::string get_pending_response(MUX_DEVICE_TDE device);
+    void cancel_device_request(MUX_DEVICE_TDE device);
+    std::string get_response_as_json(void);
+
+    ADS1293_process *_ADS1293_process;
+    MAX30009_process *_MAX30009_process;
+    WS2812_process *_WS2812_process;
+    ECG_ICG_align_process *_align_process;
+    Session_recorder *_session_recorder;
+
+    std::vector<MUX_SLOT_TDS> _slots;
+    bool _is_batch=false;
+    bool _is_pending=false;
+    std::chrono::steady_clock::time_point _pending_deadline;
+    std::string _command_text; // sub command copy, device parser needs end of text
+
+    JSON_stream_writer _json_writer {1024*1024};
+};
+
+#endif // DEVICE_MUX_PROCESS_H
@@ -0,0 +1,68 @@
+#ifndef ECG_ICG_ALIGN_PROCESS_H
+#define ECG_ICG_ALIGN_PROCESS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "ADS1293_process.h"
+#include "MAX30009_process.h"
+#include "JSON_stream_writer.h"
+#include "JSON_command_parser.h"
+#include "Polyphase_resampler.h"
+#include "Timestamp_formatter.h"
+
+typedef struct ALIGN_REQUEST
+{
+    bool use_cursor;      // from_time_ns is set, read does not change default reader
+    int64_t from_time_ns; // monotonic time of first grid point
+    uint32_t max_samples; // 0 - all samples
+    double sample_rate;   // rate of common grid, 0 - nominal ECG rate
+} ALIGN_REQUEST_TDS;
+
+//ECG and ICG streams have own clocks (ADS1293 oscillator, MAX30009 PLL) which drift apart.
+//Clock models of both devices map samples to monotonic time, both streams are resampled
+//by polyphase fractional resampler to one time grid, so every output frame has ECG and ICG of same moment
+class ECG_ICG_align_process
+{
+public:
+    ECG_ICG_align_process(ADS1293_process *ADS1293_process_ptr, MAX30009_process *MAX30009_process_ptr);
+
+    std::string process_JSON_line(const char * JSON_line);
+    std::string get_aligned_data_as_json(const ALIGN_REQUEST_TDS& request);
+
+protected:
+
+private:
+    static const uint32_t ECG_CHANNELS=3;
+    static const uint32_t ICG_CHANNELS=4;             // Load_real, Load_mag, Load_imag, Load_angle
+    static const uint32_t MAX_ALIGNED_SAMPLES=8192;   // limit of one response
+    static constexpr double MAX_SAMPLE_RATE=4000.0;
+    static constexpr double CUTOFF_MARGIN=0.9;        // cutoff of anti aliasing filter relative to output Nyquist frequency
+
+    void update_resampler(Polyphase_resampler *resampler, double *cutoff, double input_rate, double output_rate);
+    void write_empty_frame(const ALIGN_REQUEST_TDS& request, double sample_rate);
+
+    ADS1293_process *_ADS1293_process;
+    MAX30009_process *_MAX30009_process;
+
+    Polyphase_resampler _ECG_resampler;
+    Polyphase_resampler _ICG_resampler;
+    double _ECG_cutoff=1.0;
+    double _ICG_cutoff=1.0;
+
+    //input of resampler, channels are interleaved
+    std::vector<float> _ECG_input;
+    std::vector<float> _ICG_input;
+    std::vector<bool> _ICG_overload;
+    std::vector<MAX30009_FIFO_DATA_CALIB_TYPE> _ICG_data;    // decimated points, capacity is kept
+
+    Timestamp_formatter _timestamp_formatter;
+    int64_t _next_time_ns=0; // default reader, 0 - not started
+    uint64_t _lost_samples=0;
+
+    static const uint32_t JSON_BUFFER_RESERVE=MAX_ALIGNED_SAMPLES*80;
+    JSON_stream_writer _json_writer {JSON_BUFFER_RESERVE};
+};
+
+#endif // ECG_ICG_ALIGN_PROCESS_H
@@ -0,0 +1,217 @@
+#ifndef ENVELOPE_PYRAMID_H
+#define ENVELOPE_PYRAMID_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+//envelope of block of samples of one channel
+typedef struct ENVELOPE
+{
+    int32_t min;
+    int32_t max;
+    int32_t mean;
+} ENVELOPE_TDS;
+
+//envelope of last samples for screen, pixel is envelope of samples_per_pixel samples
+typedef struct ENVELOPE_PREVIEW
+{
+    uint32_t width;             // count of pixels
+    uint32_t samples_per_pixel;
+    uint32_t level_ratio;       // samples in block of used level
+    uint64_t first_seq;         // sequence number of first sample of first pixel
+    uint64_t next_seq;          // sequence number after last sample of last pixel
+    const ENVELOPE_TDS *pixels; // width*channels envelopes, channels are interleaved. Valid until next preview
+} ENVELOPE_PREVIEW_TDS;
+
+//min/max/mean pyramid of samples of CHANNELS channels. Level 0 keeps samples, level L keeps envelopes of blocks
+//of 8^L samples, blocks are aligned to sequence numbers. Levels are updated with every pushed sample, so preview
+//of any window is merged from at most 8 blocks per pixel (top level - from blocks of its capacity).
+//Not thread safe, producer and reader must be in one thread
+template <uint32_t CHANNELS>
+class Envelope_pyramid
+{
+public:
+    static const uint32_t LEVELS_COUNT=4;   // 1:1, 1:8, 1:64, 1:512
+    static const uint32_t LEVEL_SHIFT=3;
+
+    Envelope_pyramid()
+    {
+        reset(0,1,0);
+    }
+
+    /**
+        \brief set capacity and drop all data
+        \param [in] duration_samples - count of last samples which are kept by top level
+        \param [in] max_width - max count of pixels of preview
+        \param [in] start_seq - sequence number of next pushed sample
+     */
+    void reset(uint64_t duration_samples, uint32_t max_width, uint64_t start_seq)
+    {
+        for (uint32_t level=0; level<LEVELS_COUNT; level++)
+        {
+            //lower level is used while pixel has less than 8 its blocks
+            uint64_t blocks=duration_samples>>(LEVEL_SHIFT*level);
+            if (level+1<LEVELS_COUNT)
+            {
+                blocks=std::min(blocks,(uint64_t)max_width<<LEVEL_SHIFT);
+            }
+            uint32_t capacity=2;
+            while (capacity<blocks)
+            {
+                capacity<<=1;
+            }
+            _levels[level].mask=capacity-1;
+            _levels[level].envelopes.assign((size_t)capacity*CHANNELS,ENVELOPE_TDS());
+        }
+        _pixels.assign((size_t)max_width*CHANNELS,ENVELOPE_TDS());
+        _max_width=max_width;
+        _start_seq=start_seq;
+        _write_seq=start_seq;
+        clear_accumulators();
+    }
+
+    void push(const int32_t *values)
+    {
+        uint64_t position=_write_seq-_start_seq;
+        ENVELOPE_TDS *envelopes=get_envelopes(0,position);
+        for (uint32_t j=0; j<CHANNELS; j++)
+        {
+            envelopes[j]= {values[j],values[j],values[j]};
+        }
+
+        for (uint32_t level=1; level<LEVELS_COUNT; level++)
+        {
+            ACCUMULATOR_TDS *accumulators=_accumulators[level];
+            for (uint32_t j=0; j<CHANNELS; j++)
+            {
+                accumulators[j].min=std::min(accumulators[j].min,values[j]);
+                accumulators[j].max=std::max(accumulators[j].max,values[j]);
+                accumulators[j].sum+=values[j];
+            }
+            uint32_t shift=LEVEL_SHIFT*level;
+            if (((position+1) & (((uint64_t)1<<shift)-1))!=0)
+            {
+                continue;
+            }
+            envelopes=get_envelopes(level,position>>shift);
+            for (uint32_t j=0; j<CHANNELS; j++)
+            {
+                envelopes[j].min=accumulators[j].min;
+                envelopes[j].max=accumulators[j].max;
+                envelopes[j].mean=get_mean(accumulators[j].sum,shift);
+                accumulators[j]= {INT32_MAX,INT32_MIN,0};
+            }
+        }
+        _write_seq++;
+    }
+
+    uint64_t get_write_seq(void)
+    {
+        return _write_seq;
+    }
+
+    uint32_t get_max_width(void)
+    {
+        return _max_width;
+    }
+
+    /**
+        \brief envelope of last samples. Level with blocks not longer than pixel is used, pixel has whole blocks,
+        last pixel ends with last full block
+        \param [in] width - count of pixels, it is limited by max width
+        \param [in] window_samples - count of samples of window
+        \param [out] preview - pixels, width is less if pyramid has less samples
+     */
+    void get_preview(uint32_t width, uint64_t window_samples, ENVELOPE_PREVIEW_TDS *preview)
+    {
+        width=std::min(width,_max_width);
+        uint64_t samples_per_pixel=width==0 ? 1 : std::max<uint64_t>(window_samples/width,1);
+        uint32_t level=0;
+        while (level+1<LEVELS_COUNT && (samples_per_pixel>>(LEVEL_SHIFT*(level+1)))!=0)
+        {
+            level++;
+        }
+        uint32_t shift=LEVEL_SHIFT*level;
+        uint64_t blocks_per_pixel=samples_per_pixel>>shift;
+        uint64_t end_block=(_write_seq-_start_seq)>>shift;
+        uint64_t available_blocks=std::min<uint64_t>(end_block,_levels[level].mask+1);
+        uint32_t pixels=std::min<uint64_t>(width,available_blocks/blocks_per_pixel);
+        uint64_t block=end_block-pixels*blocks_per_pixel;
+
+        preview->width=pixels;
+        preview->samples_per_pixel=blocks_per_pixel<<shift;
+        preview->level_ratio=1<<shift;
+        preview->first_seq=_start_seq+(block<<shift);
+        preview->next_seq=_start_seq+(end_block<<shift);
+        preview->pixels=_pixels.data();
+
+        //blocks of one level have the same size, mean of pixel is mean of block means
+        for (uint32_t i=0; i<pixels; i++)
+        {
+            ACCUMULATOR_TDS accumulators[CHANNELS];
+            std::fill(accumulators,accumulators+CHANNELS,ACCUMULATOR_TDS {INT32_MAX,INT32_MIN,0});
+            for (uint64_t k=0; k<blocks_per_pixel; k++,block++)
+            {
+                const ENVELOPE_TDS *envelopes=get_envelopes(level,block);
+                for (uint32_t j=0; j<CHANNELS; j++)
+                {
+                    accumulators[j].min=std::min(accumulators[j].min,envelopes[j].min);
+                    accumulators[j].max=std::max(accumulators[j].max,envelopes[j].max);
+                    accumulators[j].sum+=envelopes[j].mean;
+                }
+            }
+            ENVELOPE_TDS *pixel=&_pixels[(size_t)i*CHANNELS];
+            for (uint32_t j=0; j<CHANNELS; j++)
+            {
+                pixel[j].min=accumulators[j].min;
+                pixel[j].max=accumulators[j].max;
+                pixel[j].mean=accumulators[j].sum/(int64_t)blocks_per_pixel;
+            }
+        }
+    }
+
+protected:
+
+private:
+    typedef struct ACCUMULATOR
+    {
+        int32_t min;
+        int32_t max;
+        int64_t sum;
+    } ACCUMULATOR_TDS;
+
+    typedef struct LEVEL
+    {
+        std::vector<ENVELOPE_TDS> envelopes; // ring of blocks, channels are interleaved
+        uint64_t mask;
+    } LEVEL_TDS;
+
+    ENVELOPE_TDS* get_envelopes(uint32_t level, uint64_t block)
+    {
+        return &_levels[level].envelopes[(block & _levels[level].mask)*CHANNELS];
+    }
+
+    //rounded mean of 2^shift samples
+    static int32_t get_mean(int64_t sum, uint32_t shift)
+    {
+        return (sum+((int64_t)1<<(shift-1)))>>shift;
+    }
+
+    void clear_accumulators(void)
+    {
+        for (uint32_t level=0; level<LEVELS_COUNT; level++)
+        {
+            std::fill(_accumulators[level],_accumulators[level]+CHANNELS,ACCUMULATOR_TDS {INT32_MAX,INT32_MIN,0});
+        }
+    }
+
+    LEVEL_TDS _levels[LEVELS_COUNT];
+    ACCUMULATOR_TDS _accumulators[LEVELS_COUNT][CHANNELS];  // blocks which are not full, level 0 is not used
+    std::vector<ENVELOPE_TDS> _pixels;
+    uint32_t _max_width=1;
+    uint64_t _start_seq=0;
+    uint64_t _write_seq=0;
+};
+
+#endif // ENVELOPE_PYRAMID_H
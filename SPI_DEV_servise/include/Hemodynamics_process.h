@@ -0,0 +1,104 @@
+#ifndef HEMODYNAMICS_PROCESS_H
+#define HEMODYNAMICS_PROCESS_H
+
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <cstdint>
+
+#include "ICG_feature_process.h"
+#include "JSON_stream_writer.h"
+#include "JSON_command_parser.h"
+#include "Sample_ring.h"
+
+//stroke volume model
+typedef enum HEMODYNAMICS_MODEL
+{
+    HEMODYNAMICS_MODEL_KUBICEK=0,       // rho*(L/Z0)^2*LVET*dZ/dt max
+    HEMODYNAMICS_MODEL_SRAMEK_BERNSTEIN  // (0.17*H)^3/4.25*LVET*dZ/dt max/Z0
+} HEMODYNAMICS_MODEL_TDE;
+
+static const char * const HEMODYNAMICS_MODEL_NAMES[]= {"kubicek","sramek_bernstein"};
+
+inline bool get_hemodynamics_model(std::string_view name, HEMODYNAMICS_MODEL_TDE *model)
+{
+    for (uint32_t i=0; i<sizeof(HEMODYNAMICS_MODEL_NAMES)/sizeof(HEMODYNAMICS_MODEL_NAMES[0]); i++)
+    {
+        if (name==HEMODYNAMICS_MODEL_NAMES[i])
+        {
+            *model=(HEMODYNAMICS_MODEL_TDE)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct HEMODYNAMICS_SETTINGS
+{
+    HEMODYNAMICS_MODEL_TDE model;
+    double height_cm;               // patient height, Sramek-Bernstein volume and body surface
+    double weight_kg;               // body surface for cardiac index, 0 - index is not computed
+    double electrode_distance_cm;   // between voltage electrodes, Kubicek
+    double blood_resistivity;       // Ohm*cm, Kubicek
+} HEMODYNAMICS_SETTINGS_TDS;
+
+//parameters of one beat
+typedef struct HEMODYNAMICS
+{
+    uint64_t beat_seq;      // sequence number of ECG beat
+    int64_t R_time_ns;      // CLOCK_MONOTONIC
+    double heart_rate;      // 1/min of RR interval of this beat, 0 - first beat
+    double PEP_ms;          // pre-ejection period, R to B
+    double LVET_ms;         // left ventricular ejection time, B to X
+    double SV;              // stroke volume, mL
+    double CO;              // cardiac output of this beat, L/min
+    double CI;              // cardiac index, L/min/m2, 0 - weight is not set
+    double TFC;             // thoracic fluid content, 1/kOhm
+    double average_heart_rate;  // 1/min of average of last RR intervals (QRS detector), 0 - not known yet
+    double CO_average;      // cardiac output at average heart rate, L/min
+} HEMODYNAMICS_TDS;
+
+//beat to beat hemodynamics of ICG feature records (ensemble of ECG gated -dZ/dt), one record per valid
+//feature record. Records are read as samples of get_data, compact format is for subscription of displays
+class Hemodynamics_process
+{
+public:
+    Hemodynamics_process(ICG_feature_process *ICG_feature_process_ptr);
+
+    void process(void);
+    std::string process_JSON_line(const char * JSON_line);
+    std::string process_pending_request(void);
+    void cancel_pending_request(void);
+
+    std::string get_hemodynamics_as_json(const DATA_REQUEST_TDS& request, bool is_compact);
+    uint32_t get_available_records(const DATA_REQUEST_TDS& request);
+    std::string get_settings_as_json(void);
+
+protected:
+
+private:
+    static const uint32_t RECORDS_BUFF_SIZE=512;
+    static constexpr double DEFAULT_HEIGHT_CM=170.0;
+    static constexpr double DEFAULT_WEIGHT_KG=0;
+    static constexpr double DEFAULT_ELECTRODE_DISTANCE_CM=30.0;
+    static constexpr double DEFAULT_BLOOD_RESISTIVITY=135.0;
+
+    bool compute(const ICG_BEAT_FEATURES_TDS& features, HEMODYNAMICS_TDS *record);
+
+    ICG_feature_process *_ICG_feature_process;
+
+    HEMODYNAMICS_SETTINGS_TDS _settings= {HEMODYNAMICS_MODEL_SRAMEK_BERNSTEIN,DEFAULT_HEIGHT_CM,DEFAULT_WEIGHT_KG,
+                                          DEFAULT_ELECTRODE_DISTANCE_CM,DEFAULT_BLOOD_RESISTIVITY};
+    uint64_t _features_seq=0;       // next feature record
+    uint64_t _invalid_beats=0;      // feature records without B, C, X
+    Sample_ring<HEMODYNAMICS_TDS> _records {RECORDS_BUFF_SIZE};
+
+    DATA_REQUEST_TDS _pending_request= {false,0,0,0,0};
+    bool _is_pending_compact=false;
+    std::chrono::steady_clock::time_point _pending_deadline;
+    bool _is_request_pending=false;
+
+    JSON_stream_writer _json_writer {64*1024};
+};
+
+#endif // HEMODYNAMICS_PROCESS_H
@@ -0,0 +1,141 @@
+#ifndef ICG_FEATURE_PROCESS_H
+#define ICG_FEATURE_PROCESS_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "ADS1293_process.h"
+#include "MAX30009_process.h"
+#include "JSON_stream_writer.h"
+#include "JSON_command_parser.h"
+#include "Sample_ring.h"
+#include "Biquad_filter_bank.h"
+
+//features of ensemble average after beat is added, times are from R peak of ECG
+typedef struct ICG_BEAT_FEATURES
+{
+    uint64_t beat_seq;       // sequence number of ECG beat (get_beats of ADS1293)
+    int64_t R_time_ns;       // CLOCK_MONOTONIC
+    double RR_interval;      // seconds, 0 - first beat
+    double heart_rate;       // beats per minute
+    double B_ms;             // opening of aortic valve, PEP is B_ms
+    double C_ms;             // max of -dZ/dt
+    double X_ms;             // closing of aortic valve, LVET is X_ms-B_ms
+    double dZdt_max;         // -dZ/dt at C, Ohm/s
+    double Z0;               // mean Load_mag of beat, Ohm
+    double quality;          // correlation of beat with ensemble, 0..1
+    uint32_t ensemble_beats; // count of averaged beats
+    bool is_valid;           // B, C and X are found in physiological ranges
+} ICG_BEAT_FEATURES_TDS;
+
+typedef struct ICG_FEATURE_SETTINGS
+{
+    uint32_t ensemble_count;     // averaged beats
+    double lowpass_frequency;    // of Load_mag before derivative, Hz
+    double min_confidence;       // ECG beats with lower confidence are not used
+} ICG_FEATURE_SETTINGS_TDS;
+
+//ICG feature engine. Load_mag of MAX30009 is low-pass filtered and differentiated (-dZ/dt), every ECG beat
+//of ADS1293 QRS detector cuts window of -dZ/dt after its R peak (both devices are on monotonic time of clock
+//models), beats are ensemble averaged and B, C, X points are found in ensemble. One feature record per beat
+//is kept in ring and read as samples of get_data (cursor, default reader, long poll)
+class ICG_feature_process
+{
+public:
+    ICG_feature_process(ADS1293_process *ADS1293_process_ptr, MAX30009_process *MAX30009_process_ptr);
+
+    void process(void);
+    std::string process_JSON_line(const char * JSON_line);
+    std::string process_pending_request(void);
+    void cancel_pending_request(void);
+
+    std::string get_features_as_json(const DATA_REQUEST_TDS& request);
+    uint32_t get_available_features(const DATA_REQUEST_TDS& request);
+    std::string get_ensemble_as_json(void);
+    std::string get_settings_as_json(void);
+
+    //feature records for hemodynamics
+    Sample_ring<ICG_BEAT_FEATURES_TDS>& get_features(void);
+
+protected:
+
+private:
+    static const uint32_t POINTS_BUFF_SIZE=4096;       // ICG points, 8 s at max measure frequency
+    static const uint32_t FEATURES_BUFF_SIZE=512;
+    static const uint32_t MAX_ENSEMBLE_COUNT=64;
+    static const uint32_t DEFAULT_ENSEMBLE_COUNT=10;
+    static constexpr double DEFAULT_LOWPASS_FREQUENCY=20.0;
+    static constexpr double DEFAULT_MIN_CONFIDENCE=0.5;
+    static constexpr double MIN_ICG_RATE=50.0;          // engine is off at lower measure frequency
+    static constexpr double BEAT_WINDOW=0.6;            // seconds of beat after R peak
+    static constexpr double Z_SCALE=1e6;                // Load_mag is filtered as micro Ohm
+    static constexpr double MIN_CORRELATION=0.5;        // beat is not averaged when ensemble has other shape
+    static const uint32_t MIN_FORMED_ENSEMBLE=3;       // first beats are averaged without correlation check
+
+    //physiological ranges of points, seconds after R peak
+    static constexpr double MIN_C_TIME=0.05;
+    static constexpr double MAX_C_TIME=0.35;
+    static constexpr double MIN_PEP=0.02;
+    static constexpr double MAX_PEP=0.25;
+    static constexpr double MIN_LVET=0.1;
+    static constexpr double MAX_LVET=0.5;
+    static constexpr double B_NOTCH_LEVEL=0.3;          // of C, notch above it is ripple of upstroke
+
+    typedef struct ICG_POINT
+    {
+        int64_t time_ns;
+        float Z;        // Load_mag, Ohm
+        float dZdt;     // -dZ/dt, Ohm/s
+        bool overload;
+    } ICG_POINT_TDS;
+
+    void reset(void);
+    void update_points(void);
+    bool process_beat(uint64_t beat_seq, const QRS_BEAT_TDS& beat);
+    bool find_point(int64_t time_ns, uint64_t *seq);
+    double get_correlation(void);
+    void add_template(void);
+    void find_features(ICG_BEAT_FEATURES_TDS *features);
+
+    ADS1293_process *_ADS1293_process;
+    MAX30009_process *_MAX30009_process;
+
+    ICG_FEATURE_SETTINGS_TDS _settings= {DEFAULT_ENSEMBLE_COUNT,DEFAULT_LOWPASS_FREQUENCY,DEFAULT_MIN_CONFIDENCE};
+    uint32_t _MAX30009_settings_version=0;
+    bool _is_measure_running=false;
+    bool _is_running=false;                 // measure is running at rate of engine
+
+    //-dZ/dt of decimated points, point is written when next point is filtered (central difference)
+    double _ICG_rate=0;
+    uint64_t _ICG_seq=0;                    // ADC sample after last read point
+    Biquad_filter_bank<1> _Z_filter;
+    int64_t _filter_delay_ns=0;
+    double _filtered_Z[2]= {0,0};           // previous filtered points
+    ICG_POINT_TDS _previous_point= {0,0,0,false};
+    uint32_t _filtered_count=0;
+    std::vector<MAX30009_FIFO_DATA_CALIB_TYPE> _ICG_data;
+    Sample_ring<ICG_POINT_TDS> _points {POINTS_BUFF_SIZE};
+    uint64_t _points_start_seq=0;           // first point after reset
+
+    //last beats on template grid (ICG rate from R peak), sum of averaged templates
+    uint64_t _beat_seq=0;                   // next ECG beat
+    uint32_t _template_size=0;
+    std::vector<float> _beat_template;
+    std::vector<float> _templates;          // MAX_ENSEMBLE_COUNT rows
+    std::vector<double> _template_sum;
+    uint32_t _templates_count=0;
+    uint32_t _templates_first=0;
+    uint64_t _rejected_beats=0;
+
+    Sample_ring<ICG_BEAT_FEATURES_TDS> _features {FEATURES_BUFF_SIZE};
+
+    DATA_REQUEST_TDS _pending_request= {false,0,0,0,0};
+    std::chrono::steady_clock::time_point _pending_deadline;
+    bool _is_request_pending=false;
+
+    JSON_stream_writer _json_writer {64*1024};
+};
+
+#endif // ICG_FEATURE_PROCESS_H
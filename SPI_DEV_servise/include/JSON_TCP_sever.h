@@ -13,6 +13,25 @@
 #include <thread>
 #include <chrono>
 #include <poll.h>
+#include <vector>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+
+//binary data sent after JSON line of response: bytes of data, then file ranges (sendfile, no copy to user space).
+//Server sends it with response and closes file descriptors
+typedef struct TCP_FILE_RANGE
+{
+    int fd;
+    uint64_t offset;
+    uint64_t size;
+} TCP_FILE_RANGE_TDS;
+
+typedef struct TCP_ATTACHMENT
+{
+    std::string data;
+    std::vector<TCP_FILE_RANGE_TDS> file_ranges;
+    std::vector<int> file_fds;
+} TCP_ATTACHMENT_TDS;
 
 class JSON_TCP_sever
 {
@@ -21,13 +40,15 @@ public:
                    std::string* request_json_ptr,
                    std::atomic<bool>* request_ready_flag_ptr,
                    std::string* response_json_ptr,
-                   std::atomic<bool>* response_ready_flag_ptr)
+                   std::atomic<bool>* response_ready_flag_ptr,
+                   TCP_ATTACHMENT_TDS* response_attachment_ptr=nullptr)
         : _port(port),
           _server_fd(-1),
           _request_json(request_json_ptr),
           _request_ready_flag(request_ready_flag_ptr),
           _response_json(response_json_ptr),
           _response_ready_flag(response_ready_flag_ptr),
+          _response_attachment(response_attachment_ptr),
           _server_running(false)
     {}
 
@@ -172,6 +193,126 @@ public:
         return true;
     }
 
+    /**
+        \brief send all bytes to non blocking socket
+        \param [in] socket_fd - socket
+        \param [in] data - bytes
+        \param [in] size - count of bytes
+        \return - false if client does not read data for SEND_TIMEOUT_MS or socket error
+     */
+    bool send_all(int socket_fd, const char *data, size_t size)
+    {
+        while (size>0)
+        {
+            ssize_t sent=send(socket_fd, data, size, MSG_NOSIGNAL);
+            if (sent>0)
+            {
+                data=data+sent;
+                size=size-sent;
+            }
+            else if (sent<0 && (errno==EAGAIN || errno==EWOULDBLOCK))
+            {
+                if (wait_writable(socket_fd)==false)
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool send_file_range(int socket_fd, const TCP_FILE_RANGE_TDS& range)
+    {
+        off_t offset=range.offset;
+        uint64_t size=range.size;
+        while (size>0)
+        {
+            ssize_t sent=sendfile(socket_fd, range.fd, &offset, size);
+            if (sent>0)
+            {
+                size=size-sent;
+            }
+            else if (sent<0 && (errno==EAGAIN || errno==EWOULDBLOCK))
+            {
+                if (wait_writable(socket_fd)==false)
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                //file is shorter than range
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool wait_writable(int socket_fd)
+    {
+        struct pollfd pfd;
+        pfd.fd = socket_fd;
+        pfd.events = POLLOUT;
+        return poll(&pfd, 1, SEND_TIMEOUT_MS) > 0 && (pfd.revents & POLLOUT);
+    }
+
+    void send_attachment(int socket_fd, TCP_ATTACHMENT_TDS *attachment)
+    {
+        bool result=send_all(socket_fd, attachment->data.data(), attachment->data.size());
+        for (size_t i=0; i<attachment->file_ranges.size() && result==true; i++)
+        {
+            result=send_file_range(socket_fd, attachment->file_ranges[i]);
+        }
+        if (result==false)
+        {
+            perror("attachment send failed");
+        }
+        clear_attachment(attachment);
+    }
+
+    void clear_attachment(TCP_ATTACHMENT_TDS *attachment)
+    {
+        for (size_t i=0; i<attachment->file_fds.size(); i++)
+        {
+            close(attachment->file_fds[i]);
+        }
+        attachment->data.clear();
+        attachment->file_ranges.clear();
+        attachment->file_fds.clear();
+    }
+
+    /**
+        \brief take notification of closed connection, main loop cancels waiting requests of this client.
+        Next client is accepted after notification is taken
+        \return - true if client disconnected since last call
+     */
+    bool take_client_disconnected(void)
+    {
+        return _client_disconnected.exchange(false, std::memory_order_acq_rel);
+    }
+
+    /**
+        \brief drop response which main loop prepared for closed connection
+     */
+    void drop_response(void)
+    {
+        if (_response_ready_flag->load(std::memory_order_acquire))
+        {
+            if (_response_attachment != nullptr)
+            {
+                _attachment_to_send.data.swap(_response_attachment->data);
+                _attachment_to_send.file_ranges.swap(_response_attachment->file_ranges);
+                _attachment_to_send.file_fds.swap(_response_attachment->file_fds);
+            }
+            _response_ready_flag->store(false, std::memory_order_release);
+            clear_attachment(&_attachment_to_send);
+        }
+    }
+
     void server_loop()
     {
         std::cout <<"start server loop" << std::endl;
@@ -253,12 +394,21 @@ public:
 
                 if(_response_ready_flag->load(std::memory_order_acquire))
                 {
-                    std::string response_to_send = *_response_json;
+                    //buffers of connection keep capacity, sent attachment buffers go back to main loop with next swap
+                    _response_to_send.assign(*_response_json);
+                    //attachment is taken before flag is cleared, main loop can prepare next one
+                    if (_response_attachment != nullptr)
+                    {
+                        _attachment_to_send.data.swap(_response_attachment->data);
+                        _attachment_to_send.file_ranges.swap(_response_attachment->file_ranges);
+                        _attachment_to_send.file_fds.swap(_response_attachment->file_fds);
+                    }
                     _response_ready_flag->store(false, std::memory_order_release);
 
-                    std::cout << "Sending to client: '" << response_to_send << "'" << std::endl;
-                    send(client_socket, response_to_send.c_str(), response_to_send.length(), MSG_NOSIGNAL);
-                    send(client_socket, "\n", 1, MSG_NOSIGNAL);
+                    std::cout << "Sending to client: '" << _response_to_send << "'" << std::endl;
+                    send_all(client_socket, _response_to_send.c_str(), _response_to_send.length());
+                    send_all(client_socket, "\n", 1);
+                    send_attachment(client_socket, &_attachment_to_send);
                 }
 
                 std::this_thread::yield();
@@ -266,6 +416,14 @@ public:
             }
             close(client_socket);
             std::cout << "Client disconnected." << std::endl;
+
+            //response of waiting request must not be sent to next client
+            _client_disconnected.store(true, std::memory_order_release);
+            while (_client_disconnected.load(std::memory_order_acquire) && _server_running.load(std::memory_order_acquire))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            drop_response();
         }
     }
 
@@ -283,8 +441,16 @@ private:
     std::atomic<bool>* _request_ready_flag;
     std::string* _response_json;
     std::atomic<bool>* _response_ready_flag;
+    TCP_ATTACHMENT_TDS* _response_attachment;
+
+    //server thread side, one client at time
+    std::string _response_to_send;
+    TCP_ATTACHMENT_TDS _attachment_to_send;
+
+    static const int SEND_TIMEOUT_MS=5000;
 
     std::atomic<bool> _server_running;
+    std::atomic<bool> _client_disconnected {false};
 };
 
 #endif // JSON_TCP_SEVER_H
@@ -0,0 +1,298 @@
+#ifndef JSON_COMMAND_PARSER_H
+#define JSON_COMMAND_PARSER_H
+
+#include <string_view>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <charconv>
+
+//pull parser for small fixed schema JSON commands: reads values straight from request text,
+//no DOM and no heap allocation. Strings with escape sequences are not supported (command keys and types have none)
+class JSON_command_parser
+{
+public:
+    JSON_command_parser(const char *text) : _pos(text)
+    {
+
+    }
+
+    bool begin_object(void)
+    {
+        return expect('{');
+    }
+
+    /**
+        \brief read next key of object, comma is consumed
+        \param [out] key - key name
+        \return - false at end of object or on error
+     */
+    bool next_key(std::string_view *key)
+    {
+        if (_is_error==true)
+        {
+            return false;
+        }
+        skip_spaces();
+        if (*_pos=='}')
+        {
+            _pos++;
+            _need_comma=true;
+            return false;
+        }
+        if (_need_comma==true && expect(',')==false)
+        {
+            return false;
+        }
+        if (read_string(key)==false || expect(':')==false)
+        {
+            return false;
+        }
+        _need_comma=true;
+        return true;
+    }
+
+    bool begin_array(void)
+    {
+        if (expect('[')==false)
+        {
+            return false;
+        }
+        _need_comma=false;
+        return true;
+    }
+
+    /**
+        \brief check for next item of array, comma is consumed
+        \return - false at end of array or on error
+     */
+    bool next_array_item(void)
+    {
+        if (_is_error==true)
+        {
+            return false;
+        }
+        skip_spaces();
+        if (*_pos==']')
+        {
+            _pos++;
+            _need_comma=true;
+            return false;
+        }
+        if (_need_comma==true && expect(',')==false)
+        {
+            return false;
+        }
+        _need_comma=true;
+        return true;
+    }
+
+    bool read_string(std::string_view *value)
+    {
+        if (expect('"')==false)
+        {
+            return false;
+        }
+        const char *start=_pos;
+        while (*_pos!='"')
+        {
+            if (*_pos==0 || *_pos=='\\')
+            {
+                return set_error();
+            }
+            _pos++;
+        }
+        *value=std::string_view(start,_pos-start);
+        _pos++;
+        return true;
+    }
+
+    bool read_bool(bool *value)
+    {
+        skip_spaces();
+        if (match_word("true")==true)
+        {
+            *value=true;
+            return true;
+        }
+        if (match_word("false")==true)
+        {
+            *value=false;
+            return true;
+        }
+        return set_error();
+    }
+
+    //integer types, fraction is truncated
+    template <typename T>
+    bool read_number(T *value)
+    {
+        skip_spaces();
+        int64_t number=0;
+        std::from_chars_result result=std::from_chars(_pos,_pos+strnlen(_pos,MAX_NUMBER_LENGTH),number);
+        if (result.ec!=std::errc())
+        {
+            return set_error();
+        }
+        if (*result.ptr=='.' || *result.ptr=='e' || *result.ptr=='E')
+        {
+            char *end=nullptr;
+            double real=strtod(_pos,&end);
+            number=(int64_t)real;
+            result.ptr=end;
+        }
+        _pos=result.ptr;
+        *value=(T)number;
+        return true;
+    }
+
+    bool read_number(double *value)
+    {
+        skip_spaces();
+        char *end=nullptr;
+        *value=strtod(_pos,&end);
+        if (end==_pos)
+        {
+            return set_error();
+        }
+        _pos=end;
+        return true;
+    }
+
+    //skip value of unknown key, nested objects and arrays too
+    bool skip_value(void)
+    {
+        skip_spaces();
+        if (*_pos=='"')
+        {
+            std::string_view text;
+            return read_string(&text);
+        }
+        if (*_pos=='{' || *_pos=='[')
+        {
+            uint32_t depth=0;
+            while (*_pos!=0)
+            {
+                if (*_pos=='"')
+                {
+                    std::string_view text;
+                    if (read_string(&text)==false)
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+                if (*_pos=='{' || *_pos=='[')
+                {
+                    depth++;
+                }
+                if (*_pos=='}' || *_pos==']')
+                {
+                    depth--;
+                    if (depth==0)
+                    {
+                        _pos++;
+                        return true;
+                    }
+                }
+                _pos++;
+            }
+            return set_error();
+        }
+        if (match_word("true")==true || match_word("false")==true || match_word("null")==true)
+        {
+            return true;
+        }
+        double number;
+        return read_number(&number);
+    }
+
+    //text of next value as it is in request (object of sub command)
+    bool read_raw_value(std::string_view *text)
+    {
+        skip_spaces();
+        const char *start=_pos;
+        if (skip_value()==false)
+        {
+            return false;
+        }
+        *text=std::string_view(start,_pos-start);
+        return true;
+    }
+
+    //whole text is parsed, only spaces left
+    bool is_finished(void)
+    {
+        if (_is_error==true)
+        {
+            return false;
+        }
+        skip_spaces();
+        return *_pos==0;
+    }
+
+    bool is_error(void)
+    {
+        return _is_error;
+    }
+
+protected:
+
+private:
+    static const uint32_t MAX_NUMBER_LENGTH=32;
+
+    void skip_spaces(void)
+    {
+        while (*_pos==' ' || *_pos=='\t' || *_pos=='\r' || *_pos=='\n')
+        {
+            _pos++;
+        }
+    }
+
+    bool expect(char c)
+    {
+        if (_is_error==true)
+        {
+            return false;
+        }
+        skip_spaces();
+        if (*_pos!=c)
+        {
+            return set_error();
+        }
+        _pos++;
+        if (c=='{')
+        {
+            _need_comma=false;
+        }
+        return true;
+    }
+
+    bool match_word(const char *word)
+    {
+        const char *c=_pos;
+        while (*word!=0)
+        {
+            if (*c!=*word)
+            {
+                return false;
+            }
+            c++;
+            word++;
+        }
+        _pos=c;
+        return true;
+    }
+
+    bool set_error(void)
+    {
+        _is_error=true;
+        return false;
+    }
+
+    const char *_pos;
+    bool _need_comma=false;
+    bool _is_error=false;
+};
+
+#endif // JSON_COMMAND_PARSER_H
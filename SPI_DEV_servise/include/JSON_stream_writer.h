@@ -0,0 +1,167 @@
+#ifndef JSON_STREAM_WRITER_H
+#define JSON_STREAM_WRITER_H
+
+#include <string>
+#include <cstdint>
+#include <charconv>
+#include <type_traits>
+#include <cmath>
+#include <cstdio>
+
+//JSON text writer for big data responses: values are formatted directly into one buffer,
+//buffer keeps its capacity between responses, no DOM is created
+class JSON_stream_writer
+{
+public:
+    JSON_stream_writer(size_t reserve_size=0)
+    {
+        _buffer.reserve(reserve_size);
+    }
+
+    void clear(void)
+    {
+        _buffer.clear();
+        _need_comma=false;
+    }
+
+    void begin_object(void)
+    {
+        add_separator();
+        _buffer.push_back('{');
+        _need_comma=false;
+    }
+
+    void end_object(void)
+    {
+        _buffer.push_back('}');
+        _need_comma=true;
+    }
+
+    void begin_array(void)
+    {
+        add_separator();
+        _buffer.push_back('[');
+        _need_comma=false;
+    }
+
+    void end_array(void)
+    {
+        _buffer.push_back(']');
+        _need_comma=true;
+    }
+
+    void key(const char *name)
+    {
+        add_separator();
+        add_escaped_string(name);
+        _buffer.push_back(':');
+        _need_comma=false;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T,bool>::value>::type value(T number)
+    {
+        add_separator();
+        char text[24];
+        std::to_chars_result result=std::to_chars(text,text+sizeof(text),number);
+        _buffer.append(text,result.ptr-text);
+        _need_comma=true;
+    }
+
+    //not finite number is written as null
+    void value(double number)
+    {
+        add_separator();
+        if (std::isfinite(number)==false)
+        {
+            _buffer.append("null");
+        }
+        else
+        {
+            char text[32];
+            int length=snprintf(text,sizeof(text),"%.10g",number);
+            _buffer.append(text,length);
+        }
+        _need_comma=true;
+    }
+
+    void value(bool flag)
+    {
+        add_separator();
+        _buffer.append(flag ? "true" : "false");
+        _need_comma=true;
+    }
+
+    void value(const char *text)
+    {
+        add_separator();
+        add_escaped_string(text);
+        _need_comma=true;
+    }
+
+    void value(const std::string& text)
+    {
+        value(text.c_str());
+    }
+
+    //value which is JSON text already (response of other process)
+    void raw_value(const std::string& json)
+    {
+        add_separator();
+        _buffer.append(json);
+        _need_comma=true;
+    }
+
+    template <typename T>
+    void key_value(const char *name, const T& data)
+    {
+        key(name);
+        value(data);
+    }
+
+    const std::string& get_string(void)
+    {
+        return _buffer;
+    }
+
+protected:
+
+private:
+    void add_separator(void)
+    {
+        if (_need_comma==true)
+        {
+            _buffer.push_back(',');
+        }
+    }
+
+    void add_escaped_string(const char *text)
+    {
+        static const char HEX_DIGITS[]="0123456789abcdef";
+        _buffer.push_back('"');
+        for (const char *c=text; *c!=0; c++)
+        {
+            if (*c=='"' || *c=='\\')
+            {
+                _buffer.push_back('\\');
+                _buffer.push_back(*c);
+            }
+            else if ((uint8_t)*c<0x20)
+            {
+                _buffer.append("\\u00");
+                _buffer.push_back(HEX_DIGITS[(*c>>4) & 0x0F]);
+                _buffer.push_back(HEX_DIGITS[*c & 0x0F]);
+            }
+            else
+            {
+                _buffer.push_back(*c);
+            }
+        }
+        _buffer.push_back('"');
+    }
+
+    std::string _buffer;
+    bool _need_comma=false;
+};
+
+#endif // JSON_STREAM_WRITER_H
@@ -0,0 +1,49 @@
+#ifndef MAX30009_CALIB_INTERP_H
+#define MAX30009_CALIB_INTERP_H
+
+#include <cstdint>
+
+#include "max30009_lib.h"
+
+typedef enum MAX30009_CALIB_INTERP_PARAM
+{
+    MAX30009_CALIB_INTERP_I_OFFSET,
+    MAX30009_CALIB_INTERP_Q_OFFSET,
+    MAX30009_CALIB_INTERP_I_COEF,
+    MAX30009_CALIB_INTERP_Q_COEF,
+    MAX30009_CALIB_INTERP_I_PHASE,
+    MAX30009_CALIB_INTERP_Q_PHASE,
+
+    MAX30009_CALIB_INTERP_PARAMS_COUNT,
+} MAX30009_CALIB_INTERP_PARAM_TDE;
+
+typedef struct MAX30009_CALIB_INTERP_POINT
+{
+    double value[MAX30009_CALIB_INTERP_PARAMS_COUNT];
+} MAX30009_CALIB_INTERP_POINT_TDS;
+
+//calibrate coefficients of one current as smooth functions of drive frequency:
+//monotone cubic (PCHIP) over log frequency, precomputed to dense lookup table
+class MAX30009_calib_interp
+{
+public:
+    static const uint32_t MAX_POINTS_COUNT=32;
+    static const uint32_t LUT_SIZE=512;
+
+    bool build(const uint32_t *freq_points, const MAX30009_CALIB_DATA *calib_points, const bool *points_valid, uint32_t points_count);
+    bool get_calib_data(double frequency, MAX30009_CALIB_DATA *calib_data);
+    bool is_valid(void);
+
+protected:
+
+private:
+    static void calculate_PCHIP_slopes(const double *x, const double *y, uint32_t count, double *slopes);
+    static double calculate_PCHIP_value(const double *x, const double *y, const double *slopes, uint32_t count, double x_value);
+
+    bool _is_valid=false;
+    double _log_min_freq=0;
+    double _log_step=0;
+    MAX30009_CALIB_INTERP_POINT_TDS _lut[LUT_SIZE];
+};
+
+#endif // MAX30009_CALIB_INTERP_H
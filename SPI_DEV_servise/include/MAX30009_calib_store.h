@@ -0,0 +1,81 @@
+#ifndef MAX30009_CALIB_STORE_H
+#define MAX30009_CALIB_STORE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "max30009_lib.h"
+
+static const uint32_t MAX30009_CALIB_STORE_MAGIC=0x4C43584D; // "MXCL"
+static const uint16_t MAX30009_CALIB_STORE_VERSION=2;
+static const uint32_t MAX30009_CALIB_STORE_RECORD_V1_SIZE=128; // version 1 record without quality fields
+
+typedef struct MAX30009_CALIB_STORE_HEADER
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint64_t board_id;
+    uint32_t current_points_count;
+    uint32_t freq_points_count;
+    uint32_t record_size;
+    uint32_t table_crc32;
+} MAX30009_CALIB_STORE_HEADER_TDS;
+
+typedef struct MAX30009_CALIB_STORE_RECORD
+{
+    uint32_t is_valid;
+    uint32_t calibrate_frequency;
+    uint32_t calibrate_current;
+    int32_t I_offset;
+    int32_t Q_offset;
+    int32_t I_cal_in_ADC;
+    int32_t Q_cal_in_ADC;
+    uint32_t reserved;
+
+    double I_coef;
+    double I_phase_coef;
+    double I_phase_cos;
+    double I_phase_sin;
+    double Q_coef;
+    double Q_phase_coef;
+    double Q_phase_cos;
+    double Q_phase_sin;
+
+    double I_cal_in;
+    double I_cal_quad;
+    double Q_cal_in;
+    double Q_cal_quad;
+
+    //added in version 2
+    double I_noise;
+    double Q_noise;
+    double residual;
+    int64_t calibrate_time;
+} MAX30009_CALIB_STORE_RECORD_TDS;
+
+class MAX30009_calib_store
+{
+public:
+    MAX30009_calib_store(uint32_t current_points_count, uint32_t freq_points_count);
+
+    bool load(const std::string& filename);
+    bool save(const std::string& filename);
+
+    bool get_calib_data(uint32_t current_index, uint32_t freq_index, MAX30009_CALIB_DATA *calib_data);
+    void set_calib_data(uint32_t current_index, uint32_t freq_index, const MAX30009_CALIB_DATA &calib_data);
+
+    uint64_t get_board_id(void);
+    static uint64_t read_board_id(void);
+
+protected:
+
+private:
+    uint32_t _current_points_count;
+    uint32_t _freq_points_count;
+    uint64_t _board_id=0;
+    std::vector<MAX30009_CALIB_STORE_RECORD_TDS> _records;
+};
+
+#endif // MAX30009_CALIB_STORE_H
@@ -15,6 +15,18 @@
 #include <chrono>
 #include <thread>
 #include "max30009_ext_mux.h"
+#include "MAX30009_calib_store.h"
+#include "MAX30009_calib_interp.h"
+#include "JSON_stream_writer.h"
+#include "JSON_command_parser.h"
+#include "Sync_mark_index.h"
+#include "Sample_ring.h"
+#include "Envelope_pyramid.h"
+#include "Stream_tap.h"
+#include "Sample_clock_model.h"
+#include "Timestamp_formatter.h"
+#include "JSON_TCP_sever.h"
+#include "Alloc_counter.h"
 #include <fstream>
 #include <filesystem>
 
@@ -36,10 +48,18 @@ typedef struct MAX30009_USER_SETTINGS
 
     uint32_t ext_MUX_state;
 
+    uint32_t drive_frequency; //in Hertz, 0 - stimulate_frequency from table is used
+
 
 } MAX30009_USER_SETTINGS_TDE;
 
 
+typedef struct MAX30009_CALIB_POINT
+{
+    uint32_t current_index;
+    uint32_t freq_index;
+} MAX30009_CALIB_POINT_TDS;
+
 typedef struct MAX30009_IFIFO_DATA
 {
     int32_t I_data;
@@ -56,33 +76,93 @@ public:
     void add_sync_mark(int32_t sync_num);
 
     std::string process_JSON_line(const char * JSON_line);
+    std::string process_calibration_JSON_command(const char * JSON_line);
     std::string get_all_settings_as_json(void);
     void process_all_settings_for_MAX30009(void);
     void process_ext_MUX_settings_for_MAX30009(void);
     bool check_enumerate_for_value(uint8_t value,const uint8_t *value_list, uint8_t value_list_size);
-    std::vector<MAX30009_FIFO_DATA_CALIB_TYPE> get_decimate_IFIFO_data();
-    std::string get_data_as_json(void);
+    void build_clock_solution_table(void);
+    MAX30009_FIND_CLOCKS_STRUCT_TYPE find_measure_clock_solution(uint32_t drive_freq, uint32_t measure_frequency);
+    /**
+        \brief decimated calibrated points of raw ring, only full points are read
+        \param [in] first_seq - first raw sample of first point
+        \param [in] max_points - 0 - all points
+        \param [out] next_seq - raw sample after last point
+        \param [out] decimated_data - points, vector is cleared, its capacity is kept by caller between calls
+     */
+    void get_decimate_IFIFO_data(uint64_t first_seq, uint32_t max_points, uint64_t *next_seq, std::vector<MAX30009_FIFO_DATA_CALIB_TYPE> *decimated_data);
+    const std::string& get_data_as_json(const DATA_REQUEST_TDS& request);
+    float get_decimation_ratio(void);
+    uint32_t get_available_samples(const DATA_REQUEST_TDS& request);
+    const std::string& process_pending_data_request(void);
+    bool is_data_request_pending(void);
+    void cancel_data_request(void);
+
+    /**
+        \brief min/max/mean envelope of last decimated points for screen
+        \param [in] width - count of pixels
+        \param [in] duration_ms - window length
+        \return - JSON response
+     */
+    std::string get_preview_as_json(uint32_t width, uint32_t duration_ms);
+
+    //named output streams of raw I/Q with own decimation and filter, points are calibrated when they are read
+    std::string get_tap_data_as_json(std::string_view tap_name, const DATA_REQUEST_TDS& request);
+
+    /**
+        \brief raw ADC I/Q samples at ADC rate without decimation and calibration. Samples are packed to
+        binary part of response, calibration is sent in header once after it is changed (or by request)
+        \param [in] request - cursor and max count of samples
+        \param [in] need_header - header is sent even if it is not changed
+        \return - JSON response, binary part is kept until move_attachment()
+     */
+    std::string get_raw_data_as_json(const DATA_REQUEST_TDS& request, bool need_header);
+
+    /**
+        \brief pass binary part of last response to server, it is dropped by next command
+        \param [out] attachment - attachment of server
+     */
+    void move_attachment(TCP_ATTACHMENT_TDS *attachment);
+    void clear_attachment(void);
+
+    //samples access for aligned ECG/ICG data
+    Sample_clock_model& get_clock_model(void);
+    uint64_t get_oldest_seq(void);
+    uint64_t get_write_seq(void);
+    bool is_measure_running(void);
+
+    //session recording
+    Sync_mark_index& get_sync_marks(void);
+    uint32_t get_settings_version(void);
 
     std::string calibration_process(void);
+    void fill_full_calibrate_queue(void);
+    bool fill_recalibrate_queue(const nlohmann::json& command_json);
+    std::string get_calibration_quality_as_json(void);
     std::string get_calibration_json_data(MAX30009_CALIB_DATA calib_koef);
+    nlohmann::json get_calibration_json(MAX30009_CALIB_DATA calib_koef);
+    std::string export_calibration_as_json(void);
+    std::string import_calibration_from_json(const nlohmann::json& calib_json);
     bool save_string_to_file(const std::string& filename, const std::string& data);
 
     void set_power_state(bool state);
 
-    MAX30009_CALIB_DATA  get_calib_koef_from_file(const std::string& filename);
+    void load_calibration(void);
+    bool save_calibration(void);
+    void build_calibration_interp(void);
+    void update_active_calib_data(void);
+    bool get_calib_koef_from_file(const std::string& filename, MAX30009_CALIB_DATA *calib_koef);
+    void get_calib_koef_from_json(const nlohmann::json& calib_json, MAX30009_CALIB_DATA *calib_koef);
 
-    std::string get_timestamp_string();
 protected:
 
 private:
     MAX30009_USER_SETTINGS_TDE MAX30009_user_sett= {0};
     static const uint32_t MIN_MEASURE_FREQ	=1;
     static const uint32_t MAX_MEASURE_FREQ=500;
-    static const uint32_t CALIB_STEP_PERIOD=60;
+    static const uint32_t CALIB_STEP_PERIOD=10;
     static const uint32_t CALIB_RESISTOR_VALUE=100.0;
 
-    static const int32_t SYNC_MARK_MAGIC_NUM=-99999;
-
     uint32_t _calibrate_timer=0;
 
     static const uint32_t FREQ_POINTS_COUNT=17;
@@ -99,19 +179,80 @@ private:
     };
 
     MAX30009_CALIB_DATA _calibrate_data[CURRENT_POINTS_COUNT][FREQ_POINTS_COUNT];
+    MAX30009_calib_store _calib_store {CURRENT_POINTS_COUNT,FREQ_POINTS_COUNT};
+    MAX30009_calib_interp _calib_interp[CURRENT_POINTS_COUNT];
+    MAX30009_CALIB_DATA _active_calib_data= {};
+    bool _use_drive_frequency=false;
+    const std::string CALIB_STORE_FILENAME="calib/calibration.bin";
+    const std::string CALIB_STORE_BAD_FILENAME="calib/calibration.bin.bad";
+    bool _is_calib_store_bad=false;     // store was not loaded, file is kept as CALIB_STORE_BAD_FILENAME
+
+    static const uint32_t REF_CLK_FREQ=327680; // MAX30009_REFCLK_SRC_INT_32768 in 1/10 Hertz
+    MAX30009_FIND_CLOCKS_STRUCT_TYPE _clk_solution_table[FREQ_POINTS_COUNT][MAX_MEASURE_FREQ+1];
 
 
     static const uint32_t IFIFO_BUFFER_DURATION=3;
-    static const uint32_t IFIFO_BUFF_SIZE=30000;
-    uint32_t _max_IFIFO_size = 1;
-    MAX30009_IFIFO_DATA_TDS _IFIFO_BUF[IFIFO_BUFF_SIZE]= {0};
-    uint32_t _IFIFO_write_pos=0;
-    uint32_t _IFIFO_read_pos=0;
+    static const uint32_t IFIFO_BUFF_SIZE=32768;
+    Sample_ring<MAX30009_IFIFO_DATA_TDS> _IFIFO;
+
+    //pyramid of decimated calibrated points (x10000 as in get_data), filled by own cursor of raw ring
+    static const uint32_t PREVIEW_CHANNELS_COUNT=5;
+    static const uint32_t PREVIEW_DURATION=120;     // seconds of envelope pyramid
+    static const uint32_t MAX_PREVIEW_WIDTH=4096;
+    static const uint32_t DEFAULT_PREVIEW_WIDTH=1000;
+    static const uint32_t DEFAULT_PREVIEW_DURATION_MS=30000;
+    Envelope_pyramid<PREVIEW_CHANNELS_COUNT> _preview;
+    uint64_t _preview_seq=0;    // raw sample after last point of pyramid
+    void update_preview(void);
+
+    static const uint32_t RAW_CHANNELS_COUNT=2; // I, Q
+    Stream_tap_bank<RAW_CHANNELS_COUNT> _taps;
+    MAX30009_FIFO_DATA_CALIB_TYPE calibrate_point(int32_t I_data, int32_t Q_data);
+
+    //raw I/Q passthrough: sample is pair of 20 bit two's complement words, I in bits 0..19, Q in bits 20..39,
+    //5 bytes little endian. Raw reader has own cursor, get_data reader is not changed
+    static const uint32_t RAW_WORD_BITS=20;
+    static const uint32_t RAW_SAMPLE_BYTES=5;
+    TCP_ATTACHMENT_TDS _raw_attachment;
+    uint64_t _raw_seq=0;
+    uint64_t _raw_lost_samples=0;
+    std::string _raw_header_json;       // built when it is requested after change
+    uint32_t _raw_header_version=0;     // changed with calibration or ADC rate
+    uint32_t _raw_sent_header_version=0;
+    void build_raw_header(void);
+    Sync_mark_index _sync_marks;
+    Sample_clock_model _clock_model;
+    Timestamp_formatter _timestamp_formatter;
+    uint32_t _settings_version=0; // changed when settings are applied
+
+    typedef struct SYNC_MARK_POSITION
+    {
+        uint32_t position;
+        SYNC_MARK_TDS mark;
+    } SYNC_MARK_POSITION_TDS;
+    std::vector<SYNC_MARK_POSITION_TDS> _decimated_sync_marks;
+
+    //get_data path has no heap allocations in steady state: points and JSON are written to buffers which keep
+    //capacity, response is passed by reference
+    std::vector<MAX30009_FIFO_DATA_CALIB_TYPE> _decimated_data;
+    std::vector<MAX30009_FIFO_DATA_CALIB_TYPE> _preview_data;
+    std::string _data_response;
+
+    DATA_REQUEST_TDS _pending_data_request= {false,0,0,0,0};
+    std::chrono::steady_clock::time_point _pending_data_deadline;
+    bool _is_data_request_pending=false;
+
+    static const uint32_t JSON_BUFFER_RESERVE=MAX_MEASURE_FREQ*IFIFO_BUFFER_DURATION*64;
+    JSON_stream_writer _json_writer {JSON_BUFFER_RESERVE};
 
     bool _need_calibrate=false;
     uint32_t _calibrate_current_index=0;
     uint32_t _calibrate_freq_index=0;
 
+    MAX30009_CALIB_POINT_TDS _calibrate_queue[CURRENT_POINTS_COUNT*FREQ_POINTS_COUNT];
+    uint32_t _calibrate_queue_size=0;
+    uint32_t _calibrate_queue_pos=0;
+
     bool _old_power_state=false;
 
 
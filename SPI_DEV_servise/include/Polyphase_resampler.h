@@ -0,0 +1,116 @@
+#ifndef POLYPHASE_RESAMPLER_H
+#define POLYPHASE_RESAMPLER_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+//fractional resampler: value at any fractional position of uniform input is FIR of taps input samples.
+//Coefficients of windowed sinc are kept for PHASES fractional offsets, offsets between phases are interpolated.
+//Count of taps grows with 1/cutoff (main lobe of sinc is wider at lower cutoff), so the kernel is anti aliasing
+//filter also for large rate ratio. Every phase is normalized to gain 1, so DC level (ECG baseline, impedance) is kept exactly
+class Polyphase_resampler
+{
+public:
+    static const uint32_t MIN_TAPS=16;      // taps at cutoff 1
+    static const uint32_t MAX_TAPS=1024;
+    static const uint32_t PHASES=64;
+
+    Polyphase_resampler(double cutoff=1.0)
+    {
+        design(cutoff);
+    }
+
+    /**
+        \brief build coefficient table
+        \param [in] cutoff - cutoff frequency relative to Nyquist frequency of input (0..1],
+        set below 1 when output rate is less than input rate
+     */
+    void design(double cutoff)
+    {
+        if (cutoff<=0 || cutoff>1)
+        {
+            cutoff=1;
+        }
+        _half_taps=std::min<uint32_t>((uint32_t)std::ceil(MIN_TAPS/2/cutoff),MAX_TAPS/2);
+        _taps=2*_half_taps;
+        _table.assign((PHASES+1)*_taps,0);
+        for (uint32_t phase=0; phase<=PHASES; phase++)
+        {
+            double *koefs=&_table[phase*_taps];
+            double sum=0;
+            for (uint32_t tap=0; tap<_taps; tap++)
+            {
+                //distance from output position to input sample
+                double offset=(double)tap-(double)(_half_taps-1)-(double)phase/PHASES;
+                double x=M_PI*cutoff*offset;
+                double sinc=std::fabs(x)<1e-12 ? 1.0 : std::sin(x)/x;
+                double window=0.42+0.5*std::cos(M_PI*offset/_half_taps)+0.08*std::cos(2*M_PI*offset/_half_taps);
+                koefs[tap]=sinc*window;
+                sum=sum+koefs[tap];
+            }
+            for (uint32_t tap=0; tap<_taps; tap++)
+            {
+                koefs[tap]=koefs[tap]/sum;
+            }
+        }
+    }
+
+    /**
+        \brief input samples which are used on each side of output position
+        \return - half of taps of current cutoff
+     */
+    uint32_t get_half_taps(void)
+    {
+        return _half_taps;
+    }
+
+    /**
+        \brief value of input at fractional position
+        \param [in] samples - uniform input, stride is distance between samples of one channel
+        \param [in] count - count of samples
+        \param [in] position - fractional index, half taps-1 <= position < count-half taps
+        \param [in] stride - step between samples in array (interleaved channels)
+        \return - interpolated value, nearest sample at the edges of input
+     */
+    double get_value(const float *samples, uint32_t count, double position, uint32_t stride=1)
+    {
+        double index=std::floor(position);
+        if (index<(double)(_half_taps-1) || index+_half_taps>=(double)count)
+        {
+            int64_t nearest=std::llround(position);
+            if (nearest<0)
+            {
+                nearest=0;
+            }
+            if (nearest>=(int64_t)count)
+            {
+                nearest=(int64_t)count-1;
+            }
+            return count==0 ? 0 : samples[nearest*stride];
+        }
+        double phase_position=(position-index)*PHASES;
+        uint32_t phase=(uint32_t)phase_position;
+        double phase_fraction=phase_position-phase;
+        const float *sample=samples+((uint32_t)index-(_half_taps-1))*stride;
+        const double *koefs=&_table[phase*_taps];
+        const double *next_koefs=koefs+_taps;
+        double value=0;
+        for (uint32_t tap=0; tap<_taps; tap++)
+        {
+            double koef=koefs[tap]+(next_koefs[tap]-koefs[tap])*phase_fraction;
+            value=value+koef*sample[tap*stride];
+        }
+        return value;
+    }
+
+protected:
+
+private:
+    uint32_t _taps=MIN_TAPS;
+    uint32_t _half_taps=MIN_TAPS/2;
+    std::vector<double> _table;     // PHASES+1 rows of taps
+};
+
+#endif // POLYPHASE_RESAMPLER_H
@@ -0,0 +1,376 @@
+#ifndef QRS_DETECTOR_H
+#define QRS_DETECTOR_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "Biquad_filter_bank.h"
+
+//detected beat
+typedef struct QRS_BEAT
+{
+    uint64_t seq;           // sample sequence number of R peak
+    int64_t time_ns;        // time of R peak (CLOCK_MONOTONIC), set by owner of clock model
+    double RR_interval;     // seconds from previous beat, 0 - first beat after reset
+    double heart_rate;      // beats per minute of average of last RR intervals, 0 - not known yet
+    double confidence;      // 0..1, beats found by search back are below 0.5
+} QRS_BEAT_TDS;
+
+//streaming Pan-Tompkins QRS detector of CHANNELS leads. Leads are band-pass filtered (5-15 Hz), squared five point
+//derivatives of leads are summed (lead energy), moving window integral of energy is compared with adaptive signal
+//and noise levels. Peak is final when integral has no higher value for refractory period, so beat is reported
+//about 200 ms after R peak. T waves (slope below half of previous QRS within 360 ms) are noise, missed beat is
+//searched back when RR is longer than 166% of average. R peak is maximum of band-passed energy in integration window
+//moved back by delay of band filter, it is found when peak is final (history ring has only last window)
+template <uint32_t CHANNELS>
+class QRS_detector
+{
+public:
+    static constexpr double MIN_SAMPLE_RATE=100.0;   // detector is off at lower rate
+    static constexpr double BAND_LOW_FREQUENCY=5.0;
+    static constexpr double BAND_HIGH_FREQUENCY=15.0;
+    static constexpr double BAND_DELAY=0.01;         // group delay of band filter in QRS band, seconds
+    static constexpr double WINDOW_DURATION=0.15;    // integration window, seconds
+    static constexpr double REFRACTORY_DURATION=0.2;
+    static constexpr double T_WAVE_DURATION=0.36;
+    static constexpr double LEARNING_DURATION=2.0;
+    static constexpr double SEARCH_BACK_RATIO=1.66;  // of average RR
+    static constexpr double NO_BEAT_DURATION=3.0;    // signal level is halved when there is no beat
+    static const uint32_t RR_AVERAGE_COUNT=8;
+
+    QRS_detector()
+    {
+        reset(0,0);
+    }
+
+    /**
+        \brief drop state and start learning of levels
+        \param [in] sample_rate - rate of samples, Hz
+        \param [in] start_seq - sequence number of next pushed sample
+     */
+    void reset(double sample_rate, uint64_t start_seq)
+    {
+        _sample_rate=sample_rate;
+        _is_enabled=sample_rate>=MIN_SAMPLE_RATE;
+        _band_filter.reset({0,BAND_LOW_FREQUENCY,BAND_HIGH_FREQUENCY},sample_rate);
+        _window_size=std::max<uint32_t>(std::lround(WINDOW_DURATION*sample_rate),1);
+        _band_delay_size=std::lround(BAND_DELAY*sample_rate);
+        _refractory_size=std::lround(REFRACTORY_DURATION*sample_rate);
+        _T_wave_size=std::lround(T_WAVE_DURATION*sample_rate);
+        _learning_size=std::lround(LEARNING_DURATION*sample_rate);
+        _no_beat_size=std::lround(NO_BEAT_DURATION*sample_rate);
+
+        //history keeps integration window before peak which is final after refractory period
+        uint32_t capacity=2;
+        while (capacity<_window_size+_refractory_size+DERIVATIVE_SIZE+_band_delay_size+2)
+        {
+            capacity<<=1;
+        }
+        _mask=capacity-1;
+        _slope_energy.assign(_is_enabled==true ? capacity : 2,0);
+        _band_energy.assign(_is_enabled==true ? capacity : 2,0);
+        std::fill(&_band_history[0][0],&_band_history[0][0]+DERIVATIVE_SIZE*CHANNELS,0);
+
+        _start_seq=start_seq;
+        _seq=start_seq;
+        _integral=0;
+        _previous_integral=0;
+        _candidate= {0,0,0,0};
+        _search_back= {0,0,0,0};
+        _learning_max=0;
+        _learning_sum=0;
+        _signal_level=0;
+        _noise_level=0;
+        _last_QRS= {0,0,0,0};
+        _is_last_QRS_valid=false;
+        _level_decay_seq=start_seq;
+        _RR_count=0;
+        _RR_first=0;
+        _RR_rejected_count=0;
+    }
+
+    bool is_enabled(void)
+    {
+        return _is_enabled;
+    }
+
+    /**
+        \brief push sample of all leads
+        \param [in] values - sample
+        \param [out] beat - beat which is final after this sample, time_ns is not set
+        \return - true if beat is detected
+     */
+    bool push(const int32_t *values, QRS_BEAT_TDS *beat)
+    {
+        if (_is_enabled==false)
+        {
+            _seq++;
+            return false;
+        }
+
+        int32_t band[CHANNELS];
+        _band_filter.process(values,band);
+        uint32_t position=_seq-_start_seq;
+        double *history=_band_history[position%DERIVATIVE_SIZE];
+        double slope_energy=0;
+        double band_energy=0;
+        for (uint32_t j=0; j<CHANNELS; j++)
+        {
+            //(2x[n]+x[n-1]-x[n-3]-2x[n-4])/8
+            double slope=(2.0*band[j]+_band_history[(position+4)%DERIVATIVE_SIZE][j]
+                          -_band_history[(position+2)%DERIVATIVE_SIZE][j]-2.0*_band_history[(position+1)%DERIVATIVE_SIZE][j])/8.0;
+            slope_energy+=slope*slope;
+            band_energy+=(double)band[j]*band[j];
+        }
+        for (uint32_t j=0; j<CHANNELS; j++)
+        {
+            history[j]=band[j];
+        }
+        if (position<DERIVATIVE_SIZE)
+        {
+            //derivative of primed filter output is not valid yet
+            slope_energy=0;
+        }
+
+        _integral+=slope_energy-_slope_energy[(_seq-_window_size) & _mask];
+        _slope_energy[_seq & _mask]=slope_energy;
+        _band_energy[_seq & _mask]=band_energy;
+        double integral=std::max(_integral/_window_size,0.0);
+        uint64_t seq=_seq;
+        _seq++;
+
+        if (position<_learning_size)
+        {
+            _learning_max=std::max(_learning_max,integral);
+            _learning_sum+=integral;
+            if (position+1==_learning_size)
+            {
+                _signal_level=_learning_max*0.5;
+                _noise_level=_learning_sum/_learning_size*0.5;
+            }
+            _previous_integral=integral;
+            return false;
+        }
+
+        //peak candidate starts only on rising integral, falling tail of previous peak is not a peak
+        if (integral>_candidate.value && integral>=_previous_integral)
+        {
+            _candidate= {integral,seq,0,0};
+        }
+        _previous_integral=integral;
+
+        bool is_beat=false;
+        if (_candidate.value>0 && seq-_candidate.seq>=_refractory_size)
+        {
+            PEAK_TDS peak=_candidate;
+            _candidate= {0,0,0,0};
+            peak.slope=get_max(_slope_energy,peak.seq);
+            peak.R_seq=get_R_seq(peak.seq);
+            is_beat=classify_peak(peak,beat);
+        }
+        if (is_beat==false)
+        {
+            is_beat=search_back(seq,beat);
+        }
+        if (is_beat==false && seq-_level_decay_seq>=_no_beat_size)
+        {
+            //levels are adapted to smaller signal (electrode or lead change)
+            _signal_level*=0.5;
+            _level_decay_seq=seq;
+        }
+        return is_beat;
+    }
+
+protected:
+
+private:
+    static const uint32_t DERIVATIVE_SIZE=5;
+    static const uint32_t RR_MAX_REJECTED_COUNT=3;  // average restarts after these RR out of limits in a row
+
+    typedef struct PEAK
+    {
+        double value;   // integral
+        uint64_t seq;   // sample of integral peak
+        double slope;   // max of lead energy in integration window
+        uint64_t R_seq; // R peak of leads, search back is later than history of samples
+    } PEAK_TDS;
+
+    double get_threshold(void)
+    {
+        return _noise_level+0.25*(_signal_level-_noise_level);
+    }
+
+    //max of values of integration window which ends at seq
+    double get_max(const std::vector<double>& values, uint64_t seq)
+    {
+        double max_value=0;
+        for (uint32_t i=0; i<_window_size; i++)
+        {
+            max_value=std::max(max_value,values[(seq-i) & _mask]);
+        }
+        return max_value;
+    }
+
+    uint64_t get_R_seq(uint64_t seq)
+    {
+        uint64_t R_seq=seq;
+        double max_value=-1;
+        for (uint32_t i=0; i<_window_size; i++)
+        {
+            if (_band_energy[(seq-i) & _mask]>max_value)
+            {
+                max_value=_band_energy[(seq-i) & _mask];
+                R_seq=seq-i;
+            }
+        }
+        //R peak of leads is earlier than peak of band-passed energy
+        return R_seq-std::min<uint64_t>(_band_delay_size,R_seq-_start_seq);
+    }
+
+    bool classify_peak(const PEAK_TDS& peak, QRS_BEAT_TDS *beat)
+    {
+        double threshold=get_threshold();
+        if (peak.value>threshold)
+        {
+            bool is_T_wave=_is_last_QRS_valid==true && peak.seq-_last_QRS.seq<_T_wave_size && peak.slope<0.5*_last_QRS.slope;
+            if (is_T_wave==false)
+            {
+                _signal_level=0.125*peak.value+0.875*_signal_level;
+                double confidence=0.5+0.5*std::min((peak.value-threshold)/std::max(_signal_level-threshold,1e-9),1.0);
+                add_beat(peak,confidence,beat);
+                return true;
+            }
+        }
+        _noise_level=0.125*peak.value+0.875*_noise_level;
+        if (peak.value>0.5*threshold && peak.value>_search_back.value)
+        {
+            _search_back=peak;
+        }
+        return false;
+    }
+
+    bool search_back(uint64_t seq, QRS_BEAT_TDS *beat)
+    {
+        if (_is_last_QRS_valid==false || _RR_count==0 || _search_back.value==0)
+        {
+            return false;
+        }
+        double RR_average=get_RR_average();
+        if (seq-_last_QRS.seq<SEARCH_BACK_RATIO*RR_average)
+        {
+            return false;
+        }
+        PEAK_TDS peak=_search_back;
+        double threshold=get_threshold();
+        _signal_level=0.25*peak.value+0.75*_signal_level;
+        double confidence=0.5*std::clamp((peak.value-0.5*threshold)/std::max(0.5*threshold,1e-9),0.0,1.0);
+        add_beat(peak,confidence,beat);
+        return true;
+    }
+
+    void add_beat(const PEAK_TDS& peak, double confidence, QRS_BEAT_TDS *beat)
+    {
+        beat->seq=peak.R_seq;
+        beat->time_ns=0;
+        beat->RR_interval=0;
+        if (_is_last_QRS_valid==true)
+        {
+            uint64_t RR=beat->seq-_last_R_seq;
+            bool is_RR_valid=true;
+            if (_RR_count>0)
+            {
+                //irregular beat is less sure, RR of missed beat is not averaged until rhythm is changed
+                double RR_average=get_RR_average();
+                if (RR<0.92*RR_average || RR>1.16*RR_average)
+                {
+                    confidence*=0.75;
+                }
+                is_RR_valid=(RR>0.5*RR_average && RR<SEARCH_BACK_RATIO*RR_average) || _RR_rejected_count>=RR_MAX_REJECTED_COUNT;
+            }
+            if (is_RR_valid==true)
+            {
+                add_RR(RR);
+            }
+            else
+            {
+                _RR_rejected_count++;
+            }
+            beat->RR_interval=RR/_sample_rate;
+        }
+        beat->heart_rate=_RR_count==0 ? 0 : 60.0*_sample_rate/get_RR_average();
+        beat->confidence=confidence;
+
+        _last_QRS=peak;
+        _last_R_seq=beat->seq;
+        _is_last_QRS_valid=true;
+        _search_back= {0,0,0,0};
+        _level_decay_seq=peak.seq;
+    }
+
+    void add_RR(uint64_t RR)
+    {
+        if (_RR_rejected_count>=RR_MAX_REJECTED_COUNT)
+        {
+            _RR_count=0;
+        }
+        _RR_rejected_count=0;
+        _RR[(_RR_first+_RR_count)%RR_AVERAGE_COUNT]=RR;
+        if (_RR_count==RR_AVERAGE_COUNT)
+        {
+            _RR_first=(_RR_first+1)%RR_AVERAGE_COUNT;
+        }
+        else
+        {
+            _RR_count++;
+        }
+    }
+
+    double get_RR_average(void)
+    {
+        double sum=0;
+        for (uint32_t i=0; i<_RR_count; i++)
+        {
+            sum+=_RR[(_RR_first+i)%RR_AVERAGE_COUNT];
+        }
+        return sum/_RR_count;
+    }
+
+    double _sample_rate=0;
+    bool _is_enabled=false;
+    Biquad_filter_bank<CHANNELS> _band_filter;
+    uint32_t _window_size=1;
+    uint32_t _band_delay_size=0;
+    uint32_t _refractory_size=0;
+    uint32_t _T_wave_size=0;
+    uint32_t _learning_size=0;
+    uint32_t _no_beat_size=0;
+
+    double _band_history[DERIVATIVE_SIZE][CHANNELS];
+    std::vector<double> _slope_energy;   // rings of last samples, index is seq & mask
+    std::vector<double> _band_energy;
+    uint64_t _mask=1;
+    uint64_t _start_seq=0;
+    uint64_t _seq=0;
+    double _integral=0;                  // sum of slope energy of window
+    double _previous_integral=0;
+
+    PEAK_TDS _candidate= {0,0,0,0};
+    PEAK_TDS _search_back= {0,0,0,0};      // biggest noise peak above half threshold after last QRS
+    double _learning_max=0;
+    double _learning_sum=0;
+    double _signal_level=0;
+    double _noise_level=0;
+    PEAK_TDS _last_QRS= {0,0,0,0};
+    uint64_t _last_R_seq=0;
+    bool _is_last_QRS_valid=false;
+    uint64_t _level_decay_seq=0;
+
+    uint64_t _RR[RR_AVERAGE_COUNT]= {};
+    uint32_t _RR_count=0;
+    uint32_t _RR_first=0;
+    uint32_t _RR_rejected_count=0;
+};
+
+#endif // QRS_DETECTOR_H
@@ -0,0 +1,148 @@
+#ifndef SAMPLE_CLOCK_MODEL_H
+#define SAMPLE_CLOCK_MODEL_H
+
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+
+//linear model of sample acquisition time: time(seq)=offset+seq/rate.
+//Every drained block of samples is stamped with monotonic clock (steady_clock is CLOCK_MONOTONIC on Linux),
+//rate and offset are fitted online by least squares, old stamps are forgotten with time constant FORGET_TIME_S.
+//Sums are kept relative to last stamp, so precision does not drop in long streams
+class Sample_clock_model
+{
+public:
+    static int64_t get_monotonic_ns(void)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+        \brief drop all stamps, rate is nominal until model is fitted
+        \param [in] nominal_rate - sample rate from settings, Hz
+     */
+    void reset(double nominal_rate)
+    {
+        _nominal_rate=nominal_rate;
+        _period=nominal_rate>0 ? 1.0/nominal_rate : 0;
+        _stamp_count=0;
+        _sum_w=0;
+        _sum_x=0;
+        _sum_y=0;
+        _sum_xx=0;
+        _sum_xy=0;
+    }
+
+    /**
+        \brief add stamp of drained block, last sample of block is taken as acquired at read time
+        \param [in] end_seq - sequence number after last sample of block
+        \param [in] time_ns - monotonic time of block read
+     */
+    void add_block(uint64_t end_seq, int64_t time_ns)
+    {
+        uint64_t seq=end_seq-1;
+        if (_stamp_count>0)
+        {
+            //move sums to new reference point, x - samples, y - seconds
+            double dx=(double)(int64_t)(seq-_ref_seq);
+            double dy=(double)(time_ns-_ref_time_ns)*1e-9;
+            double forget=std::exp(-dy/FORGET_TIME_S);
+            _sum_xx=forget*(_sum_xx-2*dx*_sum_x+dx*dx*_sum_w);
+            _sum_xy=forget*(_sum_xy-dx*_sum_y-dy*_sum_x+dx*dy*_sum_w);
+            _sum_x=forget*(_sum_x-dx*_sum_w);
+            _sum_y=forget*(_sum_y-dy*_sum_w);
+            _sum_w=forget*_sum_w;
+        }
+        _ref_seq=seq;
+        _ref_time_ns=time_ns;
+        _sum_w=_sum_w+1;
+        _stamp_count++;
+        fit();
+    }
+
+    /**
+        \brief acquisition time of sample
+        \param [in] seq - sequence number of sample, fraction is allowed (middle of averaged samples)
+        \return - monotonic time, ns. 0 if there is no stamp yet
+     */
+    int64_t get_time_ns(double seq)
+    {
+        if (_stamp_count==0)
+        {
+            return 0;
+        }
+        double x=seq-(double)_ref_seq;
+        return _ref_time_ns+(int64_t)std::llround((_mean_y+(x-_mean_x)*_period)*1e9);
+    }
+
+    /**
+        \brief sequence number of sample acquired at given time (inverse of get_time_ns)
+        \param [in] time_ns - monotonic time, ns
+        \return - fractional sequence number, 0 if there is no stamp yet
+     */
+    double get_seq(int64_t time_ns)
+    {
+        if (_stamp_count==0 || _period<=0)
+        {
+            return 0;
+        }
+        double y=(double)(time_ns-_ref_time_ns)*1e-9;
+        return (double)_ref_seq+_mean_x+(y-_mean_y)/_period;
+    }
+
+    bool is_valid(void)
+    {
+        return _stamp_count>0 && _period>0;
+    }
+
+    //estimated sample rate, Hz
+    double get_rate(void)
+    {
+        return _period>0 ? 1.0/_period : 0;
+    }
+
+    double get_nominal_rate(void)
+    {
+        return _nominal_rate;
+    }
+
+protected:
+
+private:
+    static constexpr double FORGET_TIME_S=30.0;
+    static constexpr double MIN_SEQ_SPREAD=16.0;  // rate is not fitted on shorter history
+    static constexpr double MAX_RATE_ERROR=0.05;  // fitted rate is not used if it differs from nominal more (stall of reading)
+
+    void fit(void)
+    {
+        _mean_x=_sum_x/_sum_w;
+        _mean_y=_sum_y/_sum_w;
+        double var_x=_sum_xx/_sum_w-_mean_x*_mean_x;
+        double nominal_period=_nominal_rate>0 ? 1.0/_nominal_rate : 0;
+        _period=nominal_period;
+        if (var_x<MIN_SEQ_SPREAD*MIN_SEQ_SPREAD)
+        {
+            return;
+        }
+        double period=(_sum_xy/_sum_w-_mean_x*_mean_y)/var_x;
+        if (std::fabs(period-nominal_period)<=nominal_period*MAX_RATE_ERROR)
+        {
+            _period=period;
+        }
+    }
+
+    double _nominal_rate=0;
+    double _period=0;      // seconds per sample
+    uint64_t _stamp_count=0;
+    uint64_t _ref_seq=0;   // last stamp
+    int64_t _ref_time_ns=0;
+    double _mean_x=0;      // fitted line passes through weighted mean of stamps
+    double _mean_y=0;
+    double _sum_w=0;
+    double _sum_x=0;
+    double _sum_y=0;
+    double _sum_xx=0;
+    double _sum_xy=0;
+};
+
+#endif // SAMPLE_CLOCK_MODEL_H
@@ -0,0 +1,172 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+
+//data request of get_data command: reader with cursor or default reader of ring
+typedef struct DATA_REQUEST
+{
+    bool use_cursor;      // from_seq is set, read does not change default reader
+    uint64_t from_seq;    // sequence number of first sample to read
+    uint32_t max_samples; // 0 - all samples
+    uint32_t min_samples; // request waits for this count of samples (long poll)
+    uint32_t timeout_ms;  // max wait time of request, data is sent after timeout even if it is less than min_samples
+} DATA_REQUEST_TDS;
+
+static const uint32_t DATA_REQUEST_MAX_TIMEOUT_MS=30000;
+
+//single producer ring of samples. Capacity is power of two, index is sequence number & mask.
+//Producer never waits: oldest samples are overwritten. Readers keep own cursor (sequence number) and
+//read samples without copy of ring, default reader cursor is kept in ring, its skipped samples are counted as lost.
+//Sequence numbers are never reset, they can be used as sample position in stream
+template <typename T>
+class Sample_ring
+{
+public:
+    Sample_ring(uint32_t min_capacity=2)
+    {
+        resize(min_capacity);
+    }
+
+    /**
+        \brief set capacity, it is rounded up to power of two. All data is dropped, sequence numbers continue.
+        Not thread safe, producer and consumer must be stopped
+        \param [in] min_capacity - minimal count of samples
+     */
+    void resize(uint32_t min_capacity)
+    {
+        uint32_t capacity=2;
+        while (capacity<min_capacity)
+        {
+            capacity<<=1;
+        }
+        if (capacity!=_buffer.size())
+        {
+            _buffer.assign(capacity,T());
+        }
+        _mask=capacity-1;
+        _start_seq=_write_seq.load(std::memory_order_relaxed);
+        _read_seq.store(_start_seq,std::memory_order_relaxed);
+    }
+
+    //producer side
+    void push(const T& item)
+    {
+        uint64_t write_seq=_write_seq.load(std::memory_order_relaxed);
+        _buffer[write_seq & _mask]=item;
+        _write_seq.store(write_seq+1,std::memory_order_release);
+    }
+
+    /**
+        \brief read sample by sequence number, ring is not changed (any reader)
+        \param [in] seq - sequence number of sample
+        \param [out] item - sample
+        \return - false if sample is not written yet or overwritten
+     */
+    bool read(uint64_t seq, T *item)
+    {
+        uint64_t write_seq=_write_seq.load(std::memory_order_acquire);
+        if (seq>=write_seq || seq<_start_seq || write_seq-seq>_mask)
+        {
+            return false;
+        }
+        *item=_buffer[seq & _mask];
+        //producer could overwrite slot while it was copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return _write_seq.load(std::memory_order_relaxed)-seq<=_mask;
+    }
+
+    //sequence number of oldest sample which is not overwritten
+    uint64_t get_oldest_seq(void)
+    {
+        uint64_t write_seq=_write_seq.load(std::memory_order_acquire);
+        //one slot is kept for producer write in progress
+        if (write_seq>_start_seq+_mask)
+        {
+            return write_seq-_mask;
+        }
+        return _start_seq;
+    }
+
+    //drop all samples (default reader)
+    void clear(void)
+    {
+        _read_seq.store(_write_seq.load(std::memory_order_acquire),std::memory_order_release);
+    }
+
+    //count of samples which can be read by default reader
+    uint32_t get_size(void)
+    {
+        return _write_seq.load(std::memory_order_acquire)-get_first_seq();
+    }
+
+    //sequence number of oldest sample which is not read by default reader and not overwritten
+    uint64_t get_first_seq(void)
+    {
+        uint64_t read_seq=_read_seq.load(std::memory_order_relaxed);
+        uint64_t oldest_seq=get_oldest_seq();
+        if (read_seq<oldest_seq)
+        {
+            return oldest_seq;
+        }
+        return read_seq;
+    }
+
+    //sequence number of next sample which will be read by default reader
+    uint64_t get_read_seq(void)
+    {
+        return _read_seq.load(std::memory_order_relaxed);
+    }
+
+    void set_read_seq(uint64_t read_seq)
+    {
+        _read_seq.store(read_seq,std::memory_order_release);
+    }
+
+    /**
+        \brief move default reader to oldest sample if its samples are overwritten, count them as lost
+        \return - sequence number of next sample for default reader
+     */
+    uint64_t skip_overwritten(void)
+    {
+        uint64_t read_seq=_read_seq.load(std::memory_order_relaxed);
+        uint64_t first_seq=get_first_seq();
+        if (first_seq!=read_seq)
+        {
+            _overflow_count.fetch_add(first_seq-read_seq,std::memory_order_relaxed);
+            _read_seq.store(first_seq,std::memory_order_release);
+        }
+        return first_seq;
+    }
+
+    //sequence number of next sample which will be written
+    uint64_t get_write_seq(void)
+    {
+        return _write_seq.load(std::memory_order_acquire);
+    }
+
+    //count of samples overwritten before read by default reader
+    uint64_t get_overflow_count(void)
+    {
+        return _overflow_count.load(std::memory_order_relaxed);
+    }
+
+    uint32_t get_capacity(void)
+    {
+        return _mask+1;
+    }
+
+protected:
+
+private:
+    std::vector<T> _buffer;
+    uint64_t _mask=1;
+    uint64_t _start_seq=0; // samples before last resize are dropped
+    std::atomic<uint64_t> _write_seq {0};
+    std::atomic<uint64_t> _read_seq {0};
+    std::atomic<uint64_t> _overflow_count {0};
+};
+
+#endif // SAMPLE_RING_H
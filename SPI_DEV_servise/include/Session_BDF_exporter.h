@@ -0,0 +1,110 @@
+#ifndef SESSION_BDF_EXPORTER_H
+#define SESSION_BDF_EXPORTER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+#include "Session_record_format.h"
+
+typedef enum BDF_EXPORT_STATE
+{
+    BDF_EXPORT_IDLE=0,
+    BDF_EXPORT_RUNNING,
+    BDF_EXPORT_DONE,
+    BDF_EXPORT_ERROR
+} BDF_EXPORT_STATE_TDE;
+
+//export of recorded session to BDF+ (24 bit EDF+) file in own thread. ECG and ICG signals are placed on one time grid
+//by chunk times, lost data is filled by zeros and marked by annotation. Sync marks and settings changes are annotations.
+//Data record duration is chosen so that both sample rates give whole number of samples in record.
+//Annotation signal has place for events of session rate with headroom, rest is written in records after data.
+//Signals are exported while sample rate is the same as at start of session
+class Session_BDF_exporter
+{
+public:
+    ~Session_BDF_exporter();
+
+    /**
+        \brief start export
+        \param [in] session_dir - directory of session segments
+        \param [in] filename - BDF file name
+        \return - false if previous export is running
+     */
+    bool start(const std::string& session_dir, const std::string& filename);
+
+    BDF_EXPORT_STATE_TDE get_state(void);
+    const char* get_state_name(void);
+    const std::string& get_filename(void);
+
+protected:
+
+private:
+    static const uint32_t ECG_CHANNELS=3;
+    static const uint32_t ICG_CHANNELS=5;
+    static const uint32_t MAX_RECORD_DURATION=100;      // seconds
+    static const uint32_t ANNOTATION_TAL_SIZE=48;       // bytes of one annotation: onset, text, separators
+    static const uint32_t ANNOTATION_HEADROOM=2;        // place for this multiple of average count of events in record
+    static const uint32_t ANNOTATION_MIN_EVENTS=4;      // place for data lost marks and bursts of events
+    static const uint32_t MAX_LAG_RECORDS=60;           // signal without data for this time is filled by zeros
+    static const uint32_t MAX_CHUNK_PAYLOAD=16*1024*1024;
+    static constexpr int32_t BDF_DIGITAL_MIN=-8388608;
+    static constexpr int32_t BDF_DIGITAL_MAX=8388607;
+    static constexpr int32_t ICG_DIGITAL_LIMIT=8000000;     // x10000 values, physical range is +-800
+
+    typedef struct BDF_SIGNAL
+    {
+        bool is_present;
+        uint32_t chunk_type;
+        uint32_t channels;
+        double sample_rate;
+        int64_t first_time_ns;
+        uint32_t samples_in_record;
+        uint64_t position;              // output position of next sample
+        std::vector<int32_t> values;    // samples waiting for data record, channels are interleaved
+        uint32_t read_position;         // first sample in values
+    } BDF_SIGNAL_TDS;
+
+    typedef struct BDF_ANNOTATION
+    {
+        int64_t time_ns;                // from start of file
+        std::string text;
+    } BDF_ANNOTATION_TDS;
+
+    void export_process(void);
+    bool scan_session(void);
+    int open_segment(uint32_t segment_index, SESSION_FILE_HEADER_TDS *file_header);
+    bool read_chunk(int fd, SESSION_CHUNK_HEADER_TDS *header, std::vector<uint8_t> *payload);
+    bool choose_record_duration(void);
+    bool write_header(void);
+    void add_chunk(const SESSION_CHUNK_HEADER_TDS& header, const std::vector<uint8_t>& payload);
+    void add_samples(BDF_SIGNAL_TDS *signal, const SESSION_CHUNK_HEADER_TDS& header, const std::vector<uint8_t>& payload);
+    void add_annotation(int64_t time_ns, const std::string& text);
+    bool write_ready_records(bool is_last);
+    bool write_annotation_records(void);
+    bool write_record(bool is_data_end);
+    uint32_t get_available_samples(const BDF_SIGNAL_TDS& signal);
+
+    std::thread _export_thread;
+    std::atomic<BDF_EXPORT_STATE_TDE> _state {BDF_EXPORT_IDLE};
+    std::string _session_dir;
+    std::string _filename;
+
+    //export thread side
+    int _fd=-1;
+    SESSION_FILE_HEADER_TDS _file_header= {};
+    BDF_SIGNAL_TDS _ECG= {};
+    BDF_SIGNAL_TDS _ICG= {};
+    int64_t _start_ns=0;                // monotonic time of first sample in file
+    uint32_t _record_duration=1;
+    uint32_t _annotation_samples=0;
+    uint64_t _events_count=0;           // sync marks and settings changes of session
+    int64_t _last_chunk_ns=0;
+    uint64_t _records_count=0;
+    std::vector<BDF_ANNOTATION_TDS> _annotations;    // sorted by time
+    std::vector<uint8_t> _record;
+};
+
+#endif // SESSION_BDF_EXPORTER_H
@@ -0,0 +1,103 @@
+#ifndef SESSION_QUERY_PROCESS_H
+#define SESSION_QUERY_PROCESS_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <string_view>
+#include <cstdint>
+
+#include "Session_recorder.h"
+#include "Session_segment_reader.h"
+#include "JSON_TCP_sever.h"
+#include "JSON_stream_writer.h"
+#include "JSON_command_parser.h"
+
+typedef struct QUERY_REQUEST
+{
+    bool is_list;                // list of sessions
+    std::string session;         // list - session which is being recorded
+    SESSION_CHUNK_TYPE_TDE type; // SESSION_CHUNK_ECG or SESSION_CHUNK_ICG
+    int64_t from_time_ns;        // system time (UTC) of range
+    int64_t to_time_ns;
+    uint32_t decimation;         // mean of this count of samples
+    uint32_t max_samples;
+    bool is_binary;              // samples are sent as int32 records after JSON line
+} QUERY_REQUEST_TDS;
+
+//time range query of recorded sessions. Query reads mapped segments in own thread, one query at time,
+//main loop only passes request and takes response (as waiting get_data request). Binary data which is stored as requested is sent by server
+//from segment files by sendfile
+class Session_query_process
+{
+public:
+    Session_query_process(Session_recorder *session_recorder_ptr);
+    ~Session_query_process();
+
+    std::string process_JSON_line(const char * JSON_line);
+    std::string process_pending_request(void);
+
+    /**
+        \brief drop response of running query, when client of query port is gone
+     */
+    void cancel_pending_request(void);
+
+    /**
+        \brief pass binary part of response to server, files of previous attachment which was not sent are closed
+        \param [out] attachment - attachment of server
+     */
+    void move_attachment(TCP_ATTACHMENT_TDS *attachment);
+
+protected:
+
+private:
+    static const uint32_t MAX_JSON_SAMPLES=50000;
+    static const uint32_t MAX_BINARY_SAMPLES=500000;
+    static const uint32_t MAX_DECIMATION=65536;
+    static const int64_t SYNC_CHUNK_DELAY_NS=2000000000; // sync chunk is written later than its marks
+
+    typedef enum QUERY_STATE
+    {
+        QUERY_STATE_IDLE=0,
+        QUERY_STATE_REQUESTED,
+        QUERY_STATE_DONE
+    } QUERY_STATE_TDE;
+
+    typedef struct QUERY_GAP
+    {
+        uint32_t position;
+        int64_t time_ns;
+    } QUERY_GAP_TDS;
+
+    static bool parse_time(std::string_view text, int64_t *time_ns);
+    static void clear_attachment(TCP_ATTACHMENT_TDS *attachment);
+
+    //worker thread
+    void worker_process(void);
+    std::string query(const QUERY_REQUEST_TDS& request);
+    std::string list_sessions(const std::string& recording_session);
+    void add_record(const int32_t *record, uint32_t channels, uint32_t decimation, bool is_ICG);
+    void collect_sync_marks(const QUERY_REQUEST_TDS& request, int64_t offset_ns);
+
+    Session_recorder *_session_recorder;
+
+    std::thread _worker_thread;
+    std::atomic<QUERY_STATE_TDE> _state {QUERY_STATE_IDLE};
+    bool _is_response_canceled=false;   // main loop side
+    QUERY_REQUEST_TDS _request;
+    std::string _response;
+    TCP_ATTACHMENT_TDS _attachment;
+
+    Session_segment_reader _reader;
+    std::vector<int32_t> _values;       // output samples, channels are interleaved
+    std::vector<int64_t> _sums;         // decimation of samples
+    uint32_t _sum_count=0;
+    int32_t _overload=0;
+    std::vector<QUERY_GAP_TDS> _gaps;
+    std::vector<SESSION_SYNC_RECORD_TDS> _sync_marks;
+
+    JSON_stream_writer _json_writer {64*1024};
+};
+
+#endif // SESSION_QUERY_PROCESS_H
@@ -0,0 +1,94 @@
+#ifndef SESSION_RECORD_FORMAT_H
+#define SESSION_RECORD_FORMAT_H
+
+#include <cstdint>
+
+//session is directory records/<session name>/ with segment files segment_NNNNNN.rec. Segment is file header
+//and append only chunks, every chunk is checked by own CRC32. Index file segment_NNNNNN.idx has one entry per chunk,
+//it can be rebuilt from segment if it is lost
+static const char SESSION_RECORD_DIR[]="records";
+static const uint32_t SESSION_FILE_MAGIC=0x43455253;  // "SREC"
+static const uint32_t SESSION_CHUNK_MAGIC=0x4B484353; // "SCHK"
+static const uint16_t SESSION_FILE_VERSION=1;
+
+typedef enum SESSION_CHUNK_TYPE
+{
+    SESSION_CHUNK_ECG=1,      // ADS1293 samples, SESSION_ECG_RECORD_TDS
+    SESSION_CHUNK_ICG,        // MAX30009 decimated calibrated points, SESSION_ICG_RECORD_TDS
+    SESSION_CHUNK_SYNC,       // sync marks, SESSION_SYNC_RECORD_TDS
+    SESSION_CHUNK_SETTINGS    // settings of one device, SESSION_SETTINGS_RECORD_TDS and JSON text
+} SESSION_CHUNK_TYPE_TDE;
+
+typedef enum SESSION_DEVICE
+{
+    SESSION_DEVICE_ADS1293=0,
+    SESSION_DEVICE_MAX30009
+} SESSION_DEVICE_TDE;
+
+typedef struct SESSION_FILE_HEADER
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t segment_index;
+    uint32_t reserved;
+    int64_t start_realtime_ns;  // system clock at session start
+    int64_t start_monotonic_ns; // CLOCK_MONOTONIC at session start, chunk times are monotonic
+} SESSION_FILE_HEADER_TDS;
+
+typedef struct SESSION_CHUNK_HEADER
+{
+    uint32_t magic;
+    uint16_t type;
+    uint16_t header_size;
+    uint32_t payload_size;
+    uint32_t record_count;
+    uint64_t first_seq;       // sequence number of first sample in device ring, ICG - first ADC sample of first point
+    int64_t first_time_ns;    // CLOCK_MONOTONIC time of first record
+    double sample_rate;       // nominal rate of records, samples go one after another from first_seq
+    uint32_t record_size;     // 0 - records of variable size
+    uint32_t crc32;           // header with crc32=0 and payload
+} SESSION_CHUNK_HEADER_TDS;
+
+typedef struct SESSION_INDEX_ENTRY
+{
+    uint16_t type;
+    uint16_t reserved;
+    uint32_t record_count;
+    uint64_t offset;          // chunk header position in segment
+    uint64_t first_seq;
+    int64_t first_time_ns;
+} SESSION_INDEX_ENTRY_TDS;
+
+typedef struct SESSION_ECG_RECORD
+{
+    int32_t ch1;
+    int32_t ch2;
+    int32_t ch3;
+} SESSION_ECG_RECORD_TDS;
+
+//values are x10000 as in get_data response
+typedef struct SESSION_ICG_RECORD
+{
+    int32_t load_real;
+    int32_t load_mag;
+    int32_t load_imag;
+    int32_t load_angle;
+    int32_t overload;
+} SESSION_ICG_RECORD_TDS;
+
+typedef struct SESSION_SYNC_RECORD
+{
+    uint32_t device;
+    int32_t sync_num;
+    uint64_t sample_count;
+    int64_t time_ms;
+} SESSION_SYNC_RECORD_TDS;
+
+typedef struct SESSION_SETTINGS_RECORD
+{
+    uint32_t device;
+    uint32_t text_size;       // JSON text follows record
+} SESSION_SETTINGS_RECORD_TDS;
+
+#endif // SESSION_RECORD_FORMAT_H
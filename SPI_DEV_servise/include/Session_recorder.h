@@ -0,0 +1,133 @@
+#ifndef SESSION_RECORDER_H
+#define SESSION_RECORDER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+#include "ADS1293_process.h"
+#include "MAX30009_process.h"
+#include "JSON_stream_writer.h"
+#include "JSON_command_parser.h"
+#include "Spsc_queue.h"
+#include "Session_record_format.h"
+#include "Session_BDF_exporter.h"
+
+//continuous recording of ECG, ICG, sync marks and settings changes to session files on device.
+//Main loop reads new data from device rings with own cursors and fills chunks in preallocated buffers,
+//full chunks are passed to writer thread by lock free queue. Main loop never waits for disk:
+//if all buffers are waiting for writer, new data is dropped and counted
+class Session_recorder
+{
+public:
+    Session_recorder(ADS1293_process *ADS1293_process_ptr, MAX30009_process *MAX30009_process_ptr);
+    ~Session_recorder();
+
+    std::string process_JSON_line(const char * JSON_line);
+    void process(void);
+
+    /**
+        \brief start new session
+        \param [in] fsync_interval_ms - max time of written data in page cache, 0 - sync after every write
+        \param [in] max_segments - count of newest segments which are kept, 0 - all segments are kept
+        \return - false if previous session is not closed by writer yet or directory can not be made
+     */
+    bool start(uint32_t fsync_interval_ms, uint32_t max_segments);
+    void stop(void);
+    std::string get_status_as_json(void);
+
+    //name of current or last session, empty if no session was started
+    const std::string& get_session_name(void);
+    bool is_recording(void);
+
+protected:
+
+private:
+    static const uint32_t CHUNK_BUFFER_SIZE=64*1024;
+    static const uint32_t CHUNK_BUFFERS_COUNT=64;        // about 20 s of data at max rates while disk is busy
+    static const uint32_t CHUNK_DURATION_MS=1000;        // chunk is closed after this time even if it is not full
+    static const uint32_t COLLECT_PERIOD_MS=100;
+    static const uint32_t WRITER_PERIOD_MS=50;
+    static const uint32_t MAX_WRITE_BATCH=16;
+    static const uint64_t SEGMENT_MAX_SIZE=64*1024*1024;
+    static const uint32_t DEFAULT_FSYNC_INTERVAL_MS=1000;
+    static const uint32_t MAX_FSYNC_INTERVAL_MS=60000;
+
+    typedef struct CHUNK_BUILDER
+    {
+        bool is_open;
+        uint32_t buffer_index;
+        uint64_t next_seq; // sequence number which continues chunk
+        std::chrono::steady_clock::time_point open_time;
+    } CHUNK_BUILDER_TDS;
+
+    bool open_chunk(CHUNK_BUILDER_TDS *builder, SESSION_CHUNK_TYPE_TDE type, uint64_t first_seq, int64_t first_time_ns,
+                    double sample_rate, uint32_t record_size);
+    bool append_record(CHUNK_BUILDER_TDS *builder, const void *record, uint32_t size);
+    void close_chunk(CHUNK_BUILDER_TDS *builder);
+    void close_old_chunk(CHUNK_BUILDER_TDS *builder);
+    SESSION_CHUNK_HEADER_TDS* get_chunk_header(uint32_t buffer_index);
+
+    void collect_settings(bool is_forced);
+    void write_settings(SESSION_DEVICE_TDE device, const std::string& settings_json);
+    void collect_ECG(void);
+    void collect_ICG(void);
+    void collect_sync_marks(Sync_mark_index& sync_marks, SESSION_DEVICE_TDE device, uint64_t read_seq, uint64_t *mark_seq);
+
+    //writer thread
+    void writer_process(void);
+    bool open_segment(uint32_t segment_index);
+    void close_segment(void);
+    void write_chunks(const uint32_t *buffer_indexes, uint32_t count);
+    void write_batch(const uint32_t *buffer_indexes, uint32_t count);
+
+    ADS1293_process *_ADS1293_process;
+    MAX30009_process *_MAX30009_process;
+
+    std::vector<std::vector<uint8_t>> _chunk_buffers;
+    Spsc_queue<uint32_t> _full_chunks {CHUNK_BUFFERS_COUNT};  // main loop -> writer
+    Spsc_queue<uint32_t> _free_chunks {CHUNK_BUFFERS_COUNT};  // writer -> main loop
+
+    //main loop side
+    bool _is_recording=false;
+    std::string _session_name;
+    std::chrono::steady_clock::time_point _next_collect_time;
+    CHUNK_BUILDER_TDS _ECG_chunk= {};
+    CHUNK_BUILDER_TDS _ICG_chunk= {};
+    CHUNK_BUILDER_TDS _sync_chunk= {};
+    uint64_t _ECG_seq=0;
+    uint64_t _ICG_seq=0;
+    uint64_t _ECG_mark_seq=0;
+    uint64_t _ICG_mark_seq=0;
+    std::vector<MAX30009_FIFO_DATA_CALIB_TYPE> _ICG_data;    // decimated points, capacity is kept
+    uint32_t _ADS1293_settings_version=0;
+    uint32_t _MAX30009_settings_version=0;
+    uint64_t _lost_ECG_samples=0;
+    uint64_t _lost_ICG_samples=0;
+    uint64_t _dropped_chunks=0;
+
+    //writer thread side
+    std::thread _writer_thread;
+    std::atomic<bool> _is_writer_running {false};
+    std::atomic<bool> _writer_stop {false};
+    std::string _session_dir;
+    uint32_t _fsync_interval_ms=DEFAULT_FSYNC_INTERVAL_MS;
+    uint32_t _max_segments=0;
+    int64_t _start_realtime_ns=0;
+    int64_t _start_monotonic_ns=0;
+    int _segment_fd=-1;
+    int _index_fd=-1;
+    uint64_t _segment_size=0;
+    std::atomic<uint32_t> _segment_index {0};
+    std::atomic<uint64_t> _bytes_written {0};
+    std::atomic<uint64_t> _chunks_written {0};
+    std::atomic<uint64_t> _write_errors {0};
+
+    Session_BDF_exporter _BDF_exporter;
+    JSON_stream_writer _json_writer {1024};
+};
+
+#endif // SESSION_RECORDER_H
@@ -0,0 +1,69 @@
+#ifndef SESSION_SEGMENT_READER_H
+#define SESSION_SEGMENT_READER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Session_record_format.h"
+
+//read only view of one segment file of recorded session. Segment is mapped to memory, chunk index is
+//loaded from index file or rebuilt from chunks. Segment which is being written can be opened,
+//it is seen as it was at open time
+class Session_segment_reader
+{
+public:
+    ~Session_segment_reader();
+
+    /**
+        \brief map segment and load its index
+        \param [in] session_dir - directory of session
+        \param [in] segment_index - number of segment
+        \return - false if segment is not found or has wrong header
+     */
+    bool open(const std::string& session_dir, uint32_t segment_index);
+    void close(void);
+
+    const SESSION_FILE_HEADER_TDS& get_file_header(void);
+    const std::string& get_filename(void);
+
+    //chunks of one type in file order
+    uint32_t get_chunks_count(SESSION_CHUNK_TYPE_TDE type);
+    const SESSION_INDEX_ENTRY_TDS& get_entry(SESSION_CHUNK_TYPE_TDE type, uint32_t position);
+
+    /**
+        \brief find chunk which can have time, it is last chunk which starts not later than time
+        \param [in] type - chunk type
+        \param [in] time_ns - CLOCK_MONOTONIC time
+        \return - position of chunk in chunks of type
+     */
+    uint32_t find(SESSION_CHUNK_TYPE_TDE type, int64_t time_ns);
+
+    /**
+        \brief get chunk with checked CRC
+        \param [in] entry - index entry of chunk
+        \return - chunk header, payload follows it. nullptr if chunk is damaged
+     */
+    const SESSION_CHUNK_HEADER_TDS* get_chunk(const SESSION_INDEX_ENTRY_TDS& entry);
+
+    static std::string get_segment_filename(const std::string& session_dir, uint32_t segment_index, const char *extension);
+    //numbers of segments of session, sorted. Oldest segments can be removed by retention of recorder
+    static std::vector<uint32_t> list_segments(const std::string& session_dir);
+
+protected:
+
+private:
+    static const uint32_t CHUNK_TYPES_COUNT=SESSION_CHUNK_SETTINGS+1;
+
+    bool load_index(const std::string& index_filename);
+    void rebuild_index(void);
+    bool check_chunk(uint64_t offset);
+
+    std::string _filename;
+    const uint8_t *_map=nullptr;
+    size_t _size=0;
+    SESSION_FILE_HEADER_TDS _file_header= {};
+    std::vector<SESSION_INDEX_ENTRY_TDS> _entries[CHUNK_TYPES_COUNT];
+};
+
+#endif // SESSION_SEGMENT_READER_H
@@ -0,0 +1,72 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+
+//single producer single consumer queue of fixed capacity, push and pop never wait
+template <typename T>
+class Spsc_queue
+{
+public:
+    Spsc_queue(uint32_t min_capacity=2)
+    {
+        uint32_t capacity=2;
+        while (capacity<min_capacity)
+        {
+            capacity<<=1;
+        }
+        _buffer.assign(capacity,T());
+        _mask=capacity-1;
+    }
+
+    /**
+        \brief add item (producer side)
+        \param [in] item - item
+        \return - false if queue is full
+     */
+    bool push(const T& item)
+    {
+        uint64_t tail=_tail.load(std::memory_order_relaxed);
+        if (tail-_head.load(std::memory_order_acquire)>_mask)
+        {
+            return false;
+        }
+        _buffer[tail & _mask]=item;
+        _tail.store(tail+1,std::memory_order_release);
+        return true;
+    }
+
+    /**
+        \brief take oldest item (consumer side)
+        \param [out] item - item
+        \return - false if queue is empty
+     */
+    bool pop(T *item)
+    {
+        uint64_t head=_head.load(std::memory_order_relaxed);
+        if (head==_tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        *item=_buffer[head & _mask];
+        _head.store(head+1,std::memory_order_release);
+        return true;
+    }
+
+    uint32_t get_size(void)
+    {
+        return _tail.load(std::memory_order_acquire)-_head.load(std::memory_order_acquire);
+    }
+
+protected:
+
+private:
+    std::vector<T> _buffer;
+    uint64_t _mask=1;
+    std::atomic<uint64_t> _head {0};
+    std::atomic<uint64_t> _tail {0};
+};
+
+#endif // SPSC_QUEUE_H
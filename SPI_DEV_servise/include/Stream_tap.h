@@ -0,0 +1,423 @@
+#ifndef STREAM_TAP_H
+#define STREAM_TAP_H
+
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <memory>
+#include <algorithm>
+
+#include "Sample_ring.h"
+#include "JSON_stream_writer.h"
+
+typedef enum TAP_FILTER
+{
+    TAP_FILTER_MEAN=0,  // mean of decimation block
+    TAP_FILTER_FIR      // windowed sinc low pass below output Nyquist frequency, centered on output sample
+} TAP_FILTER_TDE;
+
+static const char * const TAP_FILTER_NAMES[]= {"mean","fir"};
+static const char TAP_RAW_SOURCE[]="raw";
+
+inline bool get_tap_filter(std::string_view name, TAP_FILTER_TDE *filter)
+{
+    for (uint32_t i=0; i<sizeof(TAP_FILTER_NAMES)/sizeof(TAP_FILTER_NAMES[0]); i++)
+    {
+        if (name==TAP_FILTER_NAMES[i])
+        {
+            *filter=(TAP_FILTER_TDE)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct TAP_SETTINGS
+{
+    std::string name;
+    std::string source;       // TAP_RAW_SOURCE or name of other tap
+    TAP_FILTER_TDE filter;
+    uint32_t decimation;      // 0 - decimation is chosen for rate
+    double rate;              // requested output rate, Hz
+} TAP_SETTINGS_TDS;
+
+//named output stream: decimation with filter of raw samples or of other tap. Samples are pushed by producer,
+//output samples are kept in own ring with sequence numbers, readers use cursors as with device ring.
+//Output sample k belongs to raw sample position get_raw_position(k) (fractional, for clock model)
+template <uint32_t CHANNELS>
+class Stream_tap
+{
+public:
+    typedef std::array<int32_t,CHANNELS> TAP_SAMPLE_TDS;
+
+    static const uint32_t BUFFER_DURATION=10;           // seconds of output samples
+    static const uint32_t FIR_LENGTH_PER_DECIMATION=6;
+    static const uint32_t MAX_FIR_LENGTH=1025;          // longer decimation should be cascade of taps
+    static constexpr double CUTOFF_MARGIN=0.9;          // cutoff relative to output Nyquist frequency
+
+    Stream_tap(const TAP_SETTINGS_TDS& settings, int32_t source_index)
+        : _settings(settings),
+          _source_index(source_index)
+    {
+    }
+
+    /**
+        \brief drop data, choose decimation and filter for source rate
+        \param [in] source_rate - rate of source samples, Hz
+        \param [in] source_position - raw sample position of next source sample
+        \param [in] source_step - raw samples between source samples
+     */
+    void reset(double source_rate, double source_position, double source_step)
+    {
+        _decimation=_settings.decimation;
+        if (_decimation==0)
+        {
+            _decimation=_settings.rate>0 && source_rate>0 ? std::max<long>(std::lround(source_rate/_settings.rate),1) : 1;
+        }
+        _rate=source_rate/_decimation;
+
+        double delay=(_decimation-1)/2.0;
+        if (_settings.filter==TAP_FILTER_FIR)
+        {
+            design_FIR();
+            delay=(_FIR_koefs.size()-1)/2.0;
+        }
+        _sums.fill(0);
+        _count=0;
+        _input_count=0;
+        _next_output=_settings.filter==TAP_FILTER_FIR ? _FIR_koefs.size() : _decimation;
+
+        _ring.resize((uint32_t)std::max(_rate*BUFFER_DURATION,2.0));
+        _first_seq=_ring.get_write_seq();
+        _raw_position=source_position+source_step*delay;
+        _raw_step=source_step*_decimation;
+    }
+
+    /**
+        \brief add source sample
+        \param [in] values - CHANNELS values
+        \return - true if output sample is made
+     */
+    bool push(const int32_t *values)
+    {
+        if (_settings.filter==TAP_FILTER_MEAN)
+        {
+            for (uint32_t j=0; j<CHANNELS; j++)
+            {
+                _sums[j]+=values[j];
+            }
+            _count++;
+            if (_count<_decimation)
+            {
+                return false;
+            }
+            for (uint32_t j=0; j<CHANNELS; j++)
+            {
+                _output[j]=std::llround((double)_sums[j]/_decimation);
+                _sums[j]=0;
+            }
+            _count=0;
+        }
+        else
+        {
+            double *history=&_history[(_input_count & _history_mask)*CHANNELS];
+            for (uint32_t j=0; j<CHANNELS; j++)
+            {
+                history[j]=values[j];
+            }
+            _input_count++;
+            if (_input_count<_next_output)
+            {
+                return false;
+            }
+            _next_output+=_decimation;
+
+            double sums[CHANNELS]= {};
+            uint64_t first=_input_count-_FIR_koefs.size();
+            for (uint32_t t=0; t<_FIR_koefs.size(); t++)
+            {
+                history=&_history[((first+t) & _history_mask)*CHANNELS];
+                for (uint32_t j=0; j<CHANNELS; j++)
+                {
+                    sums[j]+=_FIR_koefs[t]*history[j];
+                }
+            }
+            for (uint32_t j=0; j<CHANNELS; j++)
+            {
+                _output[j]=std::llround(sums[j]);
+            }
+        }
+        _ring.push(_output);
+        return true;
+    }
+
+    const TAP_SETTINGS_TDS& get_settings(void)
+    {
+        return _settings;
+    }
+
+    int32_t get_source_index(void)
+    {
+        return _source_index;
+    }
+
+    void set_source_index(int32_t source_index)
+    {
+        _source_index=source_index;
+    }
+
+    uint32_t get_decimation(void)
+    {
+        return _decimation;
+    }
+
+    double get_rate(void)
+    {
+        return _rate;
+    }
+
+    uint32_t get_FIR_length(void)
+    {
+        return _settings.filter==TAP_FILTER_FIR ? _FIR_koefs.size() : 0;
+    }
+
+    Sample_ring<TAP_SAMPLE_TDS>& get_ring(void)
+    {
+        return _ring;
+    }
+
+    const TAP_SAMPLE_TDS& get_output(void)
+    {
+        return _output;
+    }
+
+    //raw sample position of output sample, it is middle of filter
+    double get_raw_position(uint64_t seq)
+    {
+        return _raw_position+_raw_step*((double)seq-(double)_first_seq);
+    }
+
+    double get_raw_step(void)
+    {
+        return _raw_step;
+    }
+
+protected:
+
+private:
+    void design_FIR(void)
+    {
+        uint32_t length=std::min(FIR_LENGTH_PER_DECIMATION*_decimation+1,MAX_FIR_LENGTH);
+        double cutoff=CUTOFF_MARGIN/_decimation;   // relative to input Nyquist frequency
+        double middle=(length-1)/2.0;
+        double sum=0;
+        _FIR_koefs.resize(length);
+        for (uint32_t t=0; t<length; t++)
+        {
+            double x=M_PI*cutoff*(t-middle);
+            double sinc=std::fabs(x)<1e-12 ? 1.0 : std::sin(x)/x;
+            double window=length==1 ? 1.0 : 0.42-0.5*std::cos(2*M_PI*t/(length-1))+0.08*std::cos(4*M_PI*t/(length-1));
+            _FIR_koefs[t]=sinc*window;
+            sum+=_FIR_koefs[t];
+        }
+        //gain 1, DC level is kept
+        for (double& koef : _FIR_koefs)
+        {
+            koef/=sum;
+        }
+        uint32_t capacity=2;
+        while (capacity<length)
+        {
+            capacity<<=1;
+        }
+        _history.assign((size_t)capacity*CHANNELS,0);
+        _history_mask=capacity-1;
+    }
+
+    TAP_SETTINGS_TDS _settings;
+    int32_t _source_index;          // -1 - raw samples
+    uint32_t _decimation=1;
+    double _rate=0;
+
+    std::array<int64_t,CHANNELS> _sums= {};
+    uint32_t _count=0;
+    std::vector<double> _FIR_koefs;
+    std::vector<double> _history;   // last source samples, channels are interleaved
+    uint64_t _history_mask=1;
+    uint64_t _input_count=0;
+    uint64_t _next_output=0;        // count of source samples for next output
+
+    TAP_SAMPLE_TDS _output= {};
+    Sample_ring<TAP_SAMPLE_TDS> _ring;
+    uint64_t _first_seq=0;          // output sequence number at reset
+    double _raw_position=0;         // raw position of first output after reset
+    double _raw_step=1;
+};
+
+//output taps of one device. Raw samples are pushed once, tap with other tap as source gets its output samples,
+//so low rate taps can be cascaded from higher rate taps. Source tap is always before its users
+template <uint32_t CHANNELS>
+class Stream_tap_bank
+{
+public:
+    static const uint32_t MAX_TAPS=8;
+    static const uint32_t MAX_DECIMATION=100000;
+
+    /**
+        \brief reset all taps after change of raw rate
+        \param [in] raw_rate - rate of raw samples, Hz
+        \param [in] raw_seq - sequence number of next raw sample
+     */
+    void reset(double raw_rate, uint64_t raw_seq)
+    {
+        _raw_rate=raw_rate;
+        for (uint32_t i=0; i<_taps.size(); i++)
+        {
+            reset_tap(i,raw_seq);
+        }
+    }
+
+    /**
+        \brief add tap
+        \param [in] settings - settings of tap
+        \param [in] raw_seq - sequence number of next raw sample
+        \return - false if name is used, source is not found, settings are wrong or all taps are used
+     */
+    bool add(const TAP_SETTINGS_TDS& settings, uint64_t raw_seq)
+    {
+        if (_taps.size()>=MAX_TAPS || settings.name.empty()==true || settings.name==TAP_RAW_SOURCE ||
+            find(settings.name)!=nullptr || (settings.decimation==0 && !(settings.rate>0)) || settings.decimation>MAX_DECIMATION)
+        {
+            return false;
+        }
+        int32_t source_index=-1;
+        if (settings.source!=TAP_RAW_SOURCE)
+        {
+            source_index=find_index(settings.source);
+            if (source_index<0)
+            {
+                return false;
+            }
+        }
+        _taps.push_back(std::make_unique<Stream_tap<CHANNELS>>(settings,source_index));
+        reset_tap(_taps.size()-1,raw_seq);
+        return true;
+    }
+
+    //tap which is source of other tap is not removed
+    bool remove(std::string_view name)
+    {
+        int32_t index=find_index(name);
+        if (index<0)
+        {
+            return false;
+        }
+        for (const std::unique_ptr<Stream_tap<CHANNELS>>& tap : _taps)
+        {
+            if (tap->get_source_index()==index)
+            {
+                return false;
+            }
+        }
+        _taps.erase(_taps.begin()+index);
+        for (const std::unique_ptr<Stream_tap<CHANNELS>>& tap : _taps)
+        {
+            if (tap->get_source_index()>index)
+            {
+                tap->set_source_index(tap->get_source_index()-1);
+            }
+        }
+        return true;
+    }
+
+    void push(const int32_t *values)
+    {
+        for (uint32_t i=0; i<_taps.size(); i++)
+        {
+            if (_taps[i]->get_source_index()<0)
+            {
+                push_to(i,values);
+            }
+        }
+    }
+
+    Stream_tap<CHANNELS>* find(std::string_view name)
+    {
+        int32_t index=find_index(name);
+        return index<0 ? nullptr : _taps[index].get();
+    }
+
+    void write_taps_json(JSON_stream_writer *writer)
+    {
+        writer->begin_object();
+        writer->key_value("type","taps");
+        writer->key("taps");
+        writer->begin_array();
+        for (const std::unique_ptr<Stream_tap<CHANNELS>>& tap : _taps)
+        {
+            const TAP_SETTINGS_TDS& settings=tap->get_settings();
+            writer->begin_object();
+            writer->key_value("tap",settings.name);
+            writer->key_value("source",settings.source);
+            writer->key_value("filter",TAP_FILTER_NAMES[settings.filter]);
+            writer->key_value("FIR_length",tap->get_FIR_length());
+            writer->key_value("decimation",tap->get_decimation());
+            writer->key_value("sample_rate",tap->get_rate());
+            writer->key_value("next_seq",tap->get_ring().get_write_seq());
+            writer->end_object();
+        }
+        writer->end_array();
+        writer->end_object();
+    }
+
+protected:
+
+private:
+    int32_t find_index(std::string_view name)
+    {
+        for (uint32_t i=0; i<_taps.size(); i++)
+        {
+            if (_taps[i]->get_settings().name==name)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void push_to(uint32_t index, const int32_t *values)
+    {
+        if (_taps[index]->push(values)==false)
+        {
+            return;
+        }
+        for (uint32_t i=index+1; i<_taps.size(); i++)
+        {
+            if (_taps[i]->get_source_index()==(int32_t)index)
+            {
+                push_to(i,_taps[index]->get_output().data());
+            }
+        }
+    }
+
+    void reset_tap(uint32_t index, uint64_t raw_seq)
+    {
+        Stream_tap<CHANNELS> *tap=_taps[index].get();
+        if (tap->get_source_index()<0)
+        {
+            tap->reset(_raw_rate,raw_seq,1.0);
+            return;
+        }
+        //next source sample is next output of source tap
+        Stream_tap<CHANNELS> *source=_taps[tap->get_source_index()].get();
+        tap->reset(source->get_rate(),source->get_raw_position(source->get_ring().get_write_seq()),source->get_raw_step());
+    }
+
+    std::vector<std::unique_ptr<Stream_tap<CHANNELS>>> _taps;
+    double _raw_rate=0;
+};
+
+#endif // STREAM_TAP_H
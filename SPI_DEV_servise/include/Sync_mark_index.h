@@ -0,0 +1,81 @@
+#ifndef SYNC_MARK_INDEX_H
+#define SYNC_MARK_INDEX_H
+
+#include <cstdint>
+#include <chrono>
+
+typedef struct SYNC_MARK
+{
+    uint64_t sample_count; // samples written before mark, mark belongs to sample with this sequence number
+    int32_t sync_num;
+    int64_t time_ms;       // system clock, milliseconds from epoch
+} SYNC_MARK_TDS;
+
+//sync marks are kept next to sample ring, sample data stays free of magic values.
+//Marks are not removed by readers, any number of readers can find marks of their samples.
+//Oldest mark is overwritten when index is full
+class Sync_mark_index
+{
+public:
+    static const uint32_t MARKS_COUNT=64;
+
+    void add(uint64_t sample_count, int32_t sync_num)
+    {
+        if (_size==MARKS_COUNT)
+        {
+            pop();
+        }
+        SYNC_MARK_TDS &mark=_marks[(_first+_size)%MARKS_COUNT];
+        mark.sample_count=sample_count;
+        mark.sync_num=sync_num;
+        mark.time_ms=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        _size++;
+    }
+
+    uint32_t get_size(void)
+    {
+        return _size;
+    }
+
+    //index 0 is oldest mark, marks are sorted by sample_count
+    const SYNC_MARK_TDS& get_mark(uint32_t index)
+    {
+        return _marks[(_first+index)%MARKS_COUNT];
+    }
+
+    /**
+        \brief find oldest mark of sample with sequence number not below given
+        \param [in] sample_count - sequence number of sample
+        \return - mark index, get_size() if no such mark
+     */
+    uint32_t find(uint64_t sample_count)
+    {
+        uint32_t index=0;
+        while (index<_size && get_mark(index).sample_count<sample_count)
+        {
+            index++;
+        }
+        return index;
+    }
+
+    void clear(void)
+    {
+        _first=0;
+        _size=0;
+    }
+
+protected:
+
+private:
+    void pop(void)
+    {
+        _first=(_first+1)%MARKS_COUNT;
+        _size--;
+    }
+
+    SYNC_MARK_TDS _marks[MARKS_COUNT]= {};
+    uint32_t _first=0;
+    uint32_t _size=0;
+};
+
+#endif // SYNC_MARK_INDEX_H
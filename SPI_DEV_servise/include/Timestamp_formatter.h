@@ -0,0 +1,60 @@
+#ifndef TIMESTAMP_FORMATTER_H
+#define TIMESTAMP_FORMATTER_H
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <chrono>
+
+//time text "YYYY-MM-DD HH:MM:SS.uuuuuu" (UTC) from realtime nanoseconds. Date and time part is formatted
+//once per second and reused, only microseconds are written for every call
+class Timestamp_formatter
+{
+public:
+    static int64_t get_realtime_ns(void)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+        \brief format time, returned text is valid until next call
+        \param [in] realtime_ns - nanoseconds from epoch
+        \return - time text
+     */
+    const std::string& format(int64_t realtime_ns)
+    {
+        int64_t second=realtime_ns/NS_IN_SECOND;
+        if (second!=_cached_second || _text.empty())
+        {
+            std::time_t time=(std::time_t)second;
+            std::tm ptm;
+            gmtime_r(&time,&ptm);
+            char prefix[32];
+            size_t size=strftime(prefix,sizeof(prefix),"%Y-%m-%d %H:%M:%S.",&ptm);
+            _text.assign(prefix,size);
+            _prefix_size=size;
+            _cached_second=second;
+        }
+        uint32_t microseconds=(uint32_t)((realtime_ns%NS_IN_SECOND)/1000);
+        char digits[6];
+        for (int32_t i=5; i>=0; i--)
+        {
+            digits[i]='0'+microseconds%10;
+            microseconds=microseconds/10;
+        }
+        _text.resize(_prefix_size);
+        _text.append(digits,sizeof(digits));
+        return _text;
+    }
+
+protected:
+
+private:
+    static const int64_t NS_IN_SECOND=1000000000;
+
+    std::string _text;
+    size_t _prefix_size=0;
+    int64_t _cached_second=-1;
+};
+
+#endif // TIMESTAMP_FORMATTER_H
@@ -2,7 +2,9 @@
 #define WS2812_PROCESS_H
 
 #include "WS2812_wrap_cls.h"
-#include "json.hpp"
+#include "JSON_command_parser.h"
+#include <string>
+#include <iostream>
 
 
 
@@ -67,60 +69,75 @@ public:
         {
             std::cout << "IN:" << JSON_line << std::endl << std::endl;
 
-            nlohmann::json parsed_json;
-            nlohmann::json response;
-
-            try
+            //frame is decoded to copy and applied only if whole command is valid
+            WS_COLOR_TDS colors[WS_LED_COUNT];
+            for (uint32_t i=0; i<WS_LED_COUNT; i++)
             {
-                parsed_json = nlohmann::json::parse(JSON_line);
+                colors[i]=new_colors[i];
+            }
+            bool leds_found=false;
+            uint32_t transition_time=0;
+            std::string_view key;
 
-                if ( parsed_json.contains("leds") &&  parsed_json["leds"].is_array())
+            JSON_command_parser parser(JSON_line);
+            if (parser.begin_object()==true)
+            {
+                while (parser.next_key(&key)==true)
                 {
-                    std::cout << "LEDs array found:" << std::endl;
-
-                    int led_num=0;
-                    for (const auto& led_color :  parsed_json["leds"])
+                    if (key=="leds" && parser.begin_array()==true)
                     {
-                        if (led_color.is_array() && led_color.size() == 3)
+                        leds_found=true;
+                        uint32_t led_num=0;
+                        bool is_stoped=false;
+                        while (parser.next_array_item()==true && parser.begin_array()==true)
                         {
-
-                            if(led_num<WS_LED_COUNT)
+                            uint8_t led_color[3];
+                            uint32_t color_count=0;
+                            while (parser.next_array_item()==true)
                             {
-                                new_colors[led_num].R = led_color[0].get<uint8_t>();
-                                new_colors[led_num].G  = led_color[1].get<uint8_t>();
-                                new_colors[led_num].B = led_color[2].get<uint8_t>();
+                                uint8_t color=0;
+                                parser.read_number(&color);
+                                if (color_count<3)
+                                {
+                                    led_color[color_count]=color;
+                                }
+                                color_count++;
                             }
-                             led_num++;
-                        }
-                        else
-                        {
-                            break;
+                            if (color_count!=3)
+                            {
+                                is_stoped=true;
+                            }
+                            if (is_stoped==false && led_num<WS_LED_COUNT)
+                            {
+                                colors[led_num].R=led_color[0];
+                                colors[led_num].G=led_color[1];
+                                colors[led_num].B=led_color[2];
+                            }
+                            led_num++;
                         }
                     }
-                    uint32_t transition_time=0;
-                    if (parsed_json.contains("t_time"))
+                    else if (key=="t_time")
                     {
-                        transition_time=parsed_json["t_time"];
+                        parser.read_number(&transition_time);
+                    }
+                    else
+                    {
+                        parser.skip_value();
                     }
-                    start_animation(transition_time);
-
-                    return "{\"type\": \"colors_is_set\"}";
-                }
-                else
-                {
-                    response["type"] = "error JSON";
                 }
-
             }
-            catch (const std::exception& e)
-            {
 
+            if (parser.is_finished()==false || leds_found==false)
+            {
+                return "{\"type\":\"error JSON\"}";
             }
 
-            response["type"] = "error JSON";
-            std::string response_string = response.dump();
-            return response_string;
-
+            for (uint32_t i=0; i<WS_LED_COUNT; i++)
+            {
+                new_colors[i]=colors[i];
+            }
+            start_animation(transition_time);
+            return "{\"type\": \"colors_is_set\"}";
         }
 
 
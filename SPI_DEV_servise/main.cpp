@@ -9,10 +9,23 @@
 #include "MAX30009_process.h"
 #include "ADS1293_process.h"
 #include "WS2812_process.h"
+#include "ECG_ICG_align_process.h"
+#include "ICG_feature_process.h"
+#include "Hemodynamics_process.h"
+#include "Session_recorder.h"
+#include "Session_query_process.h"
+#include "Device_mux_process.h"
 
 MAX30009_process MAX30009_process_obj;
 ADS1293_process ADS1293_process_obj;
 WS2812_process WS2812_process_obj;
+ECG_ICG_align_process ECG_ICG_align_process_obj(&ADS1293_process_obj,&MAX30009_process_obj);
+ICG_feature_process ICG_feature_process_obj(&ADS1293_process_obj,&MAX30009_process_obj);
+Hemodynamics_process Hemodynamics_process_obj(&ICG_feature_process_obj);
+Session_recorder Session_recorder_obj(&ADS1293_process_obj,&MAX30009_process_obj);
+Session_query_process Session_query_process_obj(&Session_recorder_obj);
+Device_mux_process Device_mux_process_obj(&ADS1293_process_obj,&MAX30009_process_obj,&WS2812_process_obj,&ECG_ICG_align_process_obj,
+                                          &Session_recorder_obj);
 
 #include <iostream>
 #include <vector>
@@ -37,7 +50,9 @@ std::atomic<bool> MAX30009_request_ready_flag(false);
 std::string MAX30009_response_json;
 std::atomic<bool> MAX30009_response_ready_flag(false);
 const int MAX30009_port=30009;
-JSON_TCP_sever MAX30009_TCP_server(MAX30009_port,&MAX30009_request_json,&MAX30009_request_ready_flag,&MAX30009_response_json,&MAX30009_response_ready_flag);
+TCP_ATTACHMENT_TDS MAX30009_response_attachment;
+JSON_TCP_sever MAX30009_TCP_server(MAX30009_port,&MAX30009_request_json,&MAX30009_request_ready_flag,&MAX30009_response_json,&MAX30009_response_ready_flag,
+                                   &MAX30009_response_attachment);
 
 std::string WS2812_request_json;
 std::atomic<bool> WS2812_request_ready_flag(false);
@@ -46,6 +61,43 @@ std::atomic<bool> WS2812_response_ready_flag(false);
 const int WS2812_port=2812;
 JSON_TCP_sever WS2812_TCP_server(WS2812_port,&WS2812_request_json,&WS2812_request_ready_flag,&WS2812_response_json,&WS2812_response_ready_flag);
 
+std::string ALIGN_request_json;
+std::atomic<bool> ALIGN_request_ready_flag(false);
+std::string ALIGN_response_json;
+std::atomic<bool> ALIGN_response_ready_flag(false);
+const int ALIGN_port=1294;
+JSON_TCP_sever ALIGN_TCP_server(ALIGN_port,&ALIGN_request_json,&ALIGN_request_ready_flag,&ALIGN_response_json,&ALIGN_response_ready_flag);
+
+std::string MUX_request_json;
+std::atomic<bool> MUX_request_ready_flag(false);
+std::string MUX_response_json;
+std::atomic<bool> MUX_response_ready_flag(false);
+const int MUX_port=1290;
+JSON_TCP_sever MUX_TCP_server(MUX_port,&MUX_request_json,&MUX_request_ready_flag,&MUX_response_json,&MUX_response_ready_flag);
+
+std::string QUERY_request_json;
+std::atomic<bool> QUERY_request_ready_flag(false);
+std::string QUERY_response_json;
+std::atomic<bool> QUERY_response_ready_flag(false);
+TCP_ATTACHMENT_TDS QUERY_response_attachment;
+const int QUERY_port=1295;
+JSON_TCP_sever QUERY_TCP_server(QUERY_port,&QUERY_request_json,&QUERY_request_ready_flag,&QUERY_response_json,&QUERY_response_ready_flag,
+                                &QUERY_response_attachment);
+
+std::string FEATURE_request_json;
+std::atomic<bool> FEATURE_request_ready_flag(false);
+std::string FEATURE_response_json;
+std::atomic<bool> FEATURE_response_ready_flag(false);
+const int FEATURE_port=1296;
+JSON_TCP_sever FEATURE_TCP_server(FEATURE_port,&FEATURE_request_json,&FEATURE_request_ready_flag,&FEATURE_response_json,&FEATURE_response_ready_flag);
+
+std::string HEMO_request_json;
+std::atomic<bool> HEMO_request_ready_flag(false);
+std::string HEMO_response_json;
+std::atomic<bool> HEMO_response_ready_flag(false);
+const int HEMO_port=1297;
+JSON_TCP_sever HEMO_TCP_server(HEMO_port,&HEMO_request_json,&HEMO_request_ready_flag,&HEMO_response_json,&HEMO_response_ready_flag);
+
 
 void delay(int ms)
 {
@@ -59,6 +111,11 @@ int main()
     ADS1293_TCP_server.Start();
     MAX30009_TCP_server.Start();
     WS2812_TCP_server.Start();
+    ALIGN_TCP_server.Start();
+    MUX_TCP_server.Start();
+    QUERY_TCP_server.Start();
+    FEATURE_TCP_server.Start();
+    HEMO_TCP_server.Start();
 
 
 
@@ -72,7 +129,8 @@ int main()
             std::string response_json;
             response_json=ADS1293_process_obj.process_JSON_line(ADS1293_request_json.c_str());
             ADS1293_request_ready_flag.store(false, std::memory_order_release);
-            if (ADS1293_response_ready_flag.load(std::memory_order_release)==false)
+            //empty response - get_data request waits for samples
+            if (response_json.empty()==false && ADS1293_response_ready_flag.load(std::memory_order_release)==false)
             {
                 ADS1293_response_json=response_json;
                 ADS1293_response_ready_flag.store(true, std::memory_order_release);
@@ -84,8 +142,10 @@ int main()
             std::string response_json;
             response_json=MAX30009_process_obj.process_JSON_line(MAX30009_request_json.c_str());
             MAX30009_request_ready_flag.store(false, std::memory_order_release);
-            if (MAX30009_response_ready_flag.load(std::memory_order_release)==false)
+            //empty response - get_data request waits for samples, raw I/Q words are sent by server after JSON line
+            if (response_json.empty()==false && MAX30009_response_ready_flag.load(std::memory_order_release)==false)
             {
+                MAX30009_process_obj.move_attachment(&MAX30009_response_attachment);
                 MAX30009_response_json=response_json;
                 MAX30009_response_ready_flag.store(true, std::memory_order_release);
             }
@@ -103,6 +163,70 @@ int main()
             }
         }
 
+        if (ALIGN_request_ready_flag.load(std::memory_order_acquire)==true)
+        {
+            std::string response_json;
+            response_json=ECG_ICG_align_process_obj.process_JSON_line(ALIGN_request_json.c_str());
+            ALIGN_request_ready_flag.store(false, std::memory_order_release);
+            if (ALIGN_response_ready_flag.load(std::memory_order_acquire)==false)
+            {
+                ALIGN_response_json=response_json;
+                ALIGN_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
+        if (MUX_request_ready_flag.load(std::memory_order_acquire)==true)
+        {
+            std::string response_json;
+            response_json=Device_mux_process_obj.process_JSON_line(MUX_request_json.c_str());
+            MUX_request_ready_flag.store(false, std::memory_order_release);
+            //empty response - get_data request waits for samples
+            if (response_json.empty()==false && MUX_response_ready_flag.load(std::memory_order_acquire)==false)
+            {
+                MUX_response_json=response_json;
+                MUX_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
+        if (QUERY_request_ready_flag.load(std::memory_order_acquire)==true)
+        {
+            std::string response_json;
+            response_json=Session_query_process_obj.process_JSON_line(QUERY_request_json.c_str());
+            QUERY_request_ready_flag.store(false, std::memory_order_release);
+            //empty response - query is running in own thread
+            if (response_json.empty()==false && QUERY_response_ready_flag.load(std::memory_order_acquire)==false)
+            {
+                QUERY_response_json=response_json;
+                QUERY_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
+        if (FEATURE_request_ready_flag.load(std::memory_order_acquire)==true)
+        {
+            std::string response_json;
+            response_json=ICG_feature_process_obj.process_JSON_line(FEATURE_request_json.c_str());
+            FEATURE_request_ready_flag.store(false, std::memory_order_release);
+            //empty response - get_icg_features request waits for beats
+            if (response_json.empty()==false && FEATURE_response_ready_flag.load(std::memory_order_acquire)==false)
+            {
+                FEATURE_response_json=response_json;
+                FEATURE_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
+        if (HEMO_request_ready_flag.load(std::memory_order_acquire)==true)
+        {
+            std::string response_json;
+            response_json=Hemodynamics_process_obj.process_JSON_line(HEMO_request_json.c_str());
+            HEMO_request_ready_flag.store(false, std::memory_order_release);
+            //empty response - get_hemodynamics request waits for beats
+            if (response_json.empty()==false && HEMO_response_ready_flag.load(std::memory_order_acquire)==false)
+            {
+                HEMO_response_json=response_json;
+                HEMO_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
         auto current_time = std::chrono::steady_clock::now();
         auto elapsed_time = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - last_call_time);
 
@@ -118,6 +242,9 @@ int main()
         MAX30009_process_obj.process();
         ADS1293_process_obj.process();
         WS2812_process_obj.process();
+        Session_recorder_obj.process();
+        ICG_feature_process_obj.process();
+        Hemodynamics_process_obj.process();
 
         std::string response_json=MAX30009_process_obj.calibration_process();
         if (response_json.size()>2)
@@ -131,6 +258,115 @@ int main()
 
         }
 
+        //waiting get_data request is answered when previous response is sent, request of mux is answered by mux
+        if (ADS1293_response_ready_flag.load(std::memory_order_acquire)==false && Device_mux_process_obj.is_device_pending(MUX_DEVICE_ADS1293)==false)
+        {
+            std::string data_json=ADS1293_process_obj.process_pending_data_request();
+            if (data_json.size()>2)
+            {
+                ADS1293_response_json=data_json;
+                ADS1293_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
+        if (MAX30009_response_ready_flag.load(std::memory_order_acquire)==false && Device_mux_process_obj.is_device_pending(MUX_DEVICE_MAX30009)==false)
+        {
+            //reference to buffer of process, response is copied to reserved response string
+            const std::string& data_json=MAX30009_process_obj.process_pending_data_request();
+            if (data_json.size()>2)
+            {
+                MAX30009_response_json=data_json;
+                MAX30009_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
+        if (MUX_response_ready_flag.load(std::memory_order_acquire)==false)
+        {
+            std::string data_json=Device_mux_process_obj.process_pending_request();
+            if (data_json.size()>2)
+            {
+                MUX_response_json=data_json;
+                MUX_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
+        //binary data of query is sent by server after JSON line
+        if (QUERY_response_ready_flag.load(std::memory_order_acquire)==false)
+        {
+            std::string data_json=Session_query_process_obj.process_pending_request();
+            if (data_json.size()>2)
+            {
+                Session_query_process_obj.move_attachment(&QUERY_response_attachment);
+                QUERY_response_json=data_json;
+                QUERY_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
+        if (FEATURE_response_ready_flag.load(std::memory_order_acquire)==false)
+        {
+            std::string data_json=ICG_feature_process_obj.process_pending_request();
+            if (data_json.size()>2)
+            {
+                FEATURE_response_json=data_json;
+                FEATURE_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
+        if (HEMO_response_ready_flag.load(std::memory_order_acquire)==false)
+        {
+            std::string data_json=Hemodynamics_process_obj.process_pending_request();
+            if (data_json.size()>2)
+            {
+                HEMO_response_json=data_json;
+                HEMO_response_ready_flag.store(true, std::memory_order_release);
+            }
+        }
+
+        //waiting requests of closed connection are canceled, their responses must not be sent to next client.
+        //Request which client sent before it disconnected is processed first, server drops response
+        if (ADS1293_request_ready_flag.load(std::memory_order_acquire)==false && ADS1293_TCP_server.take_client_disconnected()==true &&
+            Device_mux_process_obj.is_device_pending(MUX_DEVICE_ADS1293)==false)
+        {
+            ADS1293_process_obj.cancel_data_request();
+        }
+
+        if (MAX30009_request_ready_flag.load(std::memory_order_acquire)==false && MAX30009_TCP_server.take_client_disconnected()==true &&
+            Device_mux_process_obj.is_device_pending(MUX_DEVICE_MAX30009)==false)
+        {
+            MAX30009_process_obj.cancel_data_request();
+        }
+
+        if (MUX_request_ready_flag.load(std::memory_order_acquire)==false && MUX_TCP_server.take_client_disconnected()==true)
+        {
+            Device_mux_process_obj.cancel_pending_request();
+        }
+
+        if (QUERY_request_ready_flag.load(std::memory_order_acquire)==false && QUERY_TCP_server.take_client_disconnected()==true)
+        {
+            Session_query_process_obj.cancel_pending_request();
+        }
+
+        if (FEATURE_request_ready_flag.load(std::memory_order_acquire)==false && FEATURE_TCP_server.take_client_disconnected()==true)
+        {
+            ICG_feature_process_obj.cancel_pending_request();
+        }
+
+        if (HEMO_request_ready_flag.load(std::memory_order_acquire)==false && HEMO_TCP_server.take_client_disconnected()==true)
+        {
+            Hemodynamics_process_obj.cancel_pending_request();
+        }
+
+        //no waiting requests
+        if (WS2812_request_ready_flag.load(std::memory_order_acquire)==false)
+        {
+            WS2812_TCP_server.take_client_disconnected();
+        }
+
+        if (ALIGN_request_ready_flag.load(std::memory_order_acquire)==false)
+        {
+            ALIGN_TCP_server.take_client_disconnected();
+        }
+
 //delay(1);
         usleep(500);
 
@@ -5,6 +5,7 @@
 #include "GPIO_driver.h"
 #include "SPI_hard_driver.h"
 #include <chrono>
+#include <algorithm>
 #include <thread>
 
 using json = nlohmann::json;
@@ -40,16 +41,25 @@ void ADS1293_process::process(void)
         //  std::cout << "  ECG2:" << ECG_2;
         //  std::cout << "  ECG3:" << ECG_3 <<std::endl;
 
-        _IFIFO_write_pos=(_IFIFO_write_pos+1)%IFIFO_BUFF_SIZE;
-        if (_IFIFO_write_pos==_IFIFO_read_pos)
+        ADS1293_IFIFO_DATA_TDS item;
+        item.ch1=ECG_1;
+        item.ch2=ECG_2;
+        item.ch3=ECG_3;
+        _IFIFO.push(item);
+        int32_t values[CHANNELS_COUNT]= {item.ch1,item.ch2,item.ch3};
+        int32_t filtered[CHANNELS_COUNT];
+        _filter.process(values,filtered);
+        _filtered_IFIFO.push({filtered[0],filtered[1],filtered[2]});
+        _preview.push(values);
+        _taps.push(values);
+        _clock_model.add_block(_IFIFO.get_write_seq(),Sample_clock_model::get_monotonic_ns());
+        QRS_BEAT_TDS beat;
+        if (_QRS_detector.push(values,&beat)==true)
         {
-            _IFIFO_read_pos=(_IFIFO_read_pos+1)%IFIFO_BUFF_SIZE ;
+            beat.time_ns=_clock_model.get_time_ns(beat.seq);
+            _beats.push(beat);
         }
 
-        _IFIFO_BUF[_IFIFO_write_pos].ch1=ECG_1;
-        _IFIFO_BUF[_IFIFO_write_pos].ch2=ECG_2;
-        _IFIFO_BUF[_IFIFO_write_pos].ch3=ECG_3;
-
     }
     else
     {
@@ -59,15 +69,7 @@ void ADS1293_process::process(void)
 
 void ADS1293_process::add_sync_mark(int32_t sync_num)
 {
-        _IFIFO_write_pos=(_IFIFO_write_pos+1)%IFIFO_BUFF_SIZE;
-        if (_IFIFO_write_pos==_IFIFO_read_pos)
-        {
-            _IFIFO_read_pos=(_IFIFO_read_pos+1)%IFIFO_BUFF_SIZE ;
-        }
-
-    _IFIFO_BUF[_IFIFO_write_pos].ch1=SYNC_MARK_MAGIC_NUM;
-    _IFIFO_BUF[_IFIFO_write_pos].ch2=sync_num;
-    _IFIFO_BUF[_IFIFO_write_pos].ch3=0;
+    _sync_marks.add(_IFIFO.get_write_seq(),sync_num);
 }
 
 
@@ -75,64 +77,155 @@ std::string ADS1293_process::process_JSON_line(const char * JSON_line)
 {
     std::cout << "IN:" << JSON_line << std::endl << std::endl;
 
+    //new command cancels waiting data request, client waits response for new command
+    _is_data_request_pending=false;
+
+    ADS1293_USER_SETTINGS_TDE new_sett=ADS1293_user_sett;
+    std::string_view command_type;
+    std::string_view key;
+    DATA_REQUEST_TDS data_request= {false,0,0,0,0};
+    uint32_t preview_width=DEFAULT_PREVIEW_WIDTH;
+    uint32_t preview_duration_ms=DEFAULT_PREVIEW_DURATION_MS;
+    TAP_SETTINGS_TDS tap_settings= {"",TAP_RAW_SOURCE,TAP_FILTER_MEAN,0,0};
+    std::string_view tap_name;
+    std::string_view tap_source=TAP_RAW_SOURCE;
+    std::string_view tap_filter=TAP_FILTER_NAMES[TAP_FILTER_MEAN];
+    std::string_view output_name="raw";
+    BIQUAD_FILTER_SETTINGS_TDS filter_settings=_filter_settings;
+
+    JSON_command_parser parser(JSON_line);
+    if (parser.begin_object()==true)
+    {
+        while (parser.next_key(&key)==true)
+        {
+            if (key=="type") parser.read_string(&command_type);
+            else if (key=="enable_conversion") parser.read_bool(&new_sett.enable_conversion);
+            else if (key=="power_enable") parser.read_bool(&new_sett.power_enable);
+            else if (key=="R2_rate") parser.read_number(&new_sett.R2_rate);
+            else if (key=="R3_rate") parser.read_number(&new_sett.R3_rate);
+            else if (key=="from_seq")
+            {
+                parser.read_number(&data_request.from_seq);
+                data_request.use_cursor=true;
+            }
+            else if (key=="max_samples") parser.read_number(&data_request.max_samples);
+            else if (key=="min_samples") parser.read_number(&data_request.min_samples);
+            else if (key=="timeout_ms") parser.read_number(&data_request.timeout_ms);
+            else if (key=="width") parser.read_number(&preview_width);
+            else if (key=="duration_ms") parser.read_number(&preview_duration_ms);
+            else if (key=="tap") parser.read_string(&tap_name);
+            else if (key=="source") parser.read_string(&tap_source);
+            else if (key=="filter") parser.read_string(&tap_filter);
+            else if (key=="decimation") parser.read_number(&tap_settings.decimation);
+            else if (key=="rate") parser.read_number(&tap_settings.rate);
+            else if (key=="output") parser.read_string(&output_name);
+            else if (key=="notch_frequency") parser.read_number(&filter_settings.notch_frequency);
+            else if (key=="highpass_frequency") parser.read_number(&filter_settings.highpass_frequency);
+            else if (key=="lowpass_frequency") parser.read_number(&filter_settings.lowpass_frequency);
+            else parser.skip_value();
+        }
+    }
 
-    json parsed_json;
-    json response;
+    if (parser.is_finished()==false)
+    {
+        return "{\"type\":\"error JSON\"}";
+    }
 
-    try
+    if (command_type == "settings")
     {
-        parsed_json = json::parse(JSON_line);
+        ADS1293_user_sett=new_sett;
+        process_all_settings_for_ADS1293();
+        return get_all_settings_as_json();
+    }
 
-        if (parsed_json.contains("type"))
+    if (command_type == "get_data")
+    {
+        ADS1293_OUTPUT_TDE output=ADS1293_OUTPUT_RAW;
+        if (output_name=="filtered")
+        {
+            output=ADS1293_OUTPUT_FILTERED;
+        }
+        else if (output_name!="raw")
         {
+            return "{\"type\":\"error JSON\"}";
+        }
+        if (data_request.min_samples>0 && data_request.timeout_ms>0 && get_available_samples(data_request)<data_request.min_samples)
+        {
+            //response is sent later by process_pending_data_request()
+            _pending_data_request=data_request;
+            _pending_data_output=output;
+            _is_pending_beats=false;
+            _pending_data_deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(std::min(data_request.timeout_ms,DATA_REQUEST_MAX_TIMEOUT_MS));
+            _is_data_request_pending=true;
+            return "";
+        }
+        return get_data_as_json(data_request,output);
+    }
 
-            std::string command_type = parsed_json["type"];
+    if (command_type == "get_beats")
+    {
+        if (data_request.min_samples>0 && data_request.timeout_ms>0 && get_available_beats(data_request)<data_request.min_samples)
+        {
+            _pending_data_request=data_request;
+            _pending_data_deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(std::min(data_request.timeout_ms,DATA_REQUEST_MAX_TIMEOUT_MS));
+            _is_pending_beats=true;
+            _is_data_request_pending=true;
+            return "";
+        }
+        return get_beats_as_json(data_request);
+    }
 
-            if (command_type == "settings")
-            {
-                if (parsed_json.contains("enable_conversion"))
-                {
-                    ADS1293_user_sett.enable_conversion= parsed_json["enable_conversion"];
-                }
-                if (parsed_json.contains("power_enable"))
-                {
-                    ADS1293_user_sett.power_enable=parsed_json["power_enable"];
-                }
-
-                if (parsed_json.contains("R2_rate"))
-                {
-                    ADS1293_user_sett.R2_rate=parsed_json["R2_rate"];
-                }
-
-                if (parsed_json.contains("R3_rate"))
-                {
-                    ADS1293_user_sett.R3_rate=parsed_json["R3_rate"];
-                }
-
-                process_all_settings_for_ADS1293();
-                return get_all_settings_as_json();
-            }
+    if (command_type == "set_filter")
+    {
+        //requested frequencies are kept, stage which is off at this data rate is on after rate is changed
+        _filter_settings=filter_settings;
+        _filter.reset(_filter_settings,_clock_model.get_nominal_rate());
+        command_type="get_filter";
+    }
 
-            if (command_type == "get_data")
-            {
+    if (command_type == "get_filter")
+    {
+        return get_filter_as_json();
+    }
 
-                return get_data_as_json();
-            }
-        }
-        else
+    if (command_type == "get_preview")
+    {
+        return get_preview_as_json(preview_width,preview_duration_ms);
+    }
+
+    if (command_type == "add_tap")
+    {
+        tap_settings.name=tap_name;
+        tap_settings.source=tap_source;
+        if (get_tap_filter(tap_filter,&tap_settings.filter)==false || _taps.add(tap_settings,_IFIFO.get_write_seq())==false)
         {
-            response["type"] = "error JSON";
+            return "{\"type\":\"error tap\"}";
         }
+        command_type="get_taps";
+    }
 
+    if (command_type == "remove_tap")
+    {
+        if (_taps.remove(tap_name)==false)
+        {
+            return "{\"type\":\"error tap\"}";
+        }
+        command_type="get_taps";
     }
-    catch (const std::exception& e)
+
+    if (command_type == "get_taps")
     {
+        _json_writer.clear();
+        _taps.write_taps_json(&_json_writer);
+        return _json_writer.get_string();
+    }
 
+    if (command_type == "get_tap_data")
+    {
+        return get_tap_data_as_json(tap_name,data_request);
     }
 
-    response["type"] = "error JSON";
-    std::string response_string = response.dump();
-    return response_string;
+    return "{\"type\":\"error JSON\"}";
 }
 
 std::string ADS1293_process::get_all_settings_as_json(void)
@@ -209,6 +302,18 @@ void ADS1293_process::process_all_settings_for_ADS1293(void)
     }
 
 
+    //keep IFIFO_BUFFER_DURATION seconds of data
+    uint32_t data_rate=SDM_FREQUENCY/(R1_RATE*ADS1293_user_sett.R2_rate*ADS1293_user_sett.R3_rate);
+    _IFIFO.resize(data_rate*IFIFO_BUFFER_DURATION);
+    _filtered_IFIFO.resize(data_rate*IFIFO_BUFFER_DURATION);
+    _preview.reset((uint64_t)data_rate*PREVIEW_DURATION,MAX_PREVIEW_WIDTH,_IFIFO.get_write_seq());
+    _sync_marks.clear();
+    _clock_model.reset((double)SDM_FREQUENCY/(R1_RATE*ADS1293_user_sett.R2_rate*ADS1293_user_sett.R3_rate));
+    _taps.reset(_clock_model.get_nominal_rate(),_IFIFO.get_write_seq());
+    _filter.reset(_filter_settings,_clock_model.get_nominal_rate());
+    _QRS_detector.reset(_clock_model.get_nominal_rate(),_IFIFO.get_write_seq());
+    _settings_version++;
+
     ADS1293_obj.set_R2_decimation_rate(R2_rate_sel);
 
     ADS1293_obj.set_R3_decimation_rate_for_CH_1(R3_rate_sel);
@@ -227,64 +332,369 @@ void ADS1293_process::process_all_settings_for_ADS1293(void)
     //ADS1293_obj.load_all_registers();
 
 }
-std::string ADS1293_process::get_data_as_json(void)
+
+uint32_t ADS1293_process::get_available_samples(const DATA_REQUEST_TDS& request)
 {
-    nlohmann::json response_json;
-    response_json["type"] = "data";
-    int32_t buffer_size = (_IFIFO_write_pos- _IFIFO_read_pos + IFIFO_BUFF_SIZE) % IFIFO_BUFF_SIZE;
-    response_json["data_size"] =buffer_size;
-    response_json["timestamp"] =get_timestamp_string();
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = _IFIFO.get_first_seq();
+    }
+    uint64_t write_seq = _IFIFO.get_write_seq();
+    return write_seq-std::clamp(from_seq,_IFIFO.get_oldest_seq(),write_seq);
+}
 
-    nlohmann::json data_array = nlohmann::json::array();
+std::string ADS1293_process::process_pending_data_request(void)
+{
+    if (_is_data_request_pending==false)
+    {
+        return "";
+    }
+    uint32_t available=_is_pending_beats==true ? get_available_beats(_pending_data_request) : get_available_samples(_pending_data_request);
+    if (available<_pending_data_request.min_samples && std::chrono::steady_clock::now()<_pending_data_deadline)
+    {
+        return "";
+    }
+    _is_data_request_pending=false;
+    if (_is_pending_beats==true)
+    {
+        return get_beats_as_json(_pending_data_request);
+    }
+    return get_data_as_json(_pending_data_request,_pending_data_output);
+}
 
-    for (uint32_t i = 0; i < buffer_size; ++i)
+uint32_t ADS1293_process::get_available_beats(const DATA_REQUEST_TDS& request)
+{
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
     {
-        _IFIFO_read_pos=(_IFIFO_read_pos+1)%IFIFO_BUFF_SIZE;
-        nlohmann::json point_array = nlohmann::json::array();
-        point_array.push_back(_IFIFO_BUF[_IFIFO_read_pos].ch1);
-        point_array.push_back(_IFIFO_BUF[_IFIFO_read_pos].ch2);
-        point_array.push_back(_IFIFO_BUF[_IFIFO_read_pos].ch3);
-        data_array.push_back(point_array);
+        from_seq = _beats.get_first_seq();
     }
+    uint64_t write_seq = _beats.get_write_seq();
+    return write_seq-std::clamp(from_seq,_beats.get_oldest_seq(),write_seq);
+}
 
-    response_json["data"] = data_array;
-    return response_json.dump();
+bool ADS1293_process::is_data_request_pending(void)
+{
+    return _is_data_request_pending;
 }
 
+void ADS1293_process::cancel_data_request(void)
+{
+    _is_data_request_pending=false;
+}
 
-void ADS1293_process::set_power_state(bool state)
+Sample_clock_model& ADS1293_process::get_clock_model(void)
 {
-    if (_old_power_state==state) return;
-    _old_power_state=state;
-    if (state==true)
+    return _clock_model;
+}
+
+uint64_t ADS1293_process::get_oldest_seq(void)
+{
+    return _IFIFO.get_oldest_seq();
+}
+
+uint64_t ADS1293_process::get_write_seq(void)
+{
+    return _IFIFO.get_write_seq();
+}
+
+bool ADS1293_process::read_sample(uint64_t seq, ADS1293_IFIFO_DATA_TDS *item)
+{
+    return _IFIFO.read(seq,item);
+}
+
+Sample_ring<QRS_BEAT_TDS>& ADS1293_process::get_beats(void)
+{
+    return _beats;
+}
+
+Sync_mark_index& ADS1293_process::get_sync_marks(void)
+{
+    return _sync_marks;
+}
+
+uint32_t ADS1293_process::get_settings_version(void)
+{
+    return _settings_version;
+}
+
+std::string ADS1293_process::get_data_as_json(const DATA_REQUEST_TDS& request, ADS1293_OUTPUT_TDE output)
+{
+    //reader with cursor does not change ring, default reader continues from last read
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
     {
-        GPIO_ADS1293_POWER.set_GPIO_state(VT_GPIO_SET);
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        from_seq = _IFIFO.skip_overwritten();
+    }
+    uint64_t write_seq = _IFIFO.get_write_seq();
+    uint64_t first_seq = std::clamp(from_seq,_IFIFO.get_oldest_seq(),write_seq);
+    uint64_t end_seq = write_seq;
+    if (request.max_samples!=0 && end_seq-first_seq>request.max_samples)
+    {
+        end_seq = first_seq+request.max_samples;
+    }
+
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","data");
+    _json_writer.key_value("output",output==ADS1293_OUTPUT_FILTERED ? "filtered" : "raw");
+    int64_t realtime_ns=Timestamp_formatter::get_realtime_ns();
+    _json_writer.key_value("timestamp",_timestamp_formatter.format(realtime_ns));
+    _json_writer.key_value("timestamp_ns",realtime_ns);
+    _json_writer.key_value("monotonic_ns",Sample_clock_model::get_monotonic_ns());
+    if (request.use_cursor==true)
+    {
+        _json_writer.key_value("skipped_samples",first_seq>from_seq ? first_seq-from_seq : (uint64_t)0);
     }
     else
     {
-        GPIO_ADS1293_POWER.set_GPIO_state(VT_GPIO_UNSET);
+        _json_writer.key_value("lost_samples",_IFIFO.get_overflow_count());
     }
-}
 
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    //default reader of raw ring is used for both outputs
+    Sample_ring<ADS1293_IFIFO_DATA_TDS>& ring = output==ADS1293_OUTPUT_FILTERED ? _filtered_IFIFO : _IFIFO;
+    uint64_t next_seq = first_seq;
+    ADS1293_IFIFO_DATA_TDS item;
+    while (next_seq<end_seq && ring.read(next_seq,&item)==true)
+    {
+        _json_writer.begin_array();
+        _json_writer.value(item.ch1);
+        _json_writer.value(item.ch2);
+        _json_writer.value(item.ch3);
+        _json_writer.end_array();
+        next_seq++;
+    }
+    _json_writer.end_array();
+    _json_writer.key_value("data_size",next_seq-first_seq);
+    _json_writer.key_value("first_seq",first_seq);
+    _json_writer.key_value("next_seq",next_seq);
+    //acquisition time of data[0] (CLOCK_MONOTONIC), sample k is at first_sample_time_ns+k*1e9/sample_rate
+    _json_writer.key_value("first_sample_time_ns",_clock_model.get_time_ns(first_seq));
+    _json_writer.key_value("sample_rate",_clock_model.get_rate());
+
+    if (request.use_cursor==false)
+    {
+        _IFIFO.set_read_seq(next_seq);
+    }
 
-std::string ADS1293_process::get_timestamp_string()
+    //mark position is index of first sample after mark in data array
+    _json_writer.key("sync_marks");
+    _json_writer.begin_array();
+    for (uint32_t i = _sync_marks.find(first_seq); i < _sync_marks.get_size(); ++i)
+    {
+        const SYNC_MARK_TDS& mark = _sync_marks.get_mark(i);
+        if (mark.sample_count>=next_seq)
+        {
+            break;
+        }
+        _json_writer.begin_object();
+        _json_writer.key_value("position",mark.sample_count-first_seq);
+        _json_writer.key_value("sync_num",mark.sync_num);
+        _json_writer.key_value("time_ms",mark.time_ms);
+        _json_writer.end_object();
+    }
+    _json_writer.end_array();
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
+
+std::string ADS1293_process::get_beats_as_json(const DATA_REQUEST_TDS& request)
 {
-    auto now = std::chrono::system_clock::now();
-    std::time_t now_c = std::chrono::system_clock::to_time_t(now);
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = _beats.skip_overwritten();
+    }
+    uint64_t write_seq = _beats.get_write_seq();
+    uint64_t first_seq = std::clamp(from_seq,_beats.get_oldest_seq(),write_seq);
+    uint64_t end_seq = write_seq;
+    if (request.max_samples!=0 && end_seq-first_seq>request.max_samples)
+    {
+        end_seq = first_seq+request.max_samples;
+    }
 
-    std::tm ptm;
-    gmtime_r(&now_c, &ptm);
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","beats");
+    //detector is off below 100 Hz data rate
+    _json_writer.key_value("enabled",_QRS_detector.is_enabled());
+    if (request.use_cursor==true)
+    {
+        _json_writer.key_value("skipped_beats",first_seq>from_seq ? first_seq-from_seq : (uint64_t)0);
+    }
+    else
+    {
+        _json_writer.key_value("lost_beats",_beats.get_overflow_count());
+    }
 
-    std::stringstream ss;
+    //beat is [sample_seq,time_ns,RR_ms,heart_rate,confidence], RR_ms is 0 for first beat after settings
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    uint64_t next_seq = first_seq;
+    QRS_BEAT_TDS beat;
+    while (next_seq<end_seq && _beats.read(next_seq,&beat)==true)
+    {
+        _json_writer.begin_array();
+        _json_writer.value(beat.seq);
+        _json_writer.value(beat.time_ns);
+        _json_writer.value(beat.RR_interval*1000.0);
+        _json_writer.value(beat.heart_rate);
+        _json_writer.value(beat.confidence);
+        _json_writer.end_array();
+        next_seq++;
+    }
+    _json_writer.end_array();
+    _json_writer.key_value("data_size",next_seq-first_seq);
+    _json_writer.key_value("first_seq",first_seq);
+    _json_writer.key_value("next_seq",next_seq);
+    _json_writer.key_value("sample_rate",_clock_model.get_rate());
+    _json_writer.end_object();
+
+    if (request.use_cursor==false)
+    {
+        _beats.set_read_seq(next_seq);
+    }
+    return _json_writer.get_string();
+}
 
-    ss << std::put_time(&ptm, "%Y-%m-%d %H:%M:%S");
+std::string ADS1293_process::get_filter_as_json(void)
+{
+    const BIQUAD_FILTER_SETTINGS_TDS& actual=_filter.get_settings();
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","filter");
+    //0 - stage is off (not requested or not below 0.45 of sample rate)
+    _json_writer.key_value("notch_frequency",actual.notch_frequency);
+    _json_writer.key_value("highpass_frequency",actual.highpass_frequency);
+    _json_writer.key_value("lowpass_frequency",actual.lowpass_frequency);
+    _json_writer.key_value("sections",_filter.get_sections_count());
+    _json_writer.key_value("sample_rate",_filter.get_sample_rate());
+    _json_writer.key("requested");
+    _json_writer.begin_object();
+    _json_writer.key_value("notch_frequency",_filter_settings.notch_frequency);
+    _json_writer.key_value("highpass_frequency",_filter_settings.highpass_frequency);
+    _json_writer.key_value("lowpass_frequency",_filter_settings.lowpass_frequency);
+    _json_writer.end_object();
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
+
+std::string ADS1293_process::get_preview_as_json(uint32_t width, uint32_t duration_ms)
+{
+    //window is limited by pyramid duration, not by ring
+    uint64_t window_samples=_clock_model.get_nominal_rate()*std::min(duration_ms,PREVIEW_DURATION*1000)/1000.0;
+    ENVELOPE_PREVIEW_TDS preview;
+    _preview.get_preview(width,window_samples,&preview);
+
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","preview");
+    _json_writer.key_value("width",preview.width);
+    _json_writer.key_value("samples_per_pixel",preview.samples_per_pixel);
+    _json_writer.key_value("level_ratio",preview.level_ratio);
+    _json_writer.key_value("first_seq",preview.first_seq);
+    _json_writer.key_value("next_seq",preview.next_seq);
+    _json_writer.key_value("first_sample_time_ns",_clock_model.get_time_ns(preview.first_seq));
+    _json_writer.key_value("sample_rate",_clock_model.get_rate());
+    //pixel is [min,max,mean] of ch1, then ch2 and ch3
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    for (uint32_t i=0; i<preview.width; i++)
+    {
+        const ENVELOPE_TDS *pixel=&preview.pixels[i*CHANNELS_COUNT];
+        _json_writer.begin_array();
+        for (uint32_t j=0; j<CHANNELS_COUNT; j++)
+        {
+            _json_writer.value(pixel[j].min);
+            _json_writer.value(pixel[j].max);
+            _json_writer.value(pixel[j].mean);
+        }
+        _json_writer.end_array();
+    }
+    _json_writer.end_array();
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
+std::string ADS1293_process::get_tap_data_as_json(std::string_view tap_name, const DATA_REQUEST_TDS& request)
+{
+    Stream_tap<CHANNELS_COUNT> *tap=_taps.find(tap_name);
+    if (tap==nullptr)
+    {
+        return "{\"type\":\"error tap\"}";
+    }
 
+    //tap ring is read as device ring: with cursor or by default reader of tap
+    Sample_ring<Stream_tap<CHANNELS_COUNT>::TAP_SAMPLE_TDS>& ring=tap->get_ring();
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = ring.skip_overwritten();
+    }
+    uint64_t write_seq = ring.get_write_seq();
+    uint64_t first_seq = std::clamp(from_seq,ring.get_oldest_seq(),write_seq);
+    uint64_t end_seq = write_seq;
+    if (request.max_samples!=0 && end_seq-first_seq>request.max_samples)
+    {
+        end_seq = first_seq+request.max_samples;
+    }
 
-    auto duration = now.time_since_epoch();
-    auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(duration) % 1000;
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","tap_data");
+    _json_writer.key_value("tap",tap->get_settings().name);
+    if (request.use_cursor==true)
+    {
+        _json_writer.key_value("skipped_samples",first_seq>from_seq ? first_seq-from_seq : (uint64_t)0);
+    }
+    else
+    {
+        _json_writer.key_value("lost_samples",ring.get_overflow_count());
+    }
 
-    ss << "." << std::setfill('0') << std::setw(3) << milliseconds.count();
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    uint64_t next_seq = first_seq;
+    Stream_tap<CHANNELS_COUNT>::TAP_SAMPLE_TDS item;
+    while (next_seq<end_seq && ring.read(next_seq,&item)==true)
+    {
+        _json_writer.begin_array();
+        for (int32_t value : item)
+        {
+            _json_writer.value(value);
+        }
+        _json_writer.end_array();
+        next_seq++;
+    }
+    _json_writer.end_array();
+    _json_writer.key_value("data_size",next_seq-first_seq);
+    _json_writer.key_value("first_seq",first_seq);
+    _json_writer.key_value("next_seq",next_seq);
+    //time of data[0] is middle of its filter
+    _json_writer.key_value("first_sample_time_ns",_clock_model.get_time_ns(tap->get_raw_position(first_seq)));
+    _json_writer.key_value("sample_rate",_clock_model.get_rate()/tap->get_raw_step());
+    _json_writer.end_object();
+
+    if (request.use_cursor==false)
+    {
+        ring.set_read_seq(next_seq);
+    }
+    return _json_writer.get_string();
+}
 
-    return ss.str();
+void ADS1293_process::set_power_state(bool state)
+{
+    if (_old_power_state==state) return;
+    _old_power_state=state;
+    if (state==true)
+    {
+        GPIO_ADS1293_POWER.set_GPIO_state(VT_GPIO_SET);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    else
+    {
+        GPIO_ADS1293_POWER.set_GPIO_state(VT_GPIO_UNSET);
+    }
 }
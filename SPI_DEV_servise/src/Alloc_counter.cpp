@@ -0,0 +1,30 @@
+#include "Alloc_counter.h"
+
+#ifdef ALLOC_COUNTER
+#include <cstdlib>
+#include <new>
+
+static thread_local uint64_t thread_alloc_count=0;
+
+uint64_t get_thread_alloc_count(void)
+{
+    return thread_alloc_count;
+}
+
+//array, nothrow and sized forms of library call these two
+void* operator new(std::size_t size)
+{
+    thread_alloc_count++;
+    void *ptr=std::malloc(size==0 ? 1 : size);
+    if (ptr==nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+#endif
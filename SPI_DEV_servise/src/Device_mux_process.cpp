@@ -0,0 +1,312 @@
+#include "Device_mux_process.h"
+#include <algorithm>
+
+Device_mux_process::Device_mux_process(ADS1293_process *ADS1293_process_ptr, MAX30009_process *MAX30009_process_ptr,
+                                       WS2812_process *WS2812_process_ptr, ECG_ICG_align_process *align_process_ptr,
+                                       Session_recorder *session_recorder_ptr)
+    : _ADS1293_process(ADS1293_process_ptr),
+      _MAX30009_process(MAX30009_process_ptr),
+      _WS2812_process(WS2812_process_ptr),
+      _align_process(align_process_ptr),
+      _session_recorder(session_recorder_ptr)
+{
+    _slots.reserve(MAX_BATCH_REQUESTS);
+}
+
+std::string Device_mux_process::process_JSON_line(const char * JSON_line)
+{
+    //new command cancels waiting batch, client waits response for new command
+    cancel_pending_request();
+    _is_batch=false;
+    _slots.clear();
+
+    std::string_view command_type;
+    std::string_view device_name;
+    std::string_view key;
+    std::vector<std::string_view> requests;
+
+    JSON_command_parser parser(JSON_line);
+    if (parser.begin_object()==true)
+    {
+        while (parser.next_key(&key)==true)
+        {
+            if (key=="type") parser.read_string(&command_type);
+            else if (key=="device") parser.read_string(&device_name);
+            else if (key=="requests" && parser.begin_array()==true)
+            {
+                std::string_view request;
+                while (parser.next_array_item()==true && parser.read_raw_value(&request)==true)
+                {
+                    requests.push_back(request);
+                }
+            }
+            else parser.skip_value();
+        }
+    }
+
+    if (parser.is_finished()==false)
+    {
+        return "{\"type\":\"error JSON\"}";
+    }
+
+    if (command_type=="batch")
+    {
+        if (requests.size()==0 || requests.size()>MAX_BATCH_REQUESTS)
+        {
+            return "{\"type\":\"error JSON\"}";
+        }
+        //all commands are checked before any is executed. Device with waiting get_data has one pending request,
+        //its next command of batch would cancel it - only one command per such device
+        std::vector<MUX_DEVICE_TDE> devices;
+        for (uint32_t i=0; i<requests.size(); i++)
+        {
+            MUX_DEVICE_TDE device;
+            if (read_device(requests[i].data(),&device)==false)
+            {
+                return "{\"type\":\"error device\"}";
+            }
+            if (is_long_poll_device(device)==true && std::find(devices.begin(),devices.end(),device)!=devices.end())
+            {
+                return "{\"type\":\"error device\"}";
+            }
+            devices.push_back(device);
+        }
+        _is_batch=true;
+        for (uint32_t i=0; i<requests.size(); i++)
+        {
+            _command_text.assign(requests[i]);
+            MUX_SLOT_TDS slot;
+            slot.device=devices[i];
+            slot.response=send_to_device(devices[i],_command_text.c_str());
+            slot.is_pending=slot.response.empty();
+            _slots.push_back(slot);
+        }
+    }
+    else
+    {
+        MUX_DEVICE_TDE device;
+        if (find_device(device_name,&device)==false)
+        {
+            return "{\"type\":\"error device\"}";
+        }
+        MUX_SLOT_TDS slot;
+        slot.device=device;
+        slot.response=send_to_device(device,JSON_line);
+        slot.is_pending=slot.response.empty();
+        _slots.push_back(slot);
+    }
+
+    for (uint32_t i=0; i<_slots.size(); i++)
+    {
+        if (_slots[i].is_pending==true)
+        {
+            //response is sent later by process_pending_request()
+            _is_pending=true;
+            _pending_deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(DATA_REQUEST_MAX_TIMEOUT_MS+PENDING_MARGIN_MS);
+            return "";
+        }
+    }
+    return get_response_as_json();
+}
+
+std::string Device_mux_process::process_pending_request(void)
+{
+    if (_is_pending==false)
+    {
+        return "";
+    }
+    bool is_ready=true;
+    for (uint32_t i=0; i<_slots.size(); i++)
+    {
+        if (_slots[i].is_pending==true)
+        {
+            _slots[i].response=get_pending_response(_slots[i].device);
+            _slots[i].is_pending=_slots[i].response.empty();
+            is_ready=is_ready && _slots[i].is_pending==false;
+        }
+    }
+    if (is_ready==false && std::chrono::steady_clock::now()<_pending_deadline)
+    {
+        return "";
+    }
+    _is_pending=false;
+    return get_response_as_json();
+}
+
+bool Device_mux_process::is_device_pending(MUX_DEVICE_TDE device)
+{
+    if (_is_pending==false)
+    {
+        return false;
+    }
+    for (uint32_t i=0; i<_slots.size(); i++)
+    {
+        if (_slots[i].device==device && _slots[i].is_pending==true)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Device_mux_process::cancel_pending_request(void)
+{
+    for (uint32_t i=0; i<_slots.size(); i++)
+    {
+        if (is_device_pending(_slots[i].device)==true)
+        {
+            cancel_device_request(_slots[i].device);
+        }
+    }
+    _is_pending=false;
+}
+
+bool Device_mux_process::is_long_poll_device(MUX_DEVICE_TDE device)
+{
+    return device==MUX_DEVICE_ADS1293 || device==MUX_DEVICE_MAX30009;
+}
+
+bool Device_mux_process::find_device(std::string_view name, MUX_DEVICE_TDE *device)
+{
+    for (uint32_t i=0; i<MUX_DEVICE_COUNT; i++)
+    {
+        if (name==DEVICE_NAMES[i])
+        {
+            *device=(MUX_DEVICE_TDE)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Device_mux_process::read_device(const char *command, MUX_DEVICE_TDE *device)
+{
+    std::string_view key;
+    std::string_view device_name;
+    JSON_command_parser parser(command);
+    if (parser.begin_object()==true)
+    {
+        while (parser.next_key(&key)==true)
+        {
+            if (key=="device") parser.read_string(&device_name);
+            else parser.skip_value();
+        }
+    }
+    if (parser.is_error()==true)
+    {
+        return false;
+    }
+    return find_device(device_name,device);
+}
+
+bool Device_mux_process::read_command_type(const char *command, std::string_view *command_type)
+{
+    std::string_view key;
+    JSON_command_parser parser(command);
+    if (parser.begin_object()==true)
+    {
+        while (parser.next_key(&key)==true)
+        {
+            if (key=="type") parser.read_string(command_type);
+            else parser.skip_value();
+        }
+    }
+    return parser.is_error()==false;
+}
+
+//"device" key is unknown for device processes, they skip it
+std::string Device_mux_process::send_to_device(MUX_DEVICE_TDE device, const char *command)
+{
+    switch (device)
+    {
+    case MUX_DEVICE_ADS1293:
+        return _ADS1293_process->process_JSON_line(command);
+    case MUX_DEVICE_MAX30009:
+    {
+        //binary part of raw data is sent only by device port. Command is not run,
+        //it would move default reader of raw samples and cancel waiting get_data
+        std::string_view command_type;
+        if (read_command_type(command,&command_type)==true && command_type=="get_raw_data")
+        {
+            return "{\"type\":\"error device\"}";
+        }
+        return _MAX30009_process->process_JSON_line(command);
+    }
+    case MUX_DEVICE_WS2812:
+        return _WS2812_process->process_JSON_line(command);
+    case MUX_DEVICE_ALIGN:
+        return _align_process->process_JSON_line(command);
+    case MUX_DEVICE_RECORDER:
+        return _session_recorder->process_JSON_line(command);
+    default:
+        return "{\"type\":\"error device\"}";
+    }
+}
+
+std::string Device_mux_process::get_pending_response(MUX_DEVICE_TDE device)
+{
+    std::string response;
+    if (device==MUX_DEVICE_ADS1293)
+    {
+        if (_ADS1293_process->is_data_request_pending()==false)
+        {
+            //request is canceled by command from device port
+            return "{\"type\":\"canceled\"}";
+        }
+        response=_ADS1293_process->process_pending_data_request();
+    }
+    if (device==MUX_DEVICE_MAX30009)
+    {
+        if (_MAX30009_process->is_data_request_pending()==false)
+        {
+            return "{\"type\":\"canceled\"}";
+        }
+        response=_MAX30009_process->process_pending_data_request();
+    }
+    return response;
+}
+
+void Device_mux_process::cancel_device_request(MUX_DEVICE_TDE device)
+{
+    if (device==MUX_DEVICE_ADS1293)
+    {
+        _ADS1293_process->cancel_data_request();
+    }
+    if (device==MUX_DEVICE_MAX30009)
+    {
+        _MAX30009_process->cancel_data_request();
+    }
+}
+
+std::string Device_mux_process::get_response_as_json(void)
+{
+    _json_writer.clear();
+    if (_is_batch==true)
+    {
+        _json_writer.begin_object();
+        _json_writer.key_value("type","batch");
+        _json_writer.key("responses");
+        _json_writer.begin_array();
+    }
+    for (uint32_t i=0; i<_slots.size(); i++)
+    {
+        _json_writer.begin_object();
+        _json_writer.key_value("device",DEVICE_NAMES[_slots[i].device]);
+        _json_writer.key("response");
+        if (_slots[i].is_pending==true)
+        {
+            _json_writer.raw_value("{\"type\":\"timeout\"}");
+        }
+        else
+        {
+            _json_writer.raw_value(_slots[i].response);
+        }
+        _json_writer.end_object();
+    }
+    if (_is_batch==true)
+    {
+        _json_writer.end_array();
+        _json_writer.end_object();
+    }
+    return _json_writer.get_string();
+}
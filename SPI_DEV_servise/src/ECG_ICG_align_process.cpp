@@ -0,0 +1,249 @@
+#include "ECG_ICG_align_process.h"
+#include <cmath>
+#include <algorithm>
+
+ECG_ICG_align_process::ECG_ICG_align_process(ADS1293_process *ADS1293_process_ptr, MAX30009_process *MAX30009_process_ptr)
+    : _ADS1293_process(ADS1293_process_ptr),
+      _MAX30009_process(MAX30009_process_ptr)
+{
+    _ECG_input.reserve(MAX_ALIGNED_SAMPLES*ECG_CHANNELS);
+    _ICG_input.reserve(MAX_ALIGNED_SAMPLES*ICG_CHANNELS);
+    _ICG_overload.reserve(MAX_ALIGNED_SAMPLES);
+}
+
+std::string ECG_ICG_align_process::process_JSON_line(const char * JSON_line)
+{
+    std::string_view command_type;
+    std::string_view key;
+    ALIGN_REQUEST_TDS request= {false,0,0,0};
+
+    JSON_command_parser parser(JSON_line);
+    if (parser.begin_object()==true)
+    {
+        while (parser.next_key(&key)==true)
+        {
+            if (key=="type") parser.read_string(&command_type);
+            else if (key=="from_time_ns")
+            {
+                parser.read_number(&request.from_time_ns);
+                request.use_cursor=true;
+            }
+            else if (key=="max_samples") parser.read_number(&request.max_samples);
+            else if (key=="sample_rate") parser.read_number(&request.sample_rate);
+            else parser.skip_value();
+        }
+    }
+
+    if (parser.is_finished()==false)
+    {
+        return "{\"type\":\"error JSON\"}";
+    }
+
+    if (command_type == "get_aligned_data")
+    {
+        return get_aligned_data_as_json(request);
+    }
+
+    return "{\"type\":\"error JSON\"}";
+}
+
+void ECG_ICG_align_process::update_resampler(Polyphase_resampler *resampler, double *cutoff, double input_rate, double output_rate)
+{
+    //anti aliasing is needed only when output rate is less than input rate
+    double new_cutoff=1.0;
+    if (output_rate<input_rate)
+    {
+        new_cutoff=output_rate/input_rate*CUTOFF_MARGIN;
+    }
+    if (std::fabs(new_cutoff-*cutoff)>0.01)
+    {
+        resampler->design(new_cutoff);
+        *cutoff=new_cutoff;
+    }
+}
+
+void ECG_ICG_align_process::write_empty_frame(const ALIGN_REQUEST_TDS& request, double sample_rate)
+{
+    int64_t time_ns=request.use_cursor==true ? request.from_time_ns : _next_time_ns;
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","aligned_data");
+    int64_t realtime_ns=Timestamp_formatter::get_realtime_ns();
+    _json_writer.key_value("timestamp",_timestamp_formatter.format(realtime_ns));
+    _json_writer.key_value("timestamp_ns",realtime_ns);
+    _json_writer.key_value("sample_rate",sample_rate);
+    _json_writer.key_value("data_size",0);
+    _json_writer.key_value("first_time_ns",time_ns);
+    _json_writer.key_value("next_time_ns",time_ns);
+    if (request.use_cursor==true)
+    {
+        _json_writer.key_value("skipped_samples",0);
+    }
+    else
+    {
+        _json_writer.key_value("lost_samples",_lost_samples);
+    }
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    _json_writer.end_array();
+    _json_writer.end_object();
+}
+
+std::string ECG_ICG_align_process::get_aligned_data_as_json(const ALIGN_REQUEST_TDS& request)
+{
+    Sample_clock_model& ECG_clock=_ADS1293_process->get_clock_model();
+    Sample_clock_model& ICG_clock=_MAX30009_process->get_clock_model();
+
+    double sample_rate=request.sample_rate>0 ? request.sample_rate : ECG_clock.get_nominal_rate();
+    sample_rate=std::min(sample_rate,MAX_SAMPLE_RATE);
+    double decimation_ratio=_MAX30009_process->get_decimation_ratio();
+
+    if (ECG_clock.is_valid()==false || ICG_clock.is_valid()==false || decimation_ratio<1 || sample_rate<=0 ||
+        _MAX30009_process->is_measure_running()==false)
+    {
+        write_empty_frame(request,sample_rate);
+        return _json_writer.get_string();
+    }
+
+    double period_ns=1e9/sample_rate;
+    double ECG_rate=ECG_clock.get_rate();
+    double ICG_rate=ICG_clock.get_rate()/decimation_ratio;
+
+    //filter length depends on cutoff, halo of inputs is known after design
+    update_resampler(&_ECG_resampler,&_ECG_cutoff,ECG_rate,sample_rate);
+    update_resampler(&_ICG_resampler,&_ICG_cutoff,ICG_rate,sample_rate);
+    uint32_t ECG_half_taps=_ECG_resampler.get_half_taps();
+    uint32_t ICG_half_taps=_ICG_resampler.get_half_taps();
+
+    //time range where both inputs have full filter length around grid point, ICG halo is in ADC samples
+    uint64_t ECG_oldest=_ADS1293_process->get_oldest_seq();
+    uint64_t ECG_write=_ADS1293_process->get_write_seq();
+    uint64_t ICG_oldest=_MAX30009_process->get_oldest_seq();
+    uint64_t ICG_write=_MAX30009_process->get_write_seq();
+    double ICG_halo=(ICG_half_taps+1)*decimation_ratio;
+    if (ECG_write-ECG_oldest<=2*(ECG_half_taps+2) || (double)(ICG_write-ICG_oldest)<=2*ICG_halo)
+    {
+        write_empty_frame(request,sample_rate);
+        return _json_writer.get_string();
+    }
+    int64_t start_ns=std::max(ECG_clock.get_time_ns((double)ECG_oldest+ECG_half_taps+1),ICG_clock.get_time_ns((double)ICG_oldest+ICG_halo));
+    int64_t end_ns=std::min(ECG_clock.get_time_ns((double)ECG_write-ECG_half_taps-2),ICG_clock.get_time_ns((double)ICG_write-ICG_halo));
+
+    //grid point which is not in buffers any more is skipped, grid keeps its phase
+    int64_t first_ns=request.use_cursor==true ? request.from_time_ns : _next_time_ns;
+    if (request.use_cursor==false && _next_time_ns==0)
+    {
+        first_ns=start_ns;
+    }
+    uint64_t skipped_samples=0;
+    if (first_ns<start_ns)
+    {
+        skipped_samples=(uint64_t)std::ceil((double)(start_ns-first_ns)/period_ns);
+        first_ns=first_ns+std::llround(skipped_samples*period_ns);
+    }
+    uint32_t count=0;
+    if (end_ns>=first_ns)
+    {
+        count=(uint32_t)std::min((double)(end_ns-first_ns)/period_ns+1,(double)MAX_ALIGNED_SAMPLES);
+    }
+    if (request.max_samples!=0 && count>request.max_samples)
+    {
+        count=request.max_samples;
+    }
+    int64_t last_ns=first_ns+std::llround((count>0 ? count-1 : 0)*period_ns);
+
+    //ECG input: samples around grid points
+    uint64_t ECG_first=(uint64_t)std::floor(ECG_clock.get_seq(first_ns))-ECG_half_taps;
+    uint64_t ECG_end=std::min(ECG_write,(uint64_t)std::ceil(ECG_clock.get_seq(last_ns))+ECG_half_taps+1);
+    _ECG_input.clear();
+    ADS1293_IFIFO_DATA_TDS ECG_item;
+    for (uint64_t seq=ECG_first; count>0 && seq<ECG_end && _ADS1293_process->read_sample(seq,&ECG_item)==true; seq++)
+    {
+        _ECG_input.push_back(ECG_item.ch1);
+        _ECG_input.push_back(ECG_item.ch2);
+        _ECG_input.push_back(ECG_item.ch3);
+    }
+    uint32_t ECG_count=_ECG_input.size()/ECG_CHANNELS;
+
+    //ICG input: decimated points, point k is middle of its ADC samples
+    uint64_t ICG_first=std::max(ICG_oldest,(uint64_t)std::floor(ICG_clock.get_seq(first_ns)-ICG_halo));
+    uint32_t ICG_points=(uint32_t)std::ceil((ICG_clock.get_seq(last_ns)-(double)ICG_first)/decimation_ratio)+ICG_half_taps+2;
+    uint64_t ICG_next=ICG_first;
+    _ICG_input.clear();
+    _ICG_overload.clear();
+    if (count>0)
+    {
+        std::vector<MAX30009_FIFO_DATA_CALIB_TYPE>& ICG_data=_ICG_data;
+        _MAX30009_process->get_decimate_IFIFO_data(ICG_first,ICG_points,&ICG_next,&ICG_data);
+        for (uint32_t i=0; i<ICG_data.size(); i++)
+        {
+            _ICG_input.push_back(ICG_data[i].Load_real);
+            _ICG_input.push_back(ICG_data[i].Load_mag);
+            _ICG_input.push_back(ICG_data[i].Load_imag);
+            _ICG_input.push_back(ICG_data[i].Load_angle);
+            _ICG_overload.push_back(ICG_data[i].overload);
+        }
+    }
+    uint32_t ICG_count=_ICG_overload.size();
+    if (ECG_count==0 || ICG_count==0)
+    {
+        count=0;
+    }
+
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","aligned_data");
+    int64_t realtime_ns=Timestamp_formatter::get_realtime_ns();
+    _json_writer.key_value("timestamp",_timestamp_formatter.format(realtime_ns));
+    _json_writer.key_value("timestamp_ns",realtime_ns);
+    _json_writer.key_value("sample_rate",sample_rate);
+    _json_writer.key_value("data_size",count);
+    if (request.use_cursor==true)
+    {
+        _json_writer.key_value("skipped_samples",skipped_samples);
+    }
+    else
+    {
+        _lost_samples=_lost_samples+skipped_samples;
+        _json_writer.key_value("lost_samples",_lost_samples);
+    }
+    _json_writer.key_value("ECG_rate",ECG_rate);
+    _json_writer.key_value("ICG_rate",ICG_rate);
+    //relative drift of ECG clock against ICG clock
+    _json_writer.key_value("drift_ppm",((ECG_rate/ECG_clock.get_nominal_rate())/(ICG_clock.get_rate()/ICG_clock.get_nominal_rate())-1.0)*1e6);
+
+    //frame: ECG ch1, ch2, ch3, ICG Load_real, Load_mag, Load_imag, Load_angle (x10000), overload
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    for (uint32_t n=0; n<count; n++)
+    {
+        int64_t time_ns=first_ns+std::llround(n*period_ns);
+        double ECG_position=ECG_clock.get_seq(time_ns)-(double)ECG_first;
+        double ICG_position=(ICG_clock.get_seq(time_ns)-(double)ICG_first-(decimation_ratio-1)/2)/decimation_ratio;
+
+        _json_writer.begin_array();
+        for (uint32_t ch=0; ch<ECG_CHANNELS; ch++)
+        {
+            _json_writer.value((int32_t)std::lround(_ECG_resampler.get_value(_ECG_input.data()+ch,ECG_count,ECG_position,ECG_CHANNELS)));
+        }
+        for (uint32_t ch=0; ch<ICG_CHANNELS; ch++)
+        {
+            _json_writer.value((int32_t)(_ICG_resampler.get_value(_ICG_input.data()+ch,ICG_count,ICG_position,ICG_CHANNELS)*10000.0));
+        }
+        int64_t nearest=std::clamp((int64_t)std::llround(ICG_position),(int64_t)0,(int64_t)ICG_count-1);
+        _json_writer.value((int32_t)_ICG_overload[nearest]);
+        _json_writer.end_array();
+    }
+    _json_writer.end_array();
+
+    int64_t next_ns=first_ns+std::llround(count*period_ns);
+    _json_writer.key_value("first_time_ns",first_ns);
+    _json_writer.key_value("next_time_ns",next_ns);
+    _json_writer.end_object();
+
+    if (request.use_cursor==false)
+    {
+        _next_time_ns=next_ns;
+    }
+    return _json_writer.get_string();
+}
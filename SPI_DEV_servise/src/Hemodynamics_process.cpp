@@ -0,0 +1,274 @@
+#include "Hemodynamics_process.h"
+#include <cmath>
+#include <algorithm>
+
+Hemodynamics_process::Hemodynamics_process(ICG_feature_process *ICG_feature_process_ptr)
+    : _ICG_feature_process(ICG_feature_process_ptr)
+{
+
+}
+
+void Hemodynamics_process::process(void)
+{
+    //feature record which is not in ring any more is lost
+    Sample_ring<ICG_BEAT_FEATURES_TDS>& features_ring=_ICG_feature_process->get_features();
+    _features_seq=std::max(_features_seq,features_ring.get_oldest_seq());
+    ICG_BEAT_FEATURES_TDS features;
+    HEMODYNAMICS_TDS record;
+    while (_features_seq<features_ring.get_write_seq() && features_ring.read(_features_seq,&features)==true)
+    {
+        if (compute(features,&record)==true)
+        {
+            _records.push(record);
+        }
+        else
+        {
+            _invalid_beats++;
+        }
+        _features_seq++;
+    }
+}
+
+bool Hemodynamics_process::compute(const ICG_BEAT_FEATURES_TDS& features, HEMODYNAMICS_TDS *record)
+{
+    if (features.is_valid==false || features.Z0<=0)
+    {
+        return false;
+    }
+    record->beat_seq=features.beat_seq;
+    record->R_time_ns=features.R_time_ns;
+    //beat to beat output uses RR of this beat, average of detector is reported separately
+    record->heart_rate=features.RR_interval>0 ? 60.0/features.RR_interval : 0;
+    record->average_heart_rate=features.heart_rate;
+    record->PEP_ms=features.B_ms;
+    record->LVET_ms=features.X_ms-features.B_ms;
+
+    //volumes are in cm3 (mL), LVET in seconds
+    double LVET=record->LVET_ms/1000.0;
+    if (_settings.model==HEMODYNAMICS_MODEL_KUBICEK)
+    {
+        double ratio=_settings.electrode_distance_cm/features.Z0;
+        record->SV=_settings.blood_resistivity*ratio*ratio*LVET*features.dZdt_max;
+    }
+    else
+    {
+        //volume of electrically participating tissue
+        double VEPT=std::pow(0.17*_settings.height_cm,3)/4.25;
+        record->SV=VEPT*LVET*features.dZdt_max/features.Z0;
+    }
+    record->CO=record->SV*record->heart_rate/1000.0;
+    record->CO_average=record->SV*record->average_heart_rate/1000.0;
+
+    //body surface area of DuBois
+    record->CI=0;
+    if (_settings.weight_kg>0)
+    {
+        double BSA=0.007184*std::pow(_settings.weight_kg,0.425)*std::pow(_settings.height_cm,0.725);
+        record->CI=record->CO/BSA;
+    }
+    record->TFC=1000.0/features.Z0;
+    return true;
+}
+
+std::string Hemodynamics_process::process_JSON_line(const char * JSON_line)
+{
+    //new command cancels waiting request
+    _is_request_pending=false;
+
+    std::string_view command_type;
+    std::string_view key;
+    DATA_REQUEST_TDS request= {false,0,0,0,0};
+    bool is_compact=false;
+    HEMODYNAMICS_SETTINGS_TDS settings=_settings;
+    std::string_view model_name=HEMODYNAMICS_MODEL_NAMES[_settings.model];
+
+    JSON_command_parser parser(JSON_line);
+    if (parser.begin_object()==true)
+    {
+        while (parser.next_key(&key)==true)
+        {
+            if (key=="type") parser.read_string(&command_type);
+            else if (key=="from_seq")
+            {
+                parser.read_number(&request.from_seq);
+                request.use_cursor=true;
+            }
+            else if (key=="max_samples") parser.read_number(&request.max_samples);
+            else if (key=="min_samples") parser.read_number(&request.min_samples);
+            else if (key=="timeout_ms") parser.read_number(&request.timeout_ms);
+            else if (key=="compact") parser.read_bool(&is_compact);
+            else if (key=="model") parser.read_string(&model_name);
+            else if (key=="height_cm") parser.read_number(&settings.height_cm);
+            else if (key=="weight_kg") parser.read_number(&settings.weight_kg);
+            else if (key=="electrode_distance_cm") parser.read_number(&settings.electrode_distance_cm);
+            else if (key=="blood_resistivity") parser.read_number(&settings.blood_resistivity);
+            else parser.skip_value();
+        }
+    }
+
+    if (parser.is_finished()==false)
+    {
+        return "{\"type\":\"error JSON\"}";
+    }
+
+    if (command_type == "get_hemodynamics")
+    {
+        if (request.min_samples>0 && request.timeout_ms>0 && get_available_records(request)<request.min_samples)
+        {
+            //response is sent later by process_pending_request()
+            _pending_request=request;
+            _is_pending_compact=is_compact;
+            _pending_deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(std::min(request.timeout_ms,DATA_REQUEST_MAX_TIMEOUT_MS));
+            _is_request_pending=true;
+            return "";
+        }
+        return get_hemodynamics_as_json(request,is_compact);
+    }
+
+    if (command_type == "set_hemodynamics_settings")
+    {
+        //new settings are used for next beats
+        if (get_hemodynamics_model(model_name,&settings.model)==false || settings.height_cm<=0 || settings.weight_kg<0 ||
+            settings.electrode_distance_cm<=0 || settings.blood_resistivity<=0)
+        {
+            return "{\"type\":\"error JSON\"}";
+        }
+        _settings=settings;
+        command_type="get_hemodynamics_settings";
+    }
+
+    if (command_type == "get_hemodynamics_settings")
+    {
+        return get_settings_as_json();
+    }
+
+    return "{\"type\":\"error JSON\"}";
+}
+
+uint32_t Hemodynamics_process::get_available_records(const DATA_REQUEST_TDS& request)
+{
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = _records.get_first_seq();
+    }
+    uint64_t write_seq = _records.get_write_seq();
+    return write_seq-std::clamp(from_seq,_records.get_oldest_seq(),write_seq);
+}
+
+std::string Hemodynamics_process::process_pending_request(void)
+{
+    if (_is_request_pending==false)
+    {
+        return "";
+    }
+    if (get_available_records(_pending_request)<_pending_request.min_samples &&
+        std::chrono::steady_clock::now()<_pending_deadline)
+    {
+        return "";
+    }
+    _is_request_pending=false;
+    return get_hemodynamics_as_json(_pending_request,_is_pending_compact);
+}
+
+void Hemodynamics_process::cancel_pending_request(void)
+{
+    _is_request_pending=false;
+}
+
+std::string Hemodynamics_process::get_hemodynamics_as_json(const DATA_REQUEST_TDS& request, bool is_compact)
+{
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = _records.skip_overwritten();
+    }
+    uint64_t write_seq = _records.get_write_seq();
+    uint64_t first_seq = std::clamp(from_seq,_records.get_oldest_seq(),write_seq);
+    uint64_t end_seq = write_seq;
+    if (request.max_samples!=0 && end_seq-first_seq>request.max_samples)
+    {
+        end_seq = first_seq+request.max_samples;
+    }
+
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","hemodynamics");
+    if (is_compact==false)
+    {
+        _json_writer.key_value("model",HEMODYNAMICS_MODEL_NAMES[_settings.model]);
+        if (request.use_cursor==true)
+        {
+            _json_writer.key_value("skipped_records",first_seq>from_seq ? first_seq-from_seq : (uint64_t)0);
+        }
+        else
+        {
+            _json_writer.key_value("lost_records",_records.get_overflow_count());
+        }
+        _json_writer.key_value("invalid_beats",_invalid_beats);
+    }
+
+    //full record is [beat_seq,R_time_ns,heart_rate,PEP_ms,LVET_ms,SV,CO,CI,TFC,average_heart_rate,CO_average],
+    //compact record is [R_time_ns,heart_rate,SV,CO,PEP_ms,LVET_ms] as integers: 1/min, mL, L/min x10, ms
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    uint64_t next_seq = first_seq;
+    HEMODYNAMICS_TDS record;
+    while (next_seq<end_seq && _records.read(next_seq,&record)==true)
+    {
+        _json_writer.begin_array();
+        if (is_compact==true)
+        {
+            _json_writer.value(record.R_time_ns);
+            _json_writer.value((int32_t)std::lround(record.heart_rate));
+            _json_writer.value((int32_t)std::lround(record.SV));
+            _json_writer.value((int32_t)std::lround(record.CO*10.0));
+            _json_writer.value((int32_t)std::lround(record.PEP_ms));
+            _json_writer.value((int32_t)std::lround(record.LVET_ms));
+        }
+        else
+        {
+            _json_writer.value(record.beat_seq);
+            _json_writer.value(record.R_time_ns);
+            _json_writer.value(record.heart_rate);
+            _json_writer.value(record.PEP_ms);
+            _json_writer.value(record.LVET_ms);
+            _json_writer.value(record.SV);
+            _json_writer.value(record.CO);
+            _json_writer.value(record.CI);
+            _json_writer.value(record.TFC);
+            _json_writer.value(record.average_heart_rate);
+            _json_writer.value(record.CO_average);
+        }
+        _json_writer.end_array();
+        next_seq++;
+    }
+    _json_writer.end_array();
+    _json_writer.key_value("next_seq",next_seq);
+    if (is_compact==false)
+    {
+        _json_writer.key_value("data_size",next_seq-first_seq);
+        _json_writer.key_value("first_seq",first_seq);
+    }
+    _json_writer.end_object();
+
+    if (request.use_cursor==false)
+    {
+        _records.set_read_seq(next_seq);
+    }
+    return _json_writer.get_string();
+}
+
+std::string Hemodynamics_process::get_settings_as_json(void)
+{
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","hemodynamics_settings");
+    _json_writer.key_value("model",HEMODYNAMICS_MODEL_NAMES[_settings.model]);
+    _json_writer.key_value("height_cm",_settings.height_cm);
+    _json_writer.key_value("weight_kg",_settings.weight_kg);
+    _json_writer.key_value("electrode_distance_cm",_settings.electrode_distance_cm);
+    _json_writer.key_value("blood_resistivity",_settings.blood_resistivity);
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
@@ -0,0 +1,571 @@
+#include "ICG_feature_process.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+ICG_feature_process::ICG_feature_process(ADS1293_process *ADS1293_process_ptr, MAX30009_process *MAX30009_process_ptr)
+    : _ADS1293_process(ADS1293_process_ptr),
+      _MAX30009_process(MAX30009_process_ptr)
+{
+    _ICG_data.reserve(POINTS_BUFF_SIZE);
+}
+
+void ICG_feature_process::reset(void)
+{
+    _MAX30009_settings_version=_MAX30009_process->get_settings_version();
+    _is_measure_running=_MAX30009_process->is_measure_running();
+
+    double decimation_ratio=_MAX30009_process->get_decimation_ratio();
+    _ICG_rate=decimation_ratio>=1 ? _MAX30009_process->get_clock_model().get_nominal_rate()/decimation_ratio : 0;
+    _is_running=_is_measure_running==true && _ICG_rate>=MIN_ICG_RATE;
+
+    _ICG_seq=_MAX30009_process->get_write_seq();
+    _Z_filter.reset({0,0,_settings.lowpass_frequency},_ICG_rate);
+    _filtered_count=0;
+    //low frequency group delay of Butterworth low-pass is sqrt(2)/(2*pi*f), points are moved back by it
+    double lowpass_frequency=_Z_filter.get_settings().lowpass_frequency;
+    _filter_delay_ns=lowpass_frequency>0 ? std::llround(M_SQRT2/(2.0*M_PI*lowpass_frequency)*1e9) : 0;
+    _points_start_seq=_points.get_write_seq();
+
+    //templates are allocated only here
+    _template_size=_is_running==true ? (uint32_t)std::lround(BEAT_WINDOW*_ICG_rate)+1 : 0;
+    _beat_template.assign(_template_size,0);
+    _templates.assign((size_t)MAX_ENSEMBLE_COUNT*_template_size,0);
+    _template_sum.assign(_template_size,0);
+    _templates_count=0;
+    _templates_first=0;
+    _beat_seq=_ADS1293_process->get_beats().get_write_seq();
+}
+
+void ICG_feature_process::process(void)
+{
+    if (_MAX30009_process->get_settings_version()!=_MAX30009_settings_version ||
+        _MAX30009_process->is_measure_running()!=_is_measure_running)
+    {
+        reset();
+    }
+    Sample_ring<QRS_BEAT_TDS>& beats=_ADS1293_process->get_beats();
+    if (_is_running==false)
+    {
+        _beat_seq=beats.get_write_seq();
+        return;
+    }
+
+    update_points();
+
+    //beat waits for points of its window, beat which is not in ring any more is lost
+    _beat_seq=std::max(_beat_seq,beats.get_oldest_seq());
+    ICG_POINT_TDS last_point;
+    QRS_BEAT_TDS beat;
+    while (_points.get_write_seq()>_points_start_seq && _points.read(_points.get_write_seq()-1,&last_point)==true &&
+           _beat_seq<beats.get_write_seq() && beats.read(_beat_seq,&beat)==true)
+    {
+        if (last_point.time_ns<beat.time_ns+(int64_t)(BEAT_WINDOW*1e9))
+        {
+            break;
+        }
+        if (process_beat(_beat_seq,beat)==false)
+        {
+            _rejected_beats++;
+        }
+        _beat_seq++;
+    }
+}
+
+void ICG_feature_process::update_points(void)
+{
+    //filter starts again after gap
+    uint64_t oldest_seq=_MAX30009_process->get_oldest_seq();
+    if (_ICG_seq<oldest_seq)
+    {
+        _ICG_seq=oldest_seq;
+        _Z_filter.reset({0,0,_settings.lowpass_frequency},_ICG_rate);
+        _filtered_count=0;
+    }
+
+    uint64_t first_seq=_ICG_seq;
+    _MAX30009_process->get_decimate_IFIFO_data(first_seq,0,&_ICG_seq,&_ICG_data);
+    Sample_clock_model& ICG_clock=_MAX30009_process->get_clock_model();
+    float decimation_ratio=_MAX30009_process->get_decimation_ratio();
+
+    //point k is average of samples from k*ratio to (k+1)*ratio, its time is middle of them
+    uint32_t point_end=0;
+    for (uint32_t k=0; k<_ICG_data.size(); k++)
+    {
+        const MAX30009_FIFO_DATA_CALIB_TYPE& item=_ICG_data[k];
+        uint32_t point_start=point_end;
+        point_end=(uint32_t)((float)(k+1)*decimation_ratio);
+
+        double scaled=std::clamp(item.Load_mag*Z_SCALE,(double)std::numeric_limits<int32_t>::min(),(double)std::numeric_limits<int32_t>::max());
+        int32_t Z=(int32_t)std::lround(scaled);
+        int32_t filtered;
+        _Z_filter.process(&Z,&filtered);
+
+        if (_filtered_count>=2)
+        {
+            _previous_point.dZdt=-(filtered-_filtered_Z[1])/Z_SCALE*_ICG_rate/2.0;
+            _points.push(_previous_point);
+        }
+        else
+        {
+            _filtered_count++;
+        }
+        _filtered_Z[1]=_filtered_Z[0];
+        _filtered_Z[0]=filtered;
+        _previous_point= {ICG_clock.get_time_ns((double)first_seq+(point_start+point_end-1)/2.0)-_filter_delay_ns,(float)item.Load_mag,0,item.overload};
+    }
+}
+
+bool ICG_feature_process::find_point(int64_t time_ns, uint64_t *seq)
+{
+    uint64_t oldest_seq=std::max(_points.get_oldest_seq(),_points_start_seq);
+    uint64_t write_seq=_points.get_write_seq();
+    ICG_POINT_TDS point;
+    if (oldest_seq>=write_seq || _points.read(oldest_seq,&point)==false || point.time_ns>time_ns)
+    {
+        return false;
+    }
+
+    //position by rate, then first point which is not before time
+    double position=(double)(time_ns-point.time_ns)*1e-9*_ICG_rate;
+    uint64_t point_seq=std::min(oldest_seq+(uint64_t)position,write_seq-1);
+    while (point_seq>oldest_seq && _points.read(point_seq,&point)==true && point.time_ns>=time_ns)
+    {
+        point_seq--;
+    }
+    while (point_seq<write_seq && _points.read(point_seq,&point)==true && point.time_ns<time_ns)
+    {
+        point_seq++;
+    }
+    if (point_seq>=write_seq)
+    {
+        return false;
+    }
+    *seq=point_seq;
+    return true;
+}
+
+bool ICG_feature_process::process_beat(uint64_t beat_seq, const QRS_BEAT_TDS& beat)
+{
+    uint64_t point_seq;
+    if (beat.confidence<_settings.min_confidence || find_point(beat.time_ns,&point_seq)==false)
+    {
+        return false;
+    }
+
+    //-dZ/dt and Z on template grid by linear interpolation of points
+    uint64_t oldest_seq=std::max(_points.get_oldest_seq(),_points_start_seq);
+    uint64_t write_seq=_points.get_write_seq();
+    ICG_POINT_TDS left;
+    ICG_POINT_TDS right;
+    //point which is overwritten in ring drops the beat
+    if (_points.read(point_seq,&right)==false)
+    {
+        return false;
+    }
+    left=right;
+    if (point_seq>oldest_seq && _points.read(point_seq-1,&left)==false)
+    {
+        return false;
+    }
+    double period_ns=1e9/_ICG_rate;
+    double Z_sum=0;
+    for (uint32_t k=0; k<_template_size; k++)
+    {
+        int64_t time_ns=beat.time_ns+std::llround(k*period_ns);
+        while (right.time_ns<time_ns)
+        {
+            if (point_seq+1>=write_seq)
+            {
+                return false;
+            }
+            point_seq++;
+            left=right;
+            if (_points.read(point_seq,&right)==false)
+            {
+                return false;
+            }
+        }
+        if (left.overload==true || right.overload==true)
+        {
+            return false;
+        }
+        double weight=right.time_ns>left.time_ns ? (double)(time_ns-left.time_ns)/(right.time_ns-left.time_ns) : 1.0;
+        _beat_template[k]=left.dZdt+(right.dZdt-left.dZdt)*weight;
+        Z_sum+=left.Z+(right.Z-left.Z)*weight;
+    }
+
+    //beat of other shape (artifact) is not averaged when ensemble is formed, it has own record
+    ICG_BEAT_FEATURES_TDS features;
+    features.beat_seq=beat_seq;
+    features.R_time_ns=beat.time_ns;
+    features.RR_interval=beat.RR_interval;
+    features.heart_rate=beat.heart_rate;
+    features.Z0=Z_sum/_template_size;
+    features.quality=_templates_count>0 ? std::max(get_correlation(),0.0) : 1.0;
+    if (_templates_count<MIN_FORMED_ENSEMBLE || features.quality>=MIN_CORRELATION)
+    {
+        add_template();
+    }
+    find_features(&features);
+    _features.push(features);
+    return true;
+}
+
+double ICG_feature_process::get_correlation(void)
+{
+    double beat_mean=0;
+    double ensemble_mean=0;
+    for (uint32_t k=0; k<_template_size; k++)
+    {
+        beat_mean+=_beat_template[k];
+        ensemble_mean+=_template_sum[k];
+    }
+    beat_mean/=_template_size;
+    ensemble_mean/=_template_size;
+    double product=0;
+    double beat_energy=0;
+    double ensemble_energy=0;
+    for (uint32_t k=0; k<_template_size; k++)
+    {
+        double beat_value=_beat_template[k]-beat_mean;
+        double ensemble_value=_template_sum[k]-ensemble_mean;
+        product+=beat_value*ensemble_value;
+        beat_energy+=beat_value*beat_value;
+        ensemble_energy+=ensemble_value*ensemble_value;
+    }
+    if (beat_energy<=0 || ensemble_energy<=0)
+    {
+        return 0;
+    }
+    return product/std::sqrt(beat_energy*ensemble_energy);
+}
+
+void ICG_feature_process::add_template(void)
+{
+    //oldest template leaves sum when ensemble is full
+    if (_templates_count>=_settings.ensemble_count)
+    {
+        const float *oldest=&_templates[(size_t)_templates_first*_template_size];
+        for (uint32_t k=0; k<_template_size; k++)
+        {
+            _template_sum[k]-=oldest[k];
+        }
+        _templates_first=(_templates_first+1)%MAX_ENSEMBLE_COUNT;
+        _templates_count--;
+    }
+    float *row=&_templates[(size_t)((_templates_first+_templates_count)%MAX_ENSEMBLE_COUNT)*_template_size];
+    for (uint32_t k=0; k<_template_size; k++)
+    {
+        row[k]=_beat_template[k];
+        _template_sum[k]+=_beat_template[k];
+    }
+    _templates_count++;
+}
+
+void ICG_feature_process::find_features(ICG_BEAT_FEATURES_TDS *features)
+{
+    features->ensemble_beats=_templates_count;
+    features->B_ms=0;
+    features->C_ms=0;
+    features->X_ms=0;
+    features->dZdt_max=0;
+    features->is_valid=false;
+    if (_templates_count==0 || _template_size<3)
+    {
+        return;
+    }
+    const std::vector<double>& sum=_template_sum;
+    double count=_templates_count;
+    double ms_per_point=1000.0/_ICG_rate;
+
+    //C: max of -dZ/dt in range of ejection peak
+    uint32_t first=std::max<uint32_t>(std::lround(MIN_C_TIME*_ICG_rate),1);
+    uint32_t last=std::min<uint32_t>(std::lround(MAX_C_TIME*_ICG_rate),_template_size-2);
+    uint32_t C=first;
+    for (uint32_t k=first; k<=last; k++)
+    {
+        if (sum[k]>sum[C])
+        {
+            C=k;
+        }
+    }
+    if (first>last || sum[C]<=0)
+    {
+        return;
+    }
+
+    //B: back from C to zero crossing or notch in low part of upstroke (ripple near C is not B)
+    double B=0;
+    for (uint32_t k=C; k>0; k--)
+    {
+        if (sum[k-1]<=0)
+        {
+            B=k-1+sum[k-1]/(sum[k-1]-sum[k]);
+            break;
+        }
+        if (sum[k-1]>=sum[k] && sum[k]<B_NOTCH_LEVEL*sum[C])
+        {
+            B=k;
+            break;
+        }
+    }
+
+    //X: min of -dZ/dt after C, before next beat
+    double window=BEAT_WINDOW;
+    if (features->heart_rate>0)
+    {
+        window=std::min(window,0.9*60.0/features->heart_rate);
+    }
+    uint32_t X_first=std::max<uint32_t>(C+1,std::ceil(B+MIN_LVET*_ICG_rate));
+    uint32_t X_last=std::min<uint32_t>(std::lround(window*_ICG_rate),_template_size-2);
+    if (X_first>X_last)
+    {
+        return;
+    }
+    uint32_t X=X_first;
+    for (uint32_t k=X_first; k<=X_last; k++)
+    {
+        if (sum[k]<sum[X])
+        {
+            X=k;
+        }
+    }
+
+    //parabolic vertex of extremes
+    auto get_vertex=[&sum](uint32_t k)
+    {
+        double denominator=sum[k-1]-2.0*sum[k]+sum[k+1];
+        return denominator!=0 ? k+0.5*(sum[k-1]-sum[k+1])/denominator : (double)k;
+    };
+    features->B_ms=B*ms_per_point;
+    features->C_ms=get_vertex(C)*ms_per_point;
+    features->X_ms=get_vertex(X)*ms_per_point;
+    features->dZdt_max=sum[C]/count;
+    double LVET_ms=features->X_ms-features->B_ms;
+    features->is_valid=features->B_ms>=MIN_PEP*1000.0 && features->B_ms<=MAX_PEP*1000.0 &&
+                       LVET_ms>=MIN_LVET*1000.0 && LVET_ms<=MAX_LVET*1000.0;
+}
+
+std::string ICG_feature_process::process_JSON_line(const char * JSON_line)
+{
+    //new command cancels waiting request
+    _is_request_pending=false;
+
+    std::string_view command_type;
+    std::string_view key;
+    DATA_REQUEST_TDS request= {false,0,0,0,0};
+    ICG_FEATURE_SETTINGS_TDS settings=_settings;
+
+    JSON_command_parser parser(JSON_line);
+    if (parser.begin_object()==true)
+    {
+        while (parser.next_key(&key)==true)
+        {
+            if (key=="type") parser.read_string(&command_type);
+            else if (key=="from_seq")
+            {
+                parser.read_number(&request.from_seq);
+                request.use_cursor=true;
+            }
+            else if (key=="max_samples") parser.read_number(&request.max_samples);
+            else if (key=="min_samples") parser.read_number(&request.min_samples);
+            else if (key=="timeout_ms") parser.read_number(&request.timeout_ms);
+            else if (key=="ensemble_count") parser.read_number(&settings.ensemble_count);
+            else if (key=="lowpass_frequency") parser.read_number(&settings.lowpass_frequency);
+            else if (key=="min_confidence") parser.read_number(&settings.min_confidence);
+            else parser.skip_value();
+        }
+    }
+
+    if (parser.is_finished()==false)
+    {
+        return "{\"type\":\"error JSON\"}";
+    }
+
+    if (command_type == "get_icg_features")
+    {
+        if (request.min_samples>0 && request.timeout_ms>0 && get_available_features(request)<request.min_samples)
+        {
+            //response is sent later by process_pending_request()
+            _pending_request=request;
+            _pending_deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(std::min(request.timeout_ms,DATA_REQUEST_MAX_TIMEOUT_MS));
+            _is_request_pending=true;
+            return "";
+        }
+        return get_features_as_json(request);
+    }
+
+    if (command_type == "get_icg_ensemble")
+    {
+        return get_ensemble_as_json();
+    }
+
+    if (command_type == "set_icg_settings")
+    {
+        if (settings.ensemble_count<1 || settings.ensemble_count>MAX_ENSEMBLE_COUNT || settings.lowpass_frequency<0 ||
+            settings.min_confidence<0 || settings.min_confidence>1)
+        {
+            return "{\"type\":\"error JSON\"}";
+        }
+        _settings=settings;
+        reset();
+        command_type="get_icg_settings";
+    }
+
+    if (command_type == "get_icg_settings")
+    {
+        return get_settings_as_json();
+    }
+
+    return "{\"type\":\"error JSON\"}";
+}
+
+uint32_t ICG_feature_process::get_available_features(const DATA_REQUEST_TDS& request)
+{
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = _features.get_first_seq();
+    }
+    uint64_t write_seq = _features.get_write_seq();
+    return write_seq-std::clamp(from_seq,_features.get_oldest_seq(),write_seq);
+}
+
+std::string ICG_feature_process::process_pending_request(void)
+{
+    if (_is_request_pending==false)
+    {
+        return "";
+    }
+    if (get_available_features(_pending_request)<_pending_request.min_samples &&
+        std::chrono::steady_clock::now()<_pending_deadline)
+    {
+        return "";
+    }
+    _is_request_pending=false;
+    return get_features_as_json(_pending_request);
+}
+
+void ICG_feature_process::cancel_pending_request(void)
+{
+    _is_request_pending=false;
+}
+
+Sample_ring<ICG_BEAT_FEATURES_TDS>& ICG_feature_process::get_features(void)
+{
+    return _features;
+}
+
+std::string ICG_feature_process::get_features_as_json(const DATA_REQUEST_TDS& request)
+{
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = _features.skip_overwritten();
+    }
+    uint64_t write_seq = _features.get_write_seq();
+    uint64_t first_seq = std::clamp(from_seq,_features.get_oldest_seq(),write_seq);
+    uint64_t end_seq = write_seq;
+    if (request.max_samples!=0 && end_seq-first_seq>request.max_samples)
+    {
+        end_seq = first_seq+request.max_samples;
+    }
+
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","icg_features");
+    _json_writer.key_value("running",_is_running);
+    _json_writer.key_value("icg_rate",_ICG_rate);
+    if (request.use_cursor==true)
+    {
+        _json_writer.key_value("skipped_features",first_seq>from_seq ? first_seq-from_seq : (uint64_t)0);
+    }
+    else
+    {
+        _json_writer.key_value("lost_features",_features.get_overflow_count());
+    }
+    _json_writer.key_value("rejected_beats",_rejected_beats);
+
+    //record is [beat_seq,R_time_ns,RR_ms,heart_rate,B_ms,C_ms,X_ms,dZdt_max,Z0,quality,ensemble_beats,valid]
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    uint64_t next_seq = first_seq;
+    ICG_BEAT_FEATURES_TDS features;
+    while (next_seq<end_seq && _features.read(next_seq,&features)==true)
+    {
+        _json_writer.begin_array();
+        _json_writer.value(features.beat_seq);
+        _json_writer.value(features.R_time_ns);
+        _json_writer.value(features.RR_interval*1000.0);
+        _json_writer.value(features.heart_rate);
+        _json_writer.value(features.B_ms);
+        _json_writer.value(features.C_ms);
+        _json_writer.value(features.X_ms);
+        _json_writer.value(features.dZdt_max);
+        _json_writer.value(features.Z0);
+        _json_writer.value(features.quality);
+        _json_writer.value(features.ensemble_beats);
+        _json_writer.value(features.is_valid);
+        _json_writer.end_array();
+        next_seq++;
+    }
+    _json_writer.end_array();
+    _json_writer.key_value("data_size",next_seq-first_seq);
+    _json_writer.key_value("first_seq",first_seq);
+    _json_writer.key_value("next_seq",next_seq);
+    _json_writer.end_object();
+
+    if (request.use_cursor==false)
+    {
+        _features.set_read_seq(next_seq);
+    }
+    return _json_writer.get_string();
+}
+
+std::string ICG_feature_process::get_ensemble_as_json(void)
+{
+    //points of current ensemble with heart rate of last beat
+    ICG_BEAT_FEATURES_TDS features= {};
+    if (_features.get_write_seq()>0)
+    {
+        _features.read(_features.get_write_seq()-1,&features);
+    }
+    find_features(&features);
+
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","icg_ensemble");
+    _json_writer.key_value("running",_is_running);
+    _json_writer.key_value("sample_rate",_ICG_rate);
+    _json_writer.key_value("ensemble_beats",_templates_count);
+    _json_writer.key_value("B_ms",features.B_ms);
+    _json_writer.key_value("C_ms",features.C_ms);
+    _json_writer.key_value("X_ms",features.X_ms);
+    _json_writer.key_value("dZdt_max",features.dZdt_max);
+    _json_writer.key_value("valid",features.is_valid);
+    //-dZ/dt (Ohm/s x10000) from R peak
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    for (uint32_t k=0; _templates_count>0 && k<_template_size; k++)
+    {
+        _json_writer.value((int32_t)std::lround(_template_sum[k]/_templates_count*10000.0));
+    }
+    _json_writer.end_array();
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
+
+std::string ICG_feature_process::get_settings_as_json(void)
+{
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","icg_settings");
+    _json_writer.key_value("ensemble_count",_settings.ensemble_count);
+    _json_writer.key_value("lowpass_frequency",_Z_filter.get_settings().lowpass_frequency);
+    _json_writer.key_value("min_confidence",_settings.min_confidence);
+    _json_writer.key_value("running",_is_running);
+    _json_writer.key_value("icg_rate",_ICG_rate);
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
@@ -0,0 +1,210 @@
+#include "MAX30009_calib_interp.h"
+
+#include <cmath>
+
+
+bool MAX30009_calib_interp::build(const uint32_t *freq_points, const MAX30009_CALIB_DATA *calib_points, const bool *points_valid, uint32_t points_count)
+{
+    double x[MAX_POINTS_COUNT];
+    double y[MAX30009_CALIB_INTERP_PARAMS_COUNT][MAX_POINTS_COUNT];
+    double slopes[MAX30009_CALIB_INTERP_PARAMS_COUNT][MAX_POINTS_COUNT];
+    uint32_t count=0;
+
+    _is_valid=false;
+
+    //freq_points must be sorted ascending
+    for (uint32_t i=0; i<points_count && count<MAX_POINTS_COUNT; i++)
+    {
+        if (points_valid[i]==false || freq_points[i]==0 || calib_points[i].I_coef==0 || calib_points[i].Q_coef==0)
+        {
+            continue;
+        }
+        x[count]=log(freq_points[i]);
+        y[MAX30009_CALIB_INTERP_I_OFFSET][count]=calib_points[i].I_offset;
+        y[MAX30009_CALIB_INTERP_Q_OFFSET][count]=calib_points[i].Q_offset;
+        y[MAX30009_CALIB_INTERP_I_COEF][count]=calib_points[i].I_coef;
+        y[MAX30009_CALIB_INTERP_Q_COEF][count]=calib_points[i].Q_coef;
+        y[MAX30009_CALIB_INTERP_I_PHASE][count]=calib_points[i].I_phase_coef;
+        y[MAX30009_CALIB_INTERP_Q_PHASE][count]=calib_points[i].Q_phase_coef;
+
+        if (count>0)
+        {
+            //unwrap phase, atan2 jumps at +-180 degrees
+            for (uint32_t p=MAX30009_CALIB_INTERP_I_PHASE; p<=MAX30009_CALIB_INTERP_Q_PHASE; p++)
+            {
+                while (y[p][count]-y[p][count-1]>180.0) y[p][count]-=360.0;
+                while (y[p][count]-y[p][count-1]<-180.0) y[p][count]+=360.0;
+            }
+        }
+        count++;
+    }
+
+    if (count==0)
+    {
+        return false;
+    }
+
+    for (uint32_t p=0; p<MAX30009_CALIB_INTERP_PARAMS_COUNT; p++)
+    {
+        calculate_PCHIP_slopes(x,y[p],count,slopes[p]);
+    }
+
+    _log_min_freq=x[0];
+    _log_step=(count>1) ? (x[count-1]-x[0])/(LUT_SIZE-1) : 0;
+    for (uint32_t i=0; i<LUT_SIZE; i++)
+    {
+        double x_value=_log_min_freq+_log_step*i;
+        for (uint32_t p=0; p<MAX30009_CALIB_INTERP_PARAMS_COUNT; p++)
+        {
+            _lut[i].value[p]=calculate_PCHIP_value(x,y[p],slopes[p],count,x_value);
+        }
+    }
+
+    _is_valid=true;
+    return true;
+}
+
+bool MAX30009_calib_interp::get_calib_data(double frequency, MAX30009_CALIB_DATA *calib_data)
+{
+    if (_is_valid==false || frequency<=0)
+    {
+        return false;
+    }
+
+    //outside of calibrated range coefficients of nearest point are used
+    double position=0;
+    if (_log_step>0)
+    {
+        position=(log(frequency)-_log_min_freq)/_log_step;
+    }
+    if (position<0)
+    {
+        position=0;
+    }
+    if (position>LUT_SIZE-1)
+    {
+        position=LUT_SIZE-1;
+    }
+
+    uint32_t index=(uint32_t)position;
+    if (index>=LUT_SIZE-1)
+    {
+        index=LUT_SIZE-2;
+    }
+    double k=position-index;
+
+    double value[MAX30009_CALIB_INTERP_PARAMS_COUNT];
+    for (uint32_t p=0; p<MAX30009_CALIB_INTERP_PARAMS_COUNT; p++)
+    {
+        value[p]=_lut[index].value[p]+(_lut[index+1].value[p]-_lut[index].value[p])*k;
+    }
+
+    calib_data->calibrate_frequency=(uint32_t)lround(frequency);
+    calib_data->I_offset=(int32_t)lround(value[MAX30009_CALIB_INTERP_I_OFFSET]);
+    calib_data->Q_offset=(int32_t)lround(value[MAX30009_CALIB_INTERP_Q_OFFSET]);
+    calib_data->I_coef=value[MAX30009_CALIB_INTERP_I_COEF];
+    calib_data->Q_coef=value[MAX30009_CALIB_INTERP_Q_COEF];
+    calib_data->I_phase_coef=value[MAX30009_CALIB_INTERP_I_PHASE];
+    calib_data->Q_phase_coef=value[MAX30009_CALIB_INTERP_Q_PHASE];
+
+    calib_data->I_phase_cos=cos(calib_data->I_phase_coef*M_PI/180.0);
+    calib_data->I_phase_sin=sin(calib_data->I_phase_coef*M_PI/180.0);
+    calib_data->Q_phase_cos=cos(calib_data->Q_phase_coef*M_PI/180.0);
+    calib_data->Q_phase_sin=sin(calib_data->Q_phase_coef*M_PI/180.0);
+    return true;
+}
+
+bool MAX30009_calib_interp::is_valid(void)
+{
+    return _is_valid;
+}
+
+void MAX30009_calib_interp::calculate_PCHIP_slopes(const double *x, const double *y, uint32_t count, double *slopes)
+{
+    //Fritsch-Carlson slopes: no overshoot between calibrate points
+    if (count<2)
+    {
+        slopes[0]=0;
+        return;
+    }
+
+    double h[MAX_POINTS_COUNT];
+    double delta[MAX_POINTS_COUNT];
+    for (uint32_t i=0; i<count-1; i++)
+    {
+        h[i]=x[i+1]-x[i];
+        delta[i]=(y[i+1]-y[i])/h[i];
+    }
+
+    if (count==2)
+    {
+        slopes[0]=delta[0];
+        slopes[1]=delta[0];
+        return;
+    }
+
+    for (uint32_t i=1; i<count-1; i++)
+    {
+        if (delta[i-1]*delta[i]<=0)
+        {
+            slopes[i]=0;
+        }
+        else
+        {
+            double w1=2*h[i]+h[i-1];
+            double w2=h[i]+2*h[i-1];
+            slopes[i]=(w1+w2)/(w1/delta[i-1]+w2/delta[i]);
+        }
+    }
+
+    //one side three point end slopes
+    uint32_t n=count-1;
+    double d_start=((2*h[0]+h[1])*delta[0]-h[0]*delta[1])/(h[0]+h[1]);
+    double d_end=((2*h[n-1]+h[n-2])*delta[n-1]-h[n-1]*delta[n-2])/(h[n-1]+h[n-2]);
+
+    if (d_start*delta[0]<=0)
+    {
+        d_start=0;
+    }
+    else if (delta[0]*delta[1]<0 && fabs(d_start)>fabs(3*delta[0]))
+    {
+        d_start=3*delta[0];
+    }
+
+    if (d_end*delta[n-1]<=0)
+    {
+        d_end=0;
+    }
+    else if (delta[n-1]*delta[n-2]<0 && fabs(d_end)>fabs(3*delta[n-1]))
+    {
+        d_end=3*delta[n-1];
+    }
+
+    slopes[0]=d_start;
+    slopes[n]=d_end;
+}
+
+double MAX30009_calib_interp::calculate_PCHIP_value(const double *x, const double *y, const double *slopes, uint32_t count, double x_value)
+{
+    if (count<2 || x_value<=x[0])
+    {
+        return y[0];
+    }
+    if (x_value>=x[count-1])
+    {
+        return y[count-1];
+    }
+
+    uint32_t i=0;
+    while (i<count-2 && x_value>x[i+1])
+    {
+        i++;
+    }
+
+    double h=x[i+1]-x[i];
+    double t=(x_value-x[i])/h;
+    double t2=t*t;
+    double t3=t2*t;
+
+    return (2*t3-3*t2+1)*y[i]+(t3-2*t2+t)*h*slopes[i]+(-2*t3+3*t2)*y[i+1]+(t3-t2)*h*slopes[i+1];
+}
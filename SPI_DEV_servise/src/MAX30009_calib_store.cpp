@@ -0,0 +1,276 @@
+#include "MAX30009_calib_store.h"
+#include "CRC32.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+static_assert(offsetof(MAX30009_CALIB_STORE_RECORD_TDS,I_noise)==MAX30009_CALIB_STORE_RECORD_V1_SIZE,"calib store version 1 layout is changed");
+
+MAX30009_calib_store::MAX30009_calib_store(uint32_t current_points_count, uint32_t freq_points_count)
+{
+    _current_points_count=current_points_count;
+    _freq_points_count=freq_points_count;
+    _records.resize(current_points_count*freq_points_count);
+    memset(_records.data(),0,_records.size()*sizeof(MAX30009_CALIB_STORE_RECORD_TDS));
+    _board_id=read_board_id();
+}
+
+bool MAX30009_calib_store::load(const std::string& filename)
+{
+    int fd=open(filename.c_str(),O_RDONLY);
+    if (fd<0)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd,&file_stat)<0 || (size_t)file_stat.st_size<sizeof(MAX30009_CALIB_STORE_HEADER_TDS))
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t file_size=file_stat.st_size;
+    void *map=mmap(nullptr,file_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (map==MAP_FAILED)
+    {
+        perror("calib store mmap failed");
+        return false;
+    }
+
+    bool result=false;
+    const MAX30009_CALIB_STORE_HEADER_TDS *header=(const MAX30009_CALIB_STORE_HEADER_TDS *)map;
+    size_t record_size=0;
+    if (header->version==1)
+    {
+        record_size=MAX30009_CALIB_STORE_RECORD_V1_SIZE;
+    }
+    else if (header->version==MAX30009_CALIB_STORE_VERSION)
+    {
+        record_size=sizeof(MAX30009_CALIB_STORE_RECORD_TDS);
+    }
+    size_t table_size=_records.size()*record_size;
+
+    if (header->magic!=MAX30009_CALIB_STORE_MAGIC)
+    {
+        std::cout << filename << " - wrong magic" << std::endl;
+    }
+    else if (record_size==0)
+    {
+        std::cout << filename << " - unsupported version " << header->version << std::endl;
+    }
+    else if (header->header_size!=sizeof(MAX30009_CALIB_STORE_HEADER_TDS) ||
+             header->record_size!=record_size ||
+             header->current_points_count!=_current_points_count ||
+             header->freq_points_count!=_freq_points_count ||
+             file_size<header->header_size+table_size)
+    {
+        std::cout << filename << " - wrong table layout" << std::endl;
+    }
+    else if (header->board_id!=0 && _board_id!=0 && header->board_id!=_board_id)
+    {
+        std::cout << filename << " - calibration is made for other board" << std::endl;
+    }
+    else
+    {
+        const uint8_t *table=(const uint8_t *)map+header->header_size;
+        if (CRC32::calculate(table,table_size)!=header->table_crc32)
+        {
+            std::cout << filename << " - checksum error" << std::endl;
+        }
+        else
+        {
+            //old versions have shorter records, new fields stay zero
+            memset(_records.data(),0,_records.size()*sizeof(MAX30009_CALIB_STORE_RECORD_TDS));
+            for (size_t i=0; i<_records.size(); i++)
+            {
+                memcpy(&_records[i],table+i*record_size,record_size);
+            }
+            std::cout << filename << " - load OK, version " << header->version << std::endl;
+            result=true;
+        }
+    }
+
+    munmap(map,file_size);
+    return result;
+}
+
+bool MAX30009_calib_store::save(const std::string& filename)
+{
+    //write temp file and rename it, calibration file is always complete after power loss
+    std::string temp_filename=filename+".tmp";
+
+    MAX30009_CALIB_STORE_HEADER_TDS header;
+    memset(&header,0,sizeof(header));
+    header.magic=MAX30009_CALIB_STORE_MAGIC;
+    header.version=MAX30009_CALIB_STORE_VERSION;
+    header.header_size=sizeof(MAX30009_CALIB_STORE_HEADER_TDS);
+    header.board_id=_board_id;
+    header.current_points_count=_current_points_count;
+    header.freq_points_count=_freq_points_count;
+    header.record_size=sizeof(MAX30009_CALIB_STORE_RECORD_TDS);
+    size_t table_size=_records.size()*sizeof(MAX30009_CALIB_STORE_RECORD_TDS);
+    header.table_crc32=CRC32::calculate(_records.data(),table_size);
+
+    int fd=open(temp_filename.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+    if (fd<0)
+    {
+        perror("calib store open failed");
+        return false;
+    }
+
+    bool result=true;
+    if (write(fd,&header,sizeof(header))!=(ssize_t)sizeof(header))
+    {
+        result=false;
+    }
+    if (result==true && write(fd,_records.data(),table_size)!=(ssize_t)table_size)
+    {
+        result=false;
+    }
+    if (result==true && fsync(fd)<0)
+    {
+        result=false;
+    }
+    close(fd);
+
+    if (result==false)
+    {
+        perror("calib store write failed");
+        unlink(temp_filename.c_str());
+        return false;
+    }
+
+    if (rename(temp_filename.c_str(),filename.c_str())<0)
+    {
+        perror("calib store rename failed");
+        unlink(temp_filename.c_str());
+        return false;
+    }
+
+    //make rename durable
+    std::vector<char> dir_path(filename.begin(),filename.end());
+    dir_path.push_back('\0');
+    int dir_fd=open(dirname(dir_path.data()),O_RDONLY | O_DIRECTORY);
+    if (dir_fd>=0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+
+    std::cout << "save calib store:" << filename << std::endl;
+    return true;
+}
+
+bool MAX30009_calib_store::get_calib_data(uint32_t current_index, uint32_t freq_index, MAX30009_CALIB_DATA *calib_data)
+{
+    if (current_index>=_current_points_count || freq_index>=_freq_points_count)
+    {
+        return false;
+    }
+    const MAX30009_CALIB_STORE_RECORD_TDS &record=_records[current_index*_freq_points_count+freq_index];
+    if (record.is_valid==0)
+    {
+        return false;
+    }
+
+    calib_data->calibrate_frequency=record.calibrate_frequency;
+    calib_data->calibrate_current=(MAX30009_CURRENT_AMP_ENUM_TYPE)record.calibrate_current;
+    calib_data->I_offset=record.I_offset;
+    calib_data->Q_offset=record.Q_offset;
+    calib_data->I_cal_in_ADC=record.I_cal_in_ADC;
+    calib_data->Q_cal_in_ADC=record.Q_cal_in_ADC;
+
+    calib_data->I_coef=record.I_coef;
+    calib_data->I_phase_coef=record.I_phase_coef;
+    calib_data->I_phase_cos=record.I_phase_cos;
+    calib_data->I_phase_sin=record.I_phase_sin;
+    calib_data->Q_coef=record.Q_coef;
+    calib_data->Q_phase_coef=record.Q_phase_coef;
+    calib_data->Q_phase_cos=record.Q_phase_cos;
+    calib_data->Q_phase_sin=record.Q_phase_sin;
+
+    calib_data->I_cal_in=record.I_cal_in;
+    calib_data->I_cal_quad=record.I_cal_quad;
+    calib_data->Q_cal_in=record.Q_cal_in;
+    calib_data->Q_cal_quad=record.Q_cal_quad;
+
+    calib_data->I_noise=record.I_noise;
+    calib_data->Q_noise=record.Q_noise;
+    calib_data->residual=record.residual;
+    calib_data->calibrate_time=record.calibrate_time;
+    return true;
+}
+
+void MAX30009_calib_store::set_calib_data(uint32_t current_index, uint32_t freq_index, const MAX30009_CALIB_DATA &calib_data)
+{
+    if (current_index>=_current_points_count || freq_index>=_freq_points_count)
+    {
+        return;
+    }
+    MAX30009_CALIB_STORE_RECORD_TDS &record=_records[current_index*_freq_points_count+freq_index];
+    memset(&record,0,sizeof(record));
+
+    record.is_valid=1;
+    record.calibrate_frequency=calib_data.calibrate_frequency;
+    record.calibrate_current=calib_data.calibrate_current;
+    record.I_offset=calib_data.I_offset;
+    record.Q_offset=calib_data.Q_offset;
+    record.I_cal_in_ADC=calib_data.I_cal_in_ADC;
+    record.Q_cal_in_ADC=calib_data.Q_cal_in_ADC;
+
+    record.I_coef=calib_data.I_coef;
+    record.I_phase_coef=calib_data.I_phase_coef;
+    record.I_phase_cos=calib_data.I_phase_cos;
+    record.I_phase_sin=calib_data.I_phase_sin;
+    record.Q_coef=calib_data.Q_coef;
+    record.Q_phase_coef=calib_data.Q_phase_coef;
+    record.Q_phase_cos=calib_data.Q_phase_cos;
+    record.Q_phase_sin=calib_data.Q_phase_sin;
+
+    record.I_cal_in=calib_data.I_cal_in;
+    record.I_cal_quad=calib_data.I_cal_quad;
+    record.Q_cal_in=calib_data.Q_cal_in;
+    record.Q_cal_quad=calib_data.Q_cal_quad;
+
+    record.I_noise=calib_data.I_noise;
+    record.Q_noise=calib_data.Q_noise;
+    record.residual=calib_data.residual;
+    record.calibrate_time=calib_data.calibrate_time;
+}
+
+uint64_t MAX30009_calib_store::get_board_id(void)
+{
+    return _board_id;
+}
+
+uint64_t MAX30009_calib_store::read_board_id(void)
+{
+    //Raspberry Pi SoC serial number
+    std::ifstream file("/sys/firmware/devicetree/base/serial-number");
+    if (file.is_open()==false)
+    {
+        return 0;
+    }
+    std::string serial;
+    std::getline(file,serial,'\0');
+    try
+    {
+        return std::stoull(serial,nullptr,16);
+    }
+    catch (const std::exception& e)
+    {
+
+    }
+    return 0;
+}
@@ -1,6 +1,6 @@
 #include "MAX30009_process.h"
-#include <iomanip>
 #include <ctime>
+#include <algorithm>
 
 using json = nlohmann::json;
 
@@ -29,67 +29,202 @@ MAX30009_process::MAX30009_process()
 void MAX30009_process::init()
 {
     GPIO_MAX30009_POWER.set_GPIO_direct(VT_GPIO_OUTPUT,VT_GPIO_UNSET);
+    load_calibration();
+    build_calibration_interp();
+    build_clock_solution_table();
+}
+
+void MAX30009_process::load_calibration(void)
+{
+    std::error_code error;
+    if (_calib_store.load(CALIB_STORE_FILENAME)==false && std::filesystem::exists(CALIB_STORE_FILENAME,error)==true)
+    {
+        //corrupt or foreign store is kept for analysis, device is not calibrated until new calibration
+        std::filesystem::rename(CALIB_STORE_FILENAME,CALIB_STORE_BAD_FILENAME,error);
+        std::cout << CALIB_STORE_FILENAME << " is not loaded" << (error ? ", rename failed" : ", moved to "+CALIB_STORE_BAD_FILENAME) << std::endl;
+    }
+    _is_calib_store_bad=std::filesystem::exists(CALIB_STORE_BAD_FILENAME,error);
+
+    if (std::filesystem::exists(CALIB_STORE_FILENAME,error)==false && _is_calib_store_bad==false)
+    {
+        //no binary store yet, import old per point JSON files once
+        bool is_imported=false;
+        for (uint32_t i=0; i<CURRENT_POINTS_COUNT; i++)
+        {
+            for (uint32_t j=0; j<FREQ_POINTS_COUNT; j++)
+            {
+                std::string filename = "calib/" +  std::to_string(i) + "_" +  std::to_string(j) + ".json";
+                MAX30009_CALIB_DATA calib_koef= {};
+                if (get_calib_koef_from_file(filename,&calib_koef)==true)
+                {
+                    calib_koef.calibrate_current=CURRENT_POINTS[i];
+                    calib_koef.calibrate_frequency=FREQ_POINTS[j];
+                    _calib_store.set_calib_data(i,j,calib_koef);
+                    is_imported=true;
+                }
+            }
+        }
+        if (is_imported==true)
+        {
+            save_calibration();
+        }
+    }
+
+    for (uint32_t i=0; i<CURRENT_POINTS_COUNT; i++)
+    {
+        for (uint32_t j=0; j<FREQ_POINTS_COUNT; j++)
+        {
+            _calibrate_data[i][j]= {};
+            _calib_store.get_calib_data(i,j,&_calibrate_data[i][j]);
+        }
+    }
+}
+
+bool MAX30009_process::save_calibration(void)
+{
+    std::error_code error;
+    std::filesystem::create_directories("calib/",error);
+    if (_calib_store.save(CALIB_STORE_FILENAME)==false)
+    {
+        return false;
+    }
+    if (_is_calib_store_bad==true)
+    {
+        //new store is written, bad store is kept with its time so next bad store does not overwrite it
+        std::string old_filename=CALIB_STORE_BAD_FILENAME+"."+std::to_string(time(nullptr));
+        std::filesystem::rename(CALIB_STORE_BAD_FILENAME,old_filename,error);
+        std::cout << CALIB_STORE_BAD_FILENAME << (error ? " rename failed" : " moved to "+old_filename) << std::endl;
+        _is_calib_store_bad=std::filesystem::exists(CALIB_STORE_BAD_FILENAME,error);
+    }
+    return true;
+}
+
+void MAX30009_process::build_calibration_interp(void)
+{
     for (uint32_t i=0; i<CURRENT_POINTS_COUNT; i++)
     {
+        bool points_valid[FREQ_POINTS_COUNT];
         for (uint32_t j=0; j<FREQ_POINTS_COUNT; j++)
         {
-            std::string filename = "calib/" +  std::to_string(i) + "_" +  std::to_string(j) + ".json";
-            _calibrate_data[i][j]=get_calib_koef_from_file(filename);
+            MAX30009_CALIB_DATA calib_koef;
+            points_valid[j]=_calib_store.get_calib_data(i,j,&calib_koef);
+        }
+        _calib_interp[i].build(FREQ_POINTS,_calibrate_data[i],points_valid,FREQ_POINTS_COUNT);
+    }
+}
+
+void MAX30009_process::update_active_calib_data(void)
+{
+    //raw data header has active calibration
+    _raw_header_version++;
+    _raw_header_json.clear();
+
+    uint32_t current_index=MAX30009_user_sett.stimulate_current_select;
+    if (current_index>=CURRENT_POINTS_COUNT)
+    {
+        _active_calib_data= {};
+        return;
+    }
+
+    if (_use_drive_frequency==false)
+    {
+        _active_calib_data=_calibrate_data[current_index][MAX30009_user_sett.stimulate_frequency];
+        return;
+    }
+
+    //calibrate for real synthesized drive frequency
+    _active_calib_data= {};
+    _calib_interp[current_index].get_calib_data(MAX30009.get_all_frequency().BIOZ_DRIVE_FREQ/10.0,&_active_calib_data);
+}
+
+void MAX30009_process::build_clock_solution_table(void)
+{
+    for (uint32_t i=0; i<FREQ_POINTS_COUNT; i++)
+    {
+        for (uint32_t j=0; j<=MAX_MEASURE_FREQ; j++)
+        {
+            _clk_solution_table[i][j]=find_measure_clock_solution(FREQ_POINTS[i]*10,j);
         }
     }
 }
 
-MAX30009_CALIB_DATA  MAX30009_process::get_calib_koef_from_file(const std::string& filename)
+MAX30009_FIND_CLOCKS_STRUCT_TYPE MAX30009_process::find_measure_clock_solution(uint32_t drive_freq, uint32_t measure_frequency)
 {
-    MAX30009_CALIB_DATA out;
-    out.I_offset=0;
-    out.I_coef=0;
-    out.I_phase_coef=0;
-    out.I_phase_cos=0;
-    out.I_phase_sin=0;
-    out.Q_offset=0;
-    out.Q_coef=0;
-    out.Q_phase_coef=0;
-    out.Q_phase_cos=0;
-    out.Q_phase_sin=0;
+    MAX30009_FIND_CLOCKS_STRUCT_TYPE clk_solution= {0};
+    if (measure_frequency<MIN_MEASURE_FREQ)
+    {
+        return clk_solution;
+    }
 
+    //ADC sample rate must be at least 10 times more than measure frequency
+    MAX30009_LIB::find_clock_solution(drive_freq,measure_frequency*10*10,REF_CLK_FREQ,&clk_solution);
+    for(uint32_t i=10; i<100; i++)
+    {
+        if(measure_frequency*10>clk_solution.ADC_sample_rate/10)
+        {
+            MAX30009_LIB::find_clock_solution(drive_freq,measure_frequency*10*i,REF_CLK_FREQ,&clk_solution);
+        }
+        else
+        {
+            break;
+        }
+    }
+    return clk_solution;
+}
+
+bool MAX30009_process::get_calib_koef_from_file(const std::string& filename, MAX30009_CALIB_DATA *calib_koef)
+{
     if (std::filesystem::exists(filename)==false)
     {
-        return out;
+        return false;
     }
 
     std::ifstream file(filename);
     if (file.is_open()==false)
     {
-        return out;
+        return false;
     }
 
     try
     {
         nlohmann::json j;
         file >> j;
-
-        if (j.contains("I_offset"))  out.I_offset=j["I_offset"];
-        if (j.contains("I_coef"))  out.I_coef=j["I_coef"];
-        if (j.contains("I_phase_coef"))  out.I_phase_coef=j["I_phase_coef"];
-        if (j.contains("I_phase_cos"))  out.I_phase_cos=j["I_phase_cos"];
-        if (j.contains("I_phase_sin"))  out.I_phase_sin=j["I_phase_sin"];
-
-        if (j.contains("Q_offset"))  out.Q_offset=j["Q_offset"];
-        if (j.contains("Q_coef"))  out.Q_coef=j["Q_coef"];
-        if (j.contains("Q_phase_coef"))  out.Q_phase_coef=j["Q_phase_coef"];
-        if (j.contains("Q_phase_cos"))  out.Q_phase_cos=j["Q_phase_cos"];
-        if (j.contains("Q_phase_sin"))  out.Q_phase_sin=j["Q_phase_sin"];
-
+        get_calib_koef_from_json(j,calib_koef);
         std::cout  << filename << " - load OK" << std::endl;
+        return true;
     }
     catch (const std::exception& e)
     {
 
     }
+    return false;
+}
 
-
-    return out;
+void MAX30009_process::get_calib_koef_from_json(const nlohmann::json& calib_json, MAX30009_CALIB_DATA *calib_koef)
+{
+    if (calib_json.contains("I_offset"))  calib_koef->I_offset=calib_json["I_offset"];
+    if (calib_json.contains("I_coef"))  calib_koef->I_coef=calib_json["I_coef"];
+    if (calib_json.contains("I_phase_coef"))  calib_koef->I_phase_coef=calib_json["I_phase_coef"];
+    if (calib_json.contains("I_phase_cos"))  calib_koef->I_phase_cos=calib_json["I_phase_cos"];
+    if (calib_json.contains("I_phase_sin"))  calib_koef->I_phase_sin=calib_json["I_phase_sin"];
+
+    if (calib_json.contains("Q_offset"))  calib_koef->Q_offset=calib_json["Q_offset"];
+    if (calib_json.contains("Q_coef"))  calib_koef->Q_coef=calib_json["Q_coef"];
+    if (calib_json.contains("Q_phase_coef"))  calib_koef->Q_phase_coef=calib_json["Q_phase_coef"];
+    if (calib_json.contains("Q_phase_cos"))  calib_koef->Q_phase_cos=calib_json["Q_phase_cos"];
+    if (calib_json.contains("Q_phase_sin"))  calib_koef->Q_phase_sin=calib_json["Q_phase_sin"];
+
+    if (calib_json.contains("I_cal_in"))  calib_koef->I_cal_in=calib_json["I_cal_in"];
+    if (calib_json.contains("I_cal_in_ADC"))  calib_koef->I_cal_in_ADC=calib_json["I_cal_in_ADC"];
+    if (calib_json.contains("I_cal_quad"))  calib_koef->I_cal_quad=calib_json["I_cal_quad"];
+    if (calib_json.contains("Q_cal_in"))  calib_koef->Q_cal_in=calib_json["Q_cal_in"];
+    if (calib_json.contains("Q_cal_in_ADC"))  calib_koef->Q_cal_in_ADC=calib_json["Q_cal_in_ADC"];
+    if (calib_json.contains("Q_cal_quad"))  calib_koef->Q_cal_quad=calib_json["Q_cal_quad"];
+
+    if (calib_json.contains("I_noise"))  calib_koef->I_noise=calib_json["I_noise"];
+    if (calib_json.contains("Q_noise"))  calib_koef->Q_noise=calib_json["Q_noise"];
+    if (calib_json.contains("residual"))  calib_koef->residual=calib_json["residual"];
+    if (calib_json.contains("calibrate_time"))  calib_koef->calibrate_time=calib_json["calibrate_time"];
 }
 
 void MAX30009_process::process()
@@ -106,6 +241,8 @@ void MAX30009_process::process()
         return;
     }
 
+    uint64_t write_seq=_IFIFO.get_write_seq();
+    bool is_FIFO_empty=false;
     for (uint32_t i=0; i<128; i++)
     {
         MAX30009_FIFO_DATA fd1= {0},fd2= {0};
@@ -113,29 +250,27 @@ void MAX30009_process::process()
 
         if (fd1.data_source!=MAX30009_ERROR_DATA_SOURCE && fd2.data_source!=MAX30009_ERROR_DATA_SOURCE)
         {
-            _IFIFO_write_pos=(_IFIFO_write_pos+1)%_max_IFIFO_size ;
-            if (_IFIFO_write_pos==_IFIFO_read_pos)
-            {
-                _IFIFO_read_pos=(_IFIFO_read_pos+1)%_max_IFIFO_size ;
-            }
-
+            MAX30009_IFIFO_DATA_TDS item= {0,0};
             if (fd1.data_source==MAX30009_I_CHANNEL)
             {
-                _IFIFO_BUF[_IFIFO_write_pos].I_data=fd1.channel_value;
+                item.I_data=fd1.channel_value;
             }
             else if (fd1.data_source==MAX30009_Q_CHANNEL)
             {
-                _IFIFO_BUF[_IFIFO_write_pos].Q_data=fd1.channel_value;
+                item.Q_data=fd1.channel_value;
             }
 
             if (fd2.data_source==MAX30009_I_CHANNEL)
             {
-                _IFIFO_BUF[_IFIFO_write_pos].I_data=fd2.channel_value;
+                item.I_data=fd2.channel_value;
             }
             else if (fd2.data_source==MAX30009_Q_CHANNEL)
             {
-                _IFIFO_BUF[_IFIFO_write_pos].Q_data=fd2.channel_value;
+                item.Q_data=fd2.channel_value;
             }
+            _IFIFO.push(item);
+            int32_t values[RAW_CHANNELS_COUNT]= {item.I_data,item.Q_data};
+            _taps.push(values);
 //            MAX30009_CALIB_DATA_TYPE calibrate_koef=_calibrate_data[MAX30009_user_sett.stimulate_current_select][MAX30009_user_sett.stimulate_frequency];
 //            MAX30009.calculate_impendance(&fd1,calibrate_koef);
 //            MAX30009.calculate_impendance(&fd2,calibrate_koef);
@@ -144,10 +279,36 @@ void MAX30009_process::process()
         }
         else
         {
+            is_FIFO_empty=true;
             break;
         }
     }
 
+    //block is stamped only when FIFO is drained, then its last sample is newest
+    if (is_FIFO_empty==true && _IFIFO.get_write_seq()!=write_seq)
+    {
+        _clock_model.add_block(_IFIFO.get_write_seq(),Sample_clock_model::get_monotonic_ns());
+        update_preview();
+    }
+}
+
+void MAX30009_process::update_preview(void)
+{
+    //points of overwritten samples are skipped
+    _preview_seq=std::max(_preview_seq,_IFIFO.get_oldest_seq());
+    get_decimate_IFIFO_data(_preview_seq,0,&_preview_seq,&_preview_data);
+    for (const MAX30009_FIFO_DATA_CALIB_TYPE& item : _preview_data)
+    {
+        int32_t values[PREVIEW_CHANNELS_COUNT]=
+        {
+            (int32_t)(item.Load_real*10000.0),
+            (int32_t)(item.Load_mag*10000.0),
+            (int32_t)(item.Load_imag*10000.0),
+            (int32_t)(item.Load_angle*10000.0),
+            (int32_t)item.overload
+        };
+        _preview.push(values);
+    }
 }
 
 void MAX30009_process::add_sync_mark(int32_t sync_num)
@@ -162,14 +323,7 @@ void MAX30009_process::add_sync_mark(int32_t sync_num)
         return;
     }
 
-    _IFIFO_write_pos=(_IFIFO_write_pos+1)%_max_IFIFO_size ;
-    if (_IFIFO_write_pos==_IFIFO_read_pos)
-    {
-        _IFIFO_read_pos=(_IFIFO_read_pos+1)%_max_IFIFO_size ;
-    }
-
-    _IFIFO_BUF[_IFIFO_write_pos].I_data=SYNC_MARK_MAGIC_NUM;
-    _IFIFO_BUF[_IFIFO_write_pos].Q_data=sync_num;
+    _sync_marks.add(_IFIFO.get_write_seq(),sync_num);
 }
 
 std::string MAX30009_process::calibration_process(void)
@@ -178,8 +332,7 @@ std::string MAX30009_process::calibration_process(void)
     if (_need_calibrate==false)
     {
         MAX30009.stop_calibrate();
-        _calibrate_current_index=0;
-        _calibrate_freq_index=0;
+        _calibrate_queue_pos=0;
         return "";
     }
     set_power_state(true);
@@ -240,6 +393,9 @@ std::string MAX30009_process::calibration_process(void)
         case MAX30009_CALIB_STATE_CALCULATE_COEF:
             std::cout << "MAX30009_CALIB_STATE_CALCULATE_COEF";
             break;
+        case MAX30009_CALIB_STATE_MEAS_VERIFY:
+            std::cout << "MAX30009_CALIB_STATE_MEAS_VERIFY";
+            break;
         case MAX30009_CALIB_STATE_READY:
             std::cout << "MAX30009_CALIB_STATE_READY";
             break;
@@ -266,6 +422,9 @@ std::string MAX30009_process::calibration_process(void)
 
     if (calibrate_state==MAX30009_CALIB_STATE_STOPED)
     {
+        _calibrate_current_index=_calibrate_queue[_calibrate_queue_pos].current_index;
+        _calibrate_freq_index=_calibrate_queue[_calibrate_queue_pos].freq_index;
+
         max30009_ext_MUX_obj.set_calibrate_mode();
         MAX30009.start_calibrate(MAX30009_CALIB_SOURCE_MAINPORT,
                                  CALIB_RESISTOR_VALUE,
@@ -281,30 +440,167 @@ std::string MAX30009_process::calibration_process(void)
     if (calibrate_state==MAX30009_CALIB_STATE_READY)
     {
         //calibrate ready
-        _calibrate_data[_calibrate_current_index][_calibrate_freq_index]=MAX30009.get_last_calib_data();
-        std::string filename = "calib/" +  std::to_string(_calibrate_current_index) + "_" +  std::to_string(_calibrate_freq_index) + ".json";
-        std::filesystem::create_directories("calib/");
-        save_string_to_file(filename,get_calibration_json_data(MAX30009.get_last_calib_data()));
+        MAX30009_CALIB_DATA calib_koef=MAX30009.get_last_calib_data();
+        calib_koef.calibrate_time=time(nullptr);
+        _calibrate_data[_calibrate_current_index][_calibrate_freq_index]=calib_koef;
+        _calib_store.set_calib_data(_calibrate_current_index,_calibrate_freq_index,calib_koef);
+        save_calibration();
         MAX30009.stop_calibrate();
+        build_calibration_interp();
+
+        _calibrate_queue_pos++;
+        if (_calibrate_queue_pos>=_calibrate_queue_size)
+        {
+            //calibrate is finish
+            _need_calibrate=false;
+            process_all_settings_for_MAX30009();
+            process_ext_MUX_settings_for_MAX30009();
+        }
+        return get_calibration_json_data(calib_koef);
+    }
+    return "";
+
+}
+
+void MAX30009_process::fill_full_calibrate_queue(void)
+{
+    //frequency is outer loop: PLL relock only when frequency is changed
+    _calibrate_queue_size=0;
+    for (uint32_t j=0; j<FREQ_POINTS_COUNT; j++)
+    {
+        for (uint32_t i=0; i<CURRENT_POINTS_COUNT; i++)
+        {
+            _calibrate_queue[_calibrate_queue_size].current_index=i;
+            _calibrate_queue[_calibrate_queue_size].freq_index=j;
+            _calibrate_queue_size++;
+        }
+    }
+    _calibrate_queue_pos=0;
+}
 
-        _calibrate_freq_index++;
-        if (_calibrate_freq_index>=FREQ_POINTS_COUNT)
+bool MAX30009_process::fill_recalibrate_queue(const nlohmann::json& command_json)
+{
+    bool selected[CURRENT_POINTS_COUNT][FREQ_POINTS_COUNT]= {};
+
+    if (command_json.contains("points"))
+    {
+        //selected points
+        for (const nlohmann::json& point : command_json["points"])
+        {
+            if (point.contains("stimulate_current")==false || point.contains("stimulate_frequency")==false)
+            {
+                continue;
+            }
+            uint32_t current_index=point["stimulate_current"];
+            uint32_t freq_index=point["stimulate_frequency"];
+            if (current_index<CURRENT_POINTS_COUNT && freq_index<FREQ_POINTS_COUNT)
+            {
+                selected[current_index][freq_index]=true;
+            }
+        }
+    }
+    else if (command_json.contains("max_age_s") || command_json.contains("max_residual") || command_json.contains("max_noise"))
+    {
+        //points which are not calibrated or out of limits
+        int64_t now=time(nullptr);
+        for (uint32_t i=0; i<CURRENT_POINTS_COUNT; i++)
+        {
+            for (uint32_t j=0; j<FREQ_POINTS_COUNT; j++)
+            {
+                MAX30009_CALIB_DATA calib_koef;
+                if (_calib_store.get_calib_data(i,j,&calib_koef)==false)
+                {
+                    selected[i][j]=true;
+                    continue;
+                }
+                if (command_json.contains("max_age_s") && now-calib_koef.calibrate_time>command_json["max_age_s"].get<int64_t>())
+                {
+                    selected[i][j]=true;
+                }
+                if (command_json.contains("max_residual") && fabs(calib_koef.residual)>command_json["max_residual"].get<double>())
+                {
+                    selected[i][j]=true;
+                }
+                if (command_json.contains("max_noise") &&
+                        (calib_koef.I_noise>command_json["max_noise"].get<double>() || calib_koef.Q_noise>command_json["max_noise"].get<double>()))
+                {
+                    selected[i][j]=true;
+                }
+            }
+        }
+    }
+    else
+    {
+        //point in use
+        uint32_t current_index=MAX30009_user_sett.stimulate_current_select;
+        if (current_index<CURRENT_POINTS_COUNT && _use_drive_frequency==true)
         {
-            _calibrate_freq_index=0;
-            _calibrate_current_index++;
-            if (_calibrate_current_index>=CURRENT_POINTS_COUNT)
+            //drive frequency is interpolated between calibrated points around it
+            for (uint32_t j=0; j<FREQ_POINTS_COUNT; j++)
             {
-                //calibrate is finish
-                _need_calibrate=false;
-                process_all_settings_for_MAX30009();
-                process_ext_MUX_settings_for_MAX30009();
+                bool is_lower=FREQ_POINTS[j]<=MAX30009_user_sett.drive_frequency &&
+                              (j+1==FREQ_POINTS_COUNT || FREQ_POINTS[j+1]>MAX30009_user_sett.drive_frequency);
+                bool is_upper=FREQ_POINTS[j]>=MAX30009_user_sett.drive_frequency &&
+                              (j==0 || FREQ_POINTS[j-1]<MAX30009_user_sett.drive_frequency);
+                if (is_lower==true || is_upper==true)
+                {
+                    selected[current_index][j]=true;
+                }
+            }
+        }
+        else if (current_index<CURRENT_POINTS_COUNT && MAX30009_user_sett.stimulate_frequency<FREQ_POINTS_COUNT)
+        {
+            selected[current_index][MAX30009_user_sett.stimulate_frequency]=true;
+        }
+    }
 
+    //frequency is outer loop: PLL relock only when frequency is changed
+    _calibrate_queue_size=0;
+    for (uint32_t j=0; j<FREQ_POINTS_COUNT; j++)
+    {
+        for (uint32_t i=0; i<CURRENT_POINTS_COUNT; i++)
+        {
+            if (selected[i][j]==true)
+            {
+                _calibrate_queue[_calibrate_queue_size].current_index=i;
+                _calibrate_queue[_calibrate_queue_size].freq_index=j;
+                _calibrate_queue_size++;
             }
         }
-        return get_calibration_json_data(MAX30009.get_last_calib_data());
     }
-    return "";
+    _calibrate_queue_pos=0;
+    return _calibrate_queue_size>0;
+}
+
+std::string MAX30009_process::get_calibration_quality_as_json(void)
+{
+    int64_t now=time(nullptr);
+    nlohmann::json response_json;
+    response_json["type"] = "calibration_quality";
+    response_json["bad_store_file"] = _is_calib_store_bad ? CALIB_STORE_BAD_FILENAME : "";
 
+    nlohmann::json points_array = nlohmann::json::array();
+    for (uint32_t i=0; i<CURRENT_POINTS_COUNT; i++)
+    {
+        for (uint32_t j=0; j<FREQ_POINTS_COUNT; j++)
+        {
+            MAX30009_CALIB_DATA calib_koef;
+            nlohmann::json point_json;
+            point_json["stimulate_current"] = i;
+            point_json["stimulate_frequency"] = j;
+            point_json["valid"] = _calib_store.get_calib_data(i,j,&calib_koef);
+            if (point_json["valid"]==true)
+            {
+                point_json["age_s"] = (calib_koef.calibrate_time>0) ? now-calib_koef.calibrate_time : -1;
+                point_json["I_noise"] = calib_koef.I_noise;
+                point_json["Q_noise"] = calib_koef.Q_noise;
+                point_json["residual"] = calib_koef.residual;
+            }
+            points_array.push_back(point_json);
+        }
+    }
+    response_json["points"] = points_array;
+    return response_json.dump();
 }
 
 bool MAX30009_process::save_string_to_file(const std::string& filename, const std::string& data)
@@ -326,8 +622,14 @@ bool MAX30009_process::save_string_to_file(const std::string& filename, const st
 
 std::string MAX30009_process::get_calibration_json_data(MAX30009_CALIB_DATA calib_koef)
 {
-    nlohmann::json response_json;
+    nlohmann::json response_json=get_calibration_json(calib_koef);
     response_json["type"] = "calib_data";
+    return response_json.dump();
+}
+
+nlohmann::json MAX30009_process::get_calibration_json(MAX30009_CALIB_DATA calib_koef)
+{
+    nlohmann::json response_json;
     for (uint32_t i=0; i<FREQ_POINTS_COUNT; i++)
     {
         if (FREQ_POINTS[i]==calib_koef.calibrate_frequency)
@@ -361,7 +663,74 @@ std::string MAX30009_process::get_calibration_json_data(MAX30009_CALIB_DATA cali
 
     response_json["Q_cal_in"] =calib_koef.Q_cal_in;
     response_json["Q_cal_in_ADC"] =calib_koef.Q_cal_in_ADC;
-    response_json["Q_cal_quad"] =calib_koef.I_cal_quad;
+    response_json["Q_cal_quad"] =calib_koef.Q_cal_quad;
+
+    response_json["I_noise"] =calib_koef.I_noise;
+    response_json["Q_noise"] =calib_koef.Q_noise;
+    response_json["residual"] =calib_koef.residual;
+    response_json["calibrate_time"] =calib_koef.calibrate_time;
+    return response_json;
+}
+
+std::string MAX30009_process::export_calibration_as_json(void)
+{
+    nlohmann::json response_json;
+    response_json["type"] = "calibration";
+    response_json["board_id"] = _calib_store.get_board_id();
+
+    nlohmann::json points_array = nlohmann::json::array();
+    for (uint32_t i=0; i<CURRENT_POINTS_COUNT; i++)
+    {
+        for (uint32_t j=0; j<FREQ_POINTS_COUNT; j++)
+        {
+            MAX30009_CALIB_DATA calib_koef;
+            if (_calib_store.get_calib_data(i,j,&calib_koef)==true)
+            {
+                points_array.push_back(get_calibration_json(calib_koef));
+            }
+        }
+    }
+    response_json["points"] = points_array;
+    return response_json.dump();
+}
+
+std::string MAX30009_process::import_calibration_from_json(const nlohmann::json& calib_json)
+{
+    if (calib_json.contains("points")==false || calib_json["points"].is_array()==false)
+    {
+        return "{\"type\":\"error JSON\"}";
+    }
+
+    uint32_t import_count=0;
+    for (const nlohmann::json& point : calib_json["points"])
+    {
+        if (point.contains("stimulate_current")==false || point.contains("stimulate_frequency")==false)
+        {
+            continue;
+        }
+        uint32_t current_index=point["stimulate_current"];
+        uint32_t freq_index=point["stimulate_frequency"];
+        if (current_index>=CURRENT_POINTS_COUNT || freq_index>=FREQ_POINTS_COUNT)
+        {
+            continue;
+        }
+
+        MAX30009_CALIB_DATA calib_koef= {};
+        get_calib_koef_from_json(point,&calib_koef);
+        calib_koef.calibrate_current=CURRENT_POINTS[current_index];
+        calib_koef.calibrate_frequency=FREQ_POINTS[freq_index];
+        _calibrate_data[current_index][freq_index]=calib_koef;
+        _calib_store.set_calib_data(current_index,freq_index,calib_koef);
+        import_count++;
+    }
+
+    build_calibration_interp();
+    update_active_calib_data();
+
+    nlohmann::json response_json;
+    response_json["type"] = "calibration_imported";
+    response_json["points_count"] = import_count;
+    response_json["saved"] = save_calibration();
     return response_json.dump();
 }
 
@@ -369,94 +738,207 @@ std::string MAX30009_process::process_JSON_line(const char * JSON_line)
 {
     std::cout << "IN:" << JSON_line << std::endl << std::endl;
 
-    json parsed_json;
-    json response;
+    //new command cancels waiting data request, client waits response for new command
+    _is_data_request_pending=false;
+    //binary part of response which was not sent is dropped
+    clear_attachment();
+
+    //settings are decoded to copy and applied only for valid settings command
+    MAX30009_USER_SETTINGS_TDE new_sett=MAX30009_user_sett;
+    std::string_view command_type;
+    std::string_view key;
+    DATA_REQUEST_TDS data_request= {false,0,0,0,0};
+    uint32_t preview_width=DEFAULT_PREVIEW_WIDTH;
+    uint32_t preview_duration_ms=DEFAULT_PREVIEW_DURATION_MS;
+    TAP_SETTINGS_TDS tap_settings= {"",TAP_RAW_SOURCE,TAP_FILTER_MEAN,0,0};
+    std::string_view tap_name;
+    std::string_view tap_source=TAP_RAW_SOURCE;
+    std::string_view tap_filter=TAP_FILTER_NAMES[TAP_FILTER_MEAN];
+    bool need_raw_header=false;
+
+    JSON_command_parser parser(JSON_line);
+    if (parser.begin_object()==true)
+    {
+        while (parser.next_key(&key)==true)
+        {
+            if (key=="type") parser.read_string(&command_type);
+            else if (key=="stimulate_frequency") parser.read_number(&new_sett.stimulate_frequency);
+            else if (key=="drive_frequency") parser.read_number(&new_sett.drive_frequency);
+            else if (key=="measure_frequency") parser.read_number(&new_sett.measure_frequency);
+            else if (key=="out_LP_filter") parser.read_number(&new_sett.out_LP_filter_select);
+            else if (key=="out_HP_filter") parser.read_number(&new_sett.out_HP_filter_select);
+            else if (key=="stimulate_current") parser.read_number(&new_sett.stimulate_current_select);
+            else if (key=="measure_enable") parser.read_bool(&new_sett.measure_enable);
+            else if (key=="power_enable") parser.read_bool(&new_sett.power_enable);
+            else if (key=="ext_MUX_state") parser.read_number(&new_sett.ext_MUX_state);
+            else if (key=="from_seq")
+            {
+                parser.read_number(&data_request.from_seq);
+                data_request.use_cursor=true;
+            }
+            else if (key=="max_samples") parser.read_number(&data_request.max_samples);
+            else if (key=="min_samples") parser.read_number(&data_request.min_samples);
+            else if (key=="timeout_ms") parser.read_number(&data_request.timeout_ms);
+            else if (key=="width") parser.read_number(&preview_width);
+            else if (key=="duration_ms") parser.read_number(&preview_duration_ms);
+            else if (key=="tap") parser.read_string(&tap_name);
+            else if (key=="source") parser.read_string(&tap_source);
+            else if (key=="filter") parser.read_string(&tap_filter);
+            else if (key=="decimation") parser.read_number(&tap_settings.decimation);
+            else if (key=="rate") parser.read_number(&tap_settings.rate);
+            else if (key=="header") parser.read_bool(&need_raw_header);
+            else parser.skip_value();
+        }
+    }
 
-    try
+    if (parser.is_finished()==false)
     {
-        parsed_json = json::parse(JSON_line);
+        return "{\"type\":\"error JSON\"}";
+    }
 
-        if (parsed_json.contains("type"))
+    if (command_type == "settings")
+    {
+        if (_need_calibrate==true)
         {
+            return "{\"type\":\"calibrate_runing\"}";
+        }
+        MAX30009_user_sett=new_sett;
+        process_ext_MUX_settings_for_MAX30009();
+        process_all_settings_for_MAX30009();
+        process_all_settings_for_MAX30009();
+        process_all_settings_for_MAX30009();
+        process_all_settings_for_MAX30009();
+        return get_all_settings_as_json();
+    }
 
-            std::string command_type = parsed_json["type"];
+    if (command_type == "get_data")
+    {
+        if (_need_calibrate==true)
+        {
+            return "{\"type\":\"calibrate_runing\"}";
+        }
+        //response is sent by process_pending_data_request() without copy, request without min_samples is sent
+        //in the same loop
+        if (data_request.min_samples==0 || data_request.timeout_ms==0)
+        {
+            data_request.min_samples=0;
+        }
+        _pending_data_request=data_request;
+        _pending_data_deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(std::min(data_request.timeout_ms,DATA_REQUEST_MAX_TIMEOUT_MS));
+        _is_data_request_pending=true;
+        return "";
+    }
+    if (command_type == "get_preview")
+    {
+        return get_preview_as_json(preview_width,preview_duration_ms);
+    }
+    if (command_type == "add_tap")
+    {
+        tap_settings.name=tap_name;
+        tap_settings.source=tap_source;
+        if (get_tap_filter(tap_filter,&tap_settings.filter)==false || _taps.add(tap_settings,_IFIFO.get_write_seq())==false)
+        {
+            return "{\"type\":\"error tap\"}";
+        }
+        command_type="get_taps";
+    }
+    if (command_type == "remove_tap")
+    {
+        if (_taps.remove(tap_name)==false)
+        {
+            return "{\"type\":\"error tap\"}";
+        }
+        command_type="get_taps";
+    }
+    if (command_type == "get_taps")
+    {
+        _json_writer.clear();
+        _taps.write_taps_json(&_json_writer);
+        return _json_writer.get_string();
+    }
+    if (command_type == "get_tap_data")
+    {
+        if (_need_calibrate==true)
+        {
+            return "{\"type\":\"calibrate_runing\"}";
+        }
+        return get_tap_data_as_json(tap_name,data_request);
+    }
+    if (command_type == "get_raw_data")
+    {
+        if (_need_calibrate==true)
+        {
+            return "{\"type\":\"calibrate_runing\"}";
+        }
+        return get_raw_data_as_json(data_request,need_raw_header);
+    }
+    if (command_type == "start_calibrate")
+    {
+        _need_calibrate=true;
+        fill_full_calibrate_queue();
+        MAX30009.reset_calibrate_sequence();
+        return "{\"type\":\"calibrate_started\"}";
+    }
+    if (command_type == "get_calibration_quality")
+    {
+        return get_calibration_quality_as_json();
+    }
+    if (command_type == "export_calibration")
+    {
+        return export_calibration_as_json();
+    }
+    if (command_type == "recalibrate" || command_type == "import_calibration")
+    {
+        if (_need_calibrate==true)
+        {
+            return "{\"type\":\"calibrate_runing\"}";
+        }
+        return process_calibration_JSON_command(JSON_line);
+    }
+    if (command_type == "stop_calibrate")
+    {
+        if (_need_calibrate==true)
+        {
+            //PLL is kept locked between calibrate points, restore user settings
+            _need_calibrate=false;
+            MAX30009.stop_calibrate();
+            process_all_settings_for_MAX30009();
+            process_ext_MUX_settings_for_MAX30009();
+        }
+        _calibrate_queue_pos=0;
+        return "{\"type\":\"calibrate_stoped\"}";
+    }
 
-            if (command_type == "settings")
-            {
-                if (_need_calibrate==true)
-                {
-                    return "{\"type\":\"calibrate_runing\"}";
-                }
-                if (parsed_json.contains("stimulate_frequency"))
-                {
-                    MAX30009_user_sett.stimulate_frequency=parsed_json["stimulate_frequency"];
-                }
-                if (parsed_json.contains("measure_frequency"))
-                {
-                    MAX30009_user_sett.measure_frequency=parsed_json["measure_frequency"];
-                }
-                if (parsed_json.contains("out_LP_filter"))
-                {
-                    MAX30009_user_sett.out_LP_filter_select = parsed_json["out_LP_filter"];
-                }
-                if (parsed_json.contains("out_HP_filter"))
-                {
-                    MAX30009_user_sett.out_HP_filter_select = parsed_json["out_HP_filter"];
-                }
+    return "{\"type\":\"error JSON\"}";
+}
 
-                if (parsed_json.contains("stimulate_current"))
-                {
-                    MAX30009_user_sett.stimulate_current_select = parsed_json["stimulate_current"];
-                }
-                if (parsed_json.contains("measure_enable"))
-                {
-                    MAX30009_user_sett.measure_enable = parsed_json["measure_enable"];
-                }
+std::string MAX30009_process::process_calibration_JSON_command(const char * JSON_line)
+{
+    //calibration tooling commands with point lists, not time critical, full JSON parse
+    json parsed_json;
+    json response;
 
-                if (parsed_json.contains("power_enable"))
-                {
-                    MAX30009_user_sett.power_enable = parsed_json["power_enable"];
-                }
-                if (parsed_json.contains("ext_MUX_state"))
-                {
-                    MAX30009_user_sett.ext_MUX_state = parsed_json["ext_MUX_state"];
-                }
-                process_ext_MUX_settings_for_MAX30009();
-                process_all_settings_for_MAX30009();
-                process_all_settings_for_MAX30009();
-                process_all_settings_for_MAX30009();
-                process_all_settings_for_MAX30009();
-                return get_all_settings_as_json();
-            }
+    try
+    {
+        parsed_json = json::parse(JSON_line);
+        std::string command_type = parsed_json["type"];
 
-            if (command_type == "get_data")
-            {
-                if (_need_calibrate==true)
-                {
-                    return "{\"type\":\"calibrate_runing\"}";
-                }
-                return get_data_as_json();
-            }
-            if (command_type == "start_calibrate")
-            {
-                _need_calibrate=true;
-                _calibrate_current_index=0;
-                _calibrate_freq_index=0;
-                return "{\"type\":\"calibrate_started\"}";
-            }
-            if (command_type == "stop_calibrate")
+        if (command_type == "recalibrate")
+        {
+            if (fill_recalibrate_queue(parsed_json)==false)
             {
-                _need_calibrate=false;
-                _calibrate_current_index=0;
-                _calibrate_freq_index=0;
-                return "{\"type\":\"calibrate_stoped\"}";
+                return "{\"type\":\"calibrate_not_needed\"}";
             }
+            _need_calibrate=true;
+            MAX30009.reset_calibrate_sequence();
+            response["type"] = "calibrate_started";
+            response["points_count"] = _calibrate_queue_size;
+            return response.dump();
         }
-        else
+        if (command_type == "import_calibration")
         {
-            response["type"] = "error JSON";
+            return import_calibration_from_json(parsed_json);
         }
-
     }
     catch (const std::exception& e)
     {
@@ -480,45 +962,231 @@ std::string MAX30009_process::get_all_settings_as_json(void)
     response_json["measure_enable"] = MAX30009_user_sett.measure_enable;
     response_json["power_enable"] = MAX30009_user_sett.power_enable;
     response_json["ext_MUX_state"] = MAX30009_user_sett.ext_MUX_state;
+    response_json["drive_frequency"] = MAX30009_user_sett.drive_frequency;
+    response_json["actual_drive_frequency"] = MAX30009.get_all_frequency().BIOZ_DRIVE_FREQ/10.0;
     return response_json.dump();
 }
 
-std::string MAX30009_process::get_data_as_json(void)
+float MAX30009_process::get_decimation_ratio(void)
 {
-    std::vector<MAX30009_FIFO_DATA_CALIB_TYPE> decimated_data = get_decimate_IFIFO_data();
+    if (MAX30009_user_sett.measure_frequency==0)
+    {
+        return 0;
+    }
+    return (float)MAX30009.get_all_frequency().BIOZ_ADC_SAMPLE_RATE / ((float)MAX30009_user_sett.measure_frequency*10.0);
+}
 
-    nlohmann::json response_json;
-    response_json["type"] = "data";
-    response_json["data_frequency"] = MAX30009_user_sett.measure_frequency;
-    response_json["data_size"] = decimated_data.size();
-    response_json["timestamp"] =get_timestamp_string();
+//count of decimated points which can be read
+uint32_t MAX30009_process::get_available_samples(const DATA_REQUEST_TDS& request)
+{
+    float decimation_ratio = get_decimation_ratio();
+    if (decimation_ratio<1)
+    {
+        return 0;
+    }
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = _IFIFO.get_first_seq();
+    }
+    uint64_t write_seq = _IFIFO.get_write_seq();
+    return (float)(write_seq-std::clamp(from_seq,_IFIFO.get_oldest_seq(),write_seq))/decimation_ratio;
+}
+
+const std::string& MAX30009_process::process_pending_data_request(void)
+{
+    _data_response.clear();
+    if (_is_data_request_pending==false)
+    {
+        return _data_response;
+    }
+    if (get_available_samples(_pending_data_request)<_pending_data_request.min_samples &&
+        std::chrono::steady_clock::now()<_pending_data_deadline)
+    {
+        return _data_response;
+    }
+    _is_data_request_pending=false;
+    if (_need_calibrate==true)
+    {
+        _data_response="{\"type\":\"calibrate_runing\"}";
+        return _data_response;
+    }
+    return get_data_as_json(_pending_data_request);
+}
 
-    nlohmann::json data_array = nlohmann::json::array();
+bool MAX30009_process::is_data_request_pending(void)
+{
+    return _is_data_request_pending;
+}
+
+void MAX30009_process::cancel_data_request(void)
+{
+    _is_data_request_pending=false;
+}
+
+Sample_clock_model& MAX30009_process::get_clock_model(void)
+{
+    return _clock_model;
+}
+
+uint64_t MAX30009_process::get_oldest_seq(void)
+{
+    return _IFIFO.get_oldest_seq();
+}
+
+uint64_t MAX30009_process::get_write_seq(void)
+{
+    return _IFIFO.get_write_seq();
+}
 
+bool MAX30009_process::is_measure_running(void)
+{
+    return MAX30009_user_sett.measure_enable==true && _need_calibrate==false;
+}
+
+Sync_mark_index& MAX30009_process::get_sync_marks(void)
+{
+    return _sync_marks;
+}
+
+uint32_t MAX30009_process::get_settings_version(void)
+{
+    return _settings_version;
+}
+
+const std::string& MAX30009_process::get_data_as_json(const DATA_REQUEST_TDS& request)
+{
+#ifdef ALLOC_COUNTER
+    uint64_t alloc_count=get_thread_alloc_count();
+#endif
+
+    //reader with cursor does not change ring, default reader continues from last read
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = _IFIFO.skip_overwritten();
+    }
+    uint64_t first_seq = std::clamp(from_seq,_IFIFO.get_oldest_seq(),_IFIFO.get_write_seq());
+    uint64_t next_seq = first_seq;
+    std::vector<MAX30009_FIFO_DATA_CALIB_TYPE>& decimated_data = _decimated_data;
+    get_decimate_IFIFO_data(first_seq,request.max_samples,&next_seq,&decimated_data);
+    if (request.use_cursor==false)
+    {
+        _IFIFO.set_read_seq(next_seq);
+    }
+
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","data");
+    _json_writer.key_value("data_frequency",MAX30009_user_sett.measure_frequency);
+    _json_writer.key_value("data_size",decimated_data.size());
+    int64_t realtime_ns=Timestamp_formatter::get_realtime_ns();
+    _json_writer.key_value("timestamp",_timestamp_formatter.format(realtime_ns));
+    _json_writer.key_value("timestamp_ns",realtime_ns);
+    _json_writer.key_value("monotonic_ns",Sample_clock_model::get_monotonic_ns());
+    if (request.use_cursor==true)
+    {
+        _json_writer.key_value("skipped_samples",first_seq>from_seq ? first_seq-from_seq : (uint64_t)0);
+    }
+    else
+    {
+        _json_writer.key_value("lost_samples",_IFIFO.get_overflow_count());
+    }
+    _json_writer.key_value("first_seq",first_seq);
+    _json_writer.key_value("next_seq",next_seq);
+    //time of data[0] is middle of its ADC samples (CLOCK_MONOTONIC), sample_rate is rate of data points
+    float decimation_ratio = get_decimation_ratio();
+    if (decimation_ratio<1)
+    {
+        decimation_ratio=1;
+    }
+    _json_writer.key_value("first_sample_time_ns",_clock_model.get_time_ns((double)first_seq+((uint32_t)decimation_ratio-1)/2.0));
+    _json_writer.key_value("sample_rate",_clock_model.get_rate()/decimation_ratio);
+
+    _json_writer.key("data");
+    _json_writer.begin_array();
     for (uint32_t i = 0; i < decimated_data.size(); ++i)
     {
         MAX30009_FIFO_DATA_CALIB_TYPE& item = decimated_data[i];
 
-        nlohmann::json point_array = nlohmann::json::array();
-
         int32_t load_real=item.Load_real*10000.0;
         int32_t load_mag=item.Load_mag*10000.0;
         int32_t load_imag=item.Load_imag*10000.0;
         int32_t load_angle=item.Load_angle*10000.0;
 
-        point_array.push_back(load_real);
-        point_array.push_back(load_mag);
-        point_array.push_back(load_imag);
-        point_array.push_back(load_angle);
-        point_array.push_back((int32_t)item.overload);
-
-        data_array.push_back(point_array);
+        _json_writer.begin_array();
+        _json_writer.value(load_real);
+        _json_writer.value(load_mag);
+        _json_writer.value(load_imag);
+        _json_writer.value(load_angle);
+        _json_writer.value((int32_t)item.overload);
+        _json_writer.end_array();
     }
+    _json_writer.end_array();
 
-    response_json["data"] = data_array;
-    return response_json.dump();
+    //mark position is index of first decimated point after mark in data array
+    _json_writer.key("sync_marks");
+    _json_writer.begin_array();
+    for (uint32_t i = 0; i < _decimated_sync_marks.size(); ++i)
+    {
+        _json_writer.begin_object();
+        _json_writer.key_value("position",_decimated_sync_marks[i].position);
+        _json_writer.key_value("sync_num",_decimated_sync_marks[i].mark.sync_num);
+        _json_writer.key_value("time_ms",_decimated_sync_marks[i].mark.time_ms);
+        _json_writer.end_object();
+    }
+    _json_writer.end_array();
+#ifdef ALLOC_COUNTER
+    //heap allocations of this response, 0 when buffers have capacity
+    _json_writer.key_value("allocations",get_thread_alloc_count()-alloc_count);
+#endif
+    _json_writer.end_object();
+    return _json_writer.get_string();
 }
 
+std::string MAX30009_process::get_preview_as_json(uint32_t width, uint32_t duration_ms)
+{
+    float decimation_ratio = get_decimation_ratio();
+    if (decimation_ratio<1)
+    {
+        decimation_ratio=1;
+    }
+    uint64_t window_samples=(uint64_t)MAX30009_user_sett.measure_frequency*std::min(duration_ms,PREVIEW_DURATION*1000)/1000;
+    ENVELOPE_PREVIEW_TDS preview;
+    _preview.get_preview(width,window_samples,&preview);
+
+    //raw sample of point is counted back from cursor of pyramid
+    double first_seq=(double)_preview_seq-(double)(_preview.get_write_seq()-preview.first_seq)*decimation_ratio;
+
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","preview");
+    _json_writer.key_value("width",preview.width);
+    _json_writer.key_value("samples_per_pixel",preview.samples_per_pixel);
+    _json_writer.key_value("level_ratio",preview.level_ratio);
+    _json_writer.key_value("first_seq",preview.first_seq);
+    _json_writer.key_value("next_seq",preview.next_seq);
+    _json_writer.key_value("first_sample_time_ns",_clock_model.get_time_ns(first_seq+((uint32_t)decimation_ratio-1)/2.0));
+    _json_writer.key_value("sample_rate",_clock_model.get_rate()/decimation_ratio);
+    //pixel is [min,max,mean] of load_real, then load_mag, load_imag, load_angle and overload
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    for (uint32_t i=0; i<preview.width; i++)
+    {
+        const ENVELOPE_TDS *pixel=&preview.pixels[i*PREVIEW_CHANNELS_COUNT];
+        _json_writer.begin_array();
+        for (uint32_t j=0; j<PREVIEW_CHANNELS_COUNT; j++)
+        {
+            _json_writer.value(pixel[j].min);
+            _json_writer.value(pixel[j].max);
+            _json_writer.value(pixel[j].mean);
+        }
+        _json_writer.end_array();
+    }
+    _json_writer.end_array();
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
 
 void MAX30009_process::process_all_settings_for_MAX30009(void)
 {
@@ -600,19 +1268,27 @@ void MAX30009_process::process_all_settings_for_MAX30009(void)
         MAX30009_user_sett.stimulate_frequency=0;
     }
 
-    MAX30009.set_drive_frequency(FREQ_POINTS[MAX30009_user_sett.stimulate_frequency]*10,MAX30009_user_sett.measure_frequency*10*10);
-
-    for(uint32_t i=10; i<100; i++)
+    _use_drive_frequency=false;
+    if (MAX30009_user_sett.drive_frequency!=0)
     {
-        if(MAX30009_user_sett.measure_frequency*10>MAX30009.get_all_frequency().BIOZ_ADC_SAMPLE_RATE/10)
+        //any drive frequency in calibrated range, clock solution is not in table
+        if (MAX30009_user_sett.drive_frequency<FREQ_POINTS[0])
         {
-            MAX30009.set_drive_frequency(FREQ_POINTS[MAX30009_user_sett.stimulate_frequency]*10,MAX30009_user_sett.measure_frequency*10*i);
+            MAX30009_user_sett.drive_frequency=FREQ_POINTS[0];
         }
-        else
+        if (MAX30009_user_sett.drive_frequency>FREQ_POINTS[FREQ_POINTS_COUNT-1])
         {
-            break;
+            MAX30009_user_sett.drive_frequency=FREQ_POINTS[FREQ_POINTS_COUNT-1];
         }
+        MAX30009_FIND_CLOCKS_STRUCT_TYPE clk_solution=find_measure_clock_solution(MAX30009_user_sett.drive_frequency*10,MAX30009_user_sett.measure_frequency);
+        _use_drive_frequency=MAX30009.set_clock_solution(clk_solution);
+    }
+    if (_use_drive_frequency==false)
+    {
+        MAX30009_user_sett.drive_frequency=0;
+        MAX30009.set_clock_solution(_clk_solution_table[MAX30009_user_sett.stimulate_frequency][MAX30009_user_sett.measure_frequency]);
     }
+    update_active_calib_data();
 
 
     if (MAX30009_user_sett.measure_frequency*10>MAX30009.get_all_frequency().BIOZ_ADC_SAMPLE_RATE)
@@ -640,13 +1316,22 @@ void MAX30009_process::process_all_settings_for_MAX30009(void)
 
     // MAX30009.start_load_all_registers();
 
-    _max_IFIFO_size =(MAX30009.get_all_frequency().BIOZ_ADC_SAMPLE_RATE*IFIFO_BUFFER_DURATION)/10;
-    if (_max_IFIFO_size>IFIFO_BUFF_SIZE)
+    uint32_t IFIFO_size =(MAX30009.get_all_frequency().BIOZ_ADC_SAMPLE_RATE*IFIFO_BUFFER_DURATION)/10;
+    if (IFIFO_size>IFIFO_BUFF_SIZE)
     {
-        _max_IFIFO_size=IFIFO_BUFF_SIZE;
+        IFIFO_size=IFIFO_BUFF_SIZE;
     }
-    _IFIFO_write_pos=0;
-    _IFIFO_read_pos=0;
+    _IFIFO.resize(IFIFO_size);
+    //all points of ring fit to buffers, they are not reallocated by get_data
+    _decimated_data.reserve(_IFIFO.get_capacity()/std::max(get_decimation_ratio(),1.0f)+1);
+    _decimated_sync_marks.reserve(Sync_mark_index::MARKS_COUNT);
+    _preview.reset((uint64_t)MAX30009_user_sett.measure_frequency*PREVIEW_DURATION,MAX_PREVIEW_WIDTH,0);
+    _preview_seq=_IFIFO.get_write_seq();
+    _sync_marks.clear();
+    _clock_model.reset(MAX30009.get_all_frequency().BIOZ_ADC_SAMPLE_RATE/10.0); // rate is in 1/10 Hertz
+    _taps.reset(_clock_model.get_nominal_rate(),_IFIFO.get_write_seq());
+    _raw_seq=_IFIFO.get_write_seq();
+    _settings_version++;
 
 }
 
@@ -688,95 +1373,161 @@ bool MAX30009_process::check_enumerate_for_value(uint8_t value,const uint8_t *va
 
 
 
-std::vector<MAX30009_FIFO_DATA_CALIB_TYPE>  MAX30009_process::get_decimate_IFIFO_data()
+void MAX30009_process::get_decimate_IFIFO_data(uint64_t first_seq, uint32_t max_points, uint64_t *next_seq, std::vector<MAX30009_FIFO_DATA_CALIB_TYPE> *decimated_data)
 {
+    decimated_data->clear();
+    _decimated_sync_marks.clear();
+    *next_seq=first_seq;
 
-    std::vector<MAX30009_FIFO_DATA_CALIB_TYPE> decimated_data;
-
-    if (_IFIFO_read_pos==_IFIFO_write_pos)
+    uint64_t write_seq=_IFIFO.get_write_seq();
+    if (first_seq>=write_seq)
     {
-        return decimated_data;
+        return;
     }
 
     if (MAX30009_user_sett.measure_frequency==0)
     {
-        return decimated_data;
+        return;
     }
 
-    float decimation_ratio = (float)MAX30009.get_all_frequency().BIOZ_ADC_SAMPLE_RATE / ((float)MAX30009_user_sett.measure_frequency*10.0);
+    float decimation_ratio = get_decimation_ratio();
 
     if (decimation_ratio<1)
     {
-        return decimated_data;
+        return;
     }
 
-    uint32_t decimated_data_position=0;
-    int64_t sum_I = 0;
-    int64_t sum_Q = 0;
-    int32_t sum_count = 0;
-    int32_t sync_number=0;
-
-    for (uint32_t i=0; i<_max_IFIFO_size ; i++)
+    //point k is average of samples from k*ratio to (k+1)*ratio, only full points are read
+    uint32_t mark_index=_sync_marks.find(first_seq);
+    uint64_t seq=first_seq;
+    uint32_t point_end=0;
+    for (uint32_t k=0; max_points==0 || k<max_points; k++)
     {
-        _IFIFO_read_pos=(_IFIFO_read_pos+1)%_max_IFIFO_size ;
-
-        if ((float)i/decimation_ratio>decimated_data_position+1)
+        uint32_t point_start=point_end;
+        point_end=(uint32_t)((float)(k+1)*decimation_ratio);
+        uint32_t point_size=point_end-point_start;
+        if (write_seq-seq<point_size)
         {
-            //need start new data decimate
-            decimated_data_position++;
+            break;
+        }
 
-            MAX30009_FIFO_DATA I_ch_data;
-            MAX30009_FIFO_DATA Q_ch_data;
+        int64_t sum_I = 0;
+        int64_t sum_Q = 0;
+        uint32_t sum_count = 0;
+        MAX30009_IFIFO_DATA_TDS item;
+        while (sum_count<point_size && _IFIFO.read(seq+sum_count,&item)==true)
+        {
+            sum_I=sum_I+item.I_data;
+            sum_Q=sum_Q+item.Q_data;
+            sum_count++;
+        }
+        if (sum_count<point_size)
+        {
+            //samples are overwritten while read
+            break;
+        }
+        seq=seq+point_size;
 
+        //marks before samples of point get position of this point
+        while (mark_index<_sync_marks.get_size() && _sync_marks.get_mark(mark_index).sample_count<seq)
+        {
+            SYNC_MARK_POSITION_TDS sync_mark;
+            sync_mark.position=decimated_data->size();
+            sync_mark.mark=_sync_marks.get_mark(mark_index);
+            _decimated_sync_marks.push_back(sync_mark);
+            mark_index++;
+        }
 
-            I_ch_data.data_source=MAX30009_I_CHANNEL;
-            Q_ch_data.data_source=MAX30009_Q_CHANNEL;
+        decimated_data->push_back(calibrate_point(sum_I/sum_count,sum_Q/sum_count));
+    }
 
-            I_ch_data.channel_value=sum_I/sum_count;
-            Q_ch_data.channel_value=sum_Q/sum_count;
+    *next_seq=seq;
+}
 
-            MAX30009_CALIB_DATA_TYPE calibrate_koef=_calibrate_data[MAX30009_user_sett.stimulate_current_select][MAX30009_user_sett.stimulate_frequency];
-            MAX30009.calculate_impendance(&I_ch_data,calibrate_koef);
-            MAX30009.calculate_impendance(&Q_ch_data,calibrate_koef);
+MAX30009_FIFO_DATA_CALIB_TYPE MAX30009_process::calibrate_point(int32_t I_data, int32_t Q_data)
+{
+    MAX30009_FIFO_DATA I_ch_data;
+    MAX30009_FIFO_DATA Q_ch_data;
 
-            MAX30009_FIFO_DATA_CALIB_TYPE calibrate_data=MAX30009.calibrate_FIFO_data(I_ch_data, Q_ch_data,calibrate_koef);
-            decimated_data.push_back(calibrate_data);
+    I_ch_data.data_source=MAX30009_I_CHANNEL;
+    Q_ch_data.data_source=MAX30009_Q_CHANNEL;
 
-            if (sync_number>0)
-            {
+    I_ch_data.channel_value=I_data;
+    Q_ch_data.channel_value=Q_data;
 
-                MAX30009_FIFO_DATA_CALIB_TYPE sync_data= {0,0,0,0,0,0,0,0,0,0,false};
-                sync_data.Load_real=SYNC_MARK_MAGIC_NUM;
-                sync_data.Load_mag=sync_number;
-                decimated_data.push_back(sync_data);
-                sync_number=0;
-            }
+    MAX30009.calculate_impendance(&I_ch_data,_active_calib_data);
+    MAX30009.calculate_impendance(&Q_ch_data,_active_calib_data);
 
-            sum_I = 0;
-            sum_Q = 0;
-            sum_count = 0;
+    return MAX30009.calibrate_FIFO_data(I_ch_data, Q_ch_data,_active_calib_data);
+}
 
-            int32_t buffer_size = (_IFIFO_write_pos-_IFIFO_read_pos + _max_IFIFO_size) % _max_IFIFO_size;
-            if (buffer_size<decimation_ratio+1)
-            {
-                break;
-            }
-        }
+std::string MAX30009_process::get_tap_data_as_json(std::string_view tap_name, const DATA_REQUEST_TDS& request)
+{
+    Stream_tap<RAW_CHANNELS_COUNT> *tap=_taps.find(tap_name);
+    if (tap==nullptr)
+    {
+        return "{\"type\":\"error tap\"}";
+    }
 
-        if (_IFIFO_BUF[_IFIFO_read_pos].I_data==SYNC_MARK_MAGIC_NUM)
-        {
-            sync_number=_IFIFO_BUF[_IFIFO_read_pos].Q_data;
-        }
-        else
-        {
-            sum_I=sum_I+_IFIFO_BUF[_IFIFO_read_pos].I_data;
-            sum_Q=sum_Q+_IFIFO_BUF[_IFIFO_read_pos].Q_data;
-            sum_count++;
-        }
+    //tap ring is read as device ring: with cursor or by default reader of tap
+    Sample_ring<Stream_tap<RAW_CHANNELS_COUNT>::TAP_SAMPLE_TDS>& ring=tap->get_ring();
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = ring.skip_overwritten();
+    }
+    uint64_t write_seq = ring.get_write_seq();
+    uint64_t first_seq = std::clamp(from_seq,ring.get_oldest_seq(),write_seq);
+    uint64_t end_seq = write_seq;
+    if (request.max_samples!=0 && end_seq-first_seq>request.max_samples)
+    {
+        end_seq = first_seq+request.max_samples;
+    }
 
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","tap_data");
+    _json_writer.key_value("tap",tap->get_settings().name);
+    if (request.use_cursor==true)
+    {
+        _json_writer.key_value("skipped_samples",first_seq>from_seq ? first_seq-from_seq : (uint64_t)0);
+    }
+    else
+    {
+        _json_writer.key_value("lost_samples",ring.get_overflow_count());
     }
 
-    return decimated_data;
+    //points are calibrated as in get_data
+    _json_writer.key("data");
+    _json_writer.begin_array();
+    uint64_t next_seq = first_seq;
+    Stream_tap<RAW_CHANNELS_COUNT>::TAP_SAMPLE_TDS item;
+    while (next_seq<end_seq && ring.read(next_seq,&item)==true)
+    {
+        MAX30009_FIFO_DATA_CALIB_TYPE point=calibrate_point(item[0],item[1]);
+        _json_writer.begin_array();
+        _json_writer.value((int32_t)(point.Load_real*10000.0));
+        _json_writer.value((int32_t)(point.Load_mag*10000.0));
+        _json_writer.value((int32_t)(point.Load_imag*10000.0));
+        _json_writer.value((int32_t)(point.Load_angle*10000.0));
+        _json_writer.value((int32_t)point.overload);
+        _json_writer.end_array();
+        next_seq++;
+    }
+    _json_writer.end_array();
+    _json_writer.key_value("data_size",next_seq-first_seq);
+    _json_writer.key_value("first_seq",first_seq);
+    _json_writer.key_value("next_seq",next_seq);
+    //time of data[0] is middle of its filter
+    _json_writer.key_value("first_sample_time_ns",_clock_model.get_time_ns(tap->get_raw_position(first_seq)));
+    _json_writer.key_value("sample_rate",_clock_model.get_rate()/tap->get_raw_step());
+    _json_writer.end_object();
+
+    if (request.use_cursor==false)
+    {
+        ring.set_read_seq(next_seq);
+    }
+    return _json_writer.get_string();
 }
 
 void MAX30009_process::set_power_state(bool state)
@@ -794,24 +1545,118 @@ void MAX30009_process::set_power_state(bool state)
     }
 }
 
-
-std::string MAX30009_process::get_timestamp_string()
+void MAX30009_process::build_raw_header(void)
 {
-    auto now = std::chrono::system_clock::now();
-    std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-
-    std::tm ptm;
-    gmtime_r(&now_c, &ptm);
-
-    std::stringstream ss;
+    nlohmann::json header_json;
+    header_json["header_version"] = _raw_header_version;
+    header_json["settings_version"] = _settings_version;
+    header_json["adc_sample_rate"] = MAX30009.get_all_frequency().BIOZ_ADC_SAMPLE_RATE/10.0;
+    header_json["word_bits"] = RAW_WORD_BITS;
+    header_json["sample_bytes"] = RAW_SAMPLE_BYTES;
+    header_json["settings"] = nlohmann::json::parse(get_all_settings_as_json());
+    header_json["settings"].erase("type");
+    header_json["calib"] = get_calibration_json(_active_calib_data);
+    _raw_header_json=header_json.dump();
+}
 
-    ss << std::put_time(&ptm, "%Y-%m-%d %H:%M:%S");
+std::string MAX30009_process::get_raw_data_as_json(const DATA_REQUEST_TDS& request, bool need_header)
+{
+    //raw reader with cursor does not change own cursor of raw data
+    uint64_t from_seq = request.from_seq;
+    if (request.use_cursor==false)
+    {
+        from_seq = _raw_seq;
+        if (_raw_seq<_IFIFO.get_oldest_seq())
+        {
+            _raw_lost_samples+=_IFIFO.get_oldest_seq()-_raw_seq;
+        }
+    }
+    uint64_t write_seq = _IFIFO.get_write_seq();
+    uint64_t first_seq = std::clamp(from_seq,_IFIFO.get_oldest_seq(),write_seq);
+    uint64_t end_seq = write_seq;
+    if (request.max_samples!=0 && end_seq-first_seq>request.max_samples)
+    {
+        end_seq = first_seq+request.max_samples;
+    }
 
+    //words are packed as they are read from FIFO, without calibration
+    std::string& data=_raw_attachment.data;
+    data.resize((end_seq-first_seq)*RAW_SAMPLE_BYTES);
+    const uint32_t word_mask=(1<<RAW_WORD_BITS)-1;
+    char *byte=data.data();
+    MAX30009_IFIFO_DATA_TDS item;
+    uint64_t next_seq = first_seq;
+    while (next_seq<end_seq && _IFIFO.read(next_seq,&item)==true)
+    {
+        next_seq++;
+        uint64_t sample=((uint64_t)((uint32_t)item.Q_data & word_mask)<<RAW_WORD_BITS) | ((uint32_t)item.I_data & word_mask);
+        for (uint32_t i=0; i<RAW_SAMPLE_BYTES; i++)
+        {
+            *byte++=sample>>(8*i);
+        }
+    }
+    data.resize((next_seq-first_seq)*RAW_SAMPLE_BYTES);
+    if (request.use_cursor==false)
+    {
+        _raw_seq=next_seq;
+    }
 
-    auto duration = now.time_since_epoch();
-    auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(duration) % 1000;
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","raw_data");
+    _json_writer.key_value("header_version",_raw_header_version);
+    if (need_header==true || (request.use_cursor==false && _raw_sent_header_version!=_raw_header_version))
+    {
+        if (_raw_header_json.empty()==true)
+        {
+            build_raw_header();
+        }
+        _json_writer.key("header");
+        _json_writer.raw_value(_raw_header_json);
+        if (request.use_cursor==false)
+        {
+            _raw_sent_header_version=_raw_header_version;
+        }
+    }
+    if (request.use_cursor==true)
+    {
+        _json_writer.key_value("skipped_samples",first_seq>from_seq ? first_seq-from_seq : (uint64_t)0);
+    }
+    else
+    {
+        _json_writer.key_value("lost_samples",_raw_lost_samples);
+    }
+    _json_writer.key_value("first_seq",first_seq);
+    _json_writer.key_value("next_seq",next_seq);
+    _json_writer.key_value("data_size",next_seq-first_seq);
+    _json_writer.key_value("byte_size",data.size());
+    _json_writer.key_value("first_sample_time_ns",_clock_model.get_time_ns((double)first_seq));
+    _json_writer.key_value("sample_rate",_clock_model.get_rate());
+
+    //mark position is index of sample of mark in binary data
+    _json_writer.key("sync_marks");
+    _json_writer.begin_array();
+    for (uint32_t i=_sync_marks.find(first_seq); i<_sync_marks.get_size() && _sync_marks.get_mark(i).sample_count<next_seq; i++)
+    {
+        const SYNC_MARK_TDS& mark=_sync_marks.get_mark(i);
+        _json_writer.begin_object();
+        _json_writer.key_value("position",mark.sample_count-first_seq);
+        _json_writer.key_value("sync_num",mark.sync_num);
+        _json_writer.key_value("time_ms",mark.time_ms);
+        _json_writer.end_object();
+    }
+    _json_writer.end_array();
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
 
-    ss << "." << std::setfill('0') << std::setw(3) << milliseconds.count();
+void MAX30009_process::move_attachment(TCP_ATTACHMENT_TDS *attachment)
+{
+    attachment->data.swap(_raw_attachment.data);
+    _raw_attachment.data.clear();
+}
 
-    return ss.str();
+void MAX30009_process::clear_attachment(void)
+{
+    _raw_attachment.data.clear();
 }
@@ -0,0 +1,567 @@
+#include "Session_BDF_exporter.h"
+#include "CRC32.h"
+#include "Session_segment_reader.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char *BDF_EXPORT_STATE_NAMES[]= {"idle","running","done","error"};
+static const char *SESSION_DEVICE_NAMES[]= {"ADS1293","MAX30009"};
+static const size_t BDF_RECORDS_COUNT_OFFSET=236;
+
+//text field of BDF header, left aligned and filled by spaces
+static void add_field(std::string *header, const char *text, size_t size)
+{
+    size_t text_size=std::min(strlen(text),size);
+    header->append(text,text_size);
+    header->append(size-text_size,' ');
+}
+
+static void add_number_field(std::string *header, double number, size_t size)
+{
+    char text[32];
+    snprintf(text,sizeof(text),"%.10g",number);
+    add_field(header,text,size);
+}
+
+Session_BDF_exporter::~Session_BDF_exporter()
+{
+    if (_export_thread.joinable()==true)
+    {
+        _export_thread.join();
+    }
+}
+
+bool Session_BDF_exporter::start(const std::string& session_dir, const std::string& filename)
+{
+    if (_state.load(std::memory_order_acquire)==BDF_EXPORT_RUNNING)
+    {
+        return false;
+    }
+    if (_export_thread.joinable()==true)
+    {
+        _export_thread.join();
+    }
+    _session_dir=session_dir;
+    _filename=filename;
+    _state.store(BDF_EXPORT_RUNNING,std::memory_order_release);
+    _export_thread=std::thread(&Session_BDF_exporter::export_process,this);
+    return true;
+}
+
+BDF_EXPORT_STATE_TDE Session_BDF_exporter::get_state(void)
+{
+    return _state.load(std::memory_order_acquire);
+}
+
+const char* Session_BDF_exporter::get_state_name(void)
+{
+    return BDF_EXPORT_STATE_NAMES[get_state()];
+}
+
+const std::string& Session_BDF_exporter::get_filename(void)
+{
+    return _filename;
+}
+
+void Session_BDF_exporter::export_process(void)
+{
+    _ECG= {};
+    _ECG.chunk_type=SESSION_CHUNK_ECG;
+    _ECG.channels=ECG_CHANNELS;
+    _ICG= {};
+    _ICG.chunk_type=SESSION_CHUNK_ICG;
+    _ICG.channels=ICG_CHANNELS;
+    _annotations.clear();
+    _records_count=0;
+    _events_count=0;
+    _last_chunk_ns=0;
+
+    if (scan_session()==false || choose_record_duration()==false)
+    {
+        std::cout << _session_dir << " - no data for export" << std::endl;
+        _state.store(BDF_EXPORT_ERROR,std::memory_order_release);
+        return;
+    }
+
+    _fd=open(_filename.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+    if (_fd<0)
+    {
+        perror("BDF open failed");
+        _state.store(BDF_EXPORT_ERROR,std::memory_order_release);
+        return;
+    }
+
+    bool result=write_header();
+    SESSION_CHUNK_HEADER_TDS header;
+    std::vector<uint8_t> payload;
+    std::vector<uint32_t> segments=Session_segment_reader::list_segments(_session_dir);
+    for (uint32_t i=0; i<segments.size() && result==true; i++)
+    {
+        SESSION_FILE_HEADER_TDS file_header;
+        int segment_fd=open_segment(segments[i],&file_header);
+        if (segment_fd<0)
+        {
+            continue;
+        }
+        //chunk with wrong CRC is end of written data of segment
+        while (result==true && read_chunk(segment_fd,&header,&payload)==true)
+        {
+            add_chunk(header,payload);
+            result=write_ready_records(false);
+        }
+        close(segment_fd);
+    }
+    result=result && write_ready_records(true) && write_annotation_records();
+
+    //count of records is known only at end
+    char records_count[9];
+    snprintf(records_count,sizeof(records_count),"%-8llu",(unsigned long long)_records_count);
+    if (result==false || pwrite(_fd,records_count,8,BDF_RECORDS_COUNT_OFFSET)!=8 || fsync(_fd)<0)
+    {
+        perror("BDF write failed");
+        result=false;
+    }
+    close(_fd);
+    _fd=-1;
+    std::cout << _filename << " - export " << (result==true ? "OK" : "failed") << ", records " << _records_count << std::endl;
+    _state.store(result==true ? BDF_EXPORT_DONE : BDF_EXPORT_ERROR,std::memory_order_release);
+}
+
+bool Session_BDF_exporter::scan_session(void)
+{
+    //first chunk of signal gives sample rate and start time, events of all chunks give place of annotations.
+    //Payloads are not read
+    std::vector<uint32_t> segments=Session_segment_reader::list_segments(_session_dir);
+    for (uint32_t i=0; i<segments.size(); i++)
+    {
+        SESSION_FILE_HEADER_TDS file_header;
+        int fd=open_segment(segments[i],&file_header);
+        if (fd<0)
+        {
+            continue;
+        }
+        //all segments of session have same start time
+        _file_header=file_header;
+        SESSION_CHUNK_HEADER_TDS header;
+        while (read(fd,&header,sizeof(header))==(ssize_t)sizeof(header) && header.magic==SESSION_CHUNK_MAGIC &&
+               header.header_size==sizeof(header))
+        {
+            BDF_SIGNAL_TDS *signal=nullptr;
+            if (header.type==SESSION_CHUNK_ECG) signal=&_ECG;
+            if (header.type==SESSION_CHUNK_ICG) signal=&_ICG;
+            if (signal!=nullptr && signal->is_present==false && header.record_count>0 && header.sample_rate>0)
+            {
+                signal->is_present=true;
+                signal->sample_rate=header.sample_rate;
+                signal->first_time_ns=header.first_time_ns;
+            }
+            if (header.type==SESSION_CHUNK_SYNC) _events_count=_events_count+header.record_count;
+            if (header.type==SESSION_CHUNK_SETTINGS) _events_count++;
+            _last_chunk_ns=std::max(_last_chunk_ns,header.first_time_ns);
+            if (lseek(fd,header.payload_size,SEEK_CUR)<0)
+            {
+                break;
+            }
+        }
+        close(fd);
+    }
+    if (_ECG.is_present==false && _ICG.is_present==false)
+    {
+        return false;
+    }
+    //signal which starts later is filled by zeros
+    _start_ns=_ECG.is_present==true ? _ECG.first_time_ns : _ICG.first_time_ns;
+    if (_ICG.is_present==true)
+    {
+        _start_ns=std::min(_start_ns,_ICG.first_time_ns);
+    }
+    return true;
+}
+
+int Session_BDF_exporter::open_segment(uint32_t segment_index, SESSION_FILE_HEADER_TDS *file_header)
+{
+    std::string filename=Session_segment_reader::get_segment_filename(_session_dir,segment_index,".rec");
+    int fd=open(filename.c_str(),O_RDONLY);
+    if (fd<0)
+    {
+        return -1;
+    }
+    if (read(fd,file_header,sizeof(SESSION_FILE_HEADER_TDS))!=(ssize_t)sizeof(SESSION_FILE_HEADER_TDS) ||
+        file_header->magic!=SESSION_FILE_MAGIC || file_header->version!=SESSION_FILE_VERSION ||
+        lseek(fd,file_header->header_size,SEEK_SET)<0)
+    {
+        std::cout << filename << " - wrong header" << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool Session_BDF_exporter::read_chunk(int fd, SESSION_CHUNK_HEADER_TDS *header, std::vector<uint8_t> *payload)
+{
+    if (read(fd,header,sizeof(SESSION_CHUNK_HEADER_TDS))!=(ssize_t)sizeof(SESSION_CHUNK_HEADER_TDS) ||
+        header->magic!=SESSION_CHUNK_MAGIC || header->header_size!=sizeof(SESSION_CHUNK_HEADER_TDS) ||
+        header->payload_size>MAX_CHUNK_PAYLOAD)
+    {
+        return false;
+    }
+    payload->resize(header->payload_size);
+    if (read(fd,payload->data(),header->payload_size)!=(ssize_t)header->payload_size)
+    {
+        return false;
+    }
+    uint32_t crc32=header->crc32;
+    header->crc32=0;
+    uint32_t calculated_crc32=CRC32::calculate(header,sizeof(SESSION_CHUNK_HEADER_TDS));
+    calculated_crc32=CRC32::calculate(payload->data(),payload->size(),calculated_crc32);
+    header->crc32=crc32;
+    if (calculated_crc32!=crc32)
+    {
+        std::cout << _session_dir << " - chunk checksum error" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Session_BDF_exporter::choose_record_duration(void)
+{
+    //whole number of samples of all signals in record
+    _record_duration=0;
+    for (uint32_t duration=1; duration<=MAX_RECORD_DURATION && _record_duration==0; duration++)
+    {
+        bool is_whole=true;
+        if (_ECG.is_present==true)
+        {
+            double samples=_ECG.sample_rate*duration;
+            is_whole=is_whole && std::fabs(samples-std::round(samples))<0.001;
+        }
+        if (_ICG.is_present==true)
+        {
+            double samples=_ICG.sample_rate*duration;
+            is_whole=is_whole && std::fabs(samples-std::round(samples))<0.001;
+        }
+        if (is_whole==true)
+        {
+            _record_duration=duration;
+        }
+    }
+    if (_record_duration==0)
+    {
+        //rate is rounded, time of samples in file has small error
+        _record_duration=1;
+    }
+    _ECG.samples_in_record=std::lround(_ECG.sample_rate*_record_duration);
+    _ICG.samples_in_record=std::lround(_ICG.sample_rate*_record_duration);
+    //time keeping TAL and events of average session rate with headroom
+    double session_duration=std::max(1.0,(_last_chunk_ns-_start_ns)/1e9);
+    uint64_t events_in_record=(uint64_t)std::ceil(_events_count*_record_duration/session_duration);
+    uint64_t annotation_size=(1+events_in_record*ANNOTATION_HEADROOM+ANNOTATION_MIN_EVENTS)*ANNOTATION_TAL_SIZE;
+    _annotation_samples=(annotation_size+2)/3;
+    return (_ECG.is_present==false || _ECG.samples_in_record>0) && (_ICG.is_present==false || _ICG.samples_in_record>0);
+}
+
+bool Session_BDF_exporter::write_header(void)
+{
+    typedef struct BDF_SIGNAL_HEADER
+    {
+        const char *label;
+        const char *dimension;
+        double physical_min;
+        double physical_max;
+        int32_t digital_min;
+        int32_t digital_max;
+        uint32_t samples;
+    } BDF_SIGNAL_HEADER_TDS;
+
+    std::vector<BDF_SIGNAL_HEADER_TDS> signals;
+    if (_ECG.is_present==true)
+    {
+        //ADS1293 data is 24 bit unsigned, digital value is shifted by half of range
+        signals.push_back({"ECG1","LSB",0,16777215,BDF_DIGITAL_MIN,BDF_DIGITAL_MAX,_ECG.samples_in_record});
+        signals.push_back({"ECG2","LSB",0,16777215,BDF_DIGITAL_MIN,BDF_DIGITAL_MAX,_ECG.samples_in_record});
+        signals.push_back({"ECG3","LSB",0,16777215,BDF_DIGITAL_MIN,BDF_DIGITAL_MAX,_ECG.samples_in_record});
+    }
+    if (_ICG.is_present==true)
+    {
+        signals.push_back({"Load_real","Ohm",-800,800,-ICG_DIGITAL_LIMIT,ICG_DIGITAL_LIMIT,_ICG.samples_in_record});
+        signals.push_back({"Load_mag","Ohm",-800,800,-ICG_DIGITAL_LIMIT,ICG_DIGITAL_LIMIT,_ICG.samples_in_record});
+        signals.push_back({"Load_imag","Ohm",-800,800,-ICG_DIGITAL_LIMIT,ICG_DIGITAL_LIMIT,_ICG.samples_in_record});
+        signals.push_back({"Load_angle","deg",-800,800,-ICG_DIGITAL_LIMIT,ICG_DIGITAL_LIMIT,_ICG.samples_in_record});
+        signals.push_back({"ICG_overload","",0,1,0,1,_ICG.samples_in_record});
+    }
+    signals.push_back({"BDF Annotations","",-1,1,BDF_DIGITAL_MIN,BDF_DIGITAL_MAX,_annotation_samples});
+
+    //start of file in system time
+    int64_t start_realtime_ns=_file_header.start_realtime_ns+(_start_ns-_file_header.start_monotonic_ns);
+    std::time_t time=(std::time_t)(start_realtime_ns/1000000000);
+    std::tm ptm;
+    gmtime_r(&time,&ptm);
+    static const char *MONTHS[12]= {"JAN","FEB","MAR","APR","MAY","JUN","JUL","AUG","SEP","OCT","NOV","DEC"};
+    char text[96];
+
+    std::string header;
+    header.reserve(256*(signals.size()+1));
+    header.push_back((char)0xFF);
+    add_field(&header,"BIOSEMI",7);
+    add_field(&header,"X X X X",80);
+    snprintf(text,sizeof(text),"Startdate %02d-%s-%04d X X SPI_DEV_servise",ptm.tm_mday,MONTHS[ptm.tm_mon],ptm.tm_year+1900);
+    add_field(&header,text,80);
+    snprintf(text,sizeof(text),"%02d.%02d.%02d",ptm.tm_mday,ptm.tm_mon+1,ptm.tm_year%100);
+    add_field(&header,text,8);
+    snprintf(text,sizeof(text),"%02d.%02d.%02d",ptm.tm_hour,ptm.tm_min,ptm.tm_sec);
+    add_field(&header,text,8);
+    add_number_field(&header,256*(signals.size()+1),8);
+    add_field(&header,"BDF+C",44);
+    add_field(&header,"-1",8);
+    add_number_field(&header,_record_duration,8);
+    add_number_field(&header,signals.size(),4);
+
+    for (uint32_t i=0; i<signals.size(); i++) add_field(&header,signals[i].label,16);
+    for (uint32_t i=0; i<signals.size(); i++) add_field(&header,"",80);
+    for (uint32_t i=0; i<signals.size(); i++) add_field(&header,signals[i].dimension,8);
+    for (uint32_t i=0; i<signals.size(); i++) add_number_field(&header,signals[i].physical_min,8);
+    for (uint32_t i=0; i<signals.size(); i++) add_number_field(&header,signals[i].physical_max,8);
+    for (uint32_t i=0; i<signals.size(); i++) add_number_field(&header,signals[i].digital_min,8);
+    for (uint32_t i=0; i<signals.size(); i++) add_number_field(&header,signals[i].digital_max,8);
+    for (uint32_t i=0; i<signals.size(); i++) add_field(&header,"",80);
+    for (uint32_t i=0; i<signals.size(); i++) add_number_field(&header,signals[i].samples,8);
+    for (uint32_t i=0; i<signals.size(); i++) add_field(&header,"",32);
+
+    if (write(_fd,header.data(),header.size())!=(ssize_t)header.size())
+    {
+        return false;
+    }
+    return true;
+}
+
+void Session_BDF_exporter::add_chunk(const SESSION_CHUNK_HEADER_TDS& header, const std::vector<uint8_t>& payload)
+{
+    if (header.type==SESSION_CHUNK_ECG && _ECG.is_present==true)
+    {
+        add_samples(&_ECG,header,payload);
+    }
+    if (header.type==SESSION_CHUNK_ICG && _ICG.is_present==true)
+    {
+        add_samples(&_ICG,header,payload);
+    }
+    if (header.type==SESSION_CHUNK_SYNC && header.record_size==sizeof(SESSION_SYNC_RECORD_TDS))
+    {
+        int64_t start_realtime_ns=_file_header.start_realtime_ns+(_start_ns-_file_header.start_monotonic_ns);
+        const SESSION_SYNC_RECORD_TDS *records=(const SESSION_SYNC_RECORD_TDS *)payload.data();
+        for (uint32_t i=0; i<header.record_count && (i+1)*sizeof(SESSION_SYNC_RECORD_TDS)<=payload.size(); i++)
+        {
+            add_annotation(records[i].time_ms*1000000-start_realtime_ns,
+                           "sync "+std::string(SESSION_DEVICE_NAMES[records[i].device & 1])+" "+std::to_string(records[i].sync_num));
+        }
+    }
+    if (header.type==SESSION_CHUNK_SETTINGS && payload.size()>=sizeof(SESSION_SETTINGS_RECORD_TDS))
+    {
+        const SESSION_SETTINGS_RECORD_TDS *record=(const SESSION_SETTINGS_RECORD_TDS *)payload.data();
+        add_annotation(header.first_time_ns-_start_ns,"settings "+std::string(SESSION_DEVICE_NAMES[record->device & 1]));
+    }
+}
+
+void Session_BDF_exporter::add_samples(BDF_SIGNAL_TDS *signal, const SESSION_CHUNK_HEADER_TDS& header, const std::vector<uint8_t>& payload)
+{
+    if (header.sample_rate!=signal->sample_rate || header.record_size!=signal->channels*sizeof(int32_t) ||
+        (uint64_t)header.record_count*header.record_size>payload.size())
+    {
+        //samples of other rate are not exported
+        return;
+    }
+
+    //chunk which starts within one sample of expected position continues signal, clock jitter is not a gap
+    int64_t first_position=std::llround((double)(header.first_time_ns-_start_ns)*signal->sample_rate/1e9);
+    int64_t position=(int64_t)signal->position;
+    uint32_t skip=0;
+    if (first_position>position+1)
+    {
+        add_annotation((int64_t)(position*1e9/signal->sample_rate),signal->chunk_type==SESSION_CHUNK_ECG ? "ECG data lost" : "ICG data lost");
+        signal->values.insert(signal->values.end(),(first_position-position)*signal->channels,0);
+        signal->position=first_position;
+    }
+    else if (first_position<position-1)
+    {
+        skip=std::min((int64_t)header.record_count,position-first_position);
+    }
+
+    const int32_t *records=(const int32_t *)payload.data();
+    for (uint32_t i=skip; i<header.record_count; i++)
+    {
+        const int32_t *record=records+i*signal->channels;
+        if (signal->chunk_type==SESSION_CHUNK_ECG)
+        {
+            for (uint32_t ch=0; ch<signal->channels; ch++)
+            {
+                signal->values.push_back(std::clamp(record[ch]+BDF_DIGITAL_MIN,BDF_DIGITAL_MIN,BDF_DIGITAL_MAX));
+            }
+        }
+        else
+        {
+            for (uint32_t ch=0; ch<signal->channels-1; ch++)
+            {
+                signal->values.push_back(std::clamp(record[ch],-ICG_DIGITAL_LIMIT,ICG_DIGITAL_LIMIT));
+            }
+            signal->values.push_back(record[signal->channels-1]!=0 ? 1 : 0);
+        }
+    }
+    signal->position=signal->position+(header.record_count-skip);
+}
+
+void Session_BDF_exporter::add_annotation(int64_t time_ns, const std::string& text)
+{
+    //backlog is kept sorted, events of the same time stay in order of adding
+    std::vector<BDF_ANNOTATION_TDS>::iterator position=std::upper_bound(_annotations.begin(),_annotations.end(),time_ns,
+            [](int64_t time, const BDF_ANNOTATION_TDS& annotation)
+    {
+        return time<annotation.time_ns;
+    });
+    _annotations.insert(position,{time_ns,text});
+}
+
+uint32_t Session_BDF_exporter::get_available_samples(const BDF_SIGNAL_TDS& signal)
+{
+    return signal.values.size()/signal.channels-signal.read_position;
+}
+
+bool Session_BDF_exporter::write_ready_records(bool is_last)
+{
+    BDF_SIGNAL_TDS *signals[2]= {&_ECG,&_ICG};
+    while (true)
+    {
+        bool is_ready=true;
+        bool is_lag=false;
+        bool has_data=false;
+        for (uint32_t i=0; i<2; i++)
+        {
+            if (signals[i]->is_present==false)
+            {
+                continue;
+            }
+            uint32_t available=get_available_samples(*signals[i]);
+            is_ready=is_ready && available>=signals[i]->samples_in_record;
+            is_lag=is_lag || available>=signals[i]->samples_in_record*MAX_LAG_RECORDS;
+            has_data=has_data || available>0;
+        }
+        if (is_ready==false && (is_lag==true || (is_last==true && has_data==true)))
+        {
+            //signal without data (stopped measure, end of session) is filled by zeros
+            for (uint32_t i=0; i<2; i++)
+            {
+                uint32_t available=get_available_samples(*signals[i]);
+                if (signals[i]->is_present==true && available<signals[i]->samples_in_record)
+                {
+                    uint32_t missing=signals[i]->samples_in_record-available;
+                    signals[i]->values.insert(signals[i]->values.end(),missing*signals[i]->channels,0);
+                    signals[i]->position=signals[i]->position+missing;
+                }
+            }
+            is_ready=true;
+        }
+        if (is_ready==false)
+        {
+            return true;
+        }
+        if (write_record(false)==false)
+        {
+            return false;
+        }
+    }
+}
+
+bool Session_BDF_exporter::write_annotation_records(void)
+{
+    //events which had no place in data records are written in records of zero samples
+    BDF_SIGNAL_TDS *signals[2]= {&_ECG,&_ICG};
+    while (_annotations.empty()==false)
+    {
+        for (uint32_t i=0; i<2; i++)
+        {
+            if (signals[i]->is_present==true)
+            {
+                signals[i]->values.insert(signals[i]->values.end(),signals[i]->samples_in_record*signals[i]->channels,0);
+                signals[i]->position=signals[i]->position+signals[i]->samples_in_record;
+            }
+        }
+        size_t annotations_count=_annotations.size();
+        if (write_record(true)==false)
+        {
+            return false;
+        }
+        if (_annotations.size()==annotations_count)
+        {
+            //text is longer than annotation signal
+            _annotations.erase(_annotations.begin());
+        }
+    }
+    return true;
+}
+
+bool Session_BDF_exporter::write_record(bool is_data_end)
+{
+    _record.clear();
+    BDF_SIGNAL_TDS *signals[2]= {&_ECG,&_ICG};
+    for (uint32_t i=0; i<2; i++)
+    {
+        BDF_SIGNAL_TDS *signal=signals[i];
+        if (signal->is_present==false)
+        {
+            continue;
+        }
+        for (uint32_t ch=0; ch<signal->channels; ch++)
+        {
+            for (uint32_t n=0; n<signal->samples_in_record; n++)
+            {
+                int32_t value=signal->values[(signal->read_position+n)*signal->channels+ch];
+                _record.push_back(value & 0xFF);
+                _record.push_back((value>>8) & 0xFF);
+                _record.push_back((value>>16) & 0xFF);
+            }
+        }
+        signal->read_position=signal->read_position+signal->samples_in_record;
+        if (signal->read_position*2>signal->values.size()/signal->channels)
+        {
+            signal->values.erase(signal->values.begin(),signal->values.begin()+signal->read_position*signal->channels);
+            signal->read_position=0;
+        }
+    }
+
+    //annotations: time keeping TAL of record, then events up to end of record (all after end of data) which have place
+    size_t annotation_start=_record.size();
+    size_t annotation_size=_annotation_samples*3;
+    int64_t record_end_ns=(int64_t)(_records_count+1)*_record_duration*1000000000;
+    char text[64];
+    snprintf(text,sizeof(text),"+%llu",(unsigned long long)(_records_count*_record_duration));
+    _record.insert(_record.end(),text,text+strlen(text));
+    _record.push_back(0x14);
+    _record.push_back(0x14);
+    _record.push_back(0);
+    uint32_t written=0;
+    while (written<_annotations.size() && (_annotations[written].time_ns<record_end_ns || is_data_end==true))
+    {
+        snprintf(text,sizeof(text),"%+.3f",_annotations[written].time_ns/1e9);
+        size_t tal_size=strlen(text)+_annotations[written].text.size()+3;
+        if (_record.size()-annotation_start+tal_size>annotation_size)
+        {
+            break;
+        }
+        _record.insert(_record.end(),text,text+strlen(text));
+        _record.push_back(0x14);
+        _record.insert(_record.end(),_annotations[written].text.begin(),_annotations[written].text.end());
+        _record.push_back(0x14);
+        _record.push_back(0);
+        written++;
+    }
+    _annotations.erase(_annotations.begin(),_annotations.begin()+written);
+    _record.resize(annotation_start+annotation_size,0);
+
+    _records_count++;
+    return write(_fd,_record.data(),_record.size())==(ssize_t)_record.size();
+}
@@ -0,0 +1,546 @@
+#include "Session_query_process.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char *SESSION_DEVICE_NAMES[]= {"ADS1293","MAX30009"};
+static const uint32_t ICG_OVERLOAD_CHANNEL=4;
+
+Session_query_process::Session_query_process(Session_recorder *session_recorder_ptr)
+{
+    _session_recorder=session_recorder_ptr;
+}
+
+Session_query_process::~Session_query_process()
+{
+    if (_worker_thread.joinable()==true)
+    {
+        _worker_thread.join();
+    }
+    clear_attachment(&_attachment);
+}
+
+std::string Session_query_process::process_JSON_line(const char * JSON_line)
+{
+    std::string_view command_type;
+    std::string_view session;
+    std::string_view signal;
+    std::string_view from_time;
+    std::string_view to_time;
+    std::string_view encoding="json";
+    QUERY_REQUEST_TDS request;
+    request.is_list=false;
+    request.from_time_ns=0;
+    request.to_time_ns=INT64_MAX;
+    request.decimation=1;
+    request.max_samples=0;
+    std::string_view key;
+
+    JSON_command_parser parser(JSON_line);
+    if (parser.begin_object()==true)
+    {
+        while (parser.next_key(&key)==true)
+        {
+            if (key=="type") parser.read_string(&command_type);
+            else if (key=="session") parser.read_string(&session);
+            else if (key=="signal") parser.read_string(&signal);
+            else if (key=="from_time") parser.read_string(&from_time);
+            else if (key=="to_time") parser.read_string(&to_time);
+            else if (key=="from_time_ns") parser.read_number(&request.from_time_ns);
+            else if (key=="to_time_ns") parser.read_number(&request.to_time_ns);
+            else if (key=="decimation") parser.read_number(&request.decimation);
+            else if (key=="max_samples") parser.read_number(&request.max_samples);
+            else if (key=="encoding") parser.read_string(&encoding);
+            else parser.skip_value();
+        }
+    }
+
+    if (parser.is_finished()==false)
+    {
+        return "{\"type\":\"error JSON\"}";
+    }
+
+    if (command_type == "list_sessions")
+    {
+        //recorder is used only by main loop
+        request.is_list=true;
+        request.session=_session_recorder->is_recording()==true ? _session_recorder->get_session_name() : "";
+    }
+    else if (command_type == "query")
+    {
+        if (signal=="ECG") request.type=SESSION_CHUNK_ECG;
+        else if (signal=="ICG") request.type=SESSION_CHUNK_ICG;
+        else return "{\"type\":\"error JSON\"}";
+
+        if (encoding=="binary") request.is_binary=true;
+        else if (encoding=="json") request.is_binary=false;
+        else return "{\"type\":\"error JSON\"}";
+
+        if ((from_time.empty()==false && parse_time(from_time,&request.from_time_ns)==false) ||
+            (to_time.empty()==false && parse_time(to_time,&request.to_time_ns)==false) ||
+            request.from_time_ns>=request.to_time_ns || request.decimation==0 || request.decimation>MAX_DECIMATION)
+        {
+            return "{\"type\":\"error JSON\"}";
+        }
+
+        uint32_t max_samples=request.is_binary==true ? MAX_BINARY_SAMPLES : MAX_JSON_SAMPLES;
+        if (request.max_samples==0 || request.max_samples>max_samples)
+        {
+            request.max_samples=max_samples;
+        }
+
+        //session name is directory name, path is not accepted
+        request.session=session.empty()==true ? _session_recorder->get_session_name() : std::string(session);
+        if (request.session.empty()==true || request.session.find('/')!=std::string::npos || request.session.find("..")!=std::string::npos)
+        {
+            return "{\"type\":\"error session\"}";
+        }
+    }
+    else
+    {
+        return "{\"type\":\"error JSON\"}";
+    }
+
+    //one query at time, response of previous query must be taken by main loop
+    if (_state.load(std::memory_order_acquire)!=QUERY_STATE_IDLE)
+    {
+        return "{\"type\":\"error busy\"}";
+    }
+    if (_worker_thread.joinable()==true)
+    {
+        _worker_thread.join();
+    }
+    _request=request;
+    _state.store(QUERY_STATE_REQUESTED,std::memory_order_release);
+    _worker_thread=std::thread(&Session_query_process::worker_process,this);
+    return "";
+}
+
+std::string Session_query_process::process_pending_request(void)
+{
+    if (_state.load(std::memory_order_acquire)!=QUERY_STATE_DONE)
+    {
+        return "";
+    }
+    _worker_thread.join();
+    std::string response;
+    response.swap(_response);
+    if (_is_response_canceled==true)
+    {
+        //query can not be stopped, its result is dropped
+        _is_response_canceled=false;
+        response.clear();
+        clear_attachment(&_attachment);
+    }
+    _state.store(QUERY_STATE_IDLE,std::memory_order_release);
+    return response;
+}
+
+void Session_query_process::cancel_pending_request(void)
+{
+    _is_response_canceled=_state.load(std::memory_order_acquire)!=QUERY_STATE_IDLE;
+}
+
+void Session_query_process::move_attachment(TCP_ATTACHMENT_TDS *attachment)
+{
+    //attachment is changed only while worker is idle
+    clear_attachment(attachment);
+    std::swap(*attachment,_attachment);
+}
+
+bool Session_query_process::parse_time(std::string_view text, int64_t *time_ns)
+{
+    //"YYYY-MM-DD HH:MM:SS[.ffffff]" UTC
+    char buffer[40];
+    if (text.size()>=sizeof(buffer))
+    {
+        return false;
+    }
+    memcpy(buffer,text.data(),text.size());
+    buffer[text.size()]=0;
+
+    struct tm time_tm= {};
+    int length=0;
+    if (sscanf(buffer,"%4d-%2d-%2d %2d:%2d:%2d%n",&time_tm.tm_year,&time_tm.tm_mon,&time_tm.tm_mday,
+               &time_tm.tm_hour,&time_tm.tm_min,&time_tm.tm_sec,&length)!=6)
+    {
+        return false;
+    }
+    time_tm.tm_year-=1900;
+    time_tm.tm_mon-=1;
+
+    int64_t fraction_ns=0;
+    const char *c=buffer+length;
+    if (*c=='.')
+    {
+        int64_t scale=100000000;
+        for (c++; *c>='0' && *c<='9'; c++)
+        {
+            fraction_ns+=(*c-'0')*scale;
+            scale/=10;
+        }
+    }
+    if (*c!=0)
+    {
+        return false;
+    }
+    *time_ns=(int64_t)timegm(&time_tm)*1000000000LL+fraction_ns;
+    return true;
+}
+
+void Session_query_process::clear_attachment(TCP_ATTACHMENT_TDS *attachment)
+{
+    for (int fd : attachment->file_fds)
+    {
+        close(fd);
+    }
+    attachment->file_fds.clear();
+    attachment->file_ranges.clear();
+    attachment->data.clear();
+}
+
+void Session_query_process::worker_process(void)
+{
+    if (_request.is_list==true)
+    {
+        _response=list_sessions(_request.session);
+    }
+    else
+    {
+        _response=query(_request);
+    }
+    _state.store(QUERY_STATE_DONE,std::memory_order_release);
+}
+
+std::string Session_query_process::query(const QUERY_REQUEST_TDS& request)
+{
+    std::string session_dir=std::string(SESSION_RECORD_DIR)+"/"+request.session;
+    std::vector<uint32_t> segments=Session_segment_reader::list_segments(session_dir);
+    if (segments.empty()==true)
+    {
+        return "{\"type\":\"error session\"}";
+    }
+
+    bool is_ICG=request.type==SESSION_CHUNK_ICG;
+    uint32_t channels=is_ICG==true ? sizeof(SESSION_ICG_RECORD_TDS)/sizeof(int32_t) : sizeof(SESSION_ECG_RECORD_TDS)/sizeof(int32_t);
+    uint32_t record_size=channels*sizeof(int32_t);
+    //records are stored as they are sent, only range of file is given to server
+    bool is_zero_copy=request.is_binary==true && request.decimation==1;
+
+    clear_attachment(&_attachment);
+    _values.clear();
+    _gaps.clear();
+    _sync_marks.clear();
+    _sums.assign(channels,0);
+    _sum_count=0;
+    _overload=0;
+
+    double sample_rate=0;
+    uint32_t data_size=0;
+    int64_t first_time_ns=0;
+    int64_t next_time_ns=request.from_time_ns;  // time of first sample which is not in response
+    int64_t expected_ns=INT64_MIN;              // monotonic time of next sample after read samples
+    bool is_done=false;
+
+    for (uint32_t segment_index : segments)
+    {
+        if (is_done==true)
+        {
+            break;
+        }
+        if (_reader.open(session_dir,segment_index)==false)
+        {
+            continue;
+        }
+        const SESSION_FILE_HEADER_TDS& file_header=_reader.get_file_header();
+        int64_t offset_ns=file_header.start_realtime_ns-file_header.start_monotonic_ns;
+        int64_t from_ns=next_time_ns-offset_ns;
+        int64_t to_ns=request.to_time_ns==INT64_MAX ? INT64_MAX : request.to_time_ns-offset_ns;
+        int file_fd=-1;
+
+        uint32_t count=_reader.get_chunks_count(request.type);
+        for (uint32_t position=_reader.find(request.type,from_ns); position<count; position++)
+        {
+            const SESSION_INDEX_ENTRY_TDS& entry=_reader.get_entry(request.type,position);
+            if (entry.first_time_ns>=to_ns)
+            {
+                is_done=true;
+                break;
+            }
+            const SESSION_CHUNK_HEADER_TDS *chunk=_reader.get_chunk(entry);
+            if (chunk==nullptr || chunk->record_size!=record_size || chunk->sample_rate<=0)
+            {
+                continue;
+            }
+            //response has one sample rate, client continues from next_time_ns
+            if (sample_rate==0)
+            {
+                sample_rate=chunk->sample_rate;
+            }
+            else if (chunk->sample_rate!=sample_rate)
+            {
+                is_done=true;
+                break;
+            }
+
+            double period_ns=1e9/sample_rate;
+            int64_t first=std::max<int64_t>(0,(int64_t)std::ceil((from_ns-entry.first_time_ns)/period_ns));
+            int64_t last=chunk->record_count;
+            if (to_ns!=INT64_MAX)
+            {
+                last=std::min<int64_t>(last,(int64_t)std::ceil((to_ns-entry.first_time_ns)/period_ns));
+            }
+            if (first>=last)
+            {
+                continue;
+            }
+            int64_t remaining=(int64_t)(request.max_samples-data_size)*request.decimation-_sum_count;
+            if (last-first>=remaining)
+            {
+                last=first+remaining;
+                is_done=true;
+            }
+
+            int64_t start_ns=entry.first_time_ns+std::llround(first*period_ns);
+            if (expected_ns!=INT64_MIN && std::llabs(start_ns-expected_ns)>period_ns*1.5)
+            {
+                //incomplete decimation block before gap is dropped
+                _gaps.push_back({data_size,start_ns+offset_ns});
+                std::fill(_sums.begin(),_sums.end(),0);
+                _sum_count=0;
+                _overload=0;
+            }
+            if (data_size==0 && _sum_count==0)
+            {
+                first_time_ns=start_ns+offset_ns;
+            }
+
+            const int32_t *records=(const int32_t *)((const uint8_t *)chunk+chunk->header_size);
+            if (is_zero_copy==true)
+            {
+                if (file_fd<0)
+                {
+                    file_fd=open(_reader.get_filename().c_str(),O_RDONLY);
+                    if (file_fd<0)
+                    {
+                        perror("session segment open failed");
+                        is_done=true;
+                        break;
+                    }
+                    _attachment.file_fds.push_back(file_fd);
+                }
+                uint64_t offset=entry.offset+chunk->header_size+first*record_size;
+                uint64_t size=(last-first)*record_size;
+                if (_attachment.file_ranges.empty()==false && _attachment.file_ranges.back().fd==file_fd &&
+                    _attachment.file_ranges.back().offset+_attachment.file_ranges.back().size==offset)
+                {
+                    _attachment.file_ranges.back().size+=size;
+                }
+                else
+                {
+                    _attachment.file_ranges.push_back({file_fd,offset,size});
+                }
+                data_size+=last-first;
+            }
+            else
+            {
+                for (int64_t i=first; i<last; i++)
+                {
+                    add_record(records+i*channels,channels,request.decimation,is_ICG);
+                }
+                data_size=_values.size()/channels;
+            }
+
+            expected_ns=entry.first_time_ns+std::llround(last*period_ns);
+            from_ns=expected_ns;
+            next_time_ns=expected_ns-std::llround(_sum_count*period_ns)+offset_ns;
+            if (is_done==true)
+            {
+                break;
+            }
+        }
+        collect_sync_marks(request,offset_ns);
+        _reader.close();
+    }
+
+    //marks of samples after response are sent with next part
+    if (data_size>0)
+    {
+        _sync_marks.erase(std::remove_if(_sync_marks.begin(),_sync_marks.end(),[&](const SESSION_SYNC_RECORD_TDS& mark)
+        {
+            return mark.time_ms*1000000LL>=next_time_ns;
+        }),_sync_marks.end());
+    }
+
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","query_data");
+    _json_writer.key_value("session",request.session);
+    _json_writer.key_value("signal",is_ICG==true ? "ICG" : "ECG");
+    _json_writer.key_value("encoding",request.is_binary==true ? "binary" : "json");
+    _json_writer.key_value("sample_rate",sample_rate/request.decimation);
+    _json_writer.key_value("decimation",request.decimation);
+    _json_writer.key_value("channels",channels);
+    _json_writer.key_value("record_size",record_size);
+    _json_writer.key_value("data_size",data_size);
+    _json_writer.key_value("first_time_ns",first_time_ns);
+    _json_writer.key_value("next_time_ns",next_time_ns);
+    _json_writer.key("gaps");
+    _json_writer.begin_array();
+    for (const QUERY_GAP_TDS& gap : _gaps)
+    {
+        _json_writer.begin_object();
+        _json_writer.key_value("position",gap.position);
+        _json_writer.key_value("time_ns",gap.time_ns);
+        _json_writer.end_object();
+    }
+    _json_writer.end_array();
+    _json_writer.key("sync_marks");
+    _json_writer.begin_array();
+    for (const SESSION_SYNC_RECORD_TDS& mark : _sync_marks)
+    {
+        _json_writer.begin_object();
+        _json_writer.key_value("device",mark.device<2 ? SESSION_DEVICE_NAMES[mark.device] : "unknown");
+        _json_writer.key_value("sync_num",mark.sync_num);
+        _json_writer.key_value("sample_count",mark.sample_count);
+        _json_writer.key_value("time_ms",mark.time_ms);
+        _json_writer.end_object();
+    }
+    _json_writer.end_array();
+
+    if (request.is_binary==true)
+    {
+        //int32 records follow JSON line
+        _json_writer.key_value("byte_size",(uint64_t)data_size*record_size);
+        if (is_zero_copy==false)
+        {
+            _attachment.data.assign((const char *)_values.data(),_values.size()*sizeof(int32_t));
+        }
+    }
+    else
+    {
+        _json_writer.key("data");
+        _json_writer.begin_array();
+        for (uint32_t i=0; i<data_size; i++)
+        {
+            _json_writer.begin_array();
+            for (uint32_t j=0; j<channels; j++)
+            {
+                _json_writer.value(_values[i*channels+j]);
+            }
+            _json_writer.end_array();
+        }
+        _json_writer.end_array();
+    }
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
+
+void Session_query_process::add_record(const int32_t *record, uint32_t channels, uint32_t decimation, bool is_ICG)
+{
+    for (uint32_t j=0; j<channels; j++)
+    {
+        _sums[j]+=record[j];
+    }
+    if (is_ICG==true)
+    {
+        _overload=std::max(_overload,record[ICG_OVERLOAD_CHANNEL]);
+    }
+    _sum_count++;
+    if (_sum_count<decimation)
+    {
+        return;
+    }
+
+    //mean of block, overload is set if any sample of block is overloaded
+    for (uint32_t j=0; j<channels; j++)
+    {
+        _values.push_back((int32_t)((_sums[j]+(_sums[j]>=0 ? (int64_t)decimation/2 : -(int64_t)decimation/2))/(int64_t)decimation));
+        _sums[j]=0;
+    }
+    if (is_ICG==true)
+    {
+        _values.back()=_overload;
+        _overload=0;
+    }
+    _sum_count=0;
+}
+
+void Session_query_process::collect_sync_marks(const QUERY_REQUEST_TDS& request, int64_t offset_ns)
+{
+    //mark times are system times in ms, chunk times are monotonic
+    uint32_t count=_reader.get_chunks_count(SESSION_CHUNK_SYNC);
+    for (uint32_t position=_reader.find(SESSION_CHUNK_SYNC,request.from_time_ns-offset_ns); position<count; position++)
+    {
+        const SESSION_INDEX_ENTRY_TDS& entry=_reader.get_entry(SESSION_CHUNK_SYNC,position);
+        if (request.to_time_ns!=INT64_MAX && entry.first_time_ns+offset_ns>=request.to_time_ns+SYNC_CHUNK_DELAY_NS)
+        {
+            break;
+        }
+        const SESSION_CHUNK_HEADER_TDS *chunk=_reader.get_chunk(entry);
+        if (chunk==nullptr || chunk->record_size!=sizeof(SESSION_SYNC_RECORD_TDS))
+        {
+            continue;
+        }
+        const SESSION_SYNC_RECORD_TDS *marks=(const SESSION_SYNC_RECORD_TDS *)((const uint8_t *)chunk+chunk->header_size);
+        for (uint32_t i=0; i<chunk->record_count; i++)
+        {
+            int64_t time_ns=marks[i].time_ms*1000000LL;
+            if (time_ns>=request.from_time_ns && time_ns<request.to_time_ns)
+            {
+                _sync_marks.push_back(marks[i]);
+            }
+        }
+    }
+}
+
+std::string Session_query_process::list_sessions(const std::string& recording_session)
+{
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","sessions");
+    _json_writer.key("sessions");
+    _json_writer.begin_array();
+
+    std::vector<std::string> names;
+    std::error_code error;
+    for (const std::filesystem::directory_entry& item : std::filesystem::directory_iterator(SESSION_RECORD_DIR,error))
+    {
+        if (item.is_directory(error)==true)
+        {
+            names.push_back(item.path().filename().string());
+        }
+    }
+    std::sort(names.begin(),names.end());
+
+    for (const std::string& name : names)
+    {
+        std::string session_dir=std::string(SESSION_RECORD_DIR)+"/"+name;
+        std::vector<uint32_t> segments=Session_segment_reader::list_segments(session_dir);
+        uint64_t size=0;
+        for (uint32_t segment_index : segments)
+        {
+            uintmax_t file_size=std::filesystem::file_size(Session_segment_reader::get_segment_filename(session_dir,segment_index,".rec"),error);
+            if (!error)
+            {
+                size+=file_size;
+            }
+        }
+        _json_writer.begin_object();
+        _json_writer.key_value("name",name);
+        _json_writer.key_value("segments",(uint32_t)segments.size());
+        _json_writer.key_value("size",size);
+        _json_writer.key_value("is_recording",name==recording_session);
+        _json_writer.end_object();
+    }
+    _json_writer.end_array();
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
@@ -0,0 +1,690 @@
+#include "Session_recorder.h"
+#include "CRC32.h"
+#include "Timestamp_formatter.h"
+#include "Session_segment_reader.h"
+
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+Session_recorder::Session_recorder(ADS1293_process *ADS1293_process_ptr, MAX30009_process *MAX30009_process_ptr)
+    : _ADS1293_process(ADS1293_process_ptr),
+      _MAX30009_process(MAX30009_process_ptr)
+{
+}
+
+Session_recorder::~Session_recorder()
+{
+    stop();
+    if (_writer_thread.joinable()==true)
+    {
+        _writer_thread.join();
+    }
+}
+
+std::string Session_recorder::process_JSON_line(const char * JSON_line)
+{
+    std::string_view command_type;
+    std::string_view session;
+    std::string_view key;
+    uint32_t fsync_interval_ms=DEFAULT_FSYNC_INTERVAL_MS;
+    uint32_t max_segments=0;
+
+    JSON_command_parser parser(JSON_line);
+    if (parser.begin_object()==true)
+    {
+        while (parser.next_key(&key)==true)
+        {
+            if (key=="type") parser.read_string(&command_type);
+            else if (key=="fsync_interval_ms") parser.read_number(&fsync_interval_ms);
+            else if (key=="max_segments") parser.read_number(&max_segments);
+            else if (key=="session") parser.read_string(&session);
+            else parser.skip_value();
+        }
+    }
+
+    if (parser.is_finished()==false)
+    {
+        return "{\"type\":\"error JSON\"}";
+    }
+
+    if (command_type == "start_recording")
+    {
+        if (fsync_interval_ms>MAX_FSYNC_INTERVAL_MS)
+        {
+            fsync_interval_ms=MAX_FSYNC_INTERVAL_MS;
+        }
+        if (_is_recording==true || _is_writer_running.load(std::memory_order_acquire)==true)
+        {
+            return "{\"type\":\"error busy\"}";
+        }
+        if (start(fsync_interval_ms,max_segments)==false)
+        {
+            //session directory or its first segment can not be created
+            return "{\"type\":\"error session\"}";
+        }
+        return get_status_as_json();
+    }
+
+    if (command_type == "stop_recording")
+    {
+        stop();
+        return get_status_as_json();
+    }
+
+    if (command_type == "get_recording_status")
+    {
+        return get_status_as_json();
+    }
+
+    if (command_type == "export_bdf")
+    {
+        //session name is directory name, path is not accepted
+        std::string session_name=session.empty()==true ? _session_name : std::string(session);
+        if (session_name.empty()==true || session_name.find('/')!=std::string::npos || session_name.find("..")!=std::string::npos)
+        {
+            return "{\"type\":\"error session\"}";
+        }
+        if (_is_recording==true && session_name==_session_name)
+        {
+            return "{\"type\":\"error busy\"}";
+        }
+        std::string session_dir=std::string(SESSION_RECORD_DIR)+"/"+session_name;
+        if (_BDF_exporter.start(session_dir,session_dir+"/"+session_name+".bdf")==false)
+        {
+            return "{\"type\":\"error busy\"}";
+        }
+        return get_status_as_json();
+    }
+
+    return "{\"type\":\"error JSON\"}";
+}
+
+bool Session_recorder::start(uint32_t fsync_interval_ms, uint32_t max_segments)
+{
+    if (_is_recording==true || _is_writer_running.load(std::memory_order_acquire)==true)
+    {
+        return false;
+    }
+    if (_writer_thread.joinable()==true)
+    {
+        _writer_thread.join();
+    }
+
+    if (_chunk_buffers.empty()==true)
+    {
+        //buffers are allocated once, they are never freed while service runs
+        _chunk_buffers.resize(CHUNK_BUFFERS_COUNT);
+        for (uint32_t i=0; i<CHUNK_BUFFERS_COUNT; i++)
+        {
+            _chunk_buffers[i].resize(CHUNK_BUFFER_SIZE);
+            _free_chunks.push(i);
+        }
+    }
+
+    _start_realtime_ns=Timestamp_formatter::get_realtime_ns();
+    _start_monotonic_ns=Sample_clock_model::get_monotonic_ns();
+    std::time_t time=(std::time_t)(_start_realtime_ns/1000000000);
+    std::tm ptm;
+    gmtime_r(&time,&ptm);
+    //milliseconds keep name of restarted recording unique, files of existing session are never opened for writing
+    char name[40];
+    size_t name_size=strftime(name,sizeof(name),"session_%Y%m%d_%H%M%S",&ptm);
+    snprintf(name+name_size,sizeof(name)-name_size,"_%03u",(uint32_t)(_start_realtime_ns/1000000%1000));
+    _session_name=name;
+    _session_dir=std::string(SESSION_RECORD_DIR)+"/"+_session_name;
+
+    std::error_code error;
+    std::filesystem::create_directories(_session_dir,error);
+    if (error)
+    {
+        std::cout << _session_dir << " - " << error.message() << std::endl;
+        _session_name.clear();
+        return false;
+    }
+
+    _fsync_interval_ms=fsync_interval_ms;
+    _max_segments=max_segments;
+    if (open_segment(0)==false)
+    {
+        //directory is removed only if it is empty
+        std::filesystem::remove(_session_dir,error);
+        _session_name.clear();
+        return false;
+    }
+    _segment_index.store(0,std::memory_order_relaxed);
+    _bytes_written.store(0,std::memory_order_relaxed);
+    _chunks_written.store(0,std::memory_order_relaxed);
+    _write_errors.store(0,std::memory_order_relaxed);
+    _lost_ECG_samples=0;
+    _lost_ICG_samples=0;
+    _dropped_chunks=0;
+
+    //recording starts from newest samples, marks of older samples are not written
+    _ECG_seq=_ADS1293_process->get_write_seq();
+    _ICG_seq=_MAX30009_process->get_write_seq();
+    _ECG_mark_seq=_ECG_seq;
+    _ICG_mark_seq=_ICG_seq;
+    _next_collect_time=std::chrono::steady_clock::now();
+
+    _writer_stop.store(false,std::memory_order_relaxed);
+    _is_writer_running.store(true,std::memory_order_release);
+    _writer_thread=std::thread(&Session_recorder::writer_process,this);
+    _is_recording=true;
+
+    collect_settings(true);
+    return true;
+}
+
+void Session_recorder::stop(void)
+{
+    if (_is_recording==false)
+    {
+        return;
+    }
+    close_chunk(&_ECG_chunk);
+    close_chunk(&_ICG_chunk);
+    close_chunk(&_sync_chunk);
+    _is_recording=false;
+    //writer writes queued chunks and exits, thread is joined by next start
+    _writer_stop.store(true,std::memory_order_release);
+}
+
+void Session_recorder::process(void)
+{
+    if (_is_recording==false)
+    {
+        return;
+    }
+    auto current_time=std::chrono::steady_clock::now();
+    if (current_time<_next_collect_time)
+    {
+        return;
+    }
+    _next_collect_time=current_time+std::chrono::milliseconds(COLLECT_PERIOD_MS);
+
+    collect_settings(false);
+    collect_ECG();
+    collect_ICG();
+
+    close_old_chunk(&_ECG_chunk);
+    close_old_chunk(&_ICG_chunk);
+    close_old_chunk(&_sync_chunk);
+}
+
+void Session_recorder::collect_settings(bool is_forced)
+{
+    //data of new settings goes to new chunks, chunk has one sample rate
+    if (is_forced==true || _ADS1293_settings_version!=_ADS1293_process->get_settings_version())
+    {
+        _ADS1293_settings_version=_ADS1293_process->get_settings_version();
+        close_chunk(&_ECG_chunk);
+        write_settings(SESSION_DEVICE_ADS1293,_ADS1293_process->get_all_settings_as_json());
+    }
+    if (is_forced==true || _MAX30009_settings_version!=_MAX30009_process->get_settings_version())
+    {
+        _MAX30009_settings_version=_MAX30009_process->get_settings_version();
+        close_chunk(&_ICG_chunk);
+        write_settings(SESSION_DEVICE_MAX30009,_MAX30009_process->get_all_settings_as_json());
+    }
+}
+
+void Session_recorder::write_settings(SESSION_DEVICE_TDE device, const std::string& settings_json)
+{
+    CHUNK_BUILDER_TDS builder= {};
+    if (open_chunk(&builder,SESSION_CHUNK_SETTINGS,0,Sample_clock_model::get_monotonic_ns(),0,0)==false)
+    {
+        return;
+    }
+    SESSION_SETTINGS_RECORD_TDS record;
+    record.device=device;
+    record.text_size=settings_json.size();
+    if (append_record(&builder,&record,sizeof(record))==true)
+    {
+        append_record(&builder,settings_json.data(),settings_json.size());
+    }
+    get_chunk_header(builder.buffer_index)->record_count=1;
+    close_chunk(&builder);
+}
+
+void Session_recorder::collect_ECG(void)
+{
+    uint64_t oldest_seq=_ADS1293_process->get_oldest_seq();
+    uint64_t write_seq=_ADS1293_process->get_write_seq();
+    if (_ECG_seq<oldest_seq)
+    {
+        _lost_ECG_samples=_lost_ECG_samples+(oldest_seq-_ECG_seq);
+        _ECG_seq=oldest_seq;
+    }
+    //marks before read samples, samples after mark are in ring or written
+    collect_sync_marks(_ADS1293_process->get_sync_marks(),SESSION_DEVICE_ADS1293,write_seq,&_ECG_mark_seq);
+
+    Sample_clock_model& clock_model=_ADS1293_process->get_clock_model();
+    ADS1293_IFIFO_DATA_TDS item;
+    while (_ECG_seq<write_seq && _ADS1293_process->read_sample(_ECG_seq,&item)==true)
+    {
+        if (_ECG_chunk.is_open==true && _ECG_chunk.next_seq!=_ECG_seq)
+        {
+            close_chunk(&_ECG_chunk);
+        }
+        SESSION_ECG_RECORD_TDS record;
+        record.ch1=item.ch1;
+        record.ch2=item.ch2;
+        record.ch3=item.ch3;
+        if (_ECG_chunk.is_open==false || append_record(&_ECG_chunk,&record,sizeof(record))==false)
+        {
+            close_chunk(&_ECG_chunk);
+            if (open_chunk(&_ECG_chunk,SESSION_CHUNK_ECG,_ECG_seq,clock_model.get_time_ns((double)_ECG_seq),
+                           clock_model.get_nominal_rate(),sizeof(SESSION_ECG_RECORD_TDS))==false)
+            {
+                //no free buffer, samples are lost
+                _lost_ECG_samples=_lost_ECG_samples+(write_seq-_ECG_seq);
+                _ECG_seq=write_seq;
+                break;
+            }
+            append_record(&_ECG_chunk,&record,sizeof(record));
+        }
+        _ECG_seq++;
+        _ECG_chunk.next_seq=_ECG_seq;
+    }
+}
+
+void Session_recorder::collect_ICG(void)
+{
+    uint64_t oldest_seq=_MAX30009_process->get_oldest_seq();
+    uint64_t write_seq=_MAX30009_process->get_write_seq();
+    float decimation_ratio=_MAX30009_process->get_decimation_ratio();
+    if (_MAX30009_process->is_measure_running()==false || decimation_ratio<1)
+    {
+        //samples of calibration and stopped measure are not recorded
+        close_chunk(&_ICG_chunk);
+        _ICG_seq=write_seq;
+        _ICG_mark_seq=write_seq;
+        return;
+    }
+    if (_ICG_seq<oldest_seq)
+    {
+        _lost_ICG_samples=_lost_ICG_samples+(uint64_t)((oldest_seq-_ICG_seq)/decimation_ratio);
+        _ICG_seq=oldest_seq;
+    }
+
+    uint64_t next_seq=_ICG_seq;
+    std::vector<MAX30009_FIFO_DATA_CALIB_TYPE>& ICG_data=_ICG_data;
+    _MAX30009_process->get_decimate_IFIFO_data(_ICG_seq,0,&next_seq,&ICG_data);
+    collect_sync_marks(_MAX30009_process->get_sync_marks(),SESSION_DEVICE_MAX30009,next_seq,&_ICG_mark_seq);
+    if (ICG_data.empty()==true)
+    {
+        return;
+    }
+
+    if (_ICG_chunk.is_open==true && _ICG_chunk.next_seq!=_ICG_seq)
+    {
+        close_chunk(&_ICG_chunk);
+    }
+    Sample_clock_model& clock_model=_MAX30009_process->get_clock_model();
+    //time of point is middle of its ADC samples
+    double point_offset=((uint32_t)decimation_ratio-1)/2.0;
+    for (uint32_t i=0; i<ICG_data.size(); i++)
+    {
+        SESSION_ICG_RECORD_TDS record;
+        record.load_real=ICG_data[i].Load_real*10000.0;
+        record.load_mag=ICG_data[i].Load_mag*10000.0;
+        record.load_imag=ICG_data[i].Load_imag*10000.0;
+        record.load_angle=ICG_data[i].Load_angle*10000.0;
+        record.overload=ICG_data[i].overload;
+        if (_ICG_chunk.is_open==false || append_record(&_ICG_chunk,&record,sizeof(record))==false)
+        {
+            close_chunk(&_ICG_chunk);
+            uint64_t first_seq=_ICG_seq+(uint64_t)((float)i*decimation_ratio);
+            if (open_chunk(&_ICG_chunk,SESSION_CHUNK_ICG,first_seq,clock_model.get_time_ns((double)first_seq+point_offset),
+                           clock_model.get_nominal_rate()/decimation_ratio,sizeof(SESSION_ICG_RECORD_TDS))==false)
+            {
+                _lost_ICG_samples=_lost_ICG_samples+(ICG_data.size()-i);
+                break;
+            }
+            append_record(&_ICG_chunk,&record,sizeof(record));
+        }
+    }
+    _ICG_seq=next_seq;
+    _ICG_chunk.next_seq=next_seq;
+}
+
+void Session_recorder::collect_sync_marks(Sync_mark_index& sync_marks, SESSION_DEVICE_TDE device, uint64_t read_seq, uint64_t *mark_seq)
+{
+    for (uint32_t i=sync_marks.find(*mark_seq); i<sync_marks.get_size(); i++)
+    {
+        const SYNC_MARK_TDS& mark=sync_marks.get_mark(i);
+        if (mark.sample_count>=read_seq)
+        {
+            break;
+        }
+        if (_sync_chunk.is_open==false &&
+            open_chunk(&_sync_chunk,SESSION_CHUNK_SYNC,0,Sample_clock_model::get_monotonic_ns(),0,sizeof(SESSION_SYNC_RECORD_TDS))==false)
+        {
+            break;
+        }
+        SESSION_SYNC_RECORD_TDS record;
+        record.device=device;
+        record.sync_num=mark.sync_num;
+        record.sample_count=mark.sample_count;
+        record.time_ms=mark.time_ms;
+        if (append_record(&_sync_chunk,&record,sizeof(record))==false)
+        {
+            close_chunk(&_sync_chunk);
+            break;
+        }
+        *mark_seq=mark.sample_count+1;
+    }
+}
+
+SESSION_CHUNK_HEADER_TDS* Session_recorder::get_chunk_header(uint32_t buffer_index)
+{
+    return (SESSION_CHUNK_HEADER_TDS *)_chunk_buffers[buffer_index].data();
+}
+
+bool Session_recorder::open_chunk(CHUNK_BUILDER_TDS *builder, SESSION_CHUNK_TYPE_TDE type, uint64_t first_seq, int64_t first_time_ns,
+                                  double sample_rate, uint32_t record_size)
+{
+    uint32_t buffer_index;
+    if (_free_chunks.pop(&buffer_index)==false)
+    {
+        _dropped_chunks++;
+        return false;
+    }
+    SESSION_CHUNK_HEADER_TDS *header=get_chunk_header(buffer_index);
+    memset(header,0,sizeof(SESSION_CHUNK_HEADER_TDS));
+    header->magic=SESSION_CHUNK_MAGIC;
+    header->type=type;
+    header->header_size=sizeof(SESSION_CHUNK_HEADER_TDS);
+    header->first_seq=first_seq;
+    header->first_time_ns=first_time_ns;
+    header->sample_rate=sample_rate;
+    header->record_size=record_size;
+
+    builder->is_open=true;
+    builder->buffer_index=buffer_index;
+    builder->next_seq=first_seq;
+    builder->open_time=std::chrono::steady_clock::now();
+    return true;
+}
+
+bool Session_recorder::append_record(CHUNK_BUILDER_TDS *builder, const void *record, uint32_t size)
+{
+    SESSION_CHUNK_HEADER_TDS *header=get_chunk_header(builder->buffer_index);
+    if (header->header_size+header->payload_size+size>CHUNK_BUFFER_SIZE)
+    {
+        return false;
+    }
+    memcpy(_chunk_buffers[builder->buffer_index].data()+header->header_size+header->payload_size,record,size);
+    header->payload_size=header->payload_size+size;
+    if (header->record_size!=0)
+    {
+        header->record_count++;
+    }
+    return true;
+}
+
+void Session_recorder::close_chunk(CHUNK_BUILDER_TDS *builder)
+{
+    if (builder->is_open==false)
+    {
+        return;
+    }
+    builder->is_open=false;
+    SESSION_CHUNK_HEADER_TDS *header=get_chunk_header(builder->buffer_index);
+    if (header->payload_size==0)
+    {
+        //empty chunk is not written, buffer goes back through writer to keep queues single producer
+        header->type=0;
+    }
+    header->crc32=0;
+    header->crc32=CRC32::calculate(header,header->header_size+header->payload_size);
+    //queue has place for all buffers
+    _full_chunks.push(builder->buffer_index);
+}
+
+void Session_recorder::close_old_chunk(CHUNK_BUILDER_TDS *builder)
+{
+    if (builder->is_open==true &&
+        std::chrono::steady_clock::now()-builder->open_time>=std::chrono::milliseconds(CHUNK_DURATION_MS))
+    {
+        close_chunk(builder);
+    }
+}
+
+const std::string& Session_recorder::get_session_name(void)
+{
+    return _session_name;
+}
+
+bool Session_recorder::is_recording(void)
+{
+    return _is_recording;
+}
+
+std::string Session_recorder::get_status_as_json(void)
+{
+    _json_writer.clear();
+    _json_writer.begin_object();
+    _json_writer.key_value("type","recording_status");
+    _json_writer.key_value("is_recording",_is_recording);
+    _json_writer.key_value("session",_session_name);
+    _json_writer.key_value("segment",_segment_index.load(std::memory_order_relaxed));
+    _json_writer.key_value("fsync_interval_ms",_fsync_interval_ms);
+    _json_writer.key_value("max_segments",_max_segments);
+    _json_writer.key_value("bytes_written",_bytes_written.load(std::memory_order_relaxed));
+    _json_writer.key_value("chunks_written",_chunks_written.load(std::memory_order_relaxed));
+    _json_writer.key_value("queued_chunks",_full_chunks.get_size());
+    _json_writer.key_value("dropped_chunks",_dropped_chunks);
+    _json_writer.key_value("lost_ECG_samples",_lost_ECG_samples);
+    _json_writer.key_value("lost_ICG_samples",_lost_ICG_samples);
+    _json_writer.key_value("write_errors",_write_errors.load(std::memory_order_relaxed));
+    _json_writer.key_value("export_state",_BDF_exporter.get_state_name());
+    _json_writer.key_value("export_file",_BDF_exporter.get_filename());
+    _json_writer.end_object();
+    return _json_writer.get_string();
+}
+
+void Session_recorder::writer_process(void)
+{
+    //first segment is opened by start()
+    auto last_sync_time=std::chrono::steady_clock::now();
+    bool is_synced=true;
+    while (true)
+    {
+        //stop flag is read before queue, chunks queued before stop are written
+        bool is_stop=_writer_stop.load(std::memory_order_acquire);
+        uint32_t buffer_indexes[MAX_WRITE_BATCH];
+        uint32_t count=0;
+        while (count<MAX_WRITE_BATCH && _full_chunks.pop(&buffer_indexes[count])==true)
+        {
+            count++;
+        }
+        if (count>0)
+        {
+            write_chunks(buffer_indexes,count);
+            is_synced=false;
+            for (uint32_t i=0; i<count; i++)
+            {
+                _free_chunks.push(buffer_indexes[i]);
+            }
+        }
+
+        auto current_time=std::chrono::steady_clock::now();
+        if (is_synced==false && _segment_fd>=0 &&
+            (is_stop==true || current_time-last_sync_time>=std::chrono::milliseconds(_fsync_interval_ms)))
+        {
+            fdatasync(_segment_fd);
+            fdatasync(_index_fd);
+            last_sync_time=current_time;
+            is_synced=true;
+        }
+
+        if (count==0)
+        {
+            if (is_stop==true)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_PERIOD_MS));
+        }
+    }
+    close_segment();
+    _is_writer_running.store(false,std::memory_order_release);
+}
+
+bool Session_recorder::open_segment(uint32_t segment_index)
+{
+    std::string segment_filename=Session_segment_reader::get_segment_filename(_session_dir,segment_index,".rec");
+    std::string index_filename=Session_segment_reader::get_segment_filename(_session_dir,segment_index,".idx");
+
+    //existing file is never overwritten
+    _segment_fd=open(segment_filename.c_str(),O_WRONLY | O_CREAT | O_EXCL,0644);
+    if (_segment_fd<0)
+    {
+        perror("session segment open failed");
+        return false;
+    }
+    _index_fd=open(index_filename.c_str(),O_WRONLY | O_CREAT | O_EXCL,0644);
+    if (_index_fd<0)
+    {
+        perror("session index open failed");
+        close(_segment_fd);
+        _segment_fd=-1;
+        unlink(segment_filename.c_str());
+        return false;
+    }
+
+    SESSION_FILE_HEADER_TDS header;
+    memset(&header,0,sizeof(header));
+    header.magic=SESSION_FILE_MAGIC;
+    header.version=SESSION_FILE_VERSION;
+    header.header_size=sizeof(SESSION_FILE_HEADER_TDS);
+    header.segment_index=segment_index;
+    header.start_realtime_ns=_start_realtime_ns;
+    header.start_monotonic_ns=_start_monotonic_ns;
+    if (write(_segment_fd,&header,sizeof(header))!=(ssize_t)sizeof(header) ||
+        write(_index_fd,&header,sizeof(header))!=(ssize_t)sizeof(header))
+    {
+        perror("session header write failed");
+        close_segment();
+        return false;
+    }
+    _segment_size=sizeof(header);
+    _segment_index.store(segment_index,std::memory_order_relaxed);
+
+    //continuous recording keeps last segments only
+    if (_max_segments!=0 && segment_index>=_max_segments)
+    {
+        uint32_t old_index=segment_index-_max_segments;
+        unlink(Session_segment_reader::get_segment_filename(_session_dir,old_index,".rec").c_str());
+        unlink(Session_segment_reader::get_segment_filename(_session_dir,old_index,".idx").c_str());
+    }
+    return true;
+}
+
+void Session_recorder::close_segment(void)
+{
+    if (_segment_fd>=0)
+    {
+        fdatasync(_segment_fd);
+        close(_segment_fd);
+        _segment_fd=-1;
+    }
+    if (_index_fd>=0)
+    {
+        fdatasync(_index_fd);
+        close(_index_fd);
+        _index_fd=-1;
+    }
+}
+
+void Session_recorder::write_chunks(const uint32_t *buffer_indexes, uint32_t count)
+{
+    //chunks of one segment are written by one writev
+    uint32_t first=0;
+    uint64_t batch_size=0;
+    for (uint32_t i=0; i<count; i++)
+    {
+        SESSION_CHUNK_HEADER_TDS *header=get_chunk_header(buffer_indexes[i]);
+        uint64_t chunk_size=header->header_size+header->payload_size;
+        if (_segment_size+batch_size+chunk_size>SEGMENT_MAX_SIZE && _segment_size+batch_size>sizeof(SESSION_FILE_HEADER_TDS))
+        {
+            write_batch(buffer_indexes+first,i-first);
+            first=i;
+            batch_size=0;
+            close_segment();
+            if (open_segment(_segment_index.load(std::memory_order_relaxed)+1)==false)
+            {
+                _write_errors.fetch_add(1,std::memory_order_relaxed);
+            }
+        }
+        batch_size=batch_size+chunk_size;
+    }
+    write_batch(buffer_indexes+first,count-first);
+}
+
+void Session_recorder::write_batch(const uint32_t *buffer_indexes, uint32_t count)
+{
+    struct iovec chunks[MAX_WRITE_BATCH];
+    SESSION_INDEX_ENTRY_TDS entries[MAX_WRITE_BATCH];
+    uint32_t chunks_count=0;
+    uint64_t batch_size=0;
+    for (uint32_t i=0; i<count; i++)
+    {
+        SESSION_CHUNK_HEADER_TDS *header=get_chunk_header(buffer_indexes[i]);
+        if (header->type==0)
+        {
+            continue;
+        }
+        chunks[chunks_count].iov_base=header;
+        chunks[chunks_count].iov_len=header->header_size+header->payload_size;
+        SESSION_INDEX_ENTRY_TDS &entry=entries[chunks_count];
+        entry.type=header->type;
+        entry.reserved=0;
+        entry.record_count=header->record_count;
+        entry.offset=_segment_size+batch_size;
+        entry.first_seq=header->first_seq;
+        entry.first_time_ns=header->first_time_ns;
+        batch_size=batch_size+chunks[chunks_count].iov_len;
+        chunks_count++;
+    }
+    if (chunks_count==0)
+    {
+        return;
+    }
+    if (_segment_fd<0)
+    {
+        //segment is not open, data is lost
+        _write_errors.fetch_add(1,std::memory_order_relaxed);
+        return;
+    }
+
+    ssize_t result=writev(_segment_fd,chunks,chunks_count);
+    if (result!=(ssize_t)batch_size)
+    {
+        perror("session segment write failed");
+        _write_errors.fetch_add(1,std::memory_order_relaxed);
+        //torn chunk is found by reader by CRC, next chunk starts at file end
+        off_t file_size=lseek(_segment_fd,0,SEEK_END);
+        if (file_size>=0)
+        {
+            _segment_size=file_size;
+        }
+        return;
+    }
+    //index is written after chunks, entry always points to written chunk
+    size_t entries_size=chunks_count*sizeof(SESSION_INDEX_ENTRY_TDS);
+    if (write(_index_fd,entries,entries_size)!=(ssize_t)entries_size)
+    {
+        perror("session index write failed");
+        _write_errors.fetch_add(1,std::memory_order_relaxed);
+    }
+    _segment_size=_segment_size+batch_size;
+    _bytes_written.fetch_add(batch_size,std::memory_order_relaxed);
+    _chunks_written.fetch_add(chunks_count,std::memory_order_relaxed);
+}
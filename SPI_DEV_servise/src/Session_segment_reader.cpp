@@ -0,0 +1,222 @@
+#include "Session_segment_reader.h"
+#include "CRC32.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+Session_segment_reader::~Session_segment_reader()
+{
+    close();
+}
+
+bool Session_segment_reader::open(const std::string& session_dir, uint32_t segment_index)
+{
+    close();
+    _filename=get_segment_filename(session_dir,segment_index,".rec");
+    int fd=::open(_filename.c_str(),O_RDONLY);
+    if (fd<0)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd,&file_stat)<0 || (size_t)file_stat.st_size<sizeof(SESSION_FILE_HEADER_TDS))
+    {
+        ::close(fd);
+        return false;
+    }
+    _size=file_stat.st_size;
+    void *map=mmap(nullptr,_size,PROT_READ,MAP_SHARED,fd,0);
+    ::close(fd);
+    if (map==MAP_FAILED)
+    {
+        perror("session segment mmap failed");
+        _size=0;
+        return false;
+    }
+    _map=(const uint8_t *)map;
+
+    memcpy(&_file_header,_map,sizeof(SESSION_FILE_HEADER_TDS));
+    if (_file_header.magic!=SESSION_FILE_MAGIC || _file_header.version!=SESSION_FILE_VERSION ||
+        _file_header.header_size<sizeof(SESSION_FILE_HEADER_TDS) || _file_header.header_size>_size)
+    {
+        std::cout << _filename << " - wrong header" << std::endl;
+        close();
+        return false;
+    }
+
+    if (load_index(get_segment_filename(session_dir,segment_index,".idx"))==false)
+    {
+        rebuild_index();
+    }
+    return true;
+}
+
+void Session_segment_reader::close(void)
+{
+    if (_map!=nullptr)
+    {
+        munmap((void *)_map,_size);
+        _map=nullptr;
+    }
+    _size=0;
+    for (uint32_t i=0; i<CHUNK_TYPES_COUNT; i++)
+    {
+        _entries[i].clear();
+    }
+}
+
+const SESSION_FILE_HEADER_TDS& Session_segment_reader::get_file_header(void)
+{
+    return _file_header;
+}
+
+const std::string& Session_segment_reader::get_filename(void)
+{
+    return _filename;
+}
+
+uint32_t Session_segment_reader::get_chunks_count(SESSION_CHUNK_TYPE_TDE type)
+{
+    return _entries[type].size();
+}
+
+const SESSION_INDEX_ENTRY_TDS& Session_segment_reader::get_entry(SESSION_CHUNK_TYPE_TDE type, uint32_t position)
+{
+    return _entries[type][position];
+}
+
+uint32_t Session_segment_reader::find(SESSION_CHUNK_TYPE_TDE type, int64_t time_ns)
+{
+    const std::vector<SESSION_INDEX_ENTRY_TDS>& entries=_entries[type];
+    auto next=std::upper_bound(entries.begin(),entries.end(),time_ns,[](int64_t time, const SESSION_INDEX_ENTRY_TDS& entry)
+    {
+        return time<entry.first_time_ns;
+    });
+    if (next==entries.begin())
+    {
+        return 0;
+    }
+    return (next-entries.begin())-1;
+}
+
+const SESSION_CHUNK_HEADER_TDS* Session_segment_reader::get_chunk(const SESSION_INDEX_ENTRY_TDS& entry)
+{
+    if (check_chunk(entry.offset)==false)
+    {
+        return nullptr;
+    }
+    return (const SESSION_CHUNK_HEADER_TDS *)(_map+entry.offset);
+}
+
+bool Session_segment_reader::check_chunk(uint64_t offset)
+{
+    if (offset+sizeof(SESSION_CHUNK_HEADER_TDS)>_size)
+    {
+        return false;
+    }
+    SESSION_CHUNK_HEADER_TDS header;
+    memcpy(&header,_map+offset,sizeof(header));
+    if (header.magic!=SESSION_CHUNK_MAGIC || header.header_size!=sizeof(SESSION_CHUNK_HEADER_TDS) ||
+        offset+header.header_size+header.payload_size>_size)
+    {
+        return false;
+    }
+    uint32_t crc32=header.crc32;
+    header.crc32=0;
+    uint32_t calculated_crc32=CRC32::calculate(&header,sizeof(header));
+    calculated_crc32=CRC32::calculate(_map+offset+header.header_size,header.payload_size,calculated_crc32);
+    return calculated_crc32==crc32;
+}
+
+bool Session_segment_reader::load_index(const std::string& index_filename)
+{
+    int fd=::open(index_filename.c_str(),O_RDONLY);
+    if (fd<0)
+    {
+        return false;
+    }
+    SESSION_FILE_HEADER_TDS header;
+    if (read(fd,&header,sizeof(header))!=(ssize_t)sizeof(header) || header.magic!=SESSION_FILE_MAGIC ||
+        lseek(fd,header.header_size,SEEK_SET)<0)
+    {
+        ::close(fd);
+        return false;
+    }
+    SESSION_INDEX_ENTRY_TDS entries[256];
+    ssize_t bytes_read;
+    while ((bytes_read=read(fd,entries,sizeof(entries)))>0)
+    {
+        //entry of chunk which is not in mapped part of segment is dropped
+        for (uint32_t i=0; i<bytes_read/sizeof(SESSION_INDEX_ENTRY_TDS); i++)
+        {
+            if (entries[i].type<CHUNK_TYPES_COUNT && entries[i].offset+sizeof(SESSION_CHUNK_HEADER_TDS)<=_size)
+            {
+                _entries[entries[i].type].push_back(entries[i]);
+            }
+        }
+    }
+    ::close(fd);
+    return true;
+}
+
+void Session_segment_reader::rebuild_index(void)
+{
+    //chunks are read until first damaged chunk
+    uint64_t offset=_file_header.header_size;
+    while (check_chunk(offset)==true)
+    {
+        const SESSION_CHUNK_HEADER_TDS *header=(const SESSION_CHUNK_HEADER_TDS *)(_map+offset);
+        if (header->type<CHUNK_TYPES_COUNT)
+        {
+            SESSION_INDEX_ENTRY_TDS entry;
+            entry.type=header->type;
+            entry.reserved=0;
+            entry.record_count=header->record_count;
+            entry.offset=offset;
+            entry.first_seq=header->first_seq;
+            entry.first_time_ns=header->first_time_ns;
+            _entries[entry.type].push_back(entry);
+        }
+        offset=offset+header->header_size+header->payload_size;
+    }
+    std::cout << _filename << " - index is rebuilt" << std::endl;
+}
+
+std::string Session_segment_reader::get_segment_filename(const std::string& session_dir, uint32_t segment_index, const char *extension)
+{
+    char name[32];
+    snprintf(name,sizeof(name),"/segment_%06u%s",segment_index,extension);
+    return session_dir+name;
+}
+
+std::vector<uint32_t> Session_segment_reader::list_segments(const std::string& session_dir)
+{
+    std::vector<uint32_t> segments;
+    DIR *dir=opendir(session_dir.c_str());
+    if (dir==nullptr)
+    {
+        return segments;
+    }
+    struct dirent *item;
+    while ((item=readdir(dir))!=nullptr)
+    {
+        uint32_t segment_index;
+        char extension[8];
+        if (sscanf(item->d_name,"segment_%u.%7s",&segment_index,extension)==2 && strcmp(extension,"rec")==0)
+        {
+            segments.push_back(segment_index);
+        }
+    }
+    closedir(dir);
+    std::sort(segments.begin(),segments.end());
+    return segments;
+}
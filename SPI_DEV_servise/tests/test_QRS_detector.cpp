@@ -0,0 +1,118 @@
+//host test of QRS detector on synthetic ECG, run by test_signal_processing.py:
+//g++ -std=c++17 -Iinclude tests/test_QRS_detector.cpp -o test_QRS_detector && ./test_QRS_detector
+#include "QRS_detector.h"
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <vector>
+
+static const uint64_t START_SEQ=1000;
+static const double MAX_R_ERROR=0.005;      // seconds
+static const double SMALL_BEAT_AMPLITUDE=0.42;
+
+typedef struct SYNTHETIC_BEAT
+{
+    double time;        // seconds of R peak
+    double amplitude;   // of QRS, 1 - normal beat
+} SYNTHETIC_BEAT_TDS;
+
+//3 leads of ADC codes: QRS, T wave, baseline wander, mains and noise
+static void make_sample(double t, const std::vector<SYNTHETIC_BEAT_TDS>& beats, std::mt19937 *generator, int32_t *values)
+{
+    std::normal_distribution<double> noise(0,2000);
+    double v=50000*std::sin(2*M_PI*0.3*t)+8000*std::sin(2*M_PI*50*t);
+    for (const SYNTHETIC_BEAT_TDS& beat : beats)
+    {
+        double dt=t-beat.time;
+        if (std::fabs(dt)<1.0)
+        {
+            v+=beat.amplitude*(100000*std::exp(-dt*dt/(2*0.01*0.01))-20000*std::exp(-(dt+0.02)*(dt+0.02)/(2*0.008*0.008)))+
+               30000*std::exp(-(dt-0.25)*(dt-0.25)/(2*0.04*0.04));
+        }
+    }
+    values[0]=(int32_t)(v+noise(*generator));
+    values[1]=(int32_t)(0.5*v+noise(*generator));
+    values[2]=(int32_t)(-0.7*v+noise(*generator));
+}
+
+//beats of regular rhythm, one beat is too small for threshold and is found by search back
+static bool test_search_back(double sample_rate)
+{
+    std::vector<SYNTHETIC_BEAT_TDS> beats;
+    uint32_t small_index=0;
+    for (double t=0.5; t<30; t+=0.83)
+    {
+        if (small_index==0 && t>15)
+        {
+            small_index=beats.size();
+        }
+        beats.push_back({t,beats.size()==small_index ? SMALL_BEAT_AMPLITUDE : 1.0});
+    }
+
+    QRS_detector<3> detector;
+    detector.reset(sample_rate,START_SEQ);
+    std::mt19937 generator(1);
+    uint32_t detected=0;
+    uint32_t expected=0;
+    bool is_small_found=false;
+    bool result=true;
+    for (const SYNTHETIC_BEAT_TDS& beat : beats)
+    {
+        //first beats are in learning period, beat is final after refractory period
+        expected+=beat.time>QRS_detector<3>::LEARNING_DURATION && beat.time<30-QRS_detector<3>::REFRACTORY_DURATION-0.1;
+    }
+
+    uint32_t count=30*sample_rate;
+    for (uint32_t i=0; i<count; i++)
+    {
+        int32_t values[3];
+        make_sample(i/sample_rate,beats,&generator,values);
+        QRS_BEAT_TDS beat;
+        if (detector.push(values,&beat)==false)
+        {
+            continue;
+        }
+        detected++;
+        double time=(beat.seq-START_SEQ)/sample_rate;
+        const SYNTHETIC_BEAT_TDS *nearest=&beats[0];
+        for (const SYNTHETIC_BEAT_TDS& synthetic : beats)
+        {
+            if (std::fabs(synthetic.time-time)<std::fabs(nearest->time-time))
+            {
+                nearest=&synthetic;
+            }
+        }
+        double error=time-nearest->time;
+        if (std::fabs(error)>MAX_R_ERROR)
+        {
+            printf("%g Hz: beat at %.3f s, R error %.1f ms, confidence %.2f\n",sample_rate,time,error*1000,beat.confidence);
+            result=false;
+        }
+        if (nearest==&beats[small_index])
+        {
+            is_small_found=true;
+            if (beat.confidence>=0.5)
+            {
+                printf("%g Hz: small beat is not found by search back, confidence %.2f\n",sample_rate,beat.confidence);
+                result=false;
+            }
+        }
+    }
+    if (is_small_found==false || detected!=expected)
+    {
+        printf("%g Hz: %u beats of %u, small beat %s\n",sample_rate,detected,expected,is_small_found ? "found" : "missed");
+        result=false;
+    }
+    printf("%g Hz: search back %s\n",sample_rate,result ? "OK" : "FAILED");
+    return result;
+}
+
+int main()
+{
+    bool result=true;
+    for (double sample_rate : {200.0,500.0,1600.0})
+    {
+        result=test_search_back(sample_rate) && result;
+    }
+    return result ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+//host test of polyphase resampler on synthetic tones, run by test_signal_processing.py:
+//g++ -std=c++17 -Iinclude tests/test_polyphase_resampler.cpp -o test_polyphase_resampler && ./test_polyphase_resampler
+#include "Polyphase_resampler.h"
+#include <cstdio>
+#include <cmath>
+#include <vector>
+
+static const double CUTOFF_MARGIN=0.9;      // as in ECG_ICG_align_process
+static const double POSITION_OFFSET=0.37;   // output grid is between input samples
+
+//amplitude of tone after resampling from input_rate to output_rate
+static double get_output_amplitude(double input_rate, double output_rate, double frequency, double level)
+{
+    double cutoff=output_rate<input_rate ? output_rate/input_rate*CUTOFF_MARGIN : 1.0;
+    Polyphase_resampler resampler(cutoff);
+    uint32_t count=(uint32_t)(4*input_rate);
+    std::vector<float> samples(count);
+    for (uint32_t i=0; i<count; i++)
+    {
+        samples[i]=level+std::sin(2*M_PI*frequency*i/input_rate);
+    }
+
+    //amplitude of output tone is fitted, output values are not on its peaks
+    double step=input_rate/output_rate;
+    double sin_sum=0;
+    double cos_sum=0;
+    uint32_t points=0;
+    for (double position=resampler.get_half_taps()+POSITION_OFFSET; position<count-resampler.get_half_taps()-1; position+=step)
+    {
+        double value=resampler.get_value(samples.data(),count,position)-level;
+        double phase=2*M_PI*frequency*position/input_rate;
+        sin_sum+=value*std::sin(phase);
+        cos_sum+=value*std::cos(phase);
+        points++;
+    }
+    return 2*std::hypot(sin_sum,cos_sum)/points;
+}
+
+static bool check(const char *name, double value, double min_value, double max_value)
+{
+    bool result=value>=min_value && value<=max_value;
+    printf("%s: %.4f %s\n",name,value,result ? "OK" : "FAILED");
+    return result;
+}
+
+int main()
+{
+    bool result=true;
+    //ECG on ICG grid: tone above new Nyquist frequency is attenuated, tone in band and DC level are kept
+    result=check("1600->50 Hz, 40 Hz tone",get_output_amplitude(1600,50,40,1000),0,0.01) && result;
+    result=check("1600->50 Hz, 30 Hz tone",get_output_amplitude(1600,50,30,1000),0,0.01) && result;
+    result=check("1600->50 Hz, 5 Hz tone",get_output_amplitude(1600,50,5,1000),0.98,1.01) && result;
+    result=check("500->100 Hz, 70 Hz tone",get_output_amplitude(500,100,70,0),0,0.01) && result;
+    result=check("500->100 Hz, 10 Hz tone",get_output_amplitude(500,100,10,0),0.98,1.01) && result;
+    //upsampling: fractional positions of tone below Nyquist
+    result=check("100->500 Hz, 20 Hz tone",get_output_amplitude(100,500,20,0),0.98,1.01) && result;
+    return result ? 0 : 1;
+}
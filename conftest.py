@@ -0,0 +1,102 @@
+"""
+Common helpers of service port tests (pytest)
+
+Tests run against the live service, host is set by SENSOR_HOST (default: localhost).
+Test is skipped when the service does not listen on its port.
+Every port serves one client at a time - helpers close connection after command.
+
+Usage:
+    pytest test_align.py
+    SENSOR_HOST=192.168.1.100 pytest test_align.py
+"""
+
+import os
+import json
+import socket
+import time
+from typing import Any, Callable, Dict, Optional
+
+import pytest
+
+HOST = os.environ.get("SENSOR_HOST", "localhost")
+TIMEOUT = 10  # seconds
+
+ADS1293_PORT = 1293
+MAX30009_PORT = 30009
+WS2812_PORT = 2812
+ALIGN_PORT = 1294
+MUX_PORT = 1290
+QUERY_PORT = 1295
+FEATURE_PORT = 1296
+HEMO_PORT = 1297
+
+
+class ServiceConnection:
+    """Client connection, response is JSON line (binary data of response follows JSON line)"""
+
+    def __init__(self, port: int, timeout: float = TIMEOUT):
+        try:
+            self.sock = socket.create_connection((HOST, port), timeout=timeout)
+        except (ConnectionRefusedError, socket.timeout) as e:
+            pytest.skip(f"service is not available on {HOST}:{port} ({e})")
+        self.stream = self.sock.makefile("rb")
+        self.stream.readline()  # welcome message
+
+    def send(self, command: Dict[str, Any]) -> Dict[str, Any]:
+        """Send command and return its response"""
+        self.sock.sendall((json.dumps(command) + "\n").encode())
+        return self.read_response()
+
+    def read_response(self) -> Dict[str, Any]:
+        line = self.stream.readline()
+        if not line:
+            raise ConnectionError("connection is closed by service")
+        return json.loads(line.decode())
+
+    def read_binary(self, size: int) -> bytes:
+        return self.stream.read(size)
+
+    def close(self):
+        self.stream.close()
+        self.sock.close()
+
+
+def send_command(port: int, command: Dict[str, Any], timeout: float = TIMEOUT) -> Dict[str, Any]:
+    """Send one command on new connection"""
+    connection = ServiceConnection(port, timeout)
+    try:
+        return connection.send(command)
+    finally:
+        connection.close()
+
+
+def wait_for(port: int, command: Dict[str, Any], condition: Callable[[Dict[str, Any]], bool],
+             timeout: float = 10.0, period: float = 0.5) -> Optional[Dict[str, Any]]:
+    """Repeat command until condition(response) is true, None after timeout"""
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        response = send_command(port, command)
+        if condition(response):
+            return response
+        time.sleep(period)
+    return None
+
+
+@pytest.fixture
+def ecg_running():
+    """ADS1293 converts at 640 Hz (102400 / (4 * R2_rate * R3_rate))"""
+    response = send_command(ADS1293_PORT, {"type": "settings", "power_enable": True, "enable_conversion": True,
+                                           "R2_rate": 5, "R3_rate": 8})
+    assert response["type"] == "actual_settings"
+    time.sleep(1)
+    return response
+
+
+@pytest.fixture
+def icg_running():
+    """MAX30009 measures at 100 Hz"""
+    response = send_command(MAX30009_PORT, {"type": "settings", "power_enable": True, "measure_enable": True,
+                                            "measure_frequency": 100})
+    assert response["type"] == "actual_settings"
+    time.sleep(1)
+    return response
@@ -63,11 +63,11 @@ def create_test_cases_excel():
         {
             "Test ID": "SPI-003",
             "Area": "MAX30009 Sync Marks",
-            "Objective": "Verify sync marks injected every 1 second with magic number -99999",
+            "Objective": "Verify sync marks added every 1 second in sync_marks index",
             "Linked IDs (Hazard/SRS/Task)": "SRS-SPI-003",
             "Preconditions": "MAX30009 streaming data",
-            "Steps": "1. Start MAX30009 data acquisition\n2. Monitor data stream for 60 seconds\n3. Count sync marks\n4. Verify magic number -99999 at sync positions",
-            "Expected": "Exactly 60 sync marks with value -99999, evenly spaced at 1-second intervals",
+            "Steps": "1. Start MAX30009 data acquisition\n2. Monitor data stream for 60 seconds\n3. Count sync marks\n4. Verify sync_marks positions point into data array",
+            "Expected": "Exactly 60 sync marks in sync_marks, evenly spaced at 1-second intervals",
             "Dataset": "60 second capture",
             "Priority": "High",
             "Result": "",
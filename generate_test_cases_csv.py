@@ -16,7 +16,7 @@ def create_test_cases_csv():
     spi_tests = [
         ["SPI-001", "MAX30009 Communication", "Verify MAX30009 TCP server accepts connections on port 30009", "SRS-SPI-001", "SPI_DEV_servise running, network available", "1. Start SPI_DEV_servise\n2. Connect to localhost:30009 via telnet\n3. Verify connection established", "TCP connection established successfully, server ready to receive JSON commands", "N/A", "High", "", ""],
         ["SPI-002", "MAX30009 Data Acquisition", "Verify MAX30009 bioimpedance data streaming with I/Q samples", "SRS-SPI-002, HAZ-001", "MAX30009 initialized, sensor configured, hardware connected", "1. Send JSON start command to port 30009\n2. Configure frequency (25Hz-450kHz) and current (64μA-1.28mA)\n3. Start data acquisition\n4. Verify I/Q data FIFO buffering (max 30,000 samples)", "I/Q data stream received continuously, FIFO does not overflow, data format correct", "freq=100kHz, current=500μA", "Critical", "", ""],
-        ["SPI-003", "MAX30009 Sync Marks", "Verify sync marks injected every 1 second with magic number -99999", "SRS-SPI-003", "MAX30009 streaming data", "1. Start MAX30009 data acquisition\n2. Monitor data stream for 60 seconds\n3. Count sync marks\n4. Verify magic number -99999 at sync positions", "Exactly 60 sync marks with value -99999, evenly spaced at 1-second intervals", "60 second capture", "High", "", ""],
+        ["SPI-003", "MAX30009 Sync Marks", "Verify sync marks added every 1 second in sync_marks index", "SRS-SPI-003", "MAX30009 streaming data", "1. Start MAX30009 data acquisition\n2. Monitor data stream for 60 seconds\n3. Count sync marks\n4. Verify sync_marks positions point into data array", "Exactly 60 sync marks in sync_marks, evenly spaced at 1-second intervals", "60 second capture", "High", "", ""],
         ["SPI-004", "MAX30009 Calibration", "Verify automated calibration system across 17 frequency points × 5 current levels", "SRS-SPI-004", "Calibration reference load connected, calib/ directory exists", "1. Send calibration start command\n2. Monitor calibration progress (85 total points)\n3. Verify JSON files created in calib/ with format {current_index}_{freq_index}.json\n4. Validate calibration data structure", "85 calibration files created successfully, data within expected ranges, no missing points", "Full calibration sweep", "High", "", ""],
         ["SPI-005", "ADS1293 Communication", "Verify ADS1293 TCP server accepts connections on port 1293", "SRS-SPI-005", "SPI_DEV_servise running, network available", "1. Start SPI_DEV_servise\n2. Connect to localhost:1293 via telnet\n3. Verify connection established", "TCP connection established successfully, server ready to receive JSON commands", "N/A", "High", "", ""],
         ["SPI-006", "ADS1293 ECG Acquisition", "Verify multi-channel ECG data acquisition and streaming", "SRS-SPI-006, HAZ-002", "ADS1293 initialized, ECG electrodes connected", "1. Send JSON start command to port 1293\n2. Configure ECG channels\n3. Start data acquisition\n4. Monitor data quality and continuity", "Multi-channel ECG data streamed continuously, no data gaps, signal quality acceptable", "3-lead ECG", "Critical", "", ""],
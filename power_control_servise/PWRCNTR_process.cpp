@@ -79,89 +79,99 @@ std::string PWRCNTR_process::process_JSON_line(const char * JSON_line)
 {
     std::cout << "IN:" << JSON_line << std::endl << std::endl;
 
+    std::string_view command_type;
+    std::string_view key;
+    int32_t duration=0;
+    bool duration_found=false;
 
-
-    json parsed_json;
-    json response;
-
-    try
+    JSON_command_parser parser(JSON_line);
+    if (parser.begin_object()==true)
     {
-        parsed_json = json::parse(JSON_line);
-
-        if (parsed_json.contains("type"))
+        while (parser.next_key(&key)==true)
         {
-
-            std::string command_type = parsed_json["type"];
-
-            if (command_type == "get_batt_info")
-            {
-                response["type"] = "batt_info";
-                response["voltage"] = _BATT.voltage;
-                response["temperature"] = _BATT.temperature;
-                response["current"] = _BATT.current;
-                response["relative_state_of_charge"] = _BATT.relative_state_of_charge;
-                response["remaining_capacity"] = _BATT.remaining_capacity;
-                response["full_charge_capacity"] = _BATT.full_charge_capacity;
-                response["run_time_to_empty"] = _BATT.run_time_to_empty;
-                response["average_time_to_empty"] = _BATT.average_time_to_empty;
-                response["average_time_to_full"] = _BATT.average_time_to_full;
-                response["cycle_count"] = _BATT.cycle_count;
-                response["design_capacity"] = _BATT.design_capacity;
-                response["design_voltage"] = _BATT.design_voltage;
-
-                bool fully_discharged=_BATT.status.fully_discharged;
-                bool fully_charged=_BATT.status.fully_charged;
-                bool discharging=_BATT.status.discharging;
-
-                response["fully_discharged"] = fully_discharged;
-                response["fully_charged"] = fully_charged;
-                response["discharging"] = discharging;
-                response["charging"] = !discharging;
-
-                _BATT.charger_is_connect=(bool)GPIO_POWER_KEY.get_GPIO_state();
-                response["charger_is_connect"] =  _BATT.charger_is_connect;
-
-                response["battery_charge_is_disable"] = _BATT.battery_charge_is_disable;
-
-                std::string response_string = response.dump();
-                return response_string;
-            }
-
-            if (command_type == "charge_disable")
+            if (key=="type")
             {
-                response["type"] = "charge_is_disable";
-                _BATT.battery_charge_is_disable=true;
-                GPIO_CHARGE_DISABLE.set_GPIO_state(VT_GPIO_SET);
-                std::string response_string = response.dump();
-                return response_string;
+                parser.read_string(&command_type);
             }
-            if (command_type == "charge_enable")
+            else if (key=="duration")
             {
-                response["type"] = "charge_is_enable";
-                _BATT.battery_charge_is_disable=false;
-                GPIO_CHARGE_DISABLE.set_GPIO_state(VT_GPIO_UNSET);
-                std::string response_string = response.dump();
-                return response_string;
+                duration_found=parser.read_number(&duration);
             }
-            if (command_type == "buzzer")
+            else
             {
-
-                if (parsed_json.contains("duration"))
-                {
-                    _buzzer_timer= parsed_json["duration"];
-                }
-                if (_buzzer_timer<0 || _buzzer_timer>100)
-                {
-                    _buzzer_timer=0;
-                }
-                process_buzzer();
-                return "";
+                parser.skip_value();
             }
         }
     }
-    catch (const std::exception& e)
+
+    json response;
+
+    if (parser.is_finished()==true)
     {
+        if (command_type == "get_batt_info")
+        {
+            response["type"] = "batt_info";
+            response["voltage"] = _BATT.voltage;
+            response["temperature"] = _BATT.temperature;
+            response["current"] = _BATT.current;
+            response["relative_state_of_charge"] = _BATT.relative_state_of_charge;
+            response["remaining_capacity"] = _BATT.remaining_capacity;
+            response["full_charge_capacity"] = _BATT.full_charge_capacity;
+            response["run_time_to_empty"] = _BATT.run_time_to_empty;
+            response["average_time_to_empty"] = _BATT.average_time_to_empty;
+            response["average_time_to_full"] = _BATT.average_time_to_full;
+            response["cycle_count"] = _BATT.cycle_count;
+            response["design_capacity"] = _BATT.design_capacity;
+            response["design_voltage"] = _BATT.design_voltage;
+
+            bool fully_discharged=_BATT.status.fully_discharged;
+            bool fully_charged=_BATT.status.fully_charged;
+            bool discharging=_BATT.status.discharging;
+
+            response["fully_discharged"] = fully_discharged;
+            response["fully_charged"] = fully_charged;
+            response["discharging"] = discharging;
+            response["charging"] = !discharging;
+
+            _BATT.charger_is_connect=(bool)GPIO_POWER_KEY.get_GPIO_state();
+            response["charger_is_connect"] =  _BATT.charger_is_connect;
+
+            response["battery_charge_is_disable"] = _BATT.battery_charge_is_disable;
+
+            std::string response_string = response.dump();
+            return response_string;
+        }
+
+        if (command_type == "charge_disable")
+        {
+            response["type"] = "charge_is_disable";
+            _BATT.battery_charge_is_disable=true;
+            GPIO_CHARGE_DISABLE.set_GPIO_state(VT_GPIO_SET);
+            std::string response_string = response.dump();
+            return response_string;
+        }
+        if (command_type == "charge_enable")
+        {
+            response["type"] = "charge_is_enable";
+            _BATT.battery_charge_is_disable=false;
+            GPIO_CHARGE_DISABLE.set_GPIO_state(VT_GPIO_UNSET);
+            std::string response_string = response.dump();
+            return response_string;
+        }
+        if (command_type == "buzzer")
+        {
 
+            if (duration_found==true)
+            {
+                _buzzer_timer=duration;
+            }
+            if (_buzzer_timer<0 || _buzzer_timer>100)
+            {
+                _buzzer_timer=0;
+            }
+            process_buzzer();
+            return "";
+        }
     }
 
     response["type"] = "error JSON";
@@ -7,6 +7,7 @@
 
 #include "VT_SMBUS_driver.h"
 #include "SES_battery_info.h"
+#include "JSON_command_parser.h"
 
 #include <chrono>
 #include <thread>
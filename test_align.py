@@ -0,0 +1,66 @@
+"""
+Aligned ECG+ICG tests (port 1294)
+
+get_aligned_data resamples both streams to one time grid. Frame is
+[ecg_ch1, ecg_ch2, ecg_ch3, load_real, load_mag, load_imag, load_angle, overload], from_time_ns is cursor of grid.
+Run: pytest test_align.py
+"""
+
+import time
+
+from conftest import ALIGN_PORT, MAX30009_PORT, send_command
+
+
+def test_frame_format(ecg_running, icg_running):
+    time.sleep(2)
+    response = send_command(ALIGN_PORT, {"type": "get_aligned_data"})
+    assert response["type"] == "aligned_data"
+    # default grid is nominal ECG rate
+    assert response["sample_rate"] == 640
+    assert response["data_size"] == len(response["data"]) > 0
+    assert all(len(frame) == 8 for frame in response["data"])
+    assert "lost_samples" in response and "drift_ppm" in response
+
+
+def test_cursor_continuity(ecg_running, icg_running):
+    time.sleep(2)
+    first = send_command(ALIGN_PORT, {"type": "get_aligned_data", "sample_rate": 500, "max_samples": 200})
+    assert first["data_size"] == 200
+    # grid points are 2 ms apart
+    assert abs(first["next_time_ns"] - first["first_time_ns"] - 200 * 2000000) <= 1
+    time.sleep(0.5)
+    following = send_command(ALIGN_PORT, {"type": "get_aligned_data", "sample_rate": 500,
+                                          "from_time_ns": first["next_time_ns"]})
+    assert following["first_time_ns"] == first["next_time_ns"]
+    assert following["skipped_samples"] == 0
+    assert following["data_size"] > 0
+
+
+def test_decimated_grid(ecg_running, icg_running):
+    time.sleep(3)
+    first = send_command(ALIGN_PORT, {"type": "get_aligned_data", "sample_rate": 50})
+    time.sleep(2)
+    following = send_command(ALIGN_PORT, {"type": "get_aligned_data", "sample_rate": 50,
+                                          "from_time_ns": first["next_time_ns"]})
+    assert following["sample_rate"] == 50
+    # about 2 s of 50 Hz grid, input halo of anti aliasing filter delays the end of grid
+    assert 80 <= following["data_size"] <= 120
+    assert abs(following["next_time_ns"] - following["first_time_ns"] - following["data_size"] * 20000000) <= 1
+
+
+def test_sample_rate_limit(ecg_running, icg_running):
+    response = send_command(ALIGN_PORT, {"type": "get_aligned_data", "sample_rate": 10000, "max_samples": 10})
+    assert response["sample_rate"] == 4000
+
+
+def test_empty_frame_when_icg_stopped(ecg_running):
+    send_command(MAX30009_PORT, {"type": "settings", "measure_enable": False})
+    response = send_command(ALIGN_PORT, {"type": "get_aligned_data"})
+    assert response["type"] == "aligned_data"
+    assert response["data_size"] == 0 and response["data"] == []
+    assert response["next_time_ns"] == response["first_time_ns"]
+
+
+def test_errors():
+    assert send_command(ALIGN_PORT, {"type": "get_data"})["type"] == "error JSON"
+    assert send_command(ALIGN_PORT, {"type": "get_aligned_data", "sample_rate": "fast"})["type"] == "error JSON"
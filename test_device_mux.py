@@ -0,0 +1,113 @@
+"""
+Multiplexed endpoint tests (port 1290)
+
+One connection for all devices, command has "device" key, batch gets responses of all commands.
+Run: pytest test_device_mux.py
+"""
+
+import time
+
+from conftest import ADS1293_PORT, MAX30009_PORT, MUX_PORT, send_command, ServiceConnection
+
+
+def test_single_command(ecg_running):
+    response = send_command(MUX_PORT, {"device": "ADS1293", "type": "get_data"})
+    assert response["device"] == "ADS1293"
+    assert response["response"]["type"] == "data"
+
+
+def test_unknown_device():
+    response = send_command(MUX_PORT, {"device": "UNKNOWN", "type": "get_data"})
+    assert response["type"] == "error device"
+
+
+def test_raw_data_only_on_device_port(icg_running):
+    # binary data is not sent by mux, command is not run
+    connection = ServiceConnection(MAX30009_PORT)
+    try:
+        connection.sock.sendall(b'{"type":"get_data", "min_samples":1000000, "timeout_ms":3000}\n')
+        time.sleep(0.5)
+        response = send_command(MUX_PORT, {"device": "MAX30009", "type": "get_raw_data"})
+        assert response["response"]["type"] == "error device"
+        assert connection.read_response()["type"] == "data"
+    finally:
+        connection.close()
+
+
+def test_malformed_json():
+    connection = ServiceConnection(MUX_PORT)
+    try:
+        connection.sock.sendall(b'{"device":"ADS1293", "type":\n')
+        assert connection.read_response()["type"] == "error JSON"
+    finally:
+        connection.close()
+
+
+def test_batch_responses_in_order(ecg_running, icg_running):
+    response = send_command(MUX_PORT, {"type": "batch", "requests": [
+        {"device": "ADS1293", "type": "get_data"},
+        {"device": "MAX30009", "type": "get_data", "min_samples": 20, "timeout_ms": 1000},
+        {"device": "WS2812", "leds": [[0, 255, 0]], "t_time": 100}
+    ]})
+    assert response["type"] == "batch"
+    assert [r["device"] for r in response["responses"]] == ["ADS1293", "MAX30009", "WS2812"]
+    assert response["responses"][0]["response"]["type"] == "data"
+    assert response["responses"][1]["response"]["type"] == "data"
+    assert response["responses"][2]["response"]["type"] == "colors_is_set"
+
+
+def test_batch_long_poll_timeout(ecg_running):
+    start = time.time()
+    response = send_command(MUX_PORT, {"type": "batch", "requests": [
+        {"device": "ADS1293", "type": "get_data", "min_samples": 1000000, "timeout_ms": 1000}
+    ]})
+    elapsed = time.time() - start
+    assert response["responses"][0]["response"]["type"] == "data"
+    assert 0.9 <= elapsed < 5.0
+
+
+def test_batch_unknown_device_runs_nothing():
+    response = send_command(MUX_PORT, {"type": "batch", "requests": [
+        {"device": "WS2812", "leds": [[255, 0, 0]], "t_time": 100},
+        {"device": "UNKNOWN", "type": "get_data"}
+    ]})
+    assert response["type"] == "error device"
+
+
+def test_batch_empty():
+    response = send_command(MUX_PORT, {"type": "batch", "requests": []})
+    assert response["type"] == "error JSON"
+
+
+def test_batch_one_command_per_waiting_device(ecg_running):
+    # device has one waiting request, second command of batch would cancel it
+    for requests in (
+        [{"device": "ADS1293", "type": "get_data", "min_samples": 1000000, "timeout_ms": 1000},
+         {"device": "ADS1293", "type": "get_beats", "min_samples": 1, "timeout_ms": 1000}],
+        [{"device": "ADS1293", "type": "get_data", "min_samples": 1000000, "timeout_ms": 1000},
+         {"device": "ADS1293", "type": "get_filter"}],
+        [{"device": "MAX30009", "type": "get_data"},
+         {"device": "MAX30009", "type": "get_taps"}],
+    ):
+        response = send_command(MUX_PORT, {"type": "batch", "requests": requests})
+        assert response["type"] == "error device"
+
+    # devices without waiting requests can have several commands
+    response = send_command(MUX_PORT, {"type": "batch", "requests": [
+        {"device": "WS2812", "leds": [[0, 0, 255]], "t_time": 100},
+        {"device": "WS2812", "leds": [[0, 0, 0]], "t_time": 100}
+    ]})
+    assert [r["response"]["type"] for r in response["responses"]] == ["colors_is_set", "colors_is_set"]
+
+
+def test_device_port_command_cancels_mux_request(ecg_running):
+    connection = ServiceConnection(MUX_PORT)
+    try:
+        connection.sock.sendall(b'{"device":"ADS1293", "type":"get_data", "min_samples":1000000, "timeout_ms":3000}\n')
+        time.sleep(0.5)
+        assert send_command(ADS1293_PORT, {"type": "settings", "power_enable": True, "enable_conversion": True,
+                                             "R2_rate": 5, "R3_rate": 8})["type"] == "actual_settings"
+        response = connection.read_response()
+        assert response["response"]["type"] == "canceled"
+    finally:
+        connection.close()
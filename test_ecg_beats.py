@@ -0,0 +1,74 @@
+"""
+R-peak event stream tests (port 1293)
+
+get_beats reads beat ring as get_data reads samples: from_seq/max_samples are beat numbers, min_samples/timeout_ms wait.
+Beat is [sample_seq, time_ns, RR_ms, heart_rate, confidence].
+Run: pytest test_ecg_beats.py
+"""
+
+import time
+
+from conftest import ADS1293_PORT, send_command
+
+
+def test_beats_enabled(ecg_running):
+    response = send_command(ADS1293_PORT, {"type": "get_beats", "from_seq": 0})
+    assert response["type"] == "beats"
+    assert response["enabled"] is True
+    assert response["data_size"] == response["next_seq"] - response["first_seq"] == len(response["data"])
+
+
+def test_cursor_continuity(ecg_running):
+    time.sleep(5)
+    first = send_command(ADS1293_PORT, {"type": "get_beats", "from_seq": 0})
+    following = send_command(ADS1293_PORT, {"type": "get_beats", "from_seq": first["next_seq"],
+                                            "min_samples": 2, "timeout_ms": 4000})
+    assert following["first_seq"] == first["next_seq"]
+    assert following["skipped_beats"] == 0
+    assert following["next_seq"] - following["first_seq"] == following["data_size"]
+
+
+def test_beat_seq_order(ecg_running):
+    time.sleep(5)
+    response = send_command(ADS1293_PORT, {"type": "get_beats", "from_seq": 0, "min_samples": 3, "timeout_ms": 5000})
+    beats = response["data"]
+    for (seq, time_ns, RR_ms, heart_rate, confidence), (next_seq, next_time_ns, next_RR_ms, _, _) in zip(beats, beats[1:]):
+        assert next_seq > seq and next_time_ns > time_ns
+        # RR of beat is distance of R peaks in samples
+        if next_RR_ms > 0:
+            assert abs(next_RR_ms - (next_seq - seq) * 1000.0 / response["sample_rate"]) < 1.0
+    for seq, time_ns, RR_ms, heart_rate, confidence in beats:
+        assert 0 <= confidence <= 1
+        assert RR_ms == 0 or 250 < RR_ms < 2000
+
+
+def test_R_peak_in_data_stream(ecg_running):
+    time.sleep(5)
+    response = send_command(ADS1293_PORT, {"type": "get_beats", "from_seq": 0, "min_samples": 1, "timeout_ms": 5000})
+    if response["data_size"] == 0:
+        return
+    seq, time_ns = response["data"][-1][:2]
+    data = send_command(ADS1293_PORT, {"type": "get_data", "from_seq": seq, "max_samples": 1})
+    assert data["first_seq"] == seq
+    # clock fit can move by small part of sample period after beat is detected
+    assert abs(data["first_sample_time_ns"] - time_ns) < 2e6
+
+
+def test_default_reader_does_not_repeat(ecg_running):
+    first = send_command(ADS1293_PORT, {"type": "get_beats"})
+    second = send_command(ADS1293_PORT, {"type": "get_beats"})
+    assert second["first_seq"] >= first["next_seq"]
+    assert "lost_beats" in second
+
+
+def test_disabled_below_100_hz(ecg_running):
+    # 25 Hz data rate
+    send_command(ADS1293_PORT, {"type": "settings", "power_enable": True, "enable_conversion": True,
+                                "R2_rate": 8, "R3_rate": 128})
+    response = send_command(ADS1293_PORT, {"type": "get_beats"})
+    assert response["enabled"] is False
+
+
+def test_bad_cursor():
+    response = send_command(ADS1293_PORT, {"type": "get_beats", "from_seq": "first"})
+    assert response["type"] == "error JSON"
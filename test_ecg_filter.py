@@ -0,0 +1,75 @@
+"""
+ECG filter bank tests (port 1293)
+
+get_data with "output":"filtered" returns samples of notch/high-pass/low-pass cascade with the same seq as raw samples.
+Run: pytest test_ecg_filter.py
+"""
+
+import time
+
+import pytest
+
+from conftest import ADS1293_PORT, send_command
+
+DEFAULT_FILTER = {"notch_frequency": 50, "highpass_frequency": 0.5, "lowpass_frequency": 0}
+
+
+@pytest.fixture
+def default_filter(ecg_running):
+    yield
+    send_command(ADS1293_PORT, dict(type="set_filter", **DEFAULT_FILTER))
+
+
+def read_both_outputs(from_seq, count=500):
+    """Raw and filtered samples of the same cursor"""
+    raw = send_command(ADS1293_PORT, {"type": "get_data", "output": "raw", "from_seq": from_seq, "max_samples": count})
+    filtered = send_command(ADS1293_PORT, {"type": "get_data", "output": "filtered", "from_seq": from_seq,
+                                           "max_samples": count})
+    return raw, filtered
+
+
+def set_filter_and_wait(settings):
+    """Set filter, return write position and response, samples after position are filtered by new settings"""
+    response = send_command(ADS1293_PORT, dict(type="set_filter", **settings))
+    assert response["type"] == "filter"
+    # cursor beyond write position is clamped to it
+    position = send_command(ADS1293_PORT, {"type": "get_data", "from_seq": 2**62, "max_samples": 1})["next_seq"]
+    time.sleep(2)
+    return position, response
+
+
+def test_filter_off_keeps_raw(default_filter):
+    position, response = set_filter_and_wait({"notch_frequency": 0, "highpass_frequency": 0, "lowpass_frequency": 0})
+    assert response["sections"] == 0
+    raw, filtered = read_both_outputs(position)
+    assert raw["output"] == "raw" and filtered["output"] == "filtered"
+    assert raw["data_size"] > 0
+    assert filtered["first_seq"] == raw["first_seq"]
+    assert filtered["first_sample_time_ns"] == raw["first_sample_time_ns"]
+    assert filtered["data"] == raw["data"]
+
+
+def test_filter_on_changes_output(default_filter):
+    position, response = set_filter_and_wait({"notch_frequency": 50, "highpass_frequency": 0.5,
+                                              "lowpass_frequency": 40})
+    assert response["sections"] == 3
+    assert response["sample_rate"] == 640
+    raw, filtered = read_both_outputs(position)
+    assert raw["data_size"] > 0 and filtered["data_size"] == raw["data_size"]
+    assert filtered["first_seq"] == raw["first_seq"]
+    assert filtered["data"] != raw["data"]
+
+
+def test_stage_above_rate_is_off(default_filter):
+    # low-pass is not below 0.45 of 640 Hz, requested value is kept
+    response = send_command(ADS1293_PORT, {"type": "set_filter", "notch_frequency": 50, "highpass_frequency": 0.5,
+                                           "lowpass_frequency": 300})
+    assert response["lowpass_frequency"] == 0
+    assert response["requested"]["lowpass_frequency"] == 300
+    assert response["sections"] == 2
+    assert send_command(ADS1293_PORT, {"type": "get_filter"})["requested"]["lowpass_frequency"] == 300
+
+
+def test_unknown_output(ecg_running):
+    response = send_command(ADS1293_PORT, {"type": "get_data", "output": "smoothed"})
+    assert response["type"] == "error JSON"
@@ -0,0 +1,99 @@
+"""
+Hemodynamics tests (port 1297)
+
+Every valid ICG feature record gives beat to beat PEP, LVET, SV and CO. heart_rate and CO are of the beat (60/RR),
+averaged values are separate fields. Full record is
+[beat_seq, R_time_ns, heart_rate, PEP_ms, LVET_ms, SV, CO, CI, TFC, average_heart_rate, CO_average].
+Run: pytest test_hemodynamics.py
+"""
+
+import pytest
+
+from conftest import FEATURE_PORT, HEMO_PORT, send_command
+
+DEFAULT_SETTINGS = {"model": "sramek_bernstein", "height_cm": 170, "weight_kg": 0, "electrode_distance_cm": 30,
+                    "blood_resistivity": 135}
+
+
+@pytest.fixture
+def hemodynamics_running(ecg_running, icg_running):
+    response = send_command(HEMO_PORT, dict(type="set_hemodynamics_settings", **DEFAULT_SETTINGS))
+    assert response["type"] == "hemodynamics_settings"
+    yield response
+    send_command(HEMO_PORT, dict(type="set_hemodynamics_settings", **DEFAULT_SETTINGS))
+
+
+def read_records(min_records=5, timeout_ms=15000):
+    """Records from start of ring, long poll waits until min_records beats are measured"""
+    return send_command(HEMO_PORT, {"type": "get_hemodynamics", "from_seq": 0, "min_samples": min_records,
+                                    "timeout_ms": timeout_ms}, timeout=timeout_ms / 1000 + 5)
+
+
+def test_settings(hemodynamics_running):
+    response = send_command(HEMO_PORT, {"type": "set_hemodynamics_settings", "model": "kubicek", "height_cm": 180,
+                                        "weight_kg": 80, "electrode_distance_cm": 28})
+    assert response["type"] == "hemodynamics_settings"
+    assert response["model"] == "kubicek" and response["weight_kg"] == 80
+    assert send_command(HEMO_PORT, {"type": "get_hemodynamics_settings"})["electrode_distance_cm"] == 28
+
+
+@pytest.mark.parametrize("settings", [
+    {"model": "other"},
+    {"height_cm": 0},
+    {"weight_kg": -1},
+    {"electrode_distance_cm": 0},
+    {"blood_resistivity": -135},
+])
+def test_settings_error_keeps_settings(hemodynamics_running, settings):
+    response = send_command(HEMO_PORT, dict(type="set_hemodynamics_settings", **settings))
+    assert response["type"] == "error JSON"
+    response = send_command(HEMO_PORT, {"type": "get_hemodynamics_settings"})
+    assert response["model"] == DEFAULT_SETTINGS["model"]
+    assert response["height_cm"] == DEFAULT_SETTINGS["height_cm"]
+
+
+def test_unknown_command():
+    assert send_command(HEMO_PORT, {"type": "get_hemo"})["type"] == "error JSON"
+
+
+def test_physiological_bounds(hemodynamics_running):
+    response = read_records()
+    assert response["type"] == "hemodynamics"
+    for record in response["data"]:
+        beat_seq, R_time_ns, heart_rate, PEP_ms, LVET_ms, SV, CO, CI, TFC, average_heart_rate, CO_average = record
+        assert 20 <= PEP_ms <= 250 and 100 <= LVET_ms <= 500
+        assert 10 <= SV <= 250
+        assert heart_rate == 0 or 30 <= heart_rate <= 240
+        assert CO == 0 or 0.5 <= CO <= 25
+        assert CI == 0
+        assert TFC > 0
+
+
+def test_cardiac_output_of_beat(hemodynamics_running):
+    response = read_records()
+    features = send_command(FEATURE_PORT, {"type": "get_icg_features", "from_seq": 0})
+    RR_of_beat = {record[0]: record[2] for record in features["data"]}
+    for record in response["data"]:
+        beat_seq, R_time_ns, heart_rate, PEP_ms, LVET_ms, SV, CO, CI, TFC, average_heart_rate, CO_average = record
+        # heart rate of beat is its own RR, average is reported separately
+        if beat_seq in RR_of_beat and RR_of_beat[beat_seq] > 0:
+            assert heart_rate == pytest.approx(60000.0 / RR_of_beat[beat_seq], rel=1e-6)
+        assert CO == pytest.approx(SV * heart_rate / 1000.0, rel=1e-6, abs=1e-9)
+        assert CO_average == pytest.approx(SV * average_heart_rate / 1000.0, rel=1e-6, abs=1e-9)
+
+
+def test_cursor_continuity(hemodynamics_running):
+    first = read_records(min_records=1)
+    following = send_command(HEMO_PORT, {"type": "get_hemodynamics", "from_seq": first["next_seq"],
+                                         "min_samples": 1, "timeout_ms": 4000})
+    assert following["first_seq"] == first["next_seq"]
+    assert following["skipped_records"] == 0
+    assert following["data_size"] == following["next_seq"] - following["first_seq"] == len(following["data"])
+
+
+def test_compact_record(hemodynamics_running):
+    response = send_command(HEMO_PORT, {"type": "get_hemodynamics", "compact": True, "min_samples": 1,
+                                        "timeout_ms": 5000})
+    assert set(response.keys()) == {"type", "data", "next_seq"}
+    for record in response["data"]:
+        assert len(record) == 6 and all(isinstance(value, int) for value in record)
@@ -52,7 +52,7 @@ import os
 def parse_firmware_timestamp(timestamp_str: str) -> float:
     """Parse firmware timestamp string to Unix timestamp (seconds since epoch)
 
-    Firmware format: "2025-10-27 07:55:27.594" (UTC, millisecond precision)
+    Firmware format: "2025-10-27 07:55:27.594123" (UTC, microsecond precision)
 
     Args:
         timestamp_str: Timestamp string from firmware JSON response
@@ -64,7 +64,7 @@ def parse_firmware_timestamp(timestamp_str: str) -> float:
         ValueError: If timestamp format is invalid
     """
     try:
-        # Parse the timestamp string (format: "YYYY-MM-DD HH:MM:SS.mmm")
+        # Parse the timestamp string (format: "YYYY-MM-DD HH:MM:SS.uuuuuu")
         dt = datetime.strptime(timestamp_str, "%Y-%m-%d %H:%M:%S.%f")
 
         # Convert to Unix timestamp (seconds since epoch)
@@ -289,13 +289,15 @@ class DriftTester:
 
                     icg_data_sets.append({
                         'timestamp': firmware_timestamp,
-                        'data': icg_data['data']
+                        'data': icg_data['data'],
+                        'sync_marks': icg_data.get('sync_marks', [])
                     })
                 except ValueError as e:
                     print(f"    Warning: Failed to parse ICG timestamp: {e}")
                     icg_data_sets.append({
                         'timestamp': time.time(),
-                        'data': icg_data['data']
+                        'data': icg_data['data'],
+                        'sync_marks': icg_data.get('sync_marks', [])
                     })
 
             if ecg_data and 'data' in ecg_data:
@@ -308,13 +310,15 @@ class DriftTester:
 
                     ecg_data_sets.append({
                         'timestamp': firmware_timestamp,
-                        'data': ecg_data['data']
+                        'data': ecg_data['data'],
+                        'sync_marks': ecg_data.get('sync_marks', [])
                     })
                 except ValueError as e:
                     print(f"    Warning: Failed to parse ECG timestamp: {e}")
                     ecg_data_sets.append({
                         'timestamp': time.time(),
-                        'data': ecg_data['data']
+                        'data': ecg_data['data'],
+                        'sync_marks': ecg_data.get('sync_marks', [])
                     })
 
             # Progress indicator every 60 seconds (1 minute)
@@ -343,42 +347,22 @@ class DriftTester:
         """
         sync_marks = []
 
-        # Different magic numbers for ECG vs ICG
-        ecg_magic = -99999
-        icg_magic = -999990000
-
+        # Sync marks are delivered in 'sync_marks' next to the sample block,
+        # 'position' is index of first sample after the mark in 'data'
         for packet_index, data_set in enumerate(data_sets):
             firmware_timestamp = data_set['timestamp']
-            data_array = data_set['data']
-            total_samples = len(data_array)
-
-            for position, sample in enumerate(data_array):
-                if isinstance(sample, (list, tuple)) and len(sample) > 0:
-                    first_val = sample[0]
-
-                    # Check for ECG sync mark
-                    if device_type == 'ECG' and first_val == ecg_magic:
-                        if len(sample) >= 2:
-                            sync_num = sample[1]
-                            # Calculate sample-accurate timestamp
-                            samples_after_sync = total_samples - position - 1
-                            time_offset = samples_after_sync / sampling_rate
-                            actual_timestamp = firmware_timestamp - time_offset
-
-                            sync_marks.append((sync_num, actual_timestamp, position,
-                                             total_samples, packet_index))
-
-                    # Check for ICG sync mark (scaled by 10000)
-                    elif device_type == 'ICG' and first_val == icg_magic:
-                        if len(sample) >= 2:
-                            sync_num = sample[1] // 10000
-                            # Calculate sample-accurate timestamp
-                            samples_after_sync = total_samples - position - 1
-                            time_offset = samples_after_sync / sampling_rate
-                            actual_timestamp = firmware_timestamp - time_offset
-
-                            sync_marks.append((sync_num, actual_timestamp, position,
-                                             total_samples, packet_index))
+            total_samples = len(data_set['data'])
+
+            for mark in data_set.get('sync_marks', []):
+                sync_num = mark['sync_num']
+                position = mark['position']
+                # Calculate sample-accurate timestamp
+                samples_after_sync = total_samples - position - 1
+                time_offset = samples_after_sync / sampling_rate
+                actual_timestamp = firmware_timestamp - time_offset
+
+                sync_marks.append((sync_num, actual_timestamp, position,
+                                 total_samples, packet_index))
 
         return sync_marks
 
@@ -396,11 +380,6 @@ class DriftTester:
         """
         sample_counts = {}
 
-        # Magic numbers to identify sync marks
-        ecg_magic = -99999
-        icg_magic = -999990000
-        magic = ecg_magic if device_type == 'ECG' else icg_magic
-
         for i in range(len(sync_marks) - 1):
             sync_num1, _, pos1, total1, packet_idx1 = sync_marks[i]
             sync_num2, _, pos2, total2, packet_idx2 = sync_marks[i + 1]
@@ -410,23 +389,18 @@ class DriftTester:
 
             # Case 1: Both syncs in same packet (rare but possible)
             if packet_idx1 == packet_idx2:
-                # Samples between pos1 and pos2 (excluding the sync marks themselves)
-                sample_count = pos2 - pos1 - 1
+                # Marks are not samples, data array has only samples
+                sample_count = pos2 - pos1
 
             # Case 2: Syncs in different packets
             else:
-                # Count samples after first sync in its packet
-                sample_count += (total1 - pos1 - 1)
+                # Count samples from first sync to end of its packet
+                sample_count += (total1 - pos1)
 
                 # Count all samples in intermediate packets
                 for packet_idx in range(packet_idx1 + 1, packet_idx2):
                     if packet_idx < len(data_sets):
-                        data_array = data_sets[packet_idx]['data']
-                        # Count all non-sync samples
-                        for sample in data_array:
-                            if isinstance(sample, (list, tuple)) and len(sample) > 0:
-                                if sample[0] != magic:
-                                    sample_count += 1
+                        sample_count += len(data_sets[packet_idx]['data'])
 
                 # Count samples before second sync in its packet
                 sample_count += pos2
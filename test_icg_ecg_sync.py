@@ -3,7 +3,7 @@
 ICG-ECG Synchronization Test Script
 
 This script tests the synchronization between ICG (MAX30009) and ECG (ADS1293) data streams
-by verifying that sync marks (-99999) are time-locked between the two sensors.
+by verifying that sync marks ("sync_marks" index) are time-locked between the two sensors.
 
 Test Matrix:
 - ICG measure_frequency: 100-1000 Hz (increments of 100)
@@ -42,7 +42,7 @@ import threading
 def parse_firmware_timestamp(timestamp_str: str) -> float:
     """Parse firmware timestamp string to Unix timestamp (seconds since epoch)
 
-    Firmware format: "2025-10-27 07:55:27.594" (UTC, millisecond precision)
+    Firmware format: "2025-10-27 07:55:27.594123" (UTC, microsecond precision)
 
     Args:
         timestamp_str: Timestamp string from firmware JSON response
@@ -54,7 +54,7 @@ def parse_firmware_timestamp(timestamp_str: str) -> float:
         ValueError: If timestamp format is invalid
     """
     try:
-        # Parse the timestamp string (format: "YYYY-MM-DD HH:MM:SS.mmm")
+        # Parse the timestamp string (format: "YYYY-MM-DD HH:MM:SS.uuuuuu")
         dt = datetime.strptime(timestamp_str, "%Y-%m-%d %H:%M:%S.%f")
 
         # Convert to Unix timestamp (seconds since epoch)
@@ -287,14 +287,16 @@ class SyncTester:
 
                     icg_data_sets.append({
                         'timestamp': firmware_timestamp,
-                        'data': icg_data['data']
+                        'data': icg_data['data'],
+                        'sync_marks': icg_data.get('sync_marks', [])
                     })
                 except ValueError as e:
                     print(f"    Warning: Failed to parse ICG timestamp: {e}")
                     # Use Python time as fallback
                     icg_data_sets.append({
                         'timestamp': time.time(),
-                        'data': icg_data['data']
+                        'data': icg_data['data'],
+                        'sync_marks': icg_data.get('sync_marks', [])
                     })
 
             if ecg_data and 'data' in ecg_data:
@@ -309,14 +311,16 @@ class SyncTester:
 
                     ecg_data_sets.append({
                         'timestamp': firmware_timestamp,
-                        'data': ecg_data['data']
+                        'data': ecg_data['data'],
+                        'sync_marks': ecg_data.get('sync_marks', [])
                     })
                 except ValueError as e:
                     print(f"    Warning: Failed to parse ECG timestamp: {e}")
                     # Use Python time as fallback
                     ecg_data_sets.append({
                         'timestamp': time.time(),
-                        'data': ecg_data['data']
+                        'data': ecg_data['data'],
+                        'sync_marks': ecg_data.get('sync_marks', [])
                     })
 
             # Progress indicator
@@ -347,54 +351,24 @@ class SyncTester:
         """
         sync_marks = []
 
-        # Different magic numbers for ECG vs ICG
-        # ECG: -99999
-        # ICG: -999990000 (scaled by 10000)
-        ecg_magic = -99999
-        icg_magic = -999990000
-
+        # Sync marks are delivered in 'sync_marks' next to the sample block,
+        # 'position' is index of first sample after the mark in 'data'
         for data_set in data_sets:
             # Firmware timestamp from device (when packet was assembled)
             firmware_timestamp = data_set['timestamp']
-            data_array = data_set['data']
-            total_samples = len(data_array)
-
-            for position, sample in enumerate(data_array):
-                # Data format is array/list of integers
-                # ECG: [ch1, ch2, ch3] - 3 elements
-                # ICG: [I, Q, mag, phase, ...] - 5 elements
-                # Sync mark in ECG: [-99999, sync_num, 0]
-                # Sync mark in ICG: [-999990000, sync_num*10000, 0, 0, 0]
-
-                if isinstance(sample, (list, tuple)) and len(sample) > 0:
-                    first_val = sample[0]
-
-                    # Check for ECG sync mark
-                    if device_type == 'ECG' and first_val == ecg_magic:
-                        if len(sample) >= 2:
-                            sync_num = sample[1]
-                            # Calculate sample-accurate timestamp by backing up from firmware timestamp
-                            # Assumption: firmware timestamp represents approximately when last sample was acquired
-                            # We calculate how many samples occurred after the sync mark
-                            samples_after_sync = total_samples - position - 1
-                            time_offset = samples_after_sync / sampling_rate
-                            actual_timestamp = firmware_timestamp - time_offset
-
-                            sync_marks.append((sync_num, actual_timestamp, position, total_samples))
-
-                    # Check for ICG sync mark (scaled by 10000)
-                    elif device_type == 'ICG' and first_val == icg_magic:
-                        if len(sample) >= 2:
-                            # Sync number is also scaled by 10000, so divide it
-                            sync_num = sample[1] // 10000
-                            # Calculate sample-accurate timestamp by backing up from firmware timestamp
-                            # Assumption: firmware timestamp represents approximately when last sample was acquired
-                            # We calculate how many samples occurred after the sync mark
-                            samples_after_sync = total_samples - position - 1
-                            time_offset = samples_after_sync / sampling_rate
-                            actual_timestamp = firmware_timestamp - time_offset
-
-                            sync_marks.append((sync_num, actual_timestamp, position, total_samples))
+            total_samples = len(data_set['data'])
+
+            for mark in data_set.get('sync_marks', []):
+                sync_num = mark['sync_num']
+                position = mark['position']
+                # Calculate sample-accurate timestamp by backing up from firmware timestamp
+                # Assumption: firmware timestamp represents approximately when last sample was acquired
+                # We calculate how many samples occurred after the sync mark
+                samples_after_sync = total_samples - position - 1
+                time_offset = samples_after_sync / sampling_rate
+                actual_timestamp = firmware_timestamp - time_offset
+
+                sync_marks.append((sync_num, actual_timestamp, position, total_samples))
 
         return sync_marks
 
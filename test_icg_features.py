@@ -0,0 +1,85 @@
+"""
+ICG feature tests (port 1296)
+
+Beats of ADS1293 gate -dZ/dt of MAX30009, ensemble gives B, C, X points of every beat.
+Record is [beat_seq, R_time_ns, RR_ms, heart_rate, B_ms, C_ms, X_ms, dZdt_max, Z0, quality, ensemble_beats, valid].
+Run: pytest test_icg_features.py
+"""
+
+import time
+
+import pytest
+
+from conftest import ADS1293_PORT, FEATURE_PORT, send_command
+
+DEFAULT_SETTINGS = {"ensemble_count": 10, "lowpass_frequency": 20, "min_confidence": 0.5}
+
+
+@pytest.fixture
+def features_running(ecg_running, icg_running):
+    response = send_command(FEATURE_PORT, dict(type="set_icg_settings", **DEFAULT_SETTINGS))
+    assert response["type"] == "icg_settings"
+    yield response
+    send_command(FEATURE_PORT, dict(type="set_icg_settings", **DEFAULT_SETTINGS))
+
+
+def test_settings(features_running):
+    response = send_command(FEATURE_PORT, {"type": "set_icg_settings", "ensemble_count": 8})
+    assert response["type"] == "icg_settings"
+    assert response["ensemble_count"] == 8
+    assert response["running"] is True
+    assert send_command(FEATURE_PORT, {"type": "get_icg_settings"})["ensemble_count"] == 8
+
+
+@pytest.mark.parametrize("settings", [
+    {"ensemble_count": 0},
+    {"ensemble_count": 65},
+    {"lowpass_frequency": -1},
+    {"min_confidence": 1.5},
+    {"ensemble_count": "eight"},
+])
+def test_settings_error_keeps_settings(features_running, settings):
+    response = send_command(FEATURE_PORT, dict(type="set_icg_settings", **settings))
+    assert response["type"] == "error JSON"
+    response = send_command(FEATURE_PORT, {"type": "get_icg_settings"})
+    assert response["ensemble_count"] == DEFAULT_SETTINGS["ensemble_count"]
+    assert response["min_confidence"] == DEFAULT_SETTINGS["min_confidence"]
+
+
+def test_unknown_command():
+    assert send_command(FEATURE_PORT, {"type": "get_features"})["type"] == "error JSON"
+
+
+def test_cursor_continuity(features_running):
+    time.sleep(5)
+    first = send_command(FEATURE_PORT, {"type": "get_icg_features", "from_seq": 0})
+    assert first["type"] == "icg_features"
+    following = send_command(FEATURE_PORT, {"type": "get_icg_features", "from_seq": first["next_seq"],
+                                            "min_samples": 1, "timeout_ms": 4000})
+    assert following["first_seq"] == first["next_seq"]
+    assert following["skipped_features"] == 0
+    assert following["data_size"] == following["next_seq"] - following["first_seq"] == len(following["data"])
+
+
+def test_feature_records(features_running):
+    time.sleep(10)
+    response = send_command(FEATURE_PORT, {"type": "get_icg_features", "from_seq": 0, "min_samples": 1,
+                                           "timeout_ms": 5000})
+    beats = send_command(ADS1293_PORT, {"type": "get_beats", "from_seq": 0})
+    previous_seq = -1
+    for record in response["data"]:
+        beat_seq, R_time_ns, RR_ms, heart_rate, B_ms, C_ms, X_ms, dZdt_max, Z0, quality, ensemble_beats, valid = record
+        # one record per ECG beat, in beat order
+        assert previous_seq < beat_seq < beats["next_seq"]
+        previous_seq = beat_seq
+        assert 1 <= ensemble_beats <= DEFAULT_SETTINGS["ensemble_count"]
+        if valid:
+            assert B_ms < C_ms < X_ms
+            assert 20 <= B_ms <= 250 and 100 <= X_ms - B_ms <= 500
+
+
+def test_ensemble(features_running):
+    time.sleep(5)
+    ensemble = send_command(FEATURE_PORT, {"type": "get_icg_ensemble"})
+    if ensemble["data"]:
+        assert len(ensemble["data"]) == round(0.6 * ensemble["sample_rate"]) + 1
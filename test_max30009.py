@@ -197,6 +197,33 @@ class MAX30009Client:
             if sock:
                 sock.close()
 
+    def send_command_with_data(self, command_dict: Dict[str, Any]) -> Tuple[Optional[Dict[str, Any]], bytes]:
+        """
+        Send JSON command and read binary part of response (byte_size bytes after JSON line)
+
+        Returns:
+            Tuple of response dict (or None if error) and binary data
+        """
+        sock = None
+        try:
+            sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            sock.settimeout(self.timeout)
+            sock.connect((self.host, self.port))
+            stream = sock.makefile("rb")
+            stream.readline()  # welcome message
+
+            sock.sendall((json.dumps(command_dict) + "\n").encode())
+            response = json.loads(stream.readline().decode())
+            data = stream.read(response.get("byte_size", 0))
+            return response, data
+
+        except Exception as e:
+            logging.error(f"Error in send_command_with_data: {e}")
+            return None, b""
+        finally:
+            if sock:
+                sock.close()
+
     def is_available(self) -> bool:
         """Check if MAX30009 service is available"""
         try:
@@ -677,6 +704,33 @@ class SettingsConfigTests(MAX30009TestSuite):
                 "error": "Invalid response"
             }
 
+    def test_arbitrary_drive_frequency(self):
+        """Test drive frequency between calibrate table points"""
+        response = self.client.send_command({
+            "type": "settings",
+            "power_enable": True,
+            "measure_enable": True,
+            "measure_frequency": 100,
+            "drive_frequency": 75000
+        })
+        # Return to table frequency for next tests
+        self.client.send_command({"type": "settings", "drive_frequency": 0})
+
+        if response and response.get("drive_frequency") == 75000 and abs(response.get("actual_drive_frequency", 0) - 75000) < 75000 * 0.01:
+            return {
+                "status": "PASS",
+                "expected": "drive_frequency=75000, actual within 1%",
+                "actual": f"actual_drive_frequency={response.get('actual_drive_frequency')}",
+                "details": "Drive frequency synthesized outside of table"
+            }
+        else:
+            return {
+                "status": "FAIL",
+                "expected": "drive_frequency=75000, actual within 1%",
+                "actual": json.dumps(response) if response else "None",
+                "error": "Drive frequency not applied"
+            }
+
     def run_all(self):
         """Run all settings configuration tests"""
         logging.info(f"\n{'='*70}")
@@ -703,6 +757,8 @@ class SettingsConfigTests(MAX30009TestSuite):
                      self.test_partial_settings_update)
         self.run_test("Complete Configuration", "SETT-010",
                      self.test_complete_configuration)
+        self.run_test("Arbitrary Drive Frequency", "SETT-011",
+                     self.test_arbitrary_drive_frequency)
 
 
 # ============================================================================
@@ -799,8 +855,8 @@ class DataRetrievalTests(MAX30009TestSuite):
         if response and "data" in response and len(response["data"]) > 0:
             data_points = response["data"]
 
-            # Check first non-sync data point
-            valid_points = [pt for pt in data_points if pt[0] != -99999]
+            # Sync marks are delivered in "sync_marks", data has only samples
+            valid_points = data_points
 
             if valid_points:
                 first_point = valid_points[0]
@@ -823,7 +879,7 @@ class DataRetrievalTests(MAX30009TestSuite):
                 return {
                     "status": "FAIL",
                     "expected": "Data points",
-                    "actual": "Only sync markers found",
+                    "actual": "Empty data array",
                     "error": "No regular data points"
                 }
         else:
@@ -853,11 +909,20 @@ class DataRetrievalTests(MAX30009TestSuite):
         if response and "data" in response:
             data_points = response["data"]
 
-            # Find sync markers (Load_real = -99999)
-            sync_markers = [pt for pt in data_points if pt[0] == -99999]
+            # Sync markers are delivered next to the data: {"position", "sync_num", "time_ms"}
+            sync_markers = response.get("sync_marks", [])
+            bad_markers = [mark for mark in sync_markers
+                           if not 0 <= mark["position"] <= len(data_points)]
+            if bad_markers:
+                return {
+                    "status": "FAIL",
+                    "expected": f"Sync marker position in range 0..{len(data_points)}",
+                    "actual": f"{bad_markers}",
+                    "error": "Sync marker position outside data array"
+                }
 
             if len(sync_markers) >= 2:
-                sync_nums = [pt[1] for pt in sync_markers]
+                sync_nums = [mark["sync_num"] for mark in sync_markers]
                 return {
                     "status": "PASS",
                     "expected": "At least 2 sync markers in 3 seconds",
@@ -868,7 +933,7 @@ class DataRetrievalTests(MAX30009TestSuite):
                 return {
                     "status": "PASS",
                     "expected": "At least 1 sync marker",
-                    "actual": f"Found 1 sync marker: {sync_markers[0][1]}",
+                    "actual": f"Found 1 sync marker: {sync_markers[0]['sync_num']}",
                     "details": "May need longer wait for multiple markers"
                 }
             else:
@@ -936,6 +1001,10 @@ class DataRetrievalTests(MAX30009TestSuite):
             "measure_frequency": 500
         })
 
+        # Drain buffer and remember lost sample counter
+        response = self.client.send_command({"type": "get_data"})
+        lost_before = response.get("lost_samples", 0) if response else 0
+
         # Wait longer than 3 second buffer capacity
         logging.info("  Waiting 5 seconds to force buffer overflow...")
         time.sleep(5)
@@ -944,13 +1013,22 @@ class DataRetrievalTests(MAX30009TestSuite):
 
         if response and response.get("type") == "data":
             data_size = response.get("data_size", 0)
+            lost_after = response.get("lost_samples")
 
-            # We expect some data, but may have lost oldest samples
+            if lost_after is None or lost_after <= lost_before:
+                return {
+                    "status": "FAIL",
+                    "expected": f"lost_samples > {lost_before}",
+                    "actual": f"lost_samples={lost_after}, data_size={data_size}",
+                    "error": "Overflow is not counted"
+                }
+
+            # Oldest samples are overwritten and counted
             return {
                 "status": "PASS",
-                "expected": "Data retrieved (may have overflow)",
-                "actual": f"data_size={data_size}",
-                "details": "Buffer overflow test - some data may be lost"
+                "expected": "Data retrieved, overflow counted",
+                "actual": f"data_size={data_size}, lost_samples={lost_after - lost_before}",
+                "details": "Buffer overflow test - oldest data is lost and counted"
             }
         else:
             return {
@@ -960,6 +1038,360 @@ class DataRetrievalTests(MAX30009TestSuite):
                 "error": "No response after overflow"
             }
 
+    def test_cursor_reads(self):
+        """Test cursor reads: two readers get same samples, default reader is not changed"""
+        self.client.send_command({
+            "type": "settings",
+            "power_enable": True,
+            "measure_enable": True,
+            "measure_frequency": 100
+        })
+
+        time.sleep(2)
+
+        # Two readers with same cursor get same retained history
+        first = self.client.send_command({"type": "get_data", "from_seq": 0, "max_samples": 50})
+        second = self.client.send_command({"type": "get_data", "from_seq": 0, "max_samples": 50})
+
+        if not first or not second or "next_seq" not in first or "next_seq" not in second:
+            return {
+                "status": "FAIL",
+                "expected": "data responses with first_seq/next_seq",
+                "actual": json.dumps(first) if first else "None",
+                "error": "No cursor in response"
+            }
+
+        if first["first_seq"] != second["first_seq"] or first["data"][:10] != second["data"][:10]:
+            return {
+                "status": "FAIL",
+                "expected": "Same samples for same cursor",
+                "actual": f"first_seq {first['first_seq']} vs {second['first_seq']}",
+                "error": "Readers with same cursor got different data"
+            }
+
+        if first["data_size"] > 50:
+            return {
+                "status": "FAIL",
+                "expected": "data_size <= max_samples (50)",
+                "actual": f"data_size={first['data_size']}",
+                "error": "max_samples is ignored"
+            }
+
+        # Next read continues from returned cursor
+        time.sleep(0.5)
+        cursor = second["next_seq"]
+        following = self.client.send_command({"type": "get_data", "from_seq": cursor})
+        if not following or following.get("first_seq") != cursor or following.get("skipped_samples") != 0:
+            return {
+                "status": "FAIL",
+                "expected": f"first_seq={cursor}, skipped_samples=0",
+                "actual": json.dumps({k: following.get(k) for k in ("first_seq", "skipped_samples")}) if following else "None",
+                "error": "Cursor read does not continue from next_seq"
+            }
+
+        # Default reader still gets retained data, cursor reads did not consume it
+        default = self.client.send_command({"type": "get_data"})
+        if not default or default.get("data_size", 0) == 0:
+            return {
+                "status": "FAIL",
+                "expected": "Default reader gets data",
+                "actual": json.dumps(default) if default else "None",
+                "error": "Cursor reads consumed data of default reader"
+            }
+
+        return {
+            "status": "PASS",
+            "expected": "Independent cursor reads",
+            "actual": f"cursor {first['first_seq']}->{first['next_seq']}, next read from {cursor}, default data_size={default['data_size']}",
+            "details": "Readers with cursors do not steal samples"
+        }
+
+    def test_long_poll(self):
+        """Test long poll: get_data waits for min_samples or timeout_ms"""
+        self.client.send_command({
+            "type": "settings",
+            "power_enable": True,
+            "measure_enable": True,
+            "measure_frequency": 100
+        })
+
+        time.sleep(1)
+
+        # Drain default reader, next request has to wait for new samples
+        self.client.send_command({"type": "get_data"})
+
+        start = time.time()
+        response = self.client.send_command({"type": "get_data", "min_samples": 50, "timeout_ms": 3000})
+        elapsed = time.time() - start
+        if not response or response.get("data_size", 0) < 50 or elapsed >= 3.0:
+            return {
+                "status": "FAIL",
+                "expected": "data_size >= 50 before timeout",
+                "actual": f"data_size={response.get('data_size') if response else None}, elapsed={elapsed:.2f}s",
+                "error": "Request did not wait for min_samples"
+            }
+
+        # min_samples which can not be reached: data is sent after timeout
+        start = time.time()
+        timed_out = self.client.send_command({"type": "get_data", "min_samples": 1000000, "timeout_ms": 1000})
+        timeout_elapsed = time.time() - start
+        if not timed_out or timed_out.get("type") != "data" or timeout_elapsed < 0.9:
+            return {
+                "status": "FAIL",
+                "expected": "data response after ~1s",
+                "actual": f"response={'yes' if timed_out else 'None'}, elapsed={timeout_elapsed:.2f}s",
+                "error": "Timeout of waiting request is not kept"
+            }
+
+        # Request which waits until its timeout, client goes away before it
+        sock = socket.create_connection((self.client.host, self.client.port), timeout=self.client.timeout)
+        sock.recv(1024)
+        sock.sendall((json.dumps({"type": "get_data", "min_samples": 1000000, "timeout_ms": 2000}) + "\n").encode())
+        time.sleep(0.5)
+        sock.close()
+
+        sock = socket.create_connection((self.client.host, self.client.port), timeout=self.client.timeout)
+        try:
+            stream = sock.makefile("rb")
+            stream.readline()  # welcome message
+            sock.sendall((json.dumps({"type": "get_calibration_quality"}) + "\n").encode())
+            first = json.loads(stream.readline().decode())
+
+            # timeout of parked request is over, nothing else may come
+            sock.settimeout(3)
+            try:
+                extra = stream.readline()
+            except socket.timeout:
+                extra = b""
+        finally:
+            sock.close()
+
+        if first.get("type") != "calibration_quality" or extra:
+            return {
+                "status": "FAIL",
+                "expected": "type=calibration_quality, then no response",
+                "actual": f"first={json.dumps(first)[:100]}, extra={extra[:100]!r}",
+                "error": "Response of closed connection is sent to next client"
+            }
+
+        return {
+            "status": "PASS",
+            "expected": "Request waits for samples, timeout is kept",
+            "actual": f"{response['data_size']} points in {elapsed:.2f}s, timeout response in {timeout_elapsed:.2f}s",
+            "details": "Long poll replaces fixed polling interval"
+        }
+
+    def test_sample_timestamps(self):
+        """Test clock model: first_sample_time_ns and sample_rate of consecutive frames"""
+        self.client.send_command({
+            "type": "settings",
+            "power_enable": True,
+            "measure_enable": True,
+            "measure_frequency": 100
+        })
+
+        time.sleep(3)
+
+        first = self.client.send_command({"type": "get_data"})
+        time.sleep(0.1)
+        second = self.client.send_command({"type": "get_data", "from_seq": first["next_seq"]}) if first else None
+
+        if not first or not second or "first_sample_time_ns" not in first or "sample_rate" not in first \
+                or second.get("skipped_samples") != 0:
+            return {
+                "status": "FAIL",
+                "expected": "first_sample_time_ns and sample_rate in frame",
+                "actual": json.dumps(first)[:200] if first else "None",
+                "error": "No time of samples in response"
+            }
+
+        # Rate of data points is measure_frequency
+        rate = first["sample_rate"]
+        if abs(rate - 100) > 100 * 0.05:
+            return {
+                "status": "FAIL",
+                "expected": "sample_rate ~100 Hz",
+                "actual": f"sample_rate={rate}",
+                "error": "Rate estimate differs from nominal"
+            }
+
+        # Second frame continues first one: its time is predicted by first frame
+        predicted_ns = first["first_sample_time_ns"] + first["data_size"] * 1e9 / rate
+        error_ms = abs(second["first_sample_time_ns"] - predicted_ns) / 1e6
+        now_ms = time.monotonic_ns() / 1e6
+        age_ms = now_ms - second["first_sample_time_ns"] / 1e6
+        if error_ms > 5 or age_ms < 0:
+            return {
+                "status": "FAIL",
+                "expected": "Frames are continuous in time (<5 ms), samples are in the past",
+                "actual": f"error={error_ms:.2f} ms, age={age_ms:.1f} ms",
+                "error": "Sample times are not consistent"
+            }
+
+        return {
+            "status": "PASS",
+            "expected": "Per-frame sample times from monotonic clock",
+            "actual": f"sample_rate={rate:.3f}, frame join error={error_ms:.3f} ms",
+            "details": "Consumers do not need sync marks for sample times"
+        }
+
+    def test_preview_envelope(self):
+        """Test get_preview: envelope of window for given pixel width"""
+        self.client.send_command({
+            "type": "settings",
+            "power_enable": True,
+            "measure_enable": True,
+            "measure_frequency": 100
+        })
+
+        time.sleep(5)
+
+        response = self.client.send_command({"type": "get_preview", "width": 50, "duration_ms": 4000})
+        if not response or response.get("type") != "preview":
+            return {
+                "status": "FAIL",
+                "expected": "type=preview",
+                "actual": json.dumps(response)[:200] if response else "None",
+                "error": "No preview response"
+            }
+
+        # 4 s at 100 Hz for 50 pixels: 8 points per pixel from 1:8 level
+        width = response["width"]
+        bad_pixels = [pixel for pixel in response["data"]
+                      if len(pixel) != 15 or any(not (pixel[i] <= pixel[i + 2] <= pixel[i + 1]) for i in range(0, 15, 3))]
+        if width != 50 or len(response["data"]) != width or response["samples_per_pixel"] != 8 or bad_pixels \
+                or response["next_seq"] - response["first_seq"] != width * response["samples_per_pixel"]:
+            return {
+                "status": "FAIL",
+                "expected": "50 pixels of 8 points, min <= mean <= max",
+                "actual": f"width={width}, samples_per_pixel={response.get('samples_per_pixel')}, bad pixels={len(bad_pixels)}",
+                "error": "Wrong envelope"
+            }
+
+        # Window longer than data: fewer pixels, response is still fast
+        start = time.time()
+        long_window = self.client.send_command({"type": "get_preview", "width": 1000, "duration_ms": 120000})
+        elapsed = time.time() - start
+        if not long_window or long_window.get("width", 0) == 0 or long_window["width"] > 1000:
+            return {
+                "status": "FAIL",
+                "expected": "0 < width <= 1000",
+                "actual": json.dumps(long_window)[:200] if long_window else "None",
+                "error": "Long window preview failed"
+            }
+
+        return {
+            "status": "PASS",
+            "expected": "Envelope from pyramid levels",
+            "actual": f"{width} pixels x {response['samples_per_pixel']}, long window {long_window['width']} pixels in {elapsed:.3f}s",
+            "details": "Preview does not read raw ring"
+        }
+
+    def test_raw_iq_passthrough(self):
+        """Test get_raw_data: packed 20 bit I/Q words at ADC rate, calibration in header"""
+        self.client.send_command({
+            "type": "settings",
+            "power_enable": True,
+            "measure_enable": True,
+            "measure_frequency": 100
+        })
+
+        time.sleep(2)
+
+        # First read of raw reader after settings has header
+        response, data = self.client.send_command_with_data({"type": "get_raw_data"})
+        if not response or response.get("type") != "raw_data" or "header" not in response:
+            return {
+                "status": "FAIL",
+                "expected": "type=raw_data with header",
+                "actual": json.dumps(response)[:200] if response else "None",
+                "error": "No raw data header"
+            }
+        header = response["header"]
+        sample_bytes = header["sample_bytes"]
+        if len(data) != response["byte_size"] or len(data) != response["data_size"] * sample_bytes \
+                or "calib" not in header or abs(response["sample_rate"] / header["adc_sample_rate"] - 1) > 0.05:
+            return {
+                "status": "FAIL",
+                "expected": f"data_size*{sample_bytes} bytes at ADC rate",
+                "actual": f"bytes={len(data)}, data_size={response['data_size']}, sample_rate={response['sample_rate']}",
+                "error": "Wrong raw data size"
+            }
+
+        # Unpack I (bits 0..19) and Q (bits 20..39), two's complement
+        def to_signed(word):
+            return word - (1 << 20) if word & (1 << 19) else word
+        samples = []
+        for i in range(0, len(data), sample_bytes):
+            word = int.from_bytes(data[i:i + sample_bytes], "little")
+            samples.append((to_signed(word & 0xFFFFF), to_signed(word >> 20)))
+
+        # Header is not repeated while calibration and ADC rate are not changed
+        time.sleep(0.5)
+        second, second_data = self.client.send_command_with_data({"type": "get_raw_data"})
+        if not second or "header" in second or second["first_seq"] != response["next_seq"]:
+            return {
+                "status": "FAIL",
+                "expected": "continuation without header",
+                "actual": json.dumps(second)[:200] if second else "None",
+                "error": "Raw reader does not continue"
+            }
+
+        return {
+            "status": "PASS",
+            "expected": "Raw I/Q words at ADC rate",
+            "actual": f"{len(samples)} samples at {response['sample_rate']:.1f} Hz, first {samples[:1]}",
+            "details": f"Header version {response['header_version']}"
+        }
+
+    def test_allocation_free_get_data(self):
+        """Test get_data: no heap allocations after buffers have capacity"""
+        self.client.send_command({
+            "type": "settings",
+            "power_enable": True,
+            "measure_enable": True,
+            "measure_frequency": 500
+        })
+
+        time.sleep(3)
+
+        counts = []
+        for i in range(6):
+            response = self.client.send_command({"type": "get_data"})
+            if response and response.get("type") == "data" and "allocations" not in response:
+                # Counter is only in diagnostic build (ALLOC_COUNTER define)
+                return {
+                    "status": "SKIP",
+                    "expected": "type=data with allocations",
+                    "actual": "no allocations field",
+                    "details": "Service is built without ALLOC_COUNTER"
+                }
+            if not response or response.get("type") != "data" or "allocations" not in response:
+                return {
+                    "status": "FAIL",
+                    "expected": "type=data with allocations",
+                    "actual": json.dumps(response)[:200] if response else "None",
+                    "error": "No allocation count"
+                }
+            counts.append(response["allocations"])
+            time.sleep(0.5)
+
+        # First responses can grow buffers
+        if any(count != 0 for count in counts[3:]):
+            return {
+                "status": "FAIL",
+                "expected": "allocations=0 in steady state",
+                "actual": f"allocations={counts}",
+                "error": "get_data path allocates"
+            }
+
+        return {
+            "status": "PASS",
+            "expected": "allocations=0 in steady state",
+            "actual": f"allocations={counts}",
+            "details": "Buffers keep capacity between responses"
+        }
+
     def run_all(self):
         """Run all data retrieval tests"""
         logging.info(f"\n{'='*70}")
@@ -978,6 +1410,18 @@ class DataRetrievalTests(MAX30009TestSuite):
                      self.test_continuous_data_polling)
         self.run_test("Buffer Overflow Test", "DATA-006",
                      self.test_buffer_overflow)
+        self.run_test("Cursor Reads", "DATA-007",
+                     self.test_cursor_reads)
+        self.run_test("Long Poll", "DATA-008",
+                     self.test_long_poll)
+        self.run_test("Sample Timestamps", "DATA-009",
+                     self.test_sample_timestamps)
+        self.run_test("Preview Envelope", "DATA-010",
+                     self.test_preview_envelope)
+        self.run_test("Raw I/Q Passthrough", "DATA-011",
+                     self.test_raw_iq_passthrough)
+        self.run_test("Allocation-free Get Data", "DATA-012",
+                     self.test_allocation_free_get_data)
 
 
 # ============================================================================
@@ -1110,6 +1554,48 @@ class CalibrationTests(MAX30009TestSuite):
             "details": f"Frequencies: {FREQUENCY_POINTS_COUNT}, Current indices: {CURRENT_POINTS_COUNT}"
         }
 
+    def test_recalibrate_point_in_use(self):
+        """Test recalibration of the point currently in use"""
+        response = self.client.send_command({"type": "recalibrate"})
+        self.client.send_command({"type": "stop_calibrate"})
+
+        if response and response.get("type") == "calibrate_started" and response.get("points_count") == 1:
+            return {
+                "status": "PASS",
+                "expected": '{"type":"calibrate_started","points_count":1}',
+                "actual": json.dumps(response),
+                "details": "Single point recalibration started"
+            }
+        else:
+            return {
+                "status": "FAIL",
+                "expected": '{"type":"calibrate_started","points_count":1}',
+                "actual": json.dumps(response) if response else "None",
+                "error": "Failed to start single point recalibration"
+            }
+
+    def test_calibration_quality_report(self):
+        """Test calibration quality report covers all points"""
+        response = self.client.send_command({"type": "get_calibration_quality"})
+        total_combinations = FREQUENCY_POINTS_COUNT * CURRENT_POINTS_COUNT
+
+        if response and response.get("type") == "calibration_quality" and len(response.get("points", [])) == total_combinations \
+                and "bad_store_file" in response:
+            valid_count = sum(1 for point in response["points"] if point.get("valid"))
+            return {
+                "status": "PASS",
+                "expected": f"{total_combinations} points in report",
+                "actual": f"{valid_count} of {total_combinations} points calibrated",
+                "details": json.dumps(response["points"][0])
+            }
+        else:
+            return {
+                "status": "FAIL",
+                "expected": f"calibration_quality with {total_combinations} points",
+                "actual": json.dumps(response) if response else "None",
+                "error": "Wrong calibration quality report"
+            }
+
     def run_all(self):
         """Run all calibration tests"""
         logging.info(f"\n{'='*70}")
@@ -1126,6 +1612,10 @@ class CalibrationTests(MAX30009TestSuite):
                      self.test_resume_after_calibration)
         self.run_test("Calibration Coverage", "CALIB-005",
                      self.test_calibration_coverage)
+        self.run_test("Recalibrate Point In Use", "CALIB-006",
+                     self.test_recalibrate_point_in_use)
+        self.run_test("Calibration Quality Report", "CALIB-007",
+                     self.test_calibration_quality_report)
 
 
 # ============================================================================
@@ -0,0 +1,159 @@
+"""
+Session recording tests (device RECORDER, port 1290)
+
+Recorder writes ECG samples, ICG points and sync marks to records/session_YYYYMMDD_HHMMSS_mmm/ and exports them to BDF+.
+Run: pytest test_recorder.py
+"""
+
+import os
+import time
+
+import pytest
+
+from conftest import MUX_PORT, QUERY_PORT, send_command
+
+# records directory of service, BDF file is checked when it is reachable from test host
+RECORDS_DIR = os.environ.get("SENSOR_RECORDS_DIR", "records")
+
+
+def recorder(command):
+    """Command of recorder device, returns its response"""
+    response = send_command(MUX_PORT, dict(device="RECORDER", **command))
+    assert response["device"] == "RECORDER"
+    return response["response"]
+
+
+@pytest.fixture
+def recording(ecg_running, icg_running):
+    response = recorder({"type": "start_recording", "fsync_interval_ms": 1000})
+    assert response["type"] == "recording_status"
+    yield response
+    recorder({"type": "stop_recording"})
+
+
+def wait_export():
+    status = recorder({"type": "get_recording_status"})
+    deadline = time.time() + 60
+    while status["export_state"] == "running" and time.time() < deadline:
+        time.sleep(1)
+        status = recorder({"type": "get_recording_status"})
+    return status
+
+
+def test_record_session(recording):
+    assert recording["is_recording"] is True
+    assert recording["session"].startswith("session_")
+    time.sleep(5)
+    status = recorder({"type": "get_recording_status"})
+    assert status["session"] == recording["session"]
+    assert status["chunks_written"] > 0 and status["bytes_written"] > 0
+    assert status["lost_ECG_samples"] == 0 and status["lost_ICG_samples"] == 0
+    assert status["dropped_chunks"] == 0 and status["write_errors"] == 0
+    status = recorder({"type": "stop_recording"})
+    assert status["is_recording"] is False
+    assert status["session"] == recording["session"]
+
+
+def test_second_start_is_busy(recording):
+    assert recorder({"type": "start_recording"})["type"] == "error busy"
+
+
+def test_restart_in_same_second_is_new_session(ecg_running, icg_running):
+    first = recorder({"type": "start_recording", "fsync_interval_ms": 0})
+    time.sleep(0.2)
+    stopped = recorder({"type": "stop_recording"})
+    # writer finishes queued chunks before next start
+    second = recorder({"type": "start_recording", "fsync_interval_ms": 0})
+    deadline = time.time() + 5
+    while second["type"] == "error busy" and time.time() < deadline:
+        time.sleep(0.05)
+        second = recorder({"type": "start_recording", "fsync_interval_ms": 0})
+    try:
+        assert second["type"] == "recording_status"
+        assert second["session"] != first["session"]
+    finally:
+        recorder({"type": "stop_recording"})
+    # files of first session are not overwritten
+    sessions = {session["name"]: session for session in send_command(QUERY_PORT, {"type": "list_sessions"})["sessions"]}
+    assert sessions[first["session"]]["size"] >= stopped["bytes_written"] > 0
+
+
+def test_fsync_interval_limit():
+    response = recorder({"type": "start_recording", "fsync_interval_ms": 120000})
+    try:
+        assert response["fsync_interval_ms"] == 60000
+    finally:
+        recorder({"type": "stop_recording"})
+
+
+def test_export_of_recorded_session_is_busy(recording):
+    assert recorder({"type": "export_bdf", "session": recording["session"]})["type"] == "error busy"
+
+
+@pytest.mark.parametrize("session", ["../calib", "session_1/segment_000000.rec", ".."])
+def test_export_session_path(session):
+    assert recorder({"type": "export_bdf", "session": session})["type"] == "error session"
+
+
+def test_export_bdf(recording):
+    time.sleep(3)
+    recorder({"type": "stop_recording"})
+    response = recorder({"type": "export_bdf", "session": recording["session"]})
+    assert response["export_state"] in ("running", "done")
+    status = wait_export()
+    assert status["export_state"] == "done"
+    assert status["export_file"].endswith(recording["session"] + ".bdf")
+
+
+def session_sync_marks(session):
+    """Sync marks of whole session from session query"""
+    marks = []
+    from_time_ns = 0
+    while True:
+        response = send_command(QUERY_PORT, {"type": "query", "session": session, "signal": "ICG",
+                                             "from_time_ns": from_time_ns, "decimation": 65536})
+        assert response["type"] == "query_data"
+        marks.extend(response["sync_marks"])
+        if response["data_size"] == 0:
+            return marks
+        from_time_ns = response["next_time_ns"]
+
+
+def BDF_annotations(filename):
+    """Texts of annotations of all data records of BDF+ file"""
+    with open(filename, "rb") as file:
+        data = file.read()
+    header_size = int(data[184:192])
+    records = int(data[236:244])
+    signals = int(data[252:256])
+    offset = 256 + signals * 216
+    samples = [int(data[offset + 8 * i:offset + 8 * i + 8]) for i in range(signals)]
+    record_size = sum(samples) * 3
+    assert len(data) == header_size + records * record_size
+    texts = []
+    for record in range(records):
+        end = header_size + (record + 1) * record_size
+        for tal in data[end - samples[-1] * 3:end].split(b"\x00"):
+            fields = tal.split(b"\x14")
+            # time keeping TAL has empty text
+            if len(fields) > 2 and fields[1]:
+                texts.append(fields[1].decode())
+    return texts
+
+
+def test_long_session_keeps_all_annotations(recording):
+    time.sleep(60)
+    recorder({"type": "stop_recording"})
+    marks = session_sync_marks(recording["session"])
+    recorder({"type": "export_bdf", "session": recording["session"]})
+    status = wait_export()
+    assert status["export_state"] == "done"
+    filename = os.path.join(RECORDS_DIR, recording["session"], recording["session"] + ".bdf")
+    if not os.path.exists(filename):
+        pytest.skip(f"{filename} is not reachable, set SENSOR_RECORDS_DIR")
+    texts = BDF_annotations(filename)
+    assert len([text for text in texts if text.startswith("sync ")]) == len(marks)
+
+
+def test_unknown_command():
+    assert recorder({"type": "pause_recording"})["type"] == "error JSON"
@@ -0,0 +1,114 @@
+"""
+Session query tests (port 1295)
+
+Recorded sessions are read by time range as JSON or binary (little endian int32 records after JSON line).
+Run: pytest test_session_query.py
+"""
+
+import struct
+import time
+
+import pytest
+
+from conftest import ADS1293_PORT, MAX30009_PORT, MUX_PORT, QUERY_PORT, send_command, ServiceConnection
+
+
+@pytest.fixture(scope="module")
+def recorded_session():
+    """Session of 5 s with both sensors, ECG at 640 Hz"""
+    send_command(ADS1293_PORT, {"type": "settings", "power_enable": True, "enable_conversion": True,
+                                "R2_rate": 5, "R3_rate": 8})
+    send_command(MAX30009_PORT, {"type": "settings", "power_enable": True, "measure_enable": True,
+                                 "measure_frequency": 100})
+    time.sleep(1)
+    response = send_command(MUX_PORT, {"device": "RECORDER", "type": "start_recording", "fsync_interval_ms": 0})
+    assert response["response"]["type"] == "recording_status"
+    time.sleep(5)
+    send_command(MUX_PORT, {"device": "RECORDER", "type": "stop_recording"})
+    return response["response"]["session"]
+
+
+def query(command):
+    return send_command(QUERY_PORT, dict(type="query", **command))
+
+
+def query_binary(command):
+    """JSON line and records of binary query"""
+    connection = ServiceConnection(QUERY_PORT)
+    try:
+        response = connection.send(dict(type="query", encoding="binary", **command))
+        data = connection.read_binary(response.get("byte_size", 0))
+    finally:
+        connection.close()
+    channels = response.get("channels", 1)
+    values = struct.unpack("<%di" % (len(data) // 4), data)
+    return response, [list(values[i:i + channels]) for i in range(0, len(values), channels)]
+
+
+def test_list_sessions(recorded_session):
+    response = send_command(QUERY_PORT, {"type": "list_sessions"})
+    assert response["type"] == "sessions"
+    sessions = {session["name"]: session for session in response["sessions"]}
+    assert recorded_session in sessions
+    assert sessions[recorded_session]["segments"] >= 1 and sessions[recorded_session]["size"] > 0
+    assert sessions[recorded_session]["is_recording"] is False
+
+
+def test_json_query_cursor(recorded_session):
+    response = query({"session": recorded_session, "signal": "ECG", "max_samples": 1000})
+    assert response["type"] == "query_data"
+    assert response["channels"] == 3 and response["record_size"] == 12
+    assert len(response["data"]) == response["data_size"] == 1000
+    following = query({"session": recorded_session, "signal": "ECG", "from_time_ns": response["next_time_ns"],
+                       "max_samples": 1000})
+    assert following["first_time_ns"] >= response["next_time_ns"]
+    # next part starts at next sample of the grid
+    assert following["first_time_ns"] - response["next_time_ns"] < 1e9 / response["sample_rate"]
+
+
+def test_decimation(recorded_session):
+    full = query({"session": recorded_session, "signal": "ECG"})
+    decimated = query({"session": recorded_session, "signal": "ECG", "decimation": 4})
+    assert decimated["decimation"] == 4
+    assert decimated["sample_rate"] == pytest.approx(full["sample_rate"] / 4)
+    assert abs(decimated["data_size"] - full["data_size"] // 4) <= 1
+    # mean of block
+    first_block = full["data"][:4]
+    for channel in range(3):
+        assert abs(decimated["data"][0][channel] - sum(point[channel] for point in first_block) / 4) <= 1
+
+
+def test_ICG_query(recorded_session):
+    response = query({"session": recorded_session, "signal": "ICG", "max_samples": 100})
+    assert response["signal"] == "ICG" and response["channels"] == 5
+    assert all(len(point) == 5 for point in response["data"])
+
+
+def test_binary_equals_json(recorded_session):
+    response = query({"session": recorded_session, "signal": "ECG", "max_samples": 500})
+    binary_response, records = query_binary({"session": recorded_session, "signal": "ECG", "max_samples": 500})
+    assert binary_response["encoding"] == "binary"
+    assert binary_response["byte_size"] == binary_response["data_size"] * binary_response["record_size"]
+    assert binary_response["first_time_ns"] == response["first_time_ns"]
+    assert records == response["data"]
+
+
+@pytest.mark.parametrize("command", [
+    {"signal": "EEG"},
+    {"signal": "ECG", "encoding": "xml"},
+    {"signal": "ICG", "decimation": 0},
+    {"signal": "ICG", "decimation": 65537},
+    {"signal": "ECG", "from_time": "yesterday"},
+    {"signal": "ECG", "from_time_ns": 2000000000000000000, "to_time_ns": 1000000000000000000},
+])
+def test_query_error_JSON(command):
+    assert query(command)["type"] == "error JSON"
+
+
+@pytest.mark.parametrize("session", ["../calib", "session_1/segment", "session_00000000_000000"])
+def test_query_error_session(session):
+    assert query({"session": session, "signal": "ECG"})["type"] == "error session"
+
+
+def test_unknown_command():
+    assert send_command(QUERY_PORT, {"type": "get_sessions"})["type"] == "error JSON"
@@ -0,0 +1,32 @@
+"""
+Host tests of signal processing templates (pytest)
+
+Header-only detectors and filters of SPI_DEV_servise/include are tested on synthetic signals without
+the service: every SPI_DEV_servise/tests/test_*.cpp is compiled with host g++ and must exit with 0.
+
+Run: pytest test_signal_processing.py
+"""
+
+import glob
+import os
+import shutil
+import subprocess
+
+import pytest
+
+SERVICE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "SPI_DEV_servise")
+TEST_SOURCES = sorted(glob.glob(os.path.join(SERVICE_DIR, "tests", "test_*.cpp")))
+
+
+@pytest.mark.parametrize("source", TEST_SOURCES, ids=[os.path.basename(s) for s in TEST_SOURCES])
+def test_host_program(source, tmp_path):
+    compiler = shutil.which("g++")
+    if compiler is None:
+        pytest.skip("g++ is not available")
+    program = str(tmp_path / "test_program")
+    build = subprocess.run([compiler, "-std=c++17", "-O2", "-Wall", "-I" + os.path.join(SERVICE_DIR, "include"),
+                            source, "-o", program], capture_output=True, text=True)
+    assert build.returncode == 0, build.stderr
+    run = subprocess.run([program], capture_output=True, text=True, timeout=300)
+    print(run.stdout)
+    assert run.returncode == 0, run.stdout
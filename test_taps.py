@@ -0,0 +1,131 @@
+"""
+Output tap tests (ports 1293 and 30009)
+
+Tap is named stream with own decimation and filter of the same acquisition, read as get_data.
+Run: pytest test_taps.py
+"""
+
+import time
+
+import pytest
+
+from conftest import ADS1293_PORT, MAX30009_PORT, send_command
+
+MAX_TAPS = 8
+
+
+def remove_all_taps(port):
+    # tap which is source of other tap is removed after it
+    for tap in reversed(send_command(port, {"type": "get_taps"})["taps"]):
+        send_command(port, {"type": "remove_tap", "tap": tap["tap"]})
+
+
+@pytest.fixture(params=[(ADS1293_PORT, 3), (MAX30009_PORT, 5)], ids=["ADS1293", "MAX30009"])
+def device(request, ecg_running, icg_running):
+    """Port and channels of point"""
+    port = request.param[0]
+    remove_all_taps(port)
+    yield request.param
+    remove_all_taps(port)
+
+
+def add_chain(port):
+    response = send_command(port, {"type": "add_tap", "tap": "fast", "filter": "fir", "decimation": 2})
+    assert response["type"] == "taps"
+    return send_command(port, {"type": "add_tap", "tap": "trend", "source": "fast", "decimation": 5})
+
+
+def test_add_and_list(device):
+    port, channels = device
+    response = add_chain(port)
+    assert [tap["tap"] for tap in response["taps"]] == ["fast", "trend"]
+    fast, trend = response["taps"]
+    assert fast["source"] == "raw" and fast["filter"] == "fir" and fast["decimation"] == 2
+    assert trend["source"] == "fast" and trend["filter"] == "mean" and trend["decimation"] == 5
+    assert fast["sample_rate"] / trend["sample_rate"] == pytest.approx(5)
+
+
+def test_rate_is_rounded_to_decimation():
+    response = send_command(ADS1293_PORT, {"type": "settings", "power_enable": True, "enable_conversion": True,
+                                           "R2_rate": 5, "R3_rate": 8})
+    assert response["type"] == "actual_settings"
+    remove_all_taps(ADS1293_PORT)
+    try:
+        # 640 Hz / 125 Hz
+        response = send_command(ADS1293_PORT, {"type": "add_tap", "tap": "monitor", "rate": 125})
+        assert response["taps"][0]["decimation"] == 5
+    finally:
+        remove_all_taps(ADS1293_PORT)
+
+
+def test_tap_data_cursor(device):
+    port, channels = device
+    add_chain(port)
+    time.sleep(2)
+    first = send_command(port, {"type": "get_tap_data", "tap": "fast", "from_seq": 0, "max_samples": 50})
+    assert first["type"] == "tap_data" and first["tap"] == "fast"
+    assert first["data_size"] == len(first["data"]) == first["next_seq"] - first["first_seq"]
+    assert all(len(point) == channels for point in first["data"])
+    following = send_command(port, {"type": "get_tap_data", "tap": "fast", "from_seq": first["next_seq"]})
+    assert following["first_seq"] == first["next_seq"]
+    assert following["skipped_samples"] == 0
+    # time of samples continues on tap rate
+    expected_ns = first["first_sample_time_ns"] + first["data_size"] * 1e9 / first["sample_rate"]
+    assert abs(following["first_sample_time_ns"] - expected_ns) < 1e9 / first["sample_rate"]
+
+
+def test_decimated_tap_rate(device):
+    port, channels = device
+    add_chain(port)
+    time.sleep(2)
+    fast = send_command(port, {"type": "get_tap_data", "tap": "fast"})
+    trend = send_command(port, {"type": "get_tap_data", "tap": "trend"})
+    assert fast["sample_rate"] / trend["sample_rate"] == pytest.approx(5, rel=0.01)
+    assert all(len(point) == channels for point in trend["data"])
+
+
+def test_default_reader_does_not_repeat(device):
+    port, channels = device
+    add_chain(port)
+    time.sleep(1)
+    first = send_command(port, {"type": "get_tap_data", "tap": "trend"})
+    second = send_command(port, {"type": "get_tap_data", "tap": "trend"})
+    assert second["first_seq"] >= first["next_seq"]
+    assert "lost_samples" in second
+
+
+@pytest.mark.parametrize("command", [
+    {"tap": "fast", "decimation": 2},
+    {"tap": "raw", "decimation": 2},
+    {"tap": "", "decimation": 2},
+    {"tap": "slow", "source": "unknown", "decimation": 2},
+    {"tap": "slow", "filter": "iir", "decimation": 2},
+    {"tap": "slow"},
+])
+def test_add_error(device, command):
+    port, channels = device
+    add_chain(port)
+    assert send_command(port, dict(type="add_tap", **command))["type"] == "error tap"
+    assert len(send_command(port, {"type": "get_taps"})["taps"]) == 2
+
+
+def test_tap_limit(device):
+    port, channels = device
+    for i in range(MAX_TAPS):
+        assert send_command(port, {"type": "add_tap", "tap": "tap%d" % i, "decimation": 10})["type"] == "taps"
+    assert send_command(port, {"type": "add_tap", "tap": "extra", "decimation": 10})["type"] == "error tap"
+
+
+def test_remove(device):
+    port, channels = device
+    add_chain(port)
+    assert send_command(port, {"type": "remove_tap", "tap": "fast"})["type"] == "error tap"
+    assert send_command(port, {"type": "remove_tap", "tap": "unknown"})["type"] == "error tap"
+    response = send_command(port, {"type": "remove_tap", "tap": "trend"})
+    assert [tap["tap"] for tap in response["taps"]] == ["fast"]
+    assert send_command(port, {"type": "remove_tap", "tap": "fast"})["taps"] == []
+
+
+def test_tap_data_of_unknown_tap(device):
+    port, channels = device
+    assert send_command(port, {"type": "get_tap_data", "tap": "unknown"})["type"] == "error tap"